@@ -19,8 +19,25 @@
 #define SPI_FLASH_ON_SF_DEV_KIT  0
 #define SPI_FLASH_ON_SF_EVAL_KIT 1
 
+/* The PDMA channels are allocated by spi_flash_init() */
 #define USE_DMA_FOR_SPI_FLASH 1
-#define SPI_FLASH_DMA_CHANNEL 0
+
+/* Widest SPI frame used with the flash: 8, 16 or 32 bits */
+#define SPI_FLASH_MAX_FRAME_BITS 32
+
+/* Read cache of the SPI Flash: pages of 256 bytes kept, 0 for no cache, and
+   pages read ahead when reads follow each other. Reads longer than the read
+   ahead go straight to the flash. */
+#define SPI_FLASH_CACHE_PAGES     8
+#define SPI_FLASH_CACHE_READAHEAD 4
+
+/* Configuration for the key/value store on the SPI Flash, see
+   flash_store/flash_store.h. The store takes FLASH_STORE_BLOCKS 4 KB blocks
+   from FLASH_STORE_BASE, two of which are kept for garbage collection. */
+#define FLASH_STORE_BASE      0x00700000UL
+#define FLASH_STORE_BLOCKS    16
+#define FLASH_STORE_MAX_KEYS  32
+#define FLASH_STORE_MAX_VALUE 256
 
 #endif
 
@@ -0,0 +1,657 @@
+/*******************************************************************************
+ *  flash_store.c: Log-structured key/value store on the SPI flash.
+ *
+ *  A block is a 16 byte header followed by records, each a record header and
+ *  the value padded to 4 bytes. The erased flash reads 0xFF: the first all
+ *  0xFF record header ends the log of a block, and the header fields written
+ *  after the erase (seq when the block is opened, magic cleared when it is
+ *  collected) only clear bits.
+ */
+#include <stddef.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "../spi_flash_driver/spi_flash.h"
+#include "flash_store.h"
+
+#if FLASH_STORE_BLOCKS < 3
+#error "FLASH_STORE_BLOCKS must be at least 3, one spare and one to collect"
+#endif
+
+#define BLOCK_SIZE              4096UL
+#define BLOCK_HDR_SIZE          sizeof(block_hdr_t)
+#define BLOCK_PAYLOAD           (BLOCK_SIZE - BLOCK_HDR_SIZE)
+#define REC_HDR_SIZE            sizeof(rec_hdr_t)
+#define REC_SIZE(length)        ((REC_HDR_SIZE + (uint32_t)(length) + 3UL) & ~3UL)
+
+/* Live values are kept two blocks below the store size so that collecting the
+   oldest block always frees space */
+#define CAPACITY                ((FLASH_STORE_BLOCKS - 2) * BLOCK_PAYLOAD)
+
+#define SEQ_FREE                0xFFFFFFFFUL
+#define FLAGS_VALUE             0xFFFFu
+#define FLAGS_DELETED           0xFFFEu
+
+/* read_record() results */
+#define REC_END                 0
+#define REC_VALID               1
+#define REC_TORN                2
+
+typedef struct block_hdr {
+    uint32_t magic;             /* FLASH_STORE_MAGIC, 0 once being collected */
+    uint32_t erase_count;
+    uint32_t seq;               /* order in the log, SEQ_FREE until opened */
+    uint32_t reserved;
+} block_hdr_t;
+
+typedef struct rec_hdr {
+    uint16_t key;
+    uint16_t length;
+    uint16_t flags;             /* FLAGS_VALUE or FLAGS_DELETED */
+    uint16_t crc;               /* CRC-16-CCITT of the fields above and the value */
+} rec_hdr_t;
+
+typedef enum {
+    BLOCK_DIRTY = 0,            /* to be erased before use */
+    BLOCK_FREE,
+    BLOCK_USED
+} block_state_t;
+
+static struct {
+    uint32_t erase_count;
+    uint32_t seq;
+    uint8_t state;
+} blocks[FLASH_STORE_BLOCKS];
+
+/* Latest record of each key */
+static struct {
+    uint32_t address;
+    uint16_t key;
+    uint16_t length;
+} index_table[FLASH_STORE_MAX_KEYS];
+static uint32_t index_count;
+
+static xSemaphoreHandle lock;
+static uint8_t mounted;
+static uint32_t active;         /* block the records are appended to */
+static uint32_t write_offset;   /* of the next record in the active block */
+static uint32_t next_seq;
+static flash_store_stats_t stats;
+
+/* Record being written or read back, header first */
+static union {
+    uint32_t align;
+    uint8_t bytes[REC_HDR_SIZE + FLASH_STORE_MAX_VALUE];
+} rec_buf;
+#define REC_HDR                 ((rec_hdr_t *)rec_buf.bytes)
+
+static uint16_t crc16(uint16_t crc, const uint8_t *data, uint32_t length)
+{
+    uint32_t i;
+
+    while (length--) {
+        crc ^= (uint16_t)(*data++ << 8);
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x8000u) ? (uint16_t)((crc << 1) ^ 0x1021u) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/* CRC of the record in rec_buf, everything but the crc field */
+static uint16_t record_crc(void)
+{
+    uint16_t crc = crc16(0xFFFFu, rec_buf.bytes, offsetof(rec_hdr_t, crc));
+
+    return crc16(crc, rec_buf.bytes + REC_HDR_SIZE, REC_HDR->length);
+}
+
+static uint32_t block_address(uint32_t block)
+{
+    return FLASH_STORE_BASE + block * BLOCK_SIZE;
+}
+
+static int32_t flash_read(uint32_t address, void *data, uint32_t length)
+{
+    if (spi_flash_read(address, (uint8_t *)data, length) != SPI_FLASH_SUCCESS) {
+        return FLASH_STORE_ERR_IO;
+    }
+    return FLASH_STORE_OK;
+}
+
+static int32_t flash_write(uint32_t address, const void *data, uint32_t length)
+{
+    if (spi_flash_write(address, (uint8_t *)data, length) != SPI_FLASH_SUCCESS) {
+        return FLASH_STORE_ERR_IO;
+    }
+    return FLASH_STORE_OK;
+}
+
+static uint32_t free_blocks(void)
+{
+    uint32_t b;
+    uint32_t count = 0;
+
+    for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+        if (blocks[b].state == BLOCK_FREE) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static int32_t index_find(uint16_t key)
+{
+    uint32_t i;
+
+    for (i = 0; i < index_count; i++) {
+        if (index_table[i].key == key) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+/* Makes the record of rec_buf, written at address, the latest of its key */
+static int32_t index_update(uint32_t address)
+{
+    int32_t i = index_find(REC_HDR->key);
+
+    if (i >= 0) {
+        stats.live_bytes -= REC_SIZE(index_table[i].length);
+        if (REC_HDR->flags == FLAGS_DELETED) {
+            index_table[i] = index_table[--index_count];
+            return FLASH_STORE_OK;
+        }
+    } else {
+        if (REC_HDR->flags == FLAGS_DELETED) {
+            return FLASH_STORE_OK;
+        }
+        if (index_count == FLASH_STORE_MAX_KEYS) {
+            return FLASH_STORE_ERR_NO_KEYS;
+        }
+        i = (int32_t)index_count++;
+        index_table[i].key = REC_HDR->key;
+    }
+    index_table[i].address = address;
+    index_table[i].length = REC_HDR->length;
+    stats.live_bytes += REC_SIZE(REC_HDR->length);
+    return FLASH_STORE_OK;
+}
+
+/* Erases a block and writes its header, leaving it free */
+static int32_t prepare_block(uint32_t block, uint32_t erase_count)
+{
+    block_hdr_t hdr;
+
+    blocks[block].state = BLOCK_DIRTY;
+    if (spi_flash_control_hw(SPI_FLASH_4KBLOCK_ERASE, block_address(block), NULL) != SPI_FLASH_SUCCESS) {
+        return FLASH_STORE_ERR_IO;
+    }
+    stats.erases++;
+
+    hdr.magic = FLASH_STORE_MAGIC;
+    hdr.erase_count = erase_count;
+    hdr.seq = SEQ_FREE;
+    hdr.reserved = 0xFFFFFFFFUL;
+    if (flash_write(block_address(block), &hdr, sizeof(hdr)) != FLASH_STORE_OK) {
+        return FLASH_STORE_ERR_IO;
+    }
+    blocks[block].erase_count = erase_count;
+    blocks[block].seq = SEQ_FREE;
+    blocks[block].state = BLOCK_FREE;
+    return FLASH_STORE_OK;
+}
+
+/* Makes the least erased free block the head of the log */
+static int32_t open_block(void)
+{
+    uint32_t b;
+    uint32_t best = FLASH_STORE_BLOCKS;
+    uint32_t seq = next_seq;
+
+    for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+        if ((blocks[b].state == BLOCK_FREE) &&
+            ((best == FLASH_STORE_BLOCKS) || (blocks[b].erase_count < blocks[best].erase_count))) {
+            best = b;
+        }
+    }
+    if (best == FLASH_STORE_BLOCKS) {
+        return FLASH_STORE_ERR_FULL;
+    }
+
+    if (flash_write(block_address(best) + offsetof(block_hdr_t, seq), &seq, sizeof(seq)) != FLASH_STORE_OK) {
+        return FLASH_STORE_ERR_IO;
+    }
+    next_seq++;
+    blocks[best].seq = seq;
+    blocks[best].state = BLOCK_USED;
+    active = best;
+    write_offset = BLOCK_HDR_SIZE;
+    return FLASH_STORE_OK;
+}
+
+/* Reads the record at offset in block into rec_buf */
+static int32_t read_record(uint32_t block, uint32_t offset)
+{
+    if (offset + REC_HDR_SIZE > BLOCK_SIZE) {
+        return REC_END;
+    }
+    if (flash_read(block_address(block) + offset, REC_HDR, REC_HDR_SIZE) != FLASH_STORE_OK) {
+        return FLASH_STORE_ERR_IO;
+    }
+    if ((REC_HDR->key == 0xFFFFu) && (REC_HDR->length == 0xFFFFu) &&
+        (REC_HDR->flags == 0xFFFFu) && (REC_HDR->crc == 0xFFFFu)) {
+        return REC_END;
+    }
+    if ((REC_HDR->length > FLASH_STORE_MAX_VALUE) ||
+        (offset + REC_SIZE(REC_HDR->length) > BLOCK_SIZE) ||
+        ((REC_HDR->flags != FLAGS_VALUE) && (REC_HDR->flags != FLAGS_DELETED))) {
+        return REC_TORN;
+    }
+    if ((REC_HDR->length > 0) &&
+        (flash_read(block_address(block) + offset + REC_HDR_SIZE,
+                    rec_buf.bytes + REC_HDR_SIZE, REC_HDR->length) != FLASH_STORE_OK)) {
+        return FLASH_STORE_ERR_IO;
+    }
+    return (record_crc() == REC_HDR->crc) ? REC_VALID : REC_TORN;
+}
+
+/* Appends the record of rec_buf to the active block, which has room for it */
+static int32_t write_record(void)
+{
+    uint32_t address = block_address(active) + write_offset;
+
+    /* A failed write may leave a torn record, never write over it */
+    write_offset += REC_SIZE(REC_HDR->length);
+    if (flash_write(address, rec_buf.bytes, REC_HDR_SIZE + REC_HDR->length) != FLASH_STORE_OK) {
+        return FLASH_STORE_ERR_IO;
+    }
+    return index_update(address);
+}
+
+/* Replays the records of a block into the index, returns the end of its log */
+static int32_t replay_block(uint32_t block)
+{
+    uint32_t offset = BLOCK_HDR_SIZE;
+    int32_t status;
+
+    for (;;) {
+        status = read_record(block, offset);
+        if (status < 0) {
+            return status;
+        }
+        if (status == REC_END) {
+            return (int32_t)offset;
+        }
+        if (status == REC_TORN) {
+            /* Nothing after a torn record can be trusted, nor written */
+            stats.torn++;
+            return (int32_t)BLOCK_SIZE;
+        }
+        /* Keys beyond the index are dropped when FLASH_STORE_MAX_KEYS shrank */
+        (void)index_update(block_address(block) + offset);
+        offset += REC_SIZE(REC_HDR->length);
+    }
+}
+
+/* Moves the live records of the oldest block to the head of the log and
+   erases it. The active block must have room for a whole block of records. */
+static int32_t collect(void)
+{
+    uint32_t b;
+    uint32_t victim = FLASH_STORE_BLOCKS;
+    uint32_t offset = BLOCK_HDR_SIZE;
+    uint32_t zero = 0;
+    int32_t status;
+    int32_t i;
+
+    for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+        if ((blocks[b].state == BLOCK_USED) && (b != active) &&
+            ((victim == FLASH_STORE_BLOCKS) || (blocks[b].seq < blocks[victim].seq))) {
+            victim = b;
+        }
+    }
+    if (victim == FLASH_STORE_BLOCKS) {
+        return FLASH_STORE_ERR_FULL;
+    }
+
+    for (;;) {
+        status = read_record(victim, offset);
+        if (status < 0) {
+            return status;
+        }
+        if (status != REC_VALID) {
+            break;
+        }
+        i = index_find(REC_HDR->key);
+        if ((i >= 0) && (index_table[i].address == block_address(victim) + offset)) {
+            if (write_offset + REC_SIZE(REC_HDR->length) > BLOCK_SIZE) {
+                return FLASH_STORE_ERR_FULL;
+            }
+            status = write_record();
+            if (status != FLASH_STORE_OK) {
+                return status;
+            }
+            stats.gc_copies++;
+        }
+        /* Deleted keys and older values are dropped: the victim is the oldest
+           block, nothing older can be uncovered */
+        offset += REC_SIZE(REC_HDR->length);
+    }
+
+    /* Invalidated first, a block half erased by a power failure is not replayed */
+    if (flash_write(block_address(victim) + offsetof(block_hdr_t, magic), &zero, sizeof(zero)) != FLASH_STORE_OK) {
+        return FLASH_STORE_ERR_IO;
+    }
+    blocks[victim].state = BLOCK_DIRTY;
+    stats.gc_runs++;
+    return prepare_block(victim, blocks[victim].erase_count + 1);
+}
+
+/* Makes room for size bytes of record at the head of the log */
+static int32_t ensure_space(uint32_t size)
+{
+    uint32_t tries;
+    int32_t status;
+
+    for (tries = 0; write_offset + size > BLOCK_SIZE; tries++) {
+        if (tries == FLASH_STORE_BLOCKS) {
+            return FLASH_STORE_ERR_FULL;
+        }
+        status = open_block();
+        if ((status == FLASH_STORE_OK) && (free_blocks() == 0)) {
+            /* Keep a spare for the next block to open */
+            status = collect();
+        }
+        if (status != FLASH_STORE_OK) {
+            return status;
+        }
+    }
+    return FLASH_STORE_OK;
+}
+
+static int32_t append(uint16_t key, uint16_t flags, const void *data, uint16_t length)
+{
+    int32_t i;
+    int32_t status;
+    uint32_t live;
+
+    if (!mounted || (key == FLASH_STORE_KEY_INVALID)) {
+        return FLASH_STORE_ERR_ARG;
+    }
+
+    i = index_find(key);
+    if (flags == FLAGS_VALUE) {
+        if ((i < 0) && (index_count == FLASH_STORE_MAX_KEYS)) {
+            return FLASH_STORE_ERR_NO_KEYS;
+        }
+        live = stats.live_bytes + REC_SIZE(length);
+        if (i >= 0) {
+            live -= REC_SIZE(index_table[i].length);
+        }
+        if (live > CAPACITY) {
+            return FLASH_STORE_ERR_FULL;
+        }
+    } else if (i < 0) {
+        return FLASH_STORE_ERR_NOT_FOUND;
+    }
+
+    status = ensure_space(REC_SIZE(length));
+    if (status != FLASH_STORE_OK) {
+        return status;
+    }
+
+    REC_HDR->key = key;
+    REC_HDR->length = length;
+    REC_HDR->flags = flags;
+    if (length > 0) {
+        memcpy(rec_buf.bytes + REC_HDR_SIZE, data, length);
+    }
+    REC_HDR->crc = record_crc();
+    return write_record();
+}
+
+static int32_t format(void)
+{
+    uint32_t b;
+    int32_t status;
+
+    mounted = 0;
+    index_count = 0;
+    stats.live_bytes = 0;
+    next_seq = 0;
+    for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+        status = prepare_block(b, blocks[b].erase_count + 1);
+        if (status != FLASH_STORE_OK) {
+            return status;
+        }
+    }
+    status = open_block();
+    if (status == FLASH_STORE_OK) {
+        mounted = 1;
+    }
+    return status;
+}
+
+static int32_t mount(void)
+{
+    block_hdr_t hdr;
+    uint32_t b;
+    uint32_t last;
+    uint32_t next;
+    uint32_t max_erase_count = 0;
+    uint8_t found = 0;
+    int32_t status;
+
+    mounted = 0;
+    index_count = 0;
+    stats.live_bytes = 0;
+    stats.torn = 0;
+
+    for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+        if (flash_read(block_address(b), &hdr, sizeof(hdr)) != FLASH_STORE_OK) {
+            return FLASH_STORE_ERR_IO;
+        }
+        blocks[b].seq = hdr.seq;
+        if (hdr.magic == FLASH_STORE_MAGIC) {
+            blocks[b].state = (hdr.seq == SEQ_FREE) ? BLOCK_FREE : BLOCK_USED;
+            found = 1;
+        } else {
+            blocks[b].state = BLOCK_DIRTY;
+        }
+        /* Unknown when the block was being erased */
+        blocks[b].erase_count = ((hdr.magic == FLASH_STORE_MAGIC) || (hdr.magic == 0)) ? hdr.erase_count : 0;
+        if ((blocks[b].erase_count != 0xFFFFFFFFUL) && (blocks[b].erase_count > max_erase_count)) {
+            max_erase_count = blocks[b].erase_count;
+        }
+    }
+    if (!found) {
+        for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+            blocks[b].erase_count = 0;
+        }
+        return format();
+    }
+
+    /* Replay the used blocks from the oldest */
+    last = SEQ_FREE;
+    for (;;) {
+        next = FLASH_STORE_BLOCKS;
+        for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+            if ((blocks[b].state == BLOCK_USED) &&
+                ((last == SEQ_FREE) || (blocks[b].seq > blocks[last].seq)) &&
+                ((next == FLASH_STORE_BLOCKS) || (blocks[b].seq < blocks[next].seq))) {
+                next = b;
+            }
+        }
+        if (next == FLASH_STORE_BLOCKS) {
+            break;
+        }
+        status = replay_block(next);
+        if (status < 0) {
+            return status;
+        }
+        active = next;
+        write_offset = (uint32_t)status;
+        next_seq = blocks[next].seq + 1;
+        last = next;
+    }
+
+    for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+        if (blocks[b].state == BLOCK_DIRTY) {
+            if ((blocks[b].erase_count == 0) || (blocks[b].erase_count == 0xFFFFFFFFUL)) {
+                blocks[b].erase_count = max_erase_count;
+            }
+            status = prepare_block(b, blocks[b].erase_count + 1);
+            if (status != FLASH_STORE_OK) {
+                return status;
+            }
+        }
+    }
+
+    if (last == SEQ_FREE) {
+        status = open_block();
+    } else if (free_blocks() == 0) {
+        /* Power lost during a collection, finish it */
+        status = collect();
+    } else {
+        status = FLASH_STORE_OK;
+    }
+    if (status == FLASH_STORE_OK) {
+        mounted = 1;
+    }
+    return status;
+}
+
+/***************************************************************************//**
+ *  See flash_store.h for more information.
+ */
+int32_t flash_store_init(void)
+{
+    int32_t status;
+
+    if (lock == NULL) {
+        vSemaphoreCreateBinary(lock);
+        if (lock == NULL) {
+            return FLASH_STORE_ERR_IO;
+        }
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (spi_flash_control_hw(SPI_FLASH_GLOBAL_UNPROTECT, 0, NULL) != SPI_FLASH_SUCCESS) {
+        status = FLASH_STORE_ERR_IO;
+    } else {
+        status = mount();
+    }
+    xSemaphoreGive(lock);
+    return status;
+}
+
+/***************************************************************************//**
+ *  See flash_store.h for more information.
+ */
+int32_t flash_store_format(void)
+{
+    int32_t status;
+
+    if (lock == NULL) {
+        return FLASH_STORE_ERR_ARG;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    status = format();
+    xSemaphoreGive(lock);
+    return status;
+}
+
+/***************************************************************************//**
+ *  See flash_store.h for more information.
+ */
+int32_t flash_store_write(uint16_t key, const void *data, uint16_t length)
+{
+    int32_t status;
+
+    if (length > FLASH_STORE_MAX_VALUE) {
+        return FLASH_STORE_ERR_TOO_BIG;
+    }
+    if (lock == NULL) {
+        return FLASH_STORE_ERR_ARG;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    status = append(key, FLAGS_VALUE, data, length);
+    if (status == FLASH_STORE_OK) {
+        stats.writes++;
+    }
+    xSemaphoreGive(lock);
+    return status;
+}
+
+/***************************************************************************//**
+ *  See flash_store.h for more information.
+ */
+int32_t flash_store_read(uint16_t key, void *data, uint16_t size)
+{
+    int32_t i;
+    int32_t status;
+    uint16_t length;
+
+    if (lock == NULL) {
+        return FLASH_STORE_ERR_ARG;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    i = mounted ? index_find(key) : -1;
+    if (i < 0) {
+        status = mounted ? FLASH_STORE_ERR_NOT_FOUND : FLASH_STORE_ERR_ARG;
+    } else {
+        length = index_table[i].length;
+        status = length;
+        if ((size > 0) && (length > 0) &&
+            (flash_read(index_table[i].address + REC_HDR_SIZE, data,
+                        (length < size) ? length : size) != FLASH_STORE_OK)) {
+            status = FLASH_STORE_ERR_IO;
+        }
+    }
+    xSemaphoreGive(lock);
+    return status;
+}
+
+/***************************************************************************//**
+ *  See flash_store.h for more information.
+ */
+int32_t flash_store_delete(uint16_t key)
+{
+    int32_t status;
+
+    if (lock == NULL) {
+        return FLASH_STORE_ERR_ARG;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    status = append(key, FLAGS_DELETED, NULL, 0);
+    if (status == FLASH_STORE_OK) {
+        stats.writes++;
+    }
+    xSemaphoreGive(lock);
+    return status;
+}
+
+/***************************************************************************//**
+ *  See flash_store.h for more information.
+ */
+void flash_store_get_stats(flash_store_stats_t *out)
+{
+    uint32_t b;
+
+    *out = stats;
+    out->keys = index_count;
+    out->min_erase_count = 0xFFFFFFFFUL;
+    out->max_erase_count = 0;
+    for (b = 0; b < FLASH_STORE_BLOCKS; b++) {
+        if (blocks[b].erase_count < out->min_erase_count) {
+            out->min_erase_count = blocks[b].erase_count;
+        }
+        if (blocks[b].erase_count > out->max_erase_count) {
+            out->max_erase_count = blocks[b].erase_count;
+        }
+    }
+}
@@ -0,0 +1,106 @@
+/*******************************************************************************
+ *  flash_store.h: Log-structured key/value store on the SPI flash.
+ *
+ *  Values are appended as records to a log kept in FLASH_STORE_BLOCKS blocks
+ *  of 4 KB from FLASH_STORE_BASE, so updating a value costs one page program
+ *  instead of erasing and rewriting a whole block. The latest record of a key
+ *  holds its value; a RAM index of FLASH_STORE_MAX_KEYS entries points to it.
+ *
+ *  Blocks are used in turn: when the block being written is full the next
+ *  free one is opened, and when the last spare block is opened the oldest
+ *  block is garbage collected, its live records copied to the head of the log
+ *  before it is erased. Every block is thus erased as often as the others, and
+ *  its erase count is kept in its header.
+ *
+ *  A record is committed when its CRC matches: a record torn by a power
+ *  failure is ignored at the next flash_store_init(), together with anything
+ *  after it in its block, and the previous value of the key is kept. A block
+ *  being collected is invalidated before it is erased so that none of its
+ *  records can reappear.
+ *
+ *  spi_flash_init() must have been called before flash_store_init(). The
+ *  functions may be called from several tasks but not from interrupts.
+ */
+#ifndef FLASH_STORE_H_
+#define FLASH_STORE_H_
+
+#include <stdint.h>
+#include "../bsp_config.h"
+
+#define FLASH_STORE_MAGIC       0x5453464CUL    /* "LFST" */
+
+/* Return values, functions returning a length return one of these when < 0 */
+#define FLASH_STORE_OK              0
+#define FLASH_STORE_ERR_IO          (-1)    /* SPI flash operation failed */
+#define FLASH_STORE_ERR_NOT_FOUND   (-2)    /* key never written or deleted */
+#define FLASH_STORE_ERR_FULL        (-3)    /* live values fill the store */
+#define FLASH_STORE_ERR_TOO_BIG     (-4)    /* over FLASH_STORE_MAX_VALUE */
+#define FLASH_STORE_ERR_NO_KEYS     (-5)    /* FLASH_STORE_MAX_KEYS in use */
+#define FLASH_STORE_ERR_ARG         (-6)    /* reserved key or not mounted */
+
+/* Key value that cannot be used, it marks the erased flash */
+#define FLASH_STORE_KEY_INVALID     0xFFFFu
+
+typedef struct flash_store_stats {
+    uint32_t writes;            /* records appended by the application */
+    uint32_t gc_runs;           /* blocks collected */
+    uint32_t gc_copies;         /* live records moved by the collection */
+    uint32_t erases;            /* blocks erased */
+    uint32_t torn;              /* torn records found by the last init */
+    uint32_t min_erase_count;
+    uint32_t max_erase_count;
+    uint32_t live_bytes;        /* flash taken by the current values */
+    uint32_t keys;
+} flash_store_stats_t;
+
+/***************************************************************************//**
+ * Mounts the store: reads the block headers, replays the log into the index
+ * and repairs the blocks left unfinished by a power failure. The store is
+ * formatted when no block holds a valid header.
+ *
+ * @return              FLASH_STORE_OK or FLASH_STORE_ERR_IO
+ */
+int32_t flash_store_init(void);
+
+/***************************************************************************//**
+ * Erases every block of the store, losing all values, and mounts it empty.
+ *
+ * @return              FLASH_STORE_OK or FLASH_STORE_ERR_IO
+ */
+int32_t flash_store_format(void);
+
+/***************************************************************************//**
+ * Sets the value of a key. The value is on the flash when the function
+ * returns.
+ *
+ * @param key           any value but FLASH_STORE_KEY_INVALID
+ * @param data          value
+ * @param length        value length, up to FLASH_STORE_MAX_VALUE bytes
+ * @return              FLASH_STORE_OK or an error
+ */
+int32_t flash_store_write(uint16_t key, const void *data, uint16_t length);
+
+/***************************************************************************//**
+ * Reads the value of a key.
+ *
+ * @param key           key
+ * @param data          buffer for the value
+ * @param size          size of the buffer, a longer value is truncated
+ * @return              length of the value or an error
+ */
+int32_t flash_store_read(uint16_t key, void *data, uint16_t size);
+
+/***************************************************************************//**
+ * Removes a key.
+ *
+ * @param key           key
+ * @return              FLASH_STORE_OK, FLASH_STORE_ERR_NOT_FOUND or an error
+ */
+int32_t flash_store_delete(uint16_t key);
+
+/***************************************************************************//**
+ * Copies the store counters.
+ */
+void flash_store_get_stats(flash_store_stats_t *stats);
+
+#endif /* FLASH_STORE_H_ */
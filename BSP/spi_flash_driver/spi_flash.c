@@ -8,9 +8,16 @@
  *
  */
 
+#include <string.h>
+
 #include "spi_flash.h"
 #include "../drivers/mss_spi/mss_spi.h"
+#include "../drivers/spi_bus/spi_bus.h"
+#include "../drivers/cycle_counter/cycle_counter.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
 #ifdef USE_DMA_FOR_SPI_FLASH
 #include "../drivers/mss_pdma/mss_pdma.h"
 #endif
@@ -43,19 +50,54 @@
 #define BLOCK_ALIGN_MASK_32K     0xFFFF8000
 #define BLOCK_ALIGN_MASK_64K     0xFFFF0000
 
+/* A read is opcode, address and two dummy bytes then the data, at most 64K
+   frames per SPI transfer */
+#define READ_CMD_SIZE             6
+#define READ_CHUNK_SIZE           0x8000
+
+/* Longest single wait, the 16 bit tick count wraps every 65 ms */
+#define WAIT_SLICE_MS             50
+#define US_TO_TICKS(us)           ((portTickType)(((us) * (configTICK_RATE_HZ / 1000UL)) / 1000UL))
+
+/* Typical and maximum busy times of the AT25DF641, in microseconds */
+#define PAGE_PROGRAM_TYP_US       1500UL
+#define PAGE_PROGRAM_MAX_US       5000UL
+#define ERASE_4K_TYP_US           50000UL
+#define ERASE_4K_MAX_US           200000UL
+#define ERASE_32K_TYP_US          250000UL
+#define ERASE_32K_MAX_US          600000UL
+#define ERASE_64K_TYP_US          400000UL
+#define ERASE_64K_MAX_US          950000UL
+#define CHIP_ERASE_TYP_US         32000000UL
+#define CHIP_ERASE_MAX_US         64000000UL
+#define COMMAND_TYP_US            0UL
+#define COMMAND_MAX_US            10000UL
+
+/* Shortest poll period once the typical time is over, doubled up to
+   WAIT_SLICE_MS at every poll */
+#define POLL_MIN_US               100UL
+
+/* Time of one READ_STATUS transfer at PCLK/256, to bound the polls before the
+   scheduler runs */
+#define POLL_TRANSFER_US          42UL
+
 
 #if (SPI_FLASH_ON_SF_DEV_KIT == 1)
 #define SPI_INSTANCE    &g_mss_spi1
 #define SPI_SLAVE       MSS_SPI_SLAVE_0
 #define DMA_TO_PERI     PDMA_TO_SPI_1
+#define DMA_FROM_PERI   PDMA_FROM_SPI_1
 #define SPI_DEST_TXBUFF 0x40011014
+#define SPI_SRC_RXBUFF  0x40011010
 #endif
 
 #if (SPI_FLASH_ON_SF_EVAL_KIT == 1)
 #define SPI_INSTANCE    &g_mss_spi0
 #define SPI_SLAVE       MSS_SPI_SLAVE_0
 #define DMA_TO_PERI     PDMA_TO_SPI_0
+#define DMA_FROM_PERI   PDMA_FROM_SPI_0
 #define SPI_DEST_TXBUFF 0x40001014
+#define SPI_SRC_RXBUFF  0x40001010
 #endif
 
 #if ((SPI_FLASH_ON_SF_DEV_KIT == 1) && (SPI_FLASH_ON_SF_EVAL_KIT == 1))
@@ -63,25 +105,190 @@
         based on board usage in bsp_config.h"
 #endif
 
+/* Operation the flash may be busy with, selects the polling of wait_ready() */
+typedef enum {
+    FLASH_OP_COMMAND = 0,
+    FLASH_OP_PAGE_PROGRAM,
+    FLASH_OP_ERASE_4K,
+    FLASH_OP_ERASE_32K,
+    FLASH_OP_ERASE_64K,
+    FLASH_OP_CHIP_ERASE
+} flash_op_t;
+
+static const struct
+{
+    uint32_t typ_us;
+    uint32_t max_us;
+} g_flash_op_time[] =
+{
+    { COMMAND_TYP_US,       COMMAND_MAX_US },
+    { PAGE_PROGRAM_TYP_US,  PAGE_PROGRAM_MAX_US },
+    { ERASE_4K_TYP_US,      ERASE_4K_MAX_US },
+    { ERASE_32K_TYP_US,     ERASE_32K_MAX_US },
+    { ERASE_64K_TYP_US,     ERASE_64K_MAX_US },
+    { CHIP_ERASE_TYP_US,    CHIP_ERASE_MAX_US }
+};
+
+/* Set when an operation is started, cleared by the wait for its end */
+static flash_op_t g_flash_op = FLASH_OP_COMMAND;
+
 static uint8_t wait_ready( void );
+static spi_flash_status_t command_failed( uint8_t write_enabled );
+static spi_flash_status_t read_array( uint32_t address, uint8_t * rx_buffer, size_t size_in_bytes );
+
+/* Commands and polled reads, in frames as wide as the transfer size allows:
+   the flash sees the transaction as a bit stream */
+#define spi_transfer( cmd_buffer, cmd_byte_size, rd_buffer, rd_byte_size ) \
+    MSS_SPI_transfer_block_burst( SPI_INSTANCE, (cmd_buffer), (cmd_byte_size), 0, \
+                                  (rd_buffer), (rd_byte_size), SPI_FLASH_MAX_FRAME_BITS )
+
+/* Held by each command sequence and by reads through the cache, see
+   bus_acquire(), when the SPI is not shared through spi_bus_init() */
+static xSemaphoreHandle g_flash_lock;
+
+/* The flash as a device of the bus, if there is one */
+static const spi_bus_device_t g_flash_device =
+{
+    SPI_INSTANCE,
+    SPI_SLAVE,
+    MSS_SPI_MODE3,
+    MSS_SPI_PCLK_DIV_256,
+    SPI_FLASH_MAX_FRAME_BITS
+};
+
+#if SPI_FLASH_CACHE_PAGES > 0
+#define CACHE_EMPTY               0xFFFFFFFFUL
+
+/* Pages of the flash last read, replaced in turn so that the pages read ahead
+   land in consecutive lines and are filled by a single read */
+static struct
+{
+    uint8_t data[SPI_FLASH_CACHE_PAGES][NB_BYTES_PER_PAGE];
+    uint32_t page[SPI_FLASH_CACHE_PAGES];   /* address, CACHE_EMPTY if unused */
+    uint32_t next_line;                     /* to be replaced next */
+    uint32_t next_address;                  /* following the previous read */
+} g_cache;
+
+static spi_flash_cache_stats_t g_cache_stats;
+
+static void cache_invalidate( uint32_t address, uint32_t size );
+#else
+#define cache_invalidate( address, size )
+#endif
+
+#ifdef USE_DMA_FOR_SPI_FLASH
+/* Read in progress, see spi_flash_read_async() */
+static struct
+{
+    xSemaphoreHandle done;          /* given by the DMA interrupt at the end */
+    volatile uint8_t busy;
+    uint8_t release_bus;            /* by the DMA interrupt at the end */
+    uint8_t buffers_done;           /* of the two of the current chunk */
+    uint8_t cmd[READ_CMD_SIZE];
+    uint8_t cmd_rx[READ_CMD_SIZE];  /* what comes in while the command goes out */
+    uint32_t address;
+    uint8_t * buffer;
+    uint16_t chunk;
+    size_t remaining;               /* after the current chunk */
+} g_flash_read;
+
+/* PDMA channels of the driver, allocated by spi_flash_init() */
+static pdma_channel_id_t g_dma_tx_channel;
+static pdma_channel_id_t g_dma_rx_channel;
+static uint8_t g_dma_allocated;
+
+static spi_flash_status_t dma_read_start( uint32_t address, uint8_t * rx_buffer,
+                                          size_t size_in_bytes, uint8_t release_bus );
+static void dma_read_chunk( void );
+static void dma_read_isr( void );
+static spi_flash_status_t dma_read_abort( void );
+#endif
+
+/*******************************************************************************
+ * Takes the SPI against the other devices of the bus when it is shared through
+ * spi_bus_init(), the lock of the driver otherwise, against the other tasks
+ * using the flash and its cache.
+ */
+static void bus_acquire( void )
+{
+    if ( spi_bus_present( SPI_INSTANCE ) )
+    {
+        (void)spi_bus_acquire( SPI_INSTANCE, portMAX_DELAY );
+    }
+    else if ( g_flash_lock != NULL )
+    {
+        xSemaphoreTake( g_flash_lock, portMAX_DELAY );
+    }
+}
+
+/*******************************************************************************
+ * Gives back what bus_acquire() took.
+ */
+static void bus_release( void )
+{
+    if ( spi_bus_present( SPI_INSTANCE ) )
+    {
+        spi_bus_release( SPI_INSTANCE );
+    }
+    else if ( g_flash_lock != NULL )
+    {
+        xSemaphoreGive( g_flash_lock );
+    }
+}
+
+#ifdef USE_DMA_FOR_SPI_FLASH
+/*******************************************************************************
+ * Same as bus_release(), from the PDMA interrupt.
+ */
+static void bus_release_from_isr( portBASE_TYPE * woken )
+{
+    if ( spi_bus_present( SPI_INSTANCE ) )
+    {
+        spi_bus_release_from_isr( SPI_INSTANCE, woken );
+    }
+    else if ( g_flash_lock != NULL )
+    {
+        xSemaphoreGiveFromISR( g_flash_lock, woken );
+    }
+}
+#endif
 
 /******************************************************************************
  *For more details please refer the spi_flash.h file
  ******************************************************************************/
 spi_flash_status_t spi_flash_init( void )
 {
+#if SPI_FLASH_CACHE_PAGES > 0
+    spi_flash_cache_invalidate();
+#endif
     /*--------------------------------------------------------------------------
-     * Configure MSS_SPI.
+     * Configure MSS_SPI, unless the bus manager owns it and the other devices
+     * on it are already configured.
      */
-    MSS_SPI_init( SPI_INSTANCE );
-    MSS_SPI_configure_master_mode
-    (
-        SPI_INSTANCE,
-        SPI_SLAVE,
-        MSS_SPI_MODE3,
-        MSS_SPI_PCLK_DIV_256,
-        MSS_SPI_BLOCK_TRANSFER_FRAME_SIZE
-    );
+    if ( spi_bus_present( SPI_INSTANCE ) )
+    {
+        spi_bus_add_device( &g_flash_device );
+    }
+    else
+    {
+        MSS_SPI_init( SPI_INSTANCE );
+        MSS_SPI_configure_master_mode
+        (
+            SPI_INSTANCE,
+            SPI_SLAVE,
+            MSS_SPI_MODE3,
+            MSS_SPI_PCLK_DIV_256,
+            MSS_SPI_BLOCK_TRANSFER_FRAME_SIZE
+        );
+        if ( g_flash_lock == NULL )
+        {
+            vSemaphoreCreateBinary( g_flash_lock );
+            if ( g_flash_lock == NULL )
+            {
+                return SPI_FLASH_UNSUCCESS;
+            }
+        }
+    }
 
 
 #ifdef USE_DMA_FOR_SPI_FLASH
@@ -90,22 +297,64 @@ spi_flash_status_t spi_flash_init( void )
      */
     PDMA_init();
 
-    PDMA_configure
-    (
-        SPI_FLASH_DMA_CHANNEL,
-        DMA_TO_PERI,
-        PDMA_LOW_PRIORITY | PDMA_BYTE_TRANSFER | PDMA_INC_SRC_ONE_BYTE,
-        PDMA_DEFAULT_WRITE_ADJ
-    );
+    if ( !g_dma_allocated )
+    {
+        int32_t tx_channel;
+        int32_t rx_channel;
+
+        tx_channel = PDMA_allocate_channel
+        (
+            DMA_TO_PERI,
+            PDMA_LOW_PRIORITY | PDMA_BYTE_TRANSFER | PDMA_INC_SRC_ONE_BYTE,
+            PDMA_DEFAULT_WRITE_ADJ,
+            &g_flash_read
+        );
+
+        /* The receive side must keep up with the 4 frame FIFO of the SPI */
+        rx_channel = PDMA_allocate_channel
+        (
+            DMA_FROM_PERI,
+            PDMA_HIGH_PRIORITY | PDMA_BYTE_TRANSFER | PDMA_INC_DEST_ONE_BYTE,
+            PDMA_DEFAULT_WRITE_ADJ,
+            &g_flash_read
+        );
+
+        if ( ( tx_channel == PDMA_NO_CHANNEL ) || ( rx_channel == PDMA_NO_CHANNEL ) )
+        {
+            if ( tx_channel != PDMA_NO_CHANNEL )
+            {
+                PDMA_free_channel( (pdma_channel_id_t)tx_channel, &g_flash_read );
+            }
+            return SPI_FLASH_UNSUCCESS;
+        }
+        g_dma_tx_channel = (pdma_channel_id_t)tx_channel;
+        g_dma_rx_channel = (pdma_channel_id_t)rx_channel;
+        g_dma_allocated = 1;
+    }
+
+    if ( g_flash_read.done == NULL )
+    {
+        vSemaphoreCreateBinary( g_flash_read.done );
+        if ( g_flash_read.done == NULL )
+        {
+            return SPI_FLASH_UNSUCCESS;
+        }
+    }
+    xSemaphoreTake( g_flash_read.done, 0 );
+    g_flash_read.busy = 0;
+
+    /* The completion is signalled to tasks from the interrupt */
+    NVIC_SetPriority( DMA_IRQn, configMAX_SYSCALL_INTERRUPT_PRIORITY >> (8 - __NVIC_PRIO_BITS) );
+    PDMA_set_irq_handler( g_dma_rx_channel, dma_read_isr );
 #endif
     return 0;
 }
 
 /******************************************************************************
- *For more details please refer the spi_flash.h file
+ * Runs an operation of spi_flash_control_hw() with the bus held.
  ******************************************************************************/
-spi_flash_status_t
-spi_flash_control_hw
+static spi_flash_status_t
+control_hw
 (
     spi_flash_control_hw_t operation,
     uint32_t peram1,
@@ -121,11 +370,10 @@ spi_flash_control_hw
 
             MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE,
-                                    &read_device_id_cmd,
-                                    1,
-                                    read_buffer,
-                                    sizeof(read_buffer) );
+            spi_transfer( &read_device_id_cmd,
+                          1,
+                          read_buffer,
+                          sizeof(read_buffer) );
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
 
             ptrDevInfo->manufacturer_id = read_buffer[0];
@@ -143,9 +391,9 @@ spi_flash_control_hw
             /* Send Write Enable command */
             cmd_buffer[0] = WRITE_ENABLE_CMD;
             if(wait_ready())
-                   return SPI_FLASH_UNSUCCESS; 
+                   return command_failed( 0 );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+            spi_transfer( cmd_buffer, 1, 0, 0 );
 
             /* protect sector */
             cmd_buffer[0] = PROTECT_SECTOR_OPCODE;
@@ -153,13 +401,12 @@ spi_flash_control_hw
             cmd_buffer[2] = (address >> 8 ) & 0xFF;
             cmd_buffer[3] = address & 0xFF;
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE,
-                                    cmd_buffer,
-                                    sizeof(cmd_buffer),
-                                    0,
-                                    0 );
+            spi_transfer( cmd_buffer,
+                          sizeof(cmd_buffer),
+                          0,
+                          0 );
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
 
         }
@@ -174,9 +421,9 @@ spi_flash_control_hw
             /* Send Write Enable command */
             cmd_buffer[0] = WRITE_ENABLE_CMD;
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 0 );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+            spi_transfer( cmd_buffer, 1, 0, 0 );
 
             /* Unprotect sector */
             cmd_buffer[0] = UNPROTECT_SECTOR_OPCODE;
@@ -184,13 +431,12 @@ spi_flash_control_hw
             cmd_buffer[2] = (address >> 8 ) & 0xFF;
             cmd_buffer[3] = address & 0xFF;
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE,
-                                    cmd_buffer,
-                                    sizeof(cmd_buffer),
-                                    0,
-                                    0 );
+            spi_transfer( cmd_buffer,
+                          sizeof(cmd_buffer),
+                          0,
+                          0 );
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
 
         }
@@ -204,21 +450,21 @@ spi_flash_control_hw
             cmd_buffer[0] = WRITE_ENABLE_CMD;
 
             if(wait_ready())
-               return SPI_FLASH_UNSUCCESS; 
+               return command_failed( 0 );
 
             MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
-            MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+            spi_transfer( cmd_buffer, 1, 0, 0 );
 
             /* Send Chip Erase command */
             cmd_buffer[0] = WRITE_STATUS1_OPCODE;
             cmd_buffer[1] = 0;
 
             if(wait_ready())
-               return SPI_FLASH_UNSUCCESS; 
+               return command_failed( 1 );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 2, 0, 0 );
+            spi_transfer( cmd_buffer, 2, 0, 0 );
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
 
@@ -227,24 +473,27 @@ spi_flash_control_hw
         case SPI_FLASH_CHIP_ERASE:
         {
             uint8_t cmd_buffer;
+
+            cache_invalidate( 0, 0xFFFFFFFFUL );
             /* Send Write Enable command */
             cmd_buffer = WRITE_ENABLE_CMD;
 
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 0 );
 
             MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
-            MSS_SPI_transfer_block( SPI_INSTANCE, &cmd_buffer, 1, 0, 0 );
+            spi_transfer( &cmd_buffer, 1, 0, 0 );
 
             /* Send Chip Erase command */
             cmd_buffer = CHIP_ERASE_OPCODE;
 
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE, &cmd_buffer, 1, 0, 0 );
+            spi_transfer( &cmd_buffer, 1, 0, 0 );
+            g_flash_op = FLASH_OP_CHIP_ERASE;
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
         }
@@ -256,12 +505,12 @@ spi_flash_control_hw
             cmd_buffer = WRITE_ENABLE_CMD;
 
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 0 );
 
             MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
-            MSS_SPI_transfer_block( SPI_INSTANCE, &cmd_buffer, 1, 0, 0 );
+            spi_transfer( &cmd_buffer, 1, 0, 0 );
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
 
@@ -272,14 +521,16 @@ spi_flash_control_hw
         {
             uint32_t address = peram1 & BLOCK_ALIGN_MASK_4K;
             uint8_t cmd_buffer[4];
+
+            cache_invalidate( address, 0x1000UL );
             /* Send Write Enable command */
             cmd_buffer[0] = WRITE_ENABLE_CMD;
 
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 0 );
 
             MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
-            MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+            spi_transfer( cmd_buffer, 1, 0, 0 );
 
             /* Send Chip Erase command */
             cmd_buffer[0] = ERASE_4K_BLOCK_OPCODE;
@@ -288,15 +539,15 @@ spi_flash_control_hw
             cmd_buffer[3] = address & 0xFF;
 
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE,
-                                    cmd_buffer,
-                                    sizeof(cmd_buffer),
-                                    0,
-                                    0 );
+            spi_transfer( cmd_buffer,
+                          sizeof(cmd_buffer),
+                          0,
+                          0 );
+            g_flash_op = FLASH_OP_ERASE_4K;
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
         }
         break;
@@ -304,12 +555,16 @@ spi_flash_control_hw
         {
             uint32_t address = peram1 & BLOCK_ALIGN_MASK_32K;
             uint8_t cmd_buffer[4];
+
+            cache_invalidate( address, 0x8000UL );
             /* Send Write Enable command */
             cmd_buffer[0] = WRITE_ENABLE_CMD;
 
-            wait_ready();
+            if(wait_ready())
+                return command_failed( 0 );
+
             MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
-            MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+            spi_transfer( cmd_buffer, 1, 0, 0 );
 
             /* Send Chip Erase command */
             cmd_buffer[0] = ERASE_32K_BLOCK_OPCODE;
@@ -318,15 +573,15 @@ spi_flash_control_hw
             cmd_buffer[3] = address & 0xFF;
 
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
-            MSS_SPI_transfer_block( SPI_INSTANCE,
-                                    cmd_buffer,
-                                    sizeof(cmd_buffer),
-                                    0,
-                                    0 );
+            spi_transfer( cmd_buffer,
+                          sizeof(cmd_buffer),
+                          0,
+                          0 );
+            g_flash_op = FLASH_OP_ERASE_32K;
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
         }
@@ -335,14 +590,16 @@ spi_flash_control_hw
         {
             uint32_t address = peram1 & BLOCK_ALIGN_MASK_64K;
             uint8_t cmd_buffer[4];
+
+            cache_invalidate( address, 0x10000UL );
             /* Send Write Enable command */
             cmd_buffer[0] = WRITE_ENABLE_CMD;
 
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 0 );
 
             MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
-            MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+            spi_transfer( cmd_buffer, 1, 0, 0 );
 
              /* Send Chip Erase command */
             cmd_buffer[0] = ERASE_64K_BLOCK_OPCODE;
@@ -351,14 +608,14 @@ spi_flash_control_hw
             cmd_buffer[3] = address & 0xFF;
 
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
-            MSS_SPI_transfer_block( SPI_INSTANCE,
-                                    cmd_buffer,
-                                    sizeof(cmd_buffer),
-                                    0,
-                                    0 );
+                return command_failed( 1 );
+            spi_transfer( cmd_buffer,
+                          sizeof(cmd_buffer),
+                          0,
+                          0 );
+            g_flash_op = FLASH_OP_ERASE_64K;
             if(wait_ready())
-                return SPI_FLASH_UNSUCCESS; 
+                return command_failed( 1 );
 
             MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
         }
@@ -368,11 +625,10 @@ spi_flash_control_hw
             uint8_t status;
             uint8_t command = READ_STATUS;
 
-            MSS_SPI_transfer_block( SPI_INSTANCE,
-                                    &command,
-                                    sizeof(uint8_t),
-                                    &status,
-                                    sizeof(status) );
+            spi_transfer( &command,
+                          sizeof(uint8_t),
+                          &status,
+                          sizeof(status) );
             return status;
         }
         break;
@@ -384,6 +640,189 @@ spi_flash_control_hw
     return 0;
 }
 
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_control_hw
+(
+    spi_flash_control_hw_t operation,
+    uint32_t peram1,
+    void *   ptrPeram
+)
+{
+    spi_flash_status_t status;
+
+    bus_acquire();
+    status = control_hw( operation, peram1, ptrPeram );
+    bus_release();
+    return status;
+}
+
+
+#if SPI_FLASH_CACHE_PAGES > 0
+/*******************************************************************************
+ * Returns the cache line holding a page or -1.
+ */
+static int32_t cache_lookup( uint32_t page )
+{
+    uint32_t line;
+
+    for ( line = 0; line < SPI_FLASH_CACHE_PAGES; line++ )
+    {
+        if ( g_cache.page[line] == page )
+        {
+            return (int32_t)line;
+        }
+    }
+    return -1;
+}
+
+/*******************************************************************************
+ * Reads up to count pages from page into consecutive cache lines with one
+ * READ_ARRAY command. The pages after the first are read ahead only up to the
+ * last line and the first page already cached. Returns the line of page.
+ */
+static int32_t cache_fill( uint32_t page, uint32_t count )
+{
+    uint32_t first;
+    uint32_t i;
+
+    if ( g_cache.next_line == SPI_FLASH_CACHE_PAGES )
+    {
+        g_cache.next_line = 0;
+    }
+    first = g_cache.next_line;
+    if ( count > SPI_FLASH_CACHE_PAGES - first )
+    {
+        count = SPI_FLASH_CACHE_PAGES - first;
+    }
+    for ( i = 1; i < count; i++ )
+    {
+        if ( cache_lookup( page + i * NB_BYTES_PER_PAGE ) >= 0 )
+        {
+            count = i;
+            break;
+        }
+    }
+
+    for ( i = 0; i < count; i++ )
+    {
+        g_cache.page[first + i] = CACHE_EMPTY;
+    }
+    if ( read_array( page, g_cache.data[first], count * NB_BYTES_PER_PAGE ) != SPI_FLASH_SUCCESS )
+    {
+        return -1;
+    }
+    for ( i = 0; i < count; i++ )
+    {
+        g_cache.page[first + i] = page + i * NB_BYTES_PER_PAGE;
+    }
+    g_cache.next_line = first + count;
+    g_cache_stats.read_ahead += count - 1;
+    return (int32_t)first;
+}
+
+/*******************************************************************************
+ * Drops the cached pages overlapping a range about to be programmed or erased.
+ */
+static void cache_invalidate( uint32_t address, uint32_t size )
+{
+    uint32_t line;
+
+    for ( line = 0; line < SPI_FLASH_CACHE_PAGES; line++ )
+    {
+        if ( ( g_cache.page[line] != CACHE_EMPTY ) &&
+             ( g_cache.page[line] + NB_BYTES_PER_PAGE > address ) &&
+             ( g_cache.page[line] < address + size ) )
+        {
+            g_cache.page[line] = CACHE_EMPTY;
+            g_cache_stats.invalidated++;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Reads through the cache. The pages missing are read together, along with
+ * SPI_FLASH_CACHE_READAHEAD more when the read follows the previous one.
+ */
+static spi_flash_status_t cache_read
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes
+)
+{
+    uint32_t page;
+    uint32_t offset;
+    uint32_t count;
+    uint32_t last_page;
+    int32_t line;
+    uint8_t sequential = ( address == g_cache.next_address );
+
+    g_cache.next_address = address + size_in_bytes;
+    last_page = ( address + size_in_bytes - 1 ) & ~( NB_BYTES_PER_PAGE - 1 );
+
+    while ( size_in_bytes > 0 )
+    {
+        page = address & ~( NB_BYTES_PER_PAGE - 1 );
+        offset = address - page;
+        count = NB_BYTES_PER_PAGE - offset;
+        if ( count > size_in_bytes )
+        {
+            count = size_in_bytes;
+        }
+
+        line = cache_lookup( page );
+        if ( line >= 0 )
+        {
+            g_cache_stats.hits++;
+        }
+        else
+        {
+            g_cache_stats.misses++;
+            line = cache_fill( page, ( ( last_page - page ) / NB_BYTES_PER_PAGE ) + 1 +
+                                     ( sequential ? SPI_FLASH_CACHE_READAHEAD : 0 ) );
+            if ( line < 0 )
+            {
+                g_cache.next_address = CACHE_EMPTY;
+                return SPI_FLASH_UNSUCCESS;
+            }
+        }
+
+        memcpy( rx_buffer, &g_cache.data[line][offset], count );
+        rx_buffer += count;
+        address += count;
+        size_in_bytes -= count;
+    }
+    return SPI_FLASH_SUCCESS;
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+void spi_flash_cache_invalidate( void )
+{
+    uint32_t line;
+
+    bus_acquire();
+    for ( line = 0; line < SPI_FLASH_CACHE_PAGES; line++ )
+    {
+        g_cache.page[line] = CACHE_EMPTY;
+    }
+    g_cache.next_line = 0;
+    g_cache.next_address = CACHE_EMPTY;
+    bus_release();
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+void spi_flash_get_cache_stats( spi_flash_cache_stats_t * stats )
+{
+    *stats = g_cache_stats;
+}
+#endif
 
 /******************************************************************************
  *For more details please refer the spi_flash.h file
@@ -396,6 +835,50 @@ spi_flash_read
     size_t size_in_bytes
 )
 {
+    spi_flash_status_t status;
+
+    /* The cache lines are claimed, filled and tagged with the bus held, and
+       programs and erases invalidate them with the bus held */
+    bus_acquire();
+#if SPI_FLASH_CACHE_PAGES > 0
+    /* Long reads gain nothing from the cache and would flush it */
+    if ( size_in_bytes <= SPI_FLASH_CACHE_READAHEAD * NB_BYTES_PER_PAGE )
+    {
+        status = ( size_in_bytes == 0 ) ? SPI_FLASH_SUCCESS
+                                        : cache_read( address, rx_buffer, size_in_bytes );
+        bus_release();
+        return status;
+    }
+    g_cache_stats.bypassed++;
+    g_cache.next_address = address + size_in_bytes;
+#endif
+    status = read_array( address, rx_buffer, size_in_bytes );
+    bus_release();
+    return status;
+}
+
+/*******************************************************************************
+ * Reads the flash with a READ_ARRAY command, with the bus held.
+ */
+static spi_flash_status_t
+read_array
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes
+)
+{
+#ifdef USE_DMA_FOR_SPI_FLASH
+    if ( size_in_bytes == 0 )
+    {
+        return SPI_FLASH_SUCCESS;
+    }
+    if ( dma_read_start( address, rx_buffer, size_in_bytes, 0 ) != SPI_FLASH_SUCCESS )
+    {
+        return SPI_FLASH_UNSUCCESS;
+    }
+    return spi_flash_read_wait( SPI_FLASH_WAIT_FOREVER );
+#else
     uint8_t cmd_buffer[6];
 
     cmd_buffer[0] = READ_ARRAY_OPCODE;
@@ -407,73 +890,372 @@ spi_flash_read
 
     MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
     if(wait_ready())
-        return SPI_FLASH_UNSUCCESS; 
-    MSS_SPI_transfer_block( SPI_INSTANCE,
-                            cmd_buffer,
-                            sizeof(cmd_buffer),
-                            rx_buffer,
-                            size_in_bytes );
+        return command_failed( 0 );
+    spi_transfer( cmd_buffer,
+                  sizeof(cmd_buffer),
+                  rx_buffer,
+                  size_in_bytes );
     MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
     return 0;
+#endif
 }
 
+/*******************************************************************************
+ * Checksum comparing the data read by each method of spi_flash_measure_read().
+ */
+static uint32_t buffer_sum( const uint8_t * buffer, size_t size )
+{
+    uint32_t sum = 0;
+
+    while ( size-- > 0 )
+    {
+        sum = ( ( sum << 1 ) | ( sum >> 31 ) ) ^ *buffer++;
+    }
+    return sum;
+}
 
 /*******************************************************************************
- * This function sends the command and data on SPI
+ * Bytes per second of a transfer of size bytes lasting cycles.
  */
-static void write_cmd_data
+static uint32_t bytes_per_second( size_t size, uint32_t cycles )
+{
+    if ( cycles == 0 )
+    {
+        return 0;
+    }
+    return (uint32_t)( ( (uint64_t)size * configCPU_CLOCK_HZ ) / cycles );
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_measure_read
 (
-    mss_spi_instance_t * this_spi,
-    const uint8_t * cmd_buffer,
-    uint16_t cmd_byte_size,
-    uint8_t * data_buffer,
-    uint16_t data_byte_size
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes,
+    spi_flash_throughput_t * result
 )
 {
-    uint32_t transfer_size;
+    uint8_t cmd_buffer[READ_CMD_SIZE];
+    uint32_t start;
+    uint32_t sum;
+
+    if ( ( size_in_bytes == 0 ) || ( size_in_bytes > READ_CHUNK_SIZE ) )
+    {
+        return SPI_FLASH_UNSUCCESS;
+    }
+
+    cmd_buffer[0] = READ_ARRAY_OPCODE;
+    cmd_buffer[1] = (uint8_t)((address >> 16) & 0xFF);
+    cmd_buffer[2] = (uint8_t)((address >> 8) & 0xFF);
+    cmd_buffer[3] = (uint8_t)(address & 0xFF);
+    cmd_buffer[4] = DONT_CARE;
+    cmd_buffer[5] = DONT_CARE;
+
+    cycle_counter_enable();
 
-    transfer_size = cmd_byte_size + data_byte_size;
+    bus_acquire();
+    MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
+    if(wait_ready())
+    {
+        command_failed( 0 );
+        bus_release();
+        return SPI_FLASH_UNSUCCESS;
+    }
 
+    /* Reference: one byte frame per FIFO access */
+    start = cycle_counter_read();
+    MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, sizeof(cmd_buffer),
+                            rx_buffer, (uint16_t)size_in_bytes );
+    result->byte_frames = bytes_per_second( size_in_bytes, cycle_counter_read() - start );
+    sum = buffer_sum( rx_buffer, size_in_bytes );
+
+    memset( rx_buffer, 0, size_in_bytes );
+    start = cycle_counter_read();
+    spi_transfer( cmd_buffer, sizeof(cmd_buffer), rx_buffer, (uint16_t)size_in_bytes );
+    result->burst = bytes_per_second( size_in_bytes, cycle_counter_read() - start );
+    result->match = ( buffer_sum( rx_buffer, size_in_bytes ) == sum );
+    MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
+    bus_release();
 
 #ifdef USE_DMA_FOR_SPI_FLASH
+    /* Includes the completion interrupt and the wake up of this task */
+    memset( rx_buffer, 0, size_in_bytes );
+    start = cycle_counter_read();
+    if ( ( spi_flash_read_async( address, rx_buffer, size_in_bytes ) != SPI_FLASH_SUCCESS ) ||
+         ( spi_flash_read_wait( SPI_FLASH_WAIT_FOREVER ) != SPI_FLASH_SUCCESS ) )
+    {
+        return SPI_FLASH_UNSUCCESS;
+    }
+    result->dma = bytes_per_second( size_in_bytes, cycle_counter_read() - start );
+    result->match = result->match && ( buffer_sum( rx_buffer, size_in_bytes ) == sum );
+#else
+    result->dma = 0;
+#endif
+    return SPI_FLASH_SUCCESS;
+}
+
+#ifdef USE_DMA_FOR_SPI_FLASH
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_read_async
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes
+)
+{
+    /* Held until dma_read_isr() ends the read, so a read in progress is
+       waited for here */
+    bus_acquire();
+    if ( g_flash_read.busy )
+    {
+        bus_release();
+        return SPI_FLASH_UNSUCCESS;
+    }
+    if ( size_in_bytes == 0 )
+    {
+        bus_release();
+        xSemaphoreGive( g_flash_read.done );
+        return SPI_FLASH_SUCCESS;
+    }
+    if ( dma_read_start( address, rx_buffer, size_in_bytes, 1 ) != SPI_FLASH_SUCCESS )
+    {
+        bus_release();
+        return SPI_FLASH_UNSUCCESS;
+    }
+    return SPI_FLASH_SUCCESS;
+}
+
+/*******************************************************************************
+ * Starts a PDMA read with the bus held. With release_bus, the bus is handed
+ * over to dma_read_isr(), which gives it back at the end of the read;
+ * otherwise the caller keeps it and waits for the read.
+ */
+static spi_flash_status_t dma_read_start
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes,
+    uint8_t release_bus
+)
+{
+    MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
+    if(wait_ready())
+        return command_failed( 0 );
+
+    /* A completion nobody waited for must not end this read */
+    xSemaphoreTake( g_flash_read.done, 0 );
+    g_flash_read.busy = 1;
+    g_flash_read.release_bus = release_bus;
+    g_flash_read.address = address;
+    g_flash_read.buffer = rx_buffer;
+    g_flash_read.remaining = size_in_bytes;
+    dma_read_chunk();
+    return SPI_FLASH_SUCCESS;
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_read_wait
+(
+    uint32_t timeout_ms
+)
+{
+    uint32_t slice;
+
+    if ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
+    {
+        /* The critical sections entered before the scheduler starts leave
+           BASEPRI masking the PDMA interrupt, dma_read_isr() is run from here */
+        while ( g_flash_read.busy )
+        {
+            PDMA_poll( g_dma_rx_channel );
+        }
+        xSemaphoreTake( g_flash_read.done, 0 );
+        return SPI_FLASH_SUCCESS;
+    }
+
+    for (;;)
+    {
+        slice = ( timeout_ms < WAIT_SLICE_MS ) ? timeout_ms : WAIT_SLICE_MS;
+        if ( xSemaphoreTake( g_flash_read.done,
+                             (portTickType)((slice * configTICK_RATE_HZ) / 1000UL) ) == pdTRUE )
+        {
+            return SPI_FLASH_SUCCESS;
+        }
+        if ( timeout_ms != SPI_FLASH_WAIT_FOREVER )
+        {
+            timeout_ms -= slice;
+            if ( timeout_ms == 0 )
+            {
+                return dma_read_abort();
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Stops a read whose wait timed out and gives back the bus, unless the read
+ * ended meanwhile. The PDMA interrupt is masked in the meantime.
+ */
+static spi_flash_status_t dma_read_abort( void )
+{
+    spi_flash_status_t status = SPI_FLASH_SUCCESS;
+
+    taskENTER_CRITICAL();
+    if ( g_flash_read.busy )
+    {
+        PDMA_stop( g_dma_tx_channel );
+        PDMA_stop( g_dma_rx_channel );
+        MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
+        g_flash_read.busy = 0;
+        if ( g_flash_read.release_bus )
+        {
+            bus_release();
+        }
+        status = SPI_FLASH_UNSUCCESS;
+    }
+    taskEXIT_CRITICAL();
+
+    /* Given if the read ended meanwhile */
+    xSemaphoreTake( g_flash_read.done, 0 );
+    return status;
+}
+
+/*******************************************************************************
+ * Starts the SPI transfer of the next chunk of a read. The transmit channel
+ * sends the command then clocks the data in by sending the destination buffer
+ * itself, whose content the flash ignores; the receive channel drops what
+ * comes in with the command into cmd_rx then fills the destination buffer.
+ * Each channel has the two transfers loaded in its ping-pong buffers.
+ */
+static void dma_read_chunk( void )
+{
+    mss_spi_instance_t * this_spi = SPI_INSTANCE;
+    volatile uint32_t rx_raw;
+
+    g_flash_read.chunk = ( g_flash_read.remaining < READ_CHUNK_SIZE )
+                         ? (uint16_t)g_flash_read.remaining : READ_CHUNK_SIZE;
+    g_flash_read.remaining -= g_flash_read.chunk;
+    g_flash_read.buffers_done = 0;
+
+    g_flash_read.cmd[0] = READ_ARRAY_OPCODE;
+    g_flash_read.cmd[1] = (uint8_t)((g_flash_read.address >> 16) & 0xFF);
+    g_flash_read.cmd[2] = (uint8_t)((g_flash_read.address >> 8) & 0xFF);
+    g_flash_read.cmd[3] = (uint8_t)(g_flash_read.address & 0xFF);
+    g_flash_read.cmd[4] = DONT_CARE;
+    g_flash_read.cmd[5] = DONT_CARE;
+
     MSS_SPI_disable( this_spi );
-    MSS_SPI_set_transfer_byte_count( this_spi, transfer_size );
+    MSS_SPI_set_transfer_byte_count( this_spi, READ_CMD_SIZE + g_flash_read.chunk );
+    /* Byte transfers, a polled transfer may have left wider frames */
+    this_spi->hw_reg->TXRXDF_SIZE = 8U;
 
-    PDMA_start
-        (
-            SPI_FLASH_DMA_CHANNEL,  /* channel_id */
-            (uint32_t)cmd_buffer,   /* src_addr */
-            SPI_DEST_TXBUFF,             /* dest_addr */
-            cmd_byte_size           /* transfer_count */
-        );
+    /* Frames left over by a previous transfer */
+    while ( this_spi->hw_reg_bit->STATUS_RX_RDY == 1U )
+    {
+        rx_raw = this_spi->hw_reg->RX_DATA;
+        rx_raw = rx_raw;
+    }
+
+    PDMA_start( g_dma_rx_channel, SPI_SRC_RXBUFF,
+                (uint32_t)g_flash_read.cmd_rx, READ_CMD_SIZE );
+    PDMA_load_next_buffer( g_dma_rx_channel, SPI_SRC_RXBUFF,
+                           (uint32_t)g_flash_read.buffer, g_flash_read.chunk );
+    PDMA_start( g_dma_tx_channel, (uint32_t)g_flash_read.cmd,
+                SPI_DEST_TXBUFF, READ_CMD_SIZE );
+    PDMA_load_next_buffer( g_dma_tx_channel, (uint32_t)g_flash_read.buffer,
+                           SPI_DEST_TXBUFF, g_flash_read.chunk );
 
-    PDMA_load_next_buffer
-        (
-            SPI_FLASH_DMA_CHANNEL,  /* channel_id */
-            (uint32_t)data_buffer,  /* src_addr */
-            SPI_DEST_TXBUFF,             /* dest_addr */
-            data_byte_size          /* transfer_count */
-        );
     MSS_SPI_enable( this_spi );
-    while ( !MSS_SPI_tx_done(this_spi) )
+}
+
+/*******************************************************************************
+ * Receive channel interrupt: once both buffers of a chunk are done, starts the
+ * next chunk or ends the read and wakes the waiting task.
+ */
+static void dma_read_isr( void )
+{
+    portBASE_TYPE woken = pdFALSE;
+    uint32_t status;
+
+    status = PDMA_status( g_dma_rx_channel );
+    g_flash_read.buffers_done += (uint8_t)((status & 1u) + ((status >> 1) & 1u));
+    PDMA_clear_irq( g_dma_rx_channel );
+    if ( g_flash_read.buffers_done < 2 )
     {
-        ;
+        return;
     }
 
-#else
+    if ( g_flash_read.remaining > 0 )
     {
-#error "Non-DMA Transfers are not implemented. USE only DMA for TX"
+        g_flash_read.address += g_flash_read.chunk;
+        g_flash_read.buffer += g_flash_read.chunk;
+        dma_read_chunk();
+        return;
     }
 
+    MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
+    g_flash_read.busy = 0;
+    if ( g_flash_read.release_bus )
+    {
+        bus_release_from_isr( &woken );
+    }
+    xSemaphoreGiveFromISR( g_flash_read.done, &woken );
+    portEND_SWITCHING_ISR( woken );
+}
 #endif
 
+/*******************************************************************************
+ * This function sends the command and data on SPI
+ */
+static void write_cmd_data
+(
+    mss_spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    uint8_t * data_buffer,
+    uint16_t data_byte_size
+)
+{
+#ifdef USE_DMA_FOR_SPI_FLASH
+    MSS_SPI_dma_transfer_block
+        (
+            this_spi,
+            cmd_buffer,
+            cmd_byte_size,
+            data_buffer,
+            0,                      /* nothing to read */
+            data_byte_size,
+            g_dma_tx_channel,
+            g_dma_rx_channel
+        );
+#else
+    MSS_SPI_transfer_block_burst
+        (
+            this_spi,
+            cmd_buffer,
+            cmd_byte_size,
+            data_buffer,
+            0,                      /* nothing to read */
+            data_byte_size,
+            SPI_FLASH_MAX_FRAME_BITS
+        );
+#endif
 }
 
 /******************************************************************************
- *For more details please refer the spi_flash.h file
+ * Programs the pages of spi_flash_write() with the bus held.
  ******************************************************************************/
-spi_flash_status_t
-spi_flash_write
+static spi_flash_status_t
+write_pages
 (
     uint32_t address,
     uint8_t * write_buffer,
@@ -486,31 +1268,33 @@ spi_flash_write
     uint32_t nb_bytes_to_write;
     uint32_t target_addr;
 
+    cache_invalidate( address, size_in_bytes );
     MSS_SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
 
     /* Send Write Enable command */
     cmd_buffer[0] = WRITE_ENABLE_CMD;
-    wait_ready();
-    MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+    if(wait_ready())
+        return command_failed( 0 );
+    spi_transfer( cmd_buffer, 1, 0, 0 );
 
     /* Unprotect sector */
     cmd_buffer[0] = UNPROTECT_SECTOR_OPCODE;
     cmd_buffer[1] = (address >> 16) & 0xFF;
     cmd_buffer[2] = (address >> 8 ) & 0xFF;
     cmd_buffer[3] = address & 0xFF;
-    wait_ready();
-    MSS_SPI_transfer_block( SPI_INSTANCE,
-                            cmd_buffer,
-                            sizeof(cmd_buffer),
-                            0,
-                            0 );
+    if(wait_ready())
+        return command_failed( 1 );
+    spi_transfer( cmd_buffer,
+                  sizeof(cmd_buffer),
+                  0,
+                  0 );
 
     /* Send Write Enable command */
     cmd_buffer[0] = WRITE_ENABLE_CMD;
     if(wait_ready())
-        return SPI_FLASH_UNSUCCESS; 
+        return command_failed( 1 );
 
-    MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+    spi_transfer( cmd_buffer, 1, 0, 0 );
 
     /**/
     in_buffer_idx = 0;
@@ -529,15 +1313,15 @@ spi_flash_write
         }
 
         if(wait_ready())
-            return SPI_FLASH_UNSUCCESS; 
+            return command_failed( 1 );
 
         /* Send Write Enable command */
         cmd_buffer[0] = WRITE_ENABLE_CMD;
-        MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+        spi_transfer( cmd_buffer, 1, 0, 0 );
 
         /* Program page */
         if(wait_ready())
-            return SPI_FLASH_UNSUCCESS; 
+            return command_failed( 1 );
 
 
         cmd_buffer[0] = PROGRAM_PAGE_CMD;
@@ -553,6 +1337,7 @@ spi_flash_write
             &write_buffer[in_buffer_idx],
             nb_bytes_to_write
           );
+        g_flash_op = FLASH_OP_PAGE_PROGRAM;
 
         target_addr += nb_bytes_to_write;
         in_buffer_idx += nb_bytes_to_write;
@@ -562,32 +1347,145 @@ spi_flash_write
     cmd_buffer[0] = WRITE_DISABLE_CMD;
 
     if(wait_ready())
-        return SPI_FLASH_UNSUCCESS; 
+        return command_failed( 1 );
 
-    MSS_SPI_transfer_block( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+    spi_transfer( cmd_buffer, 1, 0, 0 );
     MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
     return 0;
 }
 
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_write
+(
+    uint32_t address,
+    uint8_t * write_buffer,
+    size_t size_in_bytes
+)
+{
+    spi_flash_status_t status;
+
+    bus_acquire();
+    status = write_pages( address, write_buffer, size_in_bytes );
+    bus_release();
+    return status;
+}
+
 
 /******************************************************************************
- * This function waits for the SPI operation to complete
+ * Ends a command sequence given up on because the flash stayed busy: disables
+ * writes again if the sequence enabled them and deselects the flash.
  ******************************************************************************/
-static uint8_t wait_ready( void )
+static spi_flash_status_t command_failed( uint8_t write_enabled )
+{
+    uint8_t command = WRITE_DISABLE_CMD;
+
+    if ( write_enabled )
+    {
+        spi_transfer( &command, 1, 0, 0 );
+    }
+    MSS_SPI_clear_slave_select( SPI_INSTANCE, SPI_SLAVE );
+    return SPI_FLASH_UNSUCCESS;
+}
+
+/******************************************************************************
+ * This function reads the busy bit of the status register
+ ******************************************************************************/
+static uint8_t read_busy( void )
 {
-    uint32_t count = 0;
     uint8_t ready_bit = 1;
     uint8_t command = READ_STATUS;
 
-    do {
-        MSS_SPI_transfer_block( SPI_INSTANCE,
-                                &command, 
-                                sizeof(command),
-                                &ready_bit,
-                                sizeof(ready_bit) );
-        ready_bit = ready_bit & READY_BIT_MASK;
-        count++;
-    } while(( ready_bit == 1 ) /*&& (count <= 0x7FFFFFFF)*/);
-
-    return (ready_bit);
+    spi_transfer( &command,
+                  sizeof(command),
+                  &ready_bit,
+                  sizeof(ready_bit) );
+    return ready_bit & READY_BIT_MASK;
+}
+
+/******************************************************************************
+ * This function waits for the SPI operation to complete. Once the scheduler
+ * runs, the calling task sleeps for the typical time of the operation started
+ * last then polls the status at increasing periods until the maximum time of
+ * the operation, so a long erase leaves the CPU to the other tasks. Returns 1
+ * when the flash is still busy at the maximum time.
+ ******************************************************************************/
+static uint8_t wait_ready( void )
+{
+    uint32_t typ_us = g_flash_op_time[g_flash_op].typ_us;
+    uint32_t max_us = g_flash_op_time[g_flash_op].max_us;
+    uint32_t elapsed_us = 0;
+    uint32_t poll_us;
+    uint32_t delay_us;
+    portTickType last;
+    portTickType now;
+
+    if ( !read_busy() )
+    {
+        g_flash_op = FLASH_OP_COMMAND;
+        return 0;
+    }
+
+    if ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
+    {
+        /* No tick yet, the number of status reads bounds the wait */
+        uint32_t count = max_us / POLL_TRANSFER_US;
+
+        while ( read_busy() )
+        {
+            if ( count-- == 0 )
+            {
+                g_flash_op = FLASH_OP_COMMAND;
+                return 1;
+            }
+        }
+        g_flash_op = FLASH_OP_COMMAND;
+        return 0;
+    }
+
+    poll_us = typ_us / 8;
+    if ( poll_us < POLL_MIN_US )
+    {
+        poll_us = POLL_MIN_US;
+    }
+    delay_us = ( typ_us > poll_us ) ? typ_us : poll_us;
+
+    last = xTaskGetTickCount();
+    for (;;)
+    {
+        /* One delay is kept below a tick count wrap */
+        if ( delay_us > WAIT_SLICE_MS * 1000UL )
+        {
+            delay_us = WAIT_SLICE_MS * 1000UL;
+        }
+        vTaskDelay( US_TO_TICKS( delay_us ) );
+
+        now = xTaskGetTickCount();
+        elapsed_us += (uint32_t)(portTickType)( now - last ) * ( 1000000UL / configTICK_RATE_HZ );
+        last = now;
+
+        if ( !read_busy() )
+        {
+            g_flash_op = FLASH_OP_COMMAND;
+            return 0;
+        }
+        if ( elapsed_us >= max_us )
+        {
+            g_flash_op = FLASH_OP_COMMAND;
+            return 1;
+        }
+
+        /* Typical time over, back off from the shortest period */
+        if ( elapsed_us < typ_us )
+        {
+            delay_us = typ_us - elapsed_us;
+        }
+        else
+        {
+            delay_us = poll_us;
+            poll_us *= 2;
+        }
+    }
 }
@@ -30,6 +30,32 @@ typedef enum {
     SPI_FLASH_UNSUCCESS
 } spi_flash_status_t;
 
+/******************************************************************************
+ * Read cache counters, see spi_flash_get_cache_stats().
+ *******************************************************************************/
+typedef struct {
+    uint32_t hits;          /* pages read from the cache */
+    uint32_t misses;        /* pages read from the flash */
+    uint32_t read_ahead;    /* pages read before being asked for */
+    uint32_t bypassed;      /* reads too long for the cache */
+    uint32_t invalidated;   /* pages dropped by a write or an erase */
+} spi_flash_cache_stats_t;
+
+/******************************************************************************
+ * Read rates measured by spi_flash_measure_read(), in bytes per second.
+ *******************************************************************************/
+typedef struct {
+    uint32_t byte_frames;   /* MSS_SPI_transfer_block(), one frame at a time */
+    uint32_t burst;         /* MSS_SPI_transfer_block_burst(), wide frames */
+    uint32_t dma;           /* PDMA, 0 without USE_DMA_FOR_SPI_FLASH */
+    uint8_t match;          /* 1 when every method read the same data */
+} spi_flash_throughput_t;
+
+/******************************************************************************
+ * Timeout of spi_flash_read_wait() never expiring.
+ *******************************************************************************/
+#define SPI_FLASH_WAIT_FOREVER  0xFFFFFFFFu
+
 /******************************************************************************
  * Possible HW Control commands on SPI FLASH.
  *******************************************************************************/
@@ -57,7 +83,10 @@ struct device_Info{
 };
 
 /******************************************************************************
- * This function initialzes the SPI pripheral and PDMA for data transfer
+ * This function initialzes the SPI pripheral and PDMA for data transfer. When
+ * spi_bus_init() was called for the SPI, the flash is added as a device of the
+ * bus instead and every command holds the bus while it runs. Otherwise a lock
+ * of the driver is held the same way against the other tasks using the flash.
  *******************************************************************************/
 spi_flash_status_t
 spi_flash_init
@@ -248,4 +277,93 @@ spi_flash_write
     size_t size_in_bytes
 );
 
+#if SPI_FLASH_CACHE_PAGES > 0
+/***************************************************************************//**
+ * spi_flash_read() goes through a cache of SPI_FLASH_CACHE_PAGES pages of
+ * 256 bytes, so small reads close to each other cost a single READ_ARRAY
+ * command. The pages missing are read together with SPI_FLASH_CACHE_READAHEAD
+ * pages more when the read starts where the previous one ended. Writes and
+ * erases through this driver drop the pages they change. The cache is only
+ * used with the bus or the lock of the driver held, see spi_flash_init().
+ *
+ * This function empties the cache, for when the flash was changed by other
+ * means.
+ */
+void spi_flash_cache_invalidate( void );
+
+/***************************************************************************//**
+ * This function copies the counters of the read cache.
+ */
+void spi_flash_get_cache_stats( spi_flash_cache_stats_t * stats );
+#endif
+
+/***************************************************************************//**
+ * This function reads the same range of Serial Flash with each SPI transfer
+ * method of the driver, bypassing the read cache, and reports the rate of
+ * each, timed with the cycle counter from the first command byte to the last
+ * data byte, and whether they all read the same data.
+ *
+ * @param address       This is the address from which data will be read.
+ * @param rx_buffer     This is a pointer to the buffer for the read data.
+ * @param size_in_bytes This is the number of bytes read, up to 32 KB.
+ * @param result        This is a pointer to the rates measured.
+ * @return              SPI_FLASH_SUCCESS or SPI_FLASH_UNSUCCESS when a read
+ *                      failed or size_in_bytes is out of range.
+ */
+spi_flash_status_t
+spi_flash_measure_read
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes,
+    spi_flash_throughput_t * result
+);
+
+#ifdef USE_DMA_FOR_SPI_FLASH
+/***************************************************************************//**
+ * This function starts reading Serial Flash into the buffer passed as
+ * parameter and returns without waiting for the data. The transfer is done by
+ * the PDMA, on two channels allocated by spi_flash_init(), one sending the
+ * command and one receiving the data, and its end is signalled by the PDMA
+ * interrupt. The buffer must not be used until spi_flash_read_wait()
+ * succeeds. Only one read can be in progress at a time. The read cache is not
+ * used. The SPI bus, if any, is held until the end of the read, so a read
+ * started by another task meanwhile waits for it.
+ *
+ * @param address       This is the address from which data will be read.
+ *                      This address is ranges from 0 to SPI Flash Size.
+ * @param rx_buffer     This is a pointer to the buffer for the read data.
+ * @param size_in_bytes This is the number of bytes to be read from SPI Flash.
+ * @return              SPI_FLASH_SUCCESS when the read is started,
+ *                      SPI_FLASH_UNSUCCESS when the Serial Flash stays busy.
+ */
+spi_flash_status_t
+spi_flash_read_async
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes
+);
+
+/***************************************************************************//**
+ * This function waits for the end of the read started by
+ * spi_flash_read_async(). The calling task is blocked until the PDMA interrupt
+ * signals the end of the transfer. Called before the scheduler is started, it
+ * polls the PDMA for the end of the transfer. When the timeout expires, the
+ * read is stopped and the SPI bus given back; the buffer content is then
+ * undefined.
+ *
+ * @param timeout_ms    This is the longest time to wait in milliseconds, or
+ *                      SPI_FLASH_WAIT_FOREVER.
+ * @return              SPI_FLASH_SUCCESS when the data is in the buffer,
+ *                      SPI_FLASH_UNSUCCESS when the timeout expired and the
+ *                      read was stopped.
+ */
+spi_flash_status_t
+spi_flash_read_wait
+(
+    uint32_t timeout_ms
+);
+#endif
+
 #endif
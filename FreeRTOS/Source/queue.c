@@ -62,6 +62,7 @@ task.h is included from an application file. */
 #include "FreeRTOS.h"
 #include "task.h"
 #include "croutine.h"
+#include "fast_mem.h"
 
 #undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
 
@@ -1063,7 +1064,7 @@ static void prvCopyDataToQueue( xQUEUE *pxQueue, const void *pvItemToQueue, port
     }
     else if( xPosition == queueSEND_TO_BACK )
     {
-        memcpy( ( void * ) pxQueue->pcWriteTo, pvItemToQueue, ( unsigned ) pxQueue->uxItemSize );
+        fast_memcpy( ( void * ) pxQueue->pcWriteTo, pvItemToQueue, ( unsigned ) pxQueue->uxItemSize );
         pxQueue->pcWriteTo += pxQueue->uxItemSize;
         if( pxQueue->pcWriteTo >= pxQueue->pcTail )
         {
@@ -1072,7 +1073,7 @@ static void prvCopyDataToQueue( xQUEUE *pxQueue, const void *pvItemToQueue, port
     }
     else
     {
-        memcpy( ( void * ) pxQueue->pcReadFrom, pvItemToQueue, ( unsigned ) pxQueue->uxItemSize );
+        fast_memcpy( ( void * ) pxQueue->pcReadFrom, pvItemToQueue, ( unsigned ) pxQueue->uxItemSize );
         pxQueue->pcReadFrom -= pxQueue->uxItemSize;
         if( pxQueue->pcReadFrom < pxQueue->pcHead )
         {
@@ -1093,7 +1094,7 @@ static void prvCopyDataFromQueue( xQUEUE * const pxQueue, const void *pvBuffer )
         {
             pxQueue->pcReadFrom = pxQueue->pcHead;
         }
-        memcpy( ( void * ) pvBuffer, ( void * ) pxQueue->pcReadFrom, ( unsigned ) pxQueue->uxItemSize );
+        fast_memcpy( ( void * ) pvBuffer, ( void * ) pxQueue->pcReadFrom, ( unsigned ) pxQueue->uxItemSize );
     }
 }
 /*-----------------------------------------------------------*/
@@ -1318,7 +1319,7 @@ signed portBASE_TYPE xReturn;
                 pxQueue->pcReadFrom = pxQueue->pcHead;
             }
             --( pxQueue->uxMessagesWaiting );
-            memcpy( ( void * ) pvBuffer, ( void * ) pxQueue->pcReadFrom, ( unsigned ) pxQueue->uxItemSize );
+            fast_memcpy( ( void * ) pvBuffer, ( void * ) pxQueue->pcReadFrom, ( unsigned ) pxQueue->uxItemSize );
 
             xReturn = pdPASS;
 
@@ -1393,7 +1394,7 @@ signed portBASE_TYPE xReturn;
             pxQueue->pcReadFrom = pxQueue->pcHead;
         }
         --( pxQueue->uxMessagesWaiting );
-        memcpy( ( void * ) pvBuffer, ( void * ) pxQueue->pcReadFrom, ( unsigned ) pxQueue->uxItemSize );
+        fast_memcpy( ( void * ) pvBuffer, ( void * ) pxQueue->pcReadFrom, ( unsigned ) pxQueue->uxItemSize );
 
         if( !( *pxCoRoutineWoken ) )
         {
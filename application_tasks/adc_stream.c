@@ -0,0 +1,122 @@
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "../drivers/mss_ace/mss_ace.h"
+#include "../drivers/mss_pdma/mss_pdma.h"
+#include "adc_stream.h"
+
+/* Raw PDMA values, see ACE_translate_pdma_value() */
+static uint32_t adc_stream_raw[ADC_STREAM_BLOCKS][ADC_STREAM_BLOCK_SAMPLES];
+static pdma_sg_entry_t adc_stream_list[ADC_STREAM_BLOCKS];
+static pdma_channel_id_t adc_stream_channel;
+static uint8_t adc_stream_running;
+static xQueueHandle adc_stream_queue;
+static volatile uint32_t adc_stream_done;      /* blocks completed */
+static adc_stream_stats_t adc_stream_stats;
+
+/**
+ * PDMA interrupt, at the end of every block. The block number goes to the
+ * processing task; the PDMA has already moved on to the next block.
+ */
+static void adc_stream_isr(pdma_channel_id_t channel_id, uint32_t entry)
+{
+    portBASE_TYPE woken = pdFALSE;
+    uint32_t seq = adc_stream_done++;
+
+    (void)channel_id;
+    (void)entry;
+    adc_stream_stats.blocks++;
+    if (xQueueSendFromISR(adc_stream_queue, &seq, &woken) != pdPASS) {
+        adc_stream_stats.overruns++;
+    }
+    portEND_SWITCHING_ISR(woken);
+}
+
+long adc_stream_start(void)
+{
+    int32_t channel;
+    uint32_t i;
+
+    if (adc_stream_running) {
+        return pdPASS;
+    }
+    if (adc_stream_queue == NULL) {
+        adc_stream_queue = xQueueCreate(ADC_STREAM_BLOCKS, sizeof(uint32_t));
+        if (adc_stream_queue == NULL) {
+            return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+        }
+    }
+
+    // the ACE only raises its request when a sample is ready
+    PDMA_init();
+    channel = PDMA_allocate_channel(PDMA_FROM_ACE,
+                                    PDMA_HIGH_PRIORITY | PDMA_WORD_TRANSFER | PDMA_INC_DEST_FOUR_BYTES,
+                                    PDMA_DEFAULT_WRITE_ADJ, adc_stream_raw);
+    if (channel == PDMA_NO_CHANNEL) {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+    adc_stream_channel = (pdma_channel_id_t)channel;
+
+    for (i = 0; i < ADC_STREAM_BLOCKS; i++) {
+        adc_stream_list[i].src_addr = PDMA_ACE_PPE_DATAOUT;
+        adc_stream_list[i].dest_addr = (uint32_t)adc_stream_raw[i];
+        adc_stream_list[i].transfer_count = ADC_STREAM_BLOCK_SAMPLES;
+    }
+    while (xQueueReceive(adc_stream_queue, &i, 0) == pdPASS) {
+    }
+    adc_stream_done = 0;
+
+    // the handler uses the RTOS API
+    NVIC_SetPriority(DMA_IRQn, configMAX_SYSCALL_INTERRUPT_PRIORITY >> (8 - __NVIC_PRIO_BITS));
+
+    // drop the samples waiting in the ACE so the first block is fresh
+    ACE_clear_sample_pipeline();
+    PDMA_start_sg(adc_stream_channel, adc_stream_list, ADC_STREAM_BLOCKS,
+                  PDMA_SG_LOOP | PDMA_SG_NOTIFY_EACH, adc_stream_isr);
+    adc_stream_running = 1;
+    return pdPASS;
+}
+
+void adc_stream_stop(void)
+{
+    if (!adc_stream_running) {
+        return;
+    }
+    PDMA_free_channel(adc_stream_channel, adc_stream_raw);
+    adc_stream_running = 0;
+}
+
+long adc_stream_read(adc_stream_block_t *block, portTickType wait)
+{
+    const uint32_t *raw;
+    adc_channel_id_t id;
+    uint32_t seq;
+    uint16_t i;
+
+    if (xQueueReceive(adc_stream_queue, &seq, wait) != pdPASS) {
+        return pdFAIL;
+    }
+
+    // the PDMA starts refilling a block once the next ADC_STREAM_BLOCKS - 1
+    // blocks are complete
+    raw = adc_stream_raw[seq % ADC_STREAM_BLOCKS];
+    for (i = 0; i < ADC_STREAM_BLOCK_SAMPLES; i++) {
+        block->value[i] = ACE_translate_pdma_value(raw[i], &id);
+        block->channel[i] = (uint8_t)ACE_get_input_channel_handle(id);
+    }
+    if (adc_stream_done - seq >= ADC_STREAM_BLOCKS) {
+        adc_stream_stats.overruns++;
+        return pdFAIL;
+    }
+    block->seq = seq;
+    block->count = ADC_STREAM_BLOCK_SAMPLES;
+    return pdPASS;
+}
+
+const adc_stream_stats_t *adc_stream_get_stats(void)
+{
+    return &adc_stream_stats;
+}
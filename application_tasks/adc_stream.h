@@ -0,0 +1,69 @@
+#ifndef ADC_STREAM_H_
+#define ADC_STREAM_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/**
+ * Continuous ADC acquisition by the PDMA.
+ *
+ * The PDMA copies every result the ACE post processing engine sends to its
+ * PDMA output into a ring of ADC_STREAM_BLOCKS blocks, looping over them with
+ * a scatter-gather list so that no sample is missed between blocks. Each
+ * completed block is announced to the processing task, which decodes it with
+ * adc_stream_read() while the PDMA fills the next ones. The sample rate is
+ * the one of the SSE sequence, not bounded by task scheduling.
+ *
+ * The analog inputs must have "Send result to DMA" selected in the ACE
+ * configurator, otherwise no sample reaches the PDMA.
+ */
+
+#ifndef ADC_STREAM_ENABLE
+#define ADC_STREAM_ENABLE           0
+#endif
+
+/* Samples per block, and blocks in the ring. The processing task has
+   ADC_STREAM_BLOCKS - 1 block periods to decode a block before it is
+   overwritten. */
+#define ADC_STREAM_BLOCK_SAMPLES    64
+#define ADC_STREAM_BLOCKS           2
+
+typedef struct adc_stream_block {
+    uint32_t seq;               /* block number since adc_stream_start(), a gap
+                                   means blocks were overwritten unread */
+    uint16_t count;             /* samples in the block */
+    uint8_t channel[ADC_STREAM_BLOCK_SAMPLES];      /* ace_channel_handle_t */
+    uint16_t value[ADC_STREAM_BLOCK_SAMPLES];       /* PPE sample values */
+} adc_stream_block_t;
+
+typedef struct adc_stream_stats {
+    uint32_t blocks;            /* blocks filled by the PDMA */
+    uint32_t overruns;          /* blocks overwritten before being read */
+} adc_stream_stats_t;
+
+/**
+ * Allocates a PDMA channel and starts the acquisition.
+ *
+ * @return pdPASS, errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY when no PDMA channel
+ *         or memory for the block queue is left
+ */
+long adc_stream_start(void);
+
+/**
+ * Stops the acquisition and frees the PDMA channel.
+ */
+void adc_stream_stop(void);
+
+/**
+ * Waits for the next completed block and decodes it.
+ *
+ * @param block     Decoded samples.
+ * @param wait      Ticks to wait for a block.
+ * @return pdPASS, or pdFAIL if no block came or it was overwritten during the
+ *         decoding
+ */
+long adc_stream_read(adc_stream_block_t *block, portTickType wait);
+
+const adc_stream_stats_t *adc_stream_get_stats(void);
+
+#endif /* ADC_STREAM_H_ */
@@ -10,9 +10,71 @@
 
 #include "FreeRTOS.h"
 #include "median_filter.h"
+#include "telemetry.h"
+#include "adc_stream.h"
 
 #include "../main.h"
 
+static volatile uint16_t last_sample;
+
+/**
+ * Returns the last raw value read by the task, for the status pages.
+ */
+uint16_t analog_read_last(void)
+{
+    return last_sample;
+}
+
+#if ADC_STREAM_ENABLE
+/**
+ * Sends a filtered value to the IPC queue. Returns 0 if the queue could not
+ * take it.
+ */
+static int send_value(task_arg_t* ta, uint16_t value_to_send)
+{
+    const xQueueHandle queue_h = ta->queue_h;
+
+    if (uxQueueMessagesWaiting(queue_h) < ta->QUEUE_LENGTH) {
+        const int xStatus = xQueueSendToBack(queue_h, &value_to_send, 0);
+        if (xStatus != pdPASS) {
+            printf( "Could not send to the queue, error code %d.\r\n", xStatus );
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static adc_stream_block_t block;
+
+/**
+ * Streaming mode: the PDMA fills sample blocks in the background, the task
+ * wakes up once per block. Every sample goes through the filter and to the
+ * telemetry, the LEDs get the filtered value once per block.
+ */
+static void analog_stream(task_arg_t* ta)
+{
+    uint16_t value_to_send = 0;
+    uint16_t i;
+
+    while (1) {
+        if (adc_stream_read(&block, portMAX_DELAY) != pdPASS) {
+            continue;
+        }
+        for (i = 0; i < block.count; i++) {
+#if TELEMETRY_ENABLE
+            telemetry_put(block.channel[i], block.value[i]);
+#endif
+            value_to_send = median_filter(block.value[i]);
+        }
+        last_sample = block.value[block.count - 1];
+        if (!send_value(ta, value_to_send)) {
+            break;
+        }
+    }
+    adc_stream_stop();
+}
+#endif
+
 /**
  * This task reads the analog input value from the potentiometer and sends it
  * to the IPC queue.
@@ -21,11 +83,28 @@ void analog_read_task(task_arg_t* ta)
 {
 	const xQueueHandle queue_h = ta->queue_h;
 
+#if ADC_STREAM_ENABLE
+    if (adc_stream_start() == pdPASS) {
+        analog_stream(ta);
+        while (1) {
+            vTaskSuspend(NULL);
+        }
+    }
+    // no PDMA channel left, read one sample at a time
+#endif
+
       while (1) {
         const ace_channel_handle_t current_channel = ACE_get_first_channel();
         const uint16_t adc_result = ACE_get_ppe_sample(current_channel);
         const uint16_t value_to_send = median_filter(adc_result);
 
+        last_sample = adc_result;
+
+#if TELEMETRY_ENABLE
+        // raw samples go off-box, the LEDs only get the filtered value
+        telemetry_put((uint16_t)current_channel, adc_result);
+#endif
+
         if (uxQueueMessagesWaiting(queue_h) < ta->QUEUE_LENGTH) {
             const int xStatus = xQueueSendToBack(queue_h, &value_to_send, 0);
             if (xStatus != pdPASS) {
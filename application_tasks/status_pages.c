@@ -0,0 +1,124 @@
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "../drivers/mss_ethernet_mac/mss_ethernet_mac.h"
+#include "../drivers/mac/nettype.h"
+#include "../drivers/mac/netif.h"
+#include "../drivers/mac/pbuf.h"
+#include "../drivers/mac/dhcp.h"
+#include "../drivers/mac/ip_reass.h"
+#include "../drivers/mac/icmp.h"
+#include "../drivers/mac/net_classify.h"
+#include "telemetry.h"
+#include "status_pages.h"
+
+/* Room vTaskList() needs per task */
+#define STATUS_TASK_LINE    (configMAX_TASK_NAME_LEN + 32)
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+extern uint16_t analog_read_last(void);
+
+static void status_field(httpd_buf_t *out, const char *name, uint32_t value)
+{
+    httpd_puts(out, out->len > 1 ? ",\"" : "\"");
+    httpd_puts(out, name);
+    httpd_puts(out, "\":");
+    httpd_putu(out, value);
+}
+
+static void status_adc(httpd_buf_t *out)
+{
+    const telemetry_stats_t *ts = telemetry_get_stats();
+
+    httpd_puts(out, "{");
+    status_field(out, "potentiometer", analog_read_last());
+    status_field(out, "telemetry_datagrams", ts->datagrams);
+    status_field(out, "telemetry_send_errors", ts->send_errors);
+    status_field(out, "telemetry_samples_lost", ts->samples_lost);
+    httpd_puts(out, "}\n");
+}
+
+static void status_net(httpd_buf_t *out)
+{
+    static const char *const dhcp_states[] = {
+        "off", "selecting", "requesting", "bound", "renewing", "rebinding"
+    };
+    const netif_stats_t *ns = netif_get_stats();
+    const pbuf_stats_t *ps = pbuf_get_stats(PBUF_POOL_DATA);
+    const ip_reass_stats_t *rs = ip_reass_get_stats();
+    const icmp_stats_t *is = icmp_get_stats();
+    const net_rx_rule_t *rules;
+    const uint32_t *hits;
+    unsigned char i, count;
+
+    httpd_puts(out, "{\"address\":\"");
+    for (i = 0; i < IP_ADDR_LEN; i++) {
+        httpd_putu(out, my_ip[i]);
+        httpd_puts(out, (i < IP_ADDR_LEN - 1) ? "." : "\"");
+    }
+    httpd_puts(out, ",\"dhcp\":\"");
+    httpd_puts(out, dhcp_states[dhcp_get_state()]);
+    httpd_puts(out, "\"");
+    status_field(out, "rx_frames", ns->rx_frames);
+    status_field(out, "rx_dropped", ns->rx_dropped);
+    status_field(out, "rx_no_pbuf", ns->rx_no_pbuf);
+    status_field(out, "rx_filtered", ns->rx_filtered);
+    status_field(out, "tx_frames", ns->tx_frames);
+    status_field(out, "tx_dropped", ns->tx_dropped);
+    status_field(out, "mac_rx_crc_errors", MSS_MAC_get_statistics(MSS_MAC_RX_CRC_ERROR));
+    status_field(out, "mac_rx_missed", MSS_MAC_get_statistics(MSS_MAC_RX_MISSED_FRAME));
+    status_field(out, "mac_rx_fifo_overflows", MSS_MAC_get_statistics(MSS_MAC_RX_FIFO_OVERFLOW));
+    status_field(out, "mac_tx_collisions", MSS_MAC_get_statistics(MSS_MAC_TX_COLLISION_COUNT));
+    status_field(out, "mac_tx_underflows", MSS_MAC_get_statistics(MSS_MAC_TX_UNDERFLOW_ERROR));
+    status_field(out, "pbufs_used", ps->used);
+    status_field(out, "pbufs_max_used", ps->max_used);
+    status_field(out, "pbuf_allocs", ps->allocs);
+    status_field(out, "pbuf_alloc_fail", ps->alloc_fail);
+    status_field(out, "ip_fragments", rs->fragments);
+    status_field(out, "ip_reassembled", rs->datagrams);
+    status_field(out, "ip_reass_timeouts", rs->timeouts);
+    status_field(out, "ip_reass_too_big", rs->too_big);
+    status_field(out, "ip_reass_evicted", rs->evicted);
+    status_field(out, "icmp_echo_requests", is->echo_requests);
+    status_field(out, "icmp_echo_replies", is->echo_replies);
+    status_field(out, "icmp_rate_limited", is->rate_limited);
+    status_field(out, "icmp_tx_full", is->tx_full);
+    /* Hits of each receive rule, the names are the field names */
+    rules = net_classify_rules(&count);
+    hits = net_classify_hits();
+    for (i = 0; i < count; i++) {
+        status_field(out, rules[i].name, hits[i]);
+    }
+    status_field(out, "rx_unmatched", hits[count]);
+    httpd_puts(out, "}\n");
+}
+
+static void status_tasks(httpd_buf_t *out)
+{
+    const unsigned portBASE_TYPE tasks = uxTaskGetNumberOfTasks();
+    char *p;
+
+    httpd_puts(out, "name\t\tstate\tprio\tstack\tnum\r\n");
+    // vTaskList() does not check the size of the buffer
+    if ((uint32_t)(out->size - out->len) < (uint32_t)tasks * STATUS_TASK_LINE + 1) {
+        httpd_puts(out, "too many tasks\r\n");
+        return;
+    }
+    p = out->data + out->len;
+    *p = 0;
+    vTaskList((signed char *)p);
+    while (*p) {
+        p++;
+    }
+    out->len = (uint16_t)(p - out->data);
+}
+
+const httpd_cgi_t status_pages[] = {
+    { "/status/adc", "application/json", status_adc },
+    { "/status/net", "application/json", status_net },
+    { "/status/tasks", "text/plain", status_tasks },
+};
+
+const unsigned char status_page_count = sizeof(status_pages) / sizeof(status_pages[0]);
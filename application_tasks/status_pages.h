@@ -0,0 +1,16 @@
+#ifndef STATUS_PAGES_H_
+#define STATUS_PAGES_H_
+
+#include "../drivers/mac/httpd.h"
+
+/**
+ * Dynamic pages of the board status web page, registered with httpd_init():
+ *
+ *   /status/adc    last potentiometer reading and telemetry counters, JSON
+ *   /status/net    address, network interface, MAC and buffer counters, JSON
+ *   /status/tasks  vTaskList() table, plain text
+ */
+extern const httpd_cgi_t status_pages[];
+extern const unsigned char status_page_count;
+
+#endif
@@ -0,0 +1,139 @@
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "../drivers/mac/netif.h"
+#include "../drivers/mac/pbuf.h"
+#include "../drivers/mac/udp.h"
+#include "../drivers/cycle_counter/cycle_counter.h"
+#include "telemetry.h"
+
+#define TELEMETRY_FLUSH_CYCLES  ((configCPU_CLOCK_HZ / 1000UL) * TELEMETRY_FLUSH_MS)
+
+static const unsigned char telemetry_dest[IP_ADDR_LEN] = TELEMETRY_DEST_IP;
+static udp_socket_t *telemetry_socket;
+static xQueueHandle telemetry_queue;
+static telemetry_stats_t telemetry_stats;
+
+/* Batch being filled, owned by the sampling task */
+static pbuf_t *telemetry_batch;
+static uint16_t telemetry_fill;
+static uint32_t telemetry_first;
+static uint32_t telemetry_seq;
+static uint32_t telemetry_lost;
+
+/**
+ * Sends the batches handed over by telemetry_put().
+ */
+static void telemetry_task(void *para)
+{
+    pbuf_t *p;
+
+    (void)para;
+    while (1) {
+        if (xQueueReceive(telemetry_queue, &p, portMAX_DELAY) != pdPASS) {
+            continue;
+        }
+        if (udp_sendto_pbuf(telemetry_socket, telemetry_dest, TELEMETRY_PORT,
+                            p, TELEMETRY_SEND_WAIT_MS) < 0) {
+            telemetry_stats.send_errors++;
+        }
+        else {
+            telemetry_stats.datagrams++;
+        }
+        // nothing is expected on the socket, don't let strays hold buffers
+        pbuf_free(udp_recv_pbuf(telemetry_socket, NULL, NULL, 0));
+    }
+}
+
+/**
+ * Completes the header of the current batch and passes it to the telemetry
+ * task, or drops it if the previous batch has not been taken yet.
+ */
+static void telemetry_flush(void)
+{
+    telemetry_hdr_t *hdr = (telemetry_hdr_t *)telemetry_batch->payload;
+    uint16_t len = sizeof(telemetry_hdr_t) + telemetry_fill * sizeof(telemetry_sample_t);
+
+    hdr->magic = TELEMETRY_MAGIC;
+    hdr->seq = telemetry_seq;
+    hdr->clock_hz = configCPU_CLOCK_HZ;
+    hdr->count = telemetry_fill;
+    hdr->lost = (telemetry_lost > 0xFFFF) ? 0xFFFF : (uint16_t)telemetry_lost;
+    telemetry_batch->len = telemetry_batch->tot_len = len;
+
+    if (xQueueSend(telemetry_queue, &telemetry_batch, 0) == pdPASS) {
+        telemetry_seq++;
+        telemetry_lost = 0;
+    }
+    else {
+        pbuf_free(telemetry_batch);
+        telemetry_lost += telemetry_fill;
+        telemetry_stats.samples_lost += telemetry_fill;
+    }
+    telemetry_batch = NULL;
+}
+
+long telemetry_init(void)
+{
+    long c;
+
+    telemetry_queue = xQueueCreate(1, sizeof(pbuf_t *));
+    if (telemetry_queue == NULL) {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+    telemetry_socket = udp_bind(0, 1);
+    if (telemetry_socket == NULL) {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+    c = xTaskCreate(telemetry_task,
+                    (signed portCHAR *) "telemetry_task",
+                    TELEMETRY_TASK_STACK_SIZE,
+                    NULL,
+                    TELEMETRY_TASK_PRIORITY,
+                    NULL);
+    if (c != pdPASS) {
+        return c;
+    }
+    /* Sample timestamps */
+    cycle_counter_enable();
+    return pdPASS;
+}
+
+void telemetry_put(uint16_t channel, uint16_t value)
+{
+    const uint32_t now = cycle_counter_read();
+    telemetry_sample_t *sample;
+
+    if (telemetry_socket == NULL) {
+        return;
+    }
+    if (telemetry_batch == NULL) {
+        telemetry_batch = pbuf_alloc(NET_PBUF_HEADROOM,
+                                     sizeof(telemetry_hdr_t) + TELEMETRY_BATCH * sizeof(telemetry_sample_t));
+        if (telemetry_batch == NULL) {
+            telemetry_lost++;
+            telemetry_stats.samples_lost++;
+            return;
+        }
+        telemetry_fill = 0;
+        telemetry_first = now;
+    }
+
+    sample = (telemetry_sample_t *)(telemetry_batch->payload + sizeof(telemetry_hdr_t)) + telemetry_fill;
+    sample->timestamp = now;
+    sample->channel = channel;
+    sample->value = value;
+    telemetry_fill++;
+
+    if ((telemetry_fill == TELEMETRY_BATCH) || (now - telemetry_first >= TELEMETRY_FLUSH_CYCLES)) {
+        telemetry_flush();
+    }
+}
+
+const telemetry_stats_t *telemetry_get_stats(void)
+{
+    return &telemetry_stats;
+}
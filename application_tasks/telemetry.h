@@ -0,0 +1,82 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+
+/**
+ * ADC telemetry over UDP.
+ *
+ * The sampling task stores each reading, with a cycle counter timestamp,
+ * straight into a packet buffer. A full batch, or one older than
+ * TELEMETRY_FLUSH_MS, is handed to the telemetry task which sends it as one
+ * datagram while sampling carries on in a fresh buffer. Only one batch waits
+ * for the sender: if it is still busy with the previous one the new batch is
+ * dropped and its samples are reported in the next datagram, so the sampling
+ * task never waits on the network.
+ *
+ * tools/telemetry_rx.py receives the stream and reports loss and throughput.
+ */
+
+#ifndef TELEMETRY_ENABLE
+#define TELEMETRY_ENABLE            1
+#endif
+
+/* Destination of the stream, the LAN broadcast address by default */
+#define TELEMETRY_DEST_IP           { 255, 255, 255, 255 }
+#define TELEMETRY_PORT              5005
+
+/* Longest time a sample waits in a batch that is not full */
+#define TELEMETRY_FLUSH_MS          20
+/* Longest time the sender waits for the destination to be resolved */
+#define TELEMETRY_SEND_WAIT_MS      100
+
+#define TELEMETRY_TASK_PRIORITY     (tskIDLE_PRIORITY + 2)
+#define TELEMETRY_TASK_STACK_SIZE   configMINIMAL_STACK_SIZE
+
+/**
+ * Datagram layout, little endian. TELEMETRY_BATCH samples fill a datagram
+ * that fits an Ethernet frame.
+ */
+#define TELEMETRY_MAGIC             0x314D4C54UL    /* "TLM1" */
+
+typedef struct telemetry_hdr {
+    uint32_t magic;
+    uint32_t seq;               /* datagram sequence number */
+    uint32_t clock_hz;          /* rate of the sample timestamps */
+    uint16_t count;             /* samples in the datagram */
+    uint16_t lost;              /* samples dropped since the previous datagram,
+                                   saturated at 0xFFFF */
+} telemetry_hdr_t;
+
+typedef struct telemetry_sample {
+    uint32_t timestamp;         /* cycle counter when the sample was read */
+    uint16_t channel;
+    uint16_t value;
+} telemetry_sample_t;
+
+#define TELEMETRY_BATCH \
+    ((1472 - sizeof(telemetry_hdr_t)) / sizeof(telemetry_sample_t))
+
+typedef struct telemetry_stats {
+    uint32_t datagrams;         /* batches sent */
+    uint32_t send_errors;       /* batches the network could not take */
+    uint32_t samples_lost;      /* samples dropped by the sampling task */
+} telemetry_stats_t;
+
+/**
+ * Binds the socket and creates the telemetry task. Must be called before the
+ * scheduler is started, after netif_init().
+ *
+ * @return pdPASS, or the error of the socket or task creation
+ */
+long telemetry_init(void);
+
+/**
+ * Adds a sample to the current batch. Called by the sampling task only, never
+ * blocks. Does nothing until telemetry_init() has succeeded.
+ */
+void telemetry_put(uint16_t channel, uint16_t value);
+
+const telemetry_stats_t *telemetry_get_stats(void);
+
+#endif
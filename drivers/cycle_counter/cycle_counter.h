@@ -0,0 +1,38 @@
+/*******************************************************************************
+ *  cycle_counter.h: Cortex-M3 DWT cycle counter.
+ *
+ *  CYCCNT counts core clock cycles, configCPU_CLOCK_HZ, once enabled. The DWT
+ *  only runs while trace is enabled in DEMCR, which a debugger does when it
+ *  connects; without one the counter stays at 0 unless TRCENA is set first,
+ *  as cycle_counter_enable() does. The counter is shared by its users, who
+ *  take differences of its values and never reset it.
+ */
+#ifndef CYCLE_COUNTER_H_
+#define CYCLE_COUNTER_H_
+
+#include <stdint.h>
+
+/***************************************************************************//**
+ * Debug registers.
+ */
+#define CYCLE_COUNTER_DEMCR         (*(volatile uint32_t *)0xE000EDFCUL)
+#define CYCLE_COUNTER_DEMCR_TRCENA  0x01000000UL
+#define CYCLE_COUNTER_DWT_CTRL      (*(volatile uint32_t *)0xE0001000UL)
+#define CYCLE_COUNTER_CYCCNTENA     0x00000001UL
+#define CYCLE_COUNTER_DWT_CYCCNT    (*(volatile uint32_t *)0xE0001004UL)
+
+/***************************************************************************//**
+ * Starts the counter, if it is not running yet.
+ */
+#define cycle_counter_enable()                                      \
+    do {                                                            \
+        CYCLE_COUNTER_DEMCR |= CYCLE_COUNTER_DEMCR_TRCENA;          \
+        CYCLE_COUNTER_DWT_CTRL |= CYCLE_COUNTER_CYCCNTENA;          \
+    } while (0)
+
+/***************************************************************************//**
+ * Current count, wrapping every 2^32 cycles.
+ */
+#define cycle_counter_read()        (CYCLE_COUNTER_DWT_CYCCNT)
+
+#endif /* CYCLE_COUNTER_H_ */
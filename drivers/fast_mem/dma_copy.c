@@ -0,0 +1,235 @@
+/*******************************************************************************
+ *  dma_copy.c: memory to memory copies by the PDMA.
+ *
+ *  Each copy is a scatter-gather list of up to DMA_COPY_MAX_ENTRIES transfers
+ *  of at most 65535 units, run by PDMA_start_sg() on one of the channels of
+ *  the service. The channel is configured for word or byte units at every
+ *  copy, with no posted write adjustment since both ends are memory.
+ */
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "../../CMSIS/a2fxxxm3.h"
+#include "fast_mem.h"
+#include "dma_copy.h"
+
+#define DMA_COPY_MAX_COUNT      0xFFFFu     /* units of one transfer */
+#define DMA_COPY_NO_SLOT        0xFFFFFFFFu
+
+static pdma_channel_id_t dma_copy_channels[DMA_COPY_CHANNELS];
+static dma_copy_t *volatile dma_copy_active[DMA_COPY_CHANNELS];    /* NULL when free */
+static xSemaphoreHandle dma_copy_done[DMA_COPY_CHANNELS];          /* given at each end */
+static uint32_t dma_copy_channel_count;
+static dma_copy_stats_t dma_copy_stats;
+
+static void dma_copy_isr(pdma_channel_id_t channel_id, uint32_t entry);
+
+/***************************************************************************//**
+ *  See dma_copy.h for more information.
+ */
+uint32_t dma_copy_init(void)
+{
+    int32_t channel;
+
+    PDMA_init();
+    while (dma_copy_channel_count < DMA_COPY_CHANNELS) {
+        channel = PDMA_allocate_channel(PDMA_MEM_TO_MEM,
+                                        PDMA_LOW_PRIORITY | PDMA_WORD_TRANSFER |
+                                        PDMA_INC_SRC_FOUR_BYTES | PDMA_INC_DEST_FOUR_BYTES,
+                                        0, dma_copy_channels);
+        if (channel == PDMA_NO_CHANNEL) {
+            break;
+        }
+        if (dma_copy_done[dma_copy_channel_count] == NULL) {
+            vSemaphoreCreateBinary(dma_copy_done[dma_copy_channel_count]);
+            if (dma_copy_done[dma_copy_channel_count] != NULL) {
+                xSemaphoreTake(dma_copy_done[dma_copy_channel_count], 0);
+            }
+        }
+        dma_copy_channels[dma_copy_channel_count++] = (pdma_channel_id_t)channel;
+    }
+
+    /* The callbacks use the RTOS API */
+    NVIC_SetPriority(DMA_IRQn, configMAX_SYSCALL_INTERRUPT_PRIORITY >> (8 - __NVIC_PRIO_BITS));
+    return dma_copy_channel_count;
+}
+
+/***************************************************************************//**
+ * Takes a free channel for a copy, DMA_COPY_NO_SLOT if there is none.
+ */
+static uint32_t dma_copy_claim(dma_copy_t *copy)
+{
+    uint32_t primask;
+    uint32_t slot;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    for (slot = 0; slot < dma_copy_channel_count; slot++) {
+        if (dma_copy_active[slot] == NULL) {
+            dma_copy_active[slot] = copy;
+            break;
+        }
+    }
+    __set_PRIMASK(primask);
+
+    return (slot < dma_copy_channel_count) ? slot : DMA_COPY_NO_SLOT;
+}
+
+/***************************************************************************//**
+ * Marks a copy done and calls its callback.
+ */
+static void dma_copy_finish(dma_copy_t *copy)
+{
+    copy->done = 1;
+    if (copy->complete != NULL) {
+        copy->complete(copy->context);
+    }
+}
+
+/***************************************************************************//**
+ *  See dma_copy.h for more information.
+ */
+int dma_copy_start(dma_copy_t *copy, void *dest, const void *src, size_t n,
+                   dma_copy_complete_t complete, void *context)
+{
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+    uint32_t slot = DMA_COPY_NO_SLOT;
+    uint32_t unit;
+    uint32_t cfg;
+    uint32_t count;
+    uint32_t chunk;
+    uint32_t entries;
+    size_t edge;
+
+    copy->complete = complete;
+    copy->context = context;
+    copy->done = 0;
+
+    if ((n >= DMA_COPY_MIN_SIZE) &&
+        (n <= (size_t)DMA_COPY_MAX_ENTRIES * DMA_COPY_MAX_COUNT)) {
+        slot = dma_copy_claim(copy);
+        if (slot == DMA_COPY_NO_SLOT) {
+            dma_copy_stats.channels_busy++;
+        }
+    }
+    if (slot == DMA_COPY_NO_SLOT) {
+        fast_memcpy(dest, src, n);
+        dma_copy_stats.cpu_copies++;
+        dma_copy_finish(copy);
+        return DMA_COPY_DONE;
+    }
+
+    if ((((uintptr_t)d ^ (uintptr_t)s) & 3u) == 0u) {
+        /* Same alignment: the edges by the processor, words in between */
+        edge = (4u - ((uintptr_t)d & 3u)) & 3u;
+        fast_memcpy(d, s, edge);
+        d += edge;
+        s += edge;
+        n -= edge;
+        edge = n & 3u;
+        n -= edge;
+        fast_memcpy(d + n, s + n, edge);
+        unit = 4;
+        cfg = PDMA_WORD_TRANSFER | PDMA_INC_SRC_FOUR_BYTES | PDMA_INC_DEST_FOUR_BYTES;
+    } else {
+        unit = 1;
+        cfg = PDMA_BYTE_TRANSFER | PDMA_INC_SRC_ONE_BYTE | PDMA_INC_DEST_ONE_BYTE;
+    }
+
+    count = (uint32_t)(n / unit);
+    for (entries = 0; count > 0; entries++) {
+        chunk = (count < DMA_COPY_MAX_COUNT) ? count : DMA_COPY_MAX_COUNT;
+        copy->entries[entries].src_addr = (uint32_t)s;
+        copy->entries[entries].dest_addr = (uint32_t)d;
+        copy->entries[entries].transfer_count = (uint16_t)chunk;
+        s += chunk * unit;
+        d += chunk * unit;
+        count -= chunk;
+    }
+
+    copy->slot = slot;
+    dma_copy_stats.dma_copies++;
+    dma_copy_stats.dma_bytes += (uint32_t)n;
+    PDMA_configure(dma_copy_channels[slot], PDMA_MEM_TO_MEM, PDMA_LOW_PRIORITY | cfg, 0);
+    PDMA_start_sg(dma_copy_channels[slot], copy->entries, entries, 0, dma_copy_isr);
+    return DMA_COPY_STARTED;
+}
+
+/***************************************************************************//**
+ *  See dma_copy.h for more information.
+ */
+void dma_copy_wait(dma_copy_t *copy)
+{
+    xSemaphoreHandle done;
+
+    if (copy->done) {
+        /* Copied by the processor, no channel */
+        return;
+    }
+    done = dma_copy_done[copy->slot];
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        /* BASEPRI may still mask the PDMA interrupt */
+        while (!copy->done) {
+            PDMA_poll(dma_copy_channels[copy->slot]);
+        }
+        return;
+    }
+    /* Every copy of the channel gives the semaphore, a waiter may take the
+       give of another one: the wait is bounded and the copy checked again */
+    while (!copy->done) {
+        if (done != NULL) {
+            xSemaphoreTake(done, DMA_COPY_RECHECK_TICKS);
+        }
+    }
+}
+
+/***************************************************************************//**
+ *  See dma_copy.h for more information.
+ */
+void *dma_memcpy(void *dest, const void *src, size_t n)
+{
+    dma_copy_t copy;
+
+    if (dma_copy_start(&copy, dest, src, n, NULL, NULL) == DMA_COPY_STARTED) {
+        dma_copy_wait(&copy);
+    }
+    return dest;
+}
+
+/***************************************************************************//**
+ *  See dma_copy.h for more information.
+ */
+const dma_copy_stats_t *dma_copy_get_stats(void)
+{
+    return &dma_copy_stats;
+}
+
+/***************************************************************************//**
+ * PDMA interrupt, at the end of the last transfer of a copy.
+ */
+static void dma_copy_isr(pdma_channel_id_t channel_id, uint32_t entry)
+{
+    portBASE_TYPE woken = pdFALSE;
+    dma_copy_t *copy;
+    uint32_t slot;
+
+    (void)entry;
+    for (slot = 0; slot < dma_copy_channel_count; slot++) {
+        if (dma_copy_channels[slot] == channel_id) {
+            copy = dma_copy_active[slot];
+            /* Free first, the callback may start another copy */
+            dma_copy_active[slot] = NULL;
+            if (copy != NULL) {
+                dma_copy_finish(copy);
+            }
+            if (dma_copy_done[slot] != NULL) {
+                xSemaphoreGiveFromISR(dma_copy_done[slot], &woken);
+            }
+            break;
+        }
+    }
+    portEND_SWITCHING_ISR(woken);
+}
@@ -0,0 +1,130 @@
+/*******************************************************************************
+ *  dma_copy.h: memory to memory copies by the PDMA.
+ *
+ *  A copy is started and the caller goes on with its work while the PDMA moves
+ *  the data, then waits for it or is called back from the PDMA interrupt.
+ *  Copies shorter than DMA_COPY_MIN_SIZE, for which programming the PDMA costs
+ *  more than the copy, and copies finding all the channels of the service
+ *  busy are done by the processor with fast_memcpy() before dma_copy_start()
+ *  returns.
+ */
+#ifndef DMA_COPY_H_
+#define DMA_COPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../mss_pdma/mss_pdma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************************************************//**
+ * PDMA channels taken by dma_copy_init(), the number of copies which can run
+ * at the same time.
+ */
+#ifndef DMA_COPY_CHANNELS
+#define DMA_COPY_CHANNELS           1
+#endif
+
+/***************************************************************************//**
+ * Shortest copy handed to the PDMA.
+ */
+#ifndef DMA_COPY_MIN_SIZE
+#define DMA_COPY_MIN_SIZE           256u
+#endif
+
+/***************************************************************************//**
+ * Longest a waiting task sleeps before checking its copy again.
+ */
+#ifndef DMA_COPY_RECHECK_TICKS
+#define DMA_COPY_RECHECK_TICKS      ((portTickType)(configTICK_RATE_HZ / 1000))
+#endif
+
+/***************************************************************************//**
+ * Transfers of up to 65535 bytes or words making up one copy.
+ */
+#define DMA_COPY_MAX_ENTRIES        2
+
+/***************************************************************************//**
+ * Results of dma_copy_start().
+ */
+#define DMA_COPY_DONE               0   /* copied by the processor */
+#define DMA_COPY_STARTED            1   /* running on the PDMA */
+
+/***************************************************************************//**
+ * Completion callback. It is called from the PDMA interrupt, or by
+ * dma_copy_start() itself when the processor did the copy.
+ */
+typedef void (*dma_copy_complete_t)(void *context);
+
+/***************************************************************************//**
+ * Copy in progress. It must remain valid until the copy is done.
+ */
+typedef struct dma_copy {
+    dma_copy_complete_t complete;
+    void *context;
+    pdma_sg_entry_t entries[DMA_COPY_MAX_ENTRIES];
+    uint32_t slot;                  /* channel of the service running it */
+    volatile uint8_t done;
+} dma_copy_t;
+
+/***************************************************************************//**
+ * Copy counters.
+ */
+typedef struct dma_copy_stats {
+    uint32_t dma_copies;
+    uint32_t dma_bytes;
+    uint32_t cpu_copies;            /* too short for the PDMA */
+    uint32_t channels_busy;         /* long enough but copied by the processor */
+} dma_copy_stats_t;
+
+/***************************************************************************//**
+ * Allocates the PDMA channels of the service. Until it is called, or when no
+ * channel is free, all copies are done by the processor. The completion
+ * callbacks may use the FreeRTOS FromISR API: the PDMA interrupt priority is
+ * set to configMAX_SYSCALL_INTERRUPT_PRIORITY.
+ *
+ * @return  Number of channels allocated.
+ */
+uint32_t dma_copy_init(void);
+
+/***************************************************************************//**
+ * Starts copying n bytes from src to dest. The areas must not overlap and
+ * must not be used until the copy is done. Bytes before the first word
+ * boundary and after the last are copied by the processor; the PDMA moves
+ * words when src and dest have the same alignment, bytes otherwise.
+ *
+ * @param  complete Called once the copy is done, may be NULL.
+ * @param  context  Parameter given to complete.
+ * @return DMA_COPY_STARTED, or DMA_COPY_DONE when the copy was done by the
+ *         processor and complete already called.
+ */
+int dma_copy_start(dma_copy_t *copy, void *dest, const void *src, size_t n,
+                   dma_copy_complete_t complete, void *context);
+
+/***************************************************************************//**
+ * Waits for a copy to be done. The calling task blocks until the PDMA
+ * interrupt ends the copy, checking it again every DMA_COPY_RECHECK_TICKS in
+ * case the end of another copy on the same channel woke a different task.
+ * Before the scheduler starts, the PDMA is polled.
+ */
+void dma_copy_wait(dma_copy_t *copy);
+
+/***************************************************************************//**
+ * Copies n bytes from src to dest and returns once done.
+ *
+ * @return  dest
+ */
+void *dma_memcpy(void *dest, const void *src, size_t n);
+
+/***************************************************************************//**
+ * Returns the copy counters.
+ */
+const dma_copy_stats_t *dma_copy_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_COPY_H_ */
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ *  fast_mem.c: word oriented memory copy and fill.
+ */
+#include <stdint.h>
+#include "fast_mem.h"
+
+#if defined(__GNUC__) && defined(__thumb2__)
+#define FAST_MEM_USE_LDM_STM    1
+#else
+#define FAST_MEM_USE_LDM_STM    0
+#endif
+
+/***************************************************************************//**
+ *  See fast_mem.h for more information.
+ */
+void *fast_memcpy(void *dest, const void *src, size_t n)
+{
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+
+    if ((n >= FAST_MEM_MIN_WORD_SIZE) &&
+        ((((uintptr_t)d ^ (uintptr_t)s) & 3u) == 0u))
+    {
+        uint32_t *dw;
+        const uint32_t *sw;
+
+        /* Prologue: both pointers share the same alignment, so aligning the
+           destination aligns the source too */
+        while (((uintptr_t)d & 3u) != 0u) {
+            *d++ = *s++;
+            n--;
+        }
+        dw = (uint32_t *)d;
+        sw = (const uint32_t *)s;
+
+#if FAST_MEM_USE_LDM_STM
+        {
+            size_t blocks = n >> 4;
+
+            if (blocks != 0u) {
+                __asm volatile (
+                    "1:                         \n"
+                    "    ldmia   %[s]!, {r3-r6} \n"
+                    "    stmia   %[d]!, {r3-r6} \n"
+                    "    subs    %[b], %[b], #1 \n"
+                    "    bne     1b             \n"
+                    : [d] "+r" (dw), [s] "+r" (sw), [b] "+r" (blocks)
+                    :
+                    : "r3", "r4", "r5", "r6", "cc", "memory" );
+                n &= 15u;
+            }
+        }
+#else
+        while (n >= 16u) {
+            dw[0] = sw[0];
+            dw[1] = sw[1];
+            dw[2] = sw[2];
+            dw[3] = sw[3];
+            dw += 4;
+            sw += 4;
+            n -= 16u;
+        }
+#endif
+        while (n >= 4u) {
+            *dw++ = *sw++;
+            n -= 4u;
+        }
+        d = (uint8_t *)dw;
+        s = (const uint8_t *)sw;
+    }
+    else
+    {
+        while (n >= 4u) {
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[2];
+            d[3] = s[3];
+            d += 4;
+            s += 4;
+            n -= 4u;
+        }
+    }
+
+    /* Epilogue */
+    while (n > 0u) {
+        *d++ = *s++;
+        n--;
+    }
+    return dest;
+}
+
+/***************************************************************************//**
+ *  See fast_mem.h for more information.
+ */
+void *fast_memset(void *s, int c, size_t n)
+{
+    uint8_t *d = (uint8_t *)s;
+    uint8_t b = (uint8_t)c;
+
+    if (n >= FAST_MEM_MIN_WORD_SIZE) {
+        uint32_t word = (uint32_t)b * 0x01010101u;
+        uint32_t *dw;
+
+        while (((uintptr_t)d & 3u) != 0u) {
+            *d++ = b;
+            n--;
+        }
+        dw = (uint32_t *)d;
+
+#if FAST_MEM_USE_LDM_STM
+        {
+            size_t blocks = n >> 4;
+
+            if (blocks != 0u) {
+                __asm volatile (
+                    "    mov     r3, %[w]       \n"
+                    "    mov     r4, %[w]       \n"
+                    "    mov     r5, %[w]       \n"
+                    "    mov     r6, %[w]       \n"
+                    "1:                         \n"
+                    "    stmia   %[d]!, {r3-r6} \n"
+                    "    subs    %[b], %[b], #1 \n"
+                    "    bne     1b             \n"
+                    : [d] "+r" (dw), [b] "+r" (blocks)
+                    : [w] "r" (word)
+                    : "r3", "r4", "r5", "r6", "cc", "memory" );
+                n &= 15u;
+            }
+        }
+#else
+        while (n >= 16u) {
+            dw[0] = word;
+            dw[1] = word;
+            dw[2] = word;
+            dw[3] = word;
+            dw += 4;
+            n -= 16u;
+        }
+#endif
+        while (n >= 4u) {
+            *dw++ = word;
+            n -= 4u;
+        }
+        d = (uint8_t *)dw;
+    }
+
+    while (n > 0u) {
+        *d++ = b;
+        n--;
+    }
+    return s;
+}
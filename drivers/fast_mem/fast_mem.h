@@ -0,0 +1,43 @@
+/*******************************************************************************
+ *  fast_mem.h: word oriented memory copy and fill.
+ *
+ *  Replacements for memcpy() and memset() on the frame and queue paths. Buffers
+ *  are handled a byte at a time only until the destination is word aligned;
+ *  the bulk is then moved with 16 byte LDM/STM bursts on the Cortex-M3, or
+ *  with a word loop on other targets. Source and destination with different
+ *  word alignment fall back to an unrolled byte loop.
+ */
+#ifndef FAST_MEM_H_
+#define FAST_MEM_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************************************************//**
+ * Buffers shorter than this are copied or filled byte by byte, the alignment
+ * prologue would cost more than it saves.
+ */
+#define FAST_MEM_MIN_WORD_SIZE      16u
+
+/***************************************************************************//**
+ * Copies n bytes from src to dest. The areas must not overlap.
+ *
+ * @return  dest
+ */
+void *fast_memcpy(void *dest, const void *src, size_t n);
+
+/***************************************************************************//**
+ * Fills n bytes at s with the byte value c.
+ *
+ * @return  s
+ */
+void *fast_memset(void *s, int c, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FAST_MEM_H_ */
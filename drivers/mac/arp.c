@@ -0,0 +1,107 @@
+/*******************************************************************************
+ *  arp.c: ARP cache.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "nettype.h"
+#include "netif.h"
+#include "pbuf.h"
+#include "arp.h"
+#include "../fast_mem/fast_mem.h"
+
+#define OK  0
+#define ERR 1
+
+#define ARP_FRAME_LEN   (sizeof(ether_hdr_t) + sizeof(arp_pkt_t))
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+extern unsigned char my_mac[ETH_ADDR_LEN];
+
+static arp_entry_t arp_cache[NET_ARP_CACHE_SIZE];
+static uint32_t arp_last_use[NET_ARP_CACHE_SIZE];
+static uint32_t arp_clock;
+
+/***************************************************************************//**
+ *  See arp.h for more information.
+ */
+void arp_cache_update(const unsigned char *ip, const unsigned char *mac)
+{
+    unsigned char i;
+    unsigned char slot = 0;
+
+    portENTER_CRITICAL();
+    for (i = 0; i < NET_ARP_CACHE_SIZE; i++) {
+        if (arp_cache[i].used && !memcmp(arp_cache[i].ip, ip, IP_ADDR_LEN)) {
+            slot = i;
+            break;
+        }
+        /* Otherwise take a free entry or the least recently used one */
+        if (!arp_cache[i].used ||
+            (arp_cache[slot].used && (int32_t)(arp_last_use[i] - arp_last_use[slot]) < 0)) {
+            slot = i;
+        }
+    }
+    fast_memcpy(arp_cache[slot].ip, ip, IP_ADDR_LEN);
+    fast_memcpy(arp_cache[slot].mac, mac, ETH_ADDR_LEN);
+    arp_cache[slot].used = 1;
+    arp_last_use[slot] = ++arp_clock;
+    portEXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ *  See arp.h for more information.
+ */
+unsigned char arp_cache_lookup(const unsigned char *ip, unsigned char *mac)
+{
+    unsigned char i;
+    unsigned char found = 0;
+
+    portENTER_CRITICAL();
+    for (i = 0; i < NET_ARP_CACHE_SIZE; i++) {
+        if (arp_cache[i].used && !memcmp(arp_cache[i].ip, ip, IP_ADDR_LEN)) {
+            fast_memcpy(mac, arp_cache[i].mac, ETH_ADDR_LEN);
+            arp_last_use[i] = ++arp_clock;
+            found = 1;
+            break;
+        }
+    }
+    portEXIT_CRITICAL();
+    return found;
+}
+
+/***************************************************************************//**
+ *  See arp.h for more information.
+ */
+unsigned char arp_request(const unsigned char *ip)
+{
+    pbuf_t *p = pbuf_alloc(0, ARP_FRAME_LEN);
+    eth_hdr_xp eth_hdr;
+    arp_pkt_xp arp_pkt;
+
+    if ((p == NULL) || (p->next != NULL)) {
+        pbuf_free(p);
+        return ERR;
+    }
+    eth_hdr = (eth_hdr_xp ) p->payload;
+    arp_pkt = (arp_pkt_xp )(p->payload + sizeof(ether_hdr_t));
+    fast_memset(eth_hdr->da, 0xFF, ETH_ADDR_LEN); /* broadcast */
+    fast_memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
+    eth_hdr->type_code[0] = ETH_TYPE_0;
+    eth_hdr->type_code[1] = ETH_TYPE_ARP_1;
+    arp_pkt->hw_type[0] = ARP_HW_TYPE_0;
+    arp_pkt->hw_type[1] = ARP_HW_TYPE_1;
+    arp_pkt->proto_type[0] = ETH_TYPE_0;
+    arp_pkt->proto_type[1] = ETH_TYPE_IP_1;
+    arp_pkt->hw_addr_len = ETH_ADDR_LEN;
+    arp_pkt->proto_addr_len = IP_ADDR_LEN;
+    arp_pkt->opcode[0] = ARP_OPCODE_0;
+    arp_pkt->opcode[1] = ARP_OPCODE_REQ_1;
+    fast_memcpy(arp_pkt->mac_sa, my_mac, ETH_ADDR_LEN);
+    fast_memcpy(arp_pkt->ip_sa, my_ip, IP_ADDR_LEN);
+    fast_memset(arp_pkt->mac_ta, 0, ETH_ADDR_LEN);
+    fast_memcpy(arp_pkt->ip_ta, ip, IP_ADDR_LEN);
+    return (netif_output_pbuf(p, 0) == pdPASS) ? OK : ERR;
+}
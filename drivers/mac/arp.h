@@ -0,0 +1,36 @@
+/*******************************************************************************
+ *  arp.h: ARP cache.
+ *
+ *  Holds the Ethernet addresses of the last NET_ARP_CACHE_SIZE neighbours
+ *  the stack heard from, so that datagrams can be sent to any host of the LAN
+ *  and not only answered. Entries are learnt from ARP requests and replies
+ *  and replaced least recently used first. May be used from any task.
+ */
+#ifndef ARP_H_
+#define ARP_H_
+
+#include "nettype.h"
+
+/***************************************************************************//**
+ * Records the Ethernet address of a neighbour.
+ */
+void arp_cache_update(const unsigned char *ip, const unsigned char *mac);
+
+/***************************************************************************//**
+ * Looks up the Ethernet address of a neighbour.
+ *
+ * @param  ip       IP address.
+ * @param  mac      Filled with the Ethernet address when found.
+ * @return 1 if the address is known, 0 otherwise
+ */
+unsigned char arp_cache_lookup(const unsigned char *ip, unsigned char *mac);
+
+/***************************************************************************//**
+ * Broadcasts an ARP request for ip. The answer is recorded in the cache by
+ * process_arp_packet().
+ *
+ * @return OK if the request was queued, ERR if no buffer was available
+ */
+unsigned char arp_request(const unsigned char *ip);
+
+#endif /* ARP_H_ */
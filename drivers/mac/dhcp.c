@@ -0,0 +1,513 @@
+/*******************************************************************************
+ *  dhcp.c: DHCP client.
+ *
+ *  A single network timer drives the client. While acquiring, it retransmits
+ *  with a doubling delay starting at NET_DHCP_RETRY_MS so that the address is
+ *  normally obtained within the first exchange after the link comes up. Once
+ *  bound it fires at T1, then retransmits the renewal at half the time left to
+ *  T2 (at least 60 s, RFC 2131 4.4.5), likewise before the lease expires while
+ *  rebinding. Lease times are kept in seconds; waits longer than a network
+ *  timer allows are done in steps.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "nettype.h"
+#include "netif.h"
+#include "net_timer.h"
+#include "pbuf.h"
+#include "tcpip.h"
+#include "dhcp.h"
+#include "../fast_mem/fast_mem.h"
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+extern unsigned char my_mac[ETH_ADDR_LEN];
+extern unsigned char ip_known;
+extern unsigned char dhcp_ip_found;
+
+#define DHCP_OPTCODE_PAD        0
+#define DHCP_OPTCODE_REQ_IP     50  /* 50, 4, a.b.c.d, requested address */
+#define DHCP_OPTCODE_PARAMS     55  /* 55, n, parameter request list */
+
+#define DHCP_FIXED_LEN          (sizeof(bootp_pkt_t) - BOOTP_VEN_LEN)
+#define DHCP_MIN_RETRY_S        60
+#define DHCP_INFINITE_LEASE     0xFFFFFFFFUL
+
+static const unsigned char dhcp_magic[4] = { 99, 130, 83, 99 };
+static const unsigned char dhcp_bcast_mac[ETH_ADDR_LEN] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+static const unsigned char dhcp_bcast_ip[IP_ADDR_LEN] = { 0xFF, 0xFF, 0xFF, 0xFF };
+static const unsigned char dhcp_any_ip[IP_ADDR_LEN] = { 0, 0, 0, 0 };
+
+static struct {
+    dhcp_state_t state;
+    unsigned char xid[BOOTP_XID_LEN];
+    unsigned char offered[IP_ADDR_LEN];     /* yiaddr of the offer */
+    unsigned char server_mac[ETH_ADDR_LEN]; /* for unicast renewals */
+    unsigned char static_ip[IP_ADDR_LEN];   /* address used without a lease */
+    uint32_t t1;                            /* seconds after obtained */
+    uint32_t t2;
+    uint32_t started;                       /* net_timer_now_s() of the first DISCOVER */
+    unsigned char tries;
+    uint32_t seed;
+    net_timer_t timer;
+} dhcp;
+
+static dhcp_lease_t dhcp_lease;
+static unsigned char dhcp_arp_frame[42];
+
+/* Fields of a received message */
+typedef struct dhcp_opts {
+    unsigned char type;
+    unsigned char has_server;
+    unsigned char server[IP_ADDR_LEN];
+    unsigned char netmask[IP_ADDR_LEN];
+    unsigned char router[IP_ADDR_LEN];
+    uint32_t lease_time;
+    uint32_t t1;
+    uint32_t t2;
+} dhcp_opts_t;
+
+static uint32_t dhcp_random(void);
+static void dhcp_discover(void);
+static void dhcp_send(unsigned char type);
+static void dhcp_retry(void);
+static void dhcp_wait_s(uint32_t seconds);
+static void dhcp_timeout(void *arg);
+static void dhcp_lease_timeout(void);
+static void dhcp_bind(unsigned char *buf, const bootp_pkt_t *msg, const dhcp_opts_t *opts);
+static void dhcp_unbind(void);
+static unsigned char dhcp_parse(const unsigned char *opt, const unsigned char *end, dhcp_opts_t *opts);
+static uint32_t dhcp_get32(const unsigned char *p);
+
+/***************************************************************************//**
+ *  See dhcp.h for more information.
+ */
+void dhcp_start(void)
+{
+    if (dhcp.state == DHCP_STATE_OFF) {
+        fast_memcpy(dhcp.static_ip, my_ip, IP_ADDR_LEN);
+    }
+    dhcp.seed ^= ((uint32_t)my_mac[2] << 24) | ((uint32_t)my_mac[3] << 16) |
+                 ((uint32_t)my_mac[4] << 8) | my_mac[5];
+    dhcp.seed ^= (uint32_t)xTaskGetTickCount();
+    dhcp_discover();
+}
+
+/***************************************************************************//**
+ *  See dhcp.h for more information.
+ */
+void dhcp_stop(void)
+{
+    if (dhcp.state >= DHCP_STATE_BOUND) {
+        dhcp.state = DHCP_STATE_RENEWING;   /* RELEASE is unicast like a renewal */
+        dhcp_send(DHCP_TYPE_RELEASE);
+        dhcp_unbind();
+    }
+    net_timer_stop(&dhcp.timer);
+    dhcp.state = DHCP_STATE_OFF;
+}
+
+/***************************************************************************//**
+ *  See dhcp.h for more information.
+ */
+dhcp_state_t dhcp_get_state(void)
+{
+    return dhcp.state;
+}
+
+/***************************************************************************//**
+ *  See dhcp.h for more information.
+ */
+const dhcp_lease_t *dhcp_get_lease(void)
+{
+    return &dhcp_lease;
+}
+
+/***************************************************************************//**
+ *  See dhcp.h for more information.
+ */
+void dhcp_input(unsigned char *buf)
+{
+    ip_hdr_xp ip_hdr = (ip_hdr_xp ) (buf + sizeof(ether_hdr_t));
+    udp_hdr_xp udp_hdr = (udp_hdr_xp ) (buf + sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
+    bootp_pkt_xp msg = (bootp_pkt_xp )((unsigned char *)udp_hdr + sizeof(udp_hdr_t));
+    unsigned short int tlen = ((unsigned short int)ip_hdr->tlen[0] << 8) | ip_hdr->tlen[1];
+    unsigned short int ulen = ((unsigned short int)udp_hdr->len[0] << 8) | udp_hdr->len[1];
+    dhcp_opts_t opts;
+
+    if ((dhcp.state == DHCP_STATE_OFF) || (dhcp.state == DHCP_STATE_BOUND) ||
+        (ulen < sizeof(udp_hdr_t) + DHCP_FIXED_LEN + sizeof(dhcp_magic)) ||
+        (tlen < sizeof(ip_hdr_t)) || (ulen > tlen - sizeof(ip_hdr_t)) ||
+        (msg->op != BOOTP_OP_REPLY) ||
+        memcmp(msg->xid, dhcp.xid, BOOTP_XID_LEN) ||
+        memcmp(msg->chaddr, my_mac, ETH_ADDR_LEN)) {
+        return;
+    }
+    if (!dhcp_parse(msg->vend, (unsigned char *)udp_hdr + ulen, &opts)) {
+        return;
+    }
+
+    switch (dhcp.state) {
+    case DHCP_STATE_SELECTING:
+        if ((opts.type == DHCP_TYPE_OFFER) && opts.has_server) {
+            fast_memcpy(dhcp.offered, msg->yiaddr, IP_ADDR_LEN);
+            fast_memcpy(dhcp_lease.server, opts.server, IP_ADDR_LEN);
+            dhcp.state = DHCP_STATE_REQUESTING;
+            dhcp.tries = 0;
+            dhcp_send(DHCP_TYPE_REQUEST);
+            dhcp_retry();
+        }
+        break;
+    case DHCP_STATE_REQUESTING:
+    case DHCP_STATE_RENEWING:
+        /* Only the chosen server answers, any server may while rebinding */
+        if (!opts.has_server || memcmp(opts.server, dhcp_lease.server, IP_ADDR_LEN)) {
+            break;
+        }
+        /* fall through */
+    case DHCP_STATE_REBINDING:
+        if (opts.type == DHCP_TYPE_ACK) {
+            dhcp_bind(buf, msg, &opts);
+        } else if (opts.type == DHCP_TYPE_NAK) {
+            dhcp_unbind();
+            dhcp_discover();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/***************************************************************************//**
+ * Reads the options of a message. The options may run past the 64 byte
+ * vendor field of bootp_pkt_t, up to end.
+ *
+ * @return  1 if the message is a valid DHCP message
+ */
+static unsigned char dhcp_parse(const unsigned char *opt, const unsigned char *end, dhcp_opts_t *opts)
+{
+    unsigned char code;
+    unsigned char len;
+
+    fast_memset(opts, 0, sizeof(dhcp_opts_t));
+    opts->lease_time = DHCP_INFINITE_LEASE;
+    if (memcmp(opt, dhcp_magic, sizeof(dhcp_magic))) {
+        return 0;
+    }
+    opt += sizeof(dhcp_magic);
+    while (opt < end) {
+        code = *opt++;
+        if (code == DHCP_OPTCODE_PAD) {
+            continue;
+        }
+        if ((code == BOOTP_OPTCODE_END) || (opt >= end)) {
+            break;
+        }
+        len = *opt++;
+        if (opt + len > end) {
+            break;
+        }
+        switch (code) {
+        case BOOTP_OPTCODE_DHCP_TYPE:
+            if (len >= 1) {
+                opts->type = opt[0];
+            }
+            break;
+        case BOOTP_OPTCODE_DHCP_SID:
+            if (len >= IP_ADDR_LEN) {
+                fast_memcpy(opts->server, opt, IP_ADDR_LEN);
+                opts->has_server = 1;
+            }
+            break;
+        case BOOTP_OPTCODE_DHCP_SUBNET:
+            if (len >= IP_ADDR_LEN) {
+                fast_memcpy(opts->netmask, opt, IP_ADDR_LEN);
+            }
+            break;
+        case BOOTP_OPTCODE_DHCP_ROUTER:
+            if (len >= IP_ADDR_LEN) {
+                fast_memcpy(opts->router, opt, IP_ADDR_LEN);
+            }
+            break;
+        case BOOTP_OPTCODE_DHCP_LEASE:
+            if (len >= 4) {
+                opts->lease_time = dhcp_get32(opt);
+            }
+            break;
+        case BOOTP_OPTCODE_DHCP_RENEW:
+            if (len >= 4) {
+                opts->t1 = dhcp_get32(opt);
+            }
+            break;
+        case BOOTP_OPTCODE_DHCP_REBIND:
+            if (len >= 4) {
+                opts->t2 = dhcp_get32(opt);
+            }
+            break;
+        default:
+            break;
+        }
+        opt += len;
+    }
+    return opts->type != 0;
+}
+
+/***************************************************************************//**
+ * Takes the address of an ACK into use and schedules the renewal.
+ */
+static void dhcp_bind(unsigned char *buf, const bootp_pkt_t *msg, const dhcp_opts_t *opts)
+{
+    eth_hdr_xp eth_hdr = (eth_hdr_xp ) buf;
+    unsigned char announce = (dhcp.state == DHCP_STATE_REQUESTING) ||
+                             memcmp(my_ip, msg->yiaddr, IP_ADDR_LEN);
+
+    fast_memcpy(dhcp_lease.address, msg->yiaddr, IP_ADDR_LEN);
+    fast_memcpy(dhcp_lease.netmask, opts->netmask, IP_ADDR_LEN);
+    fast_memcpy(dhcp_lease.router, opts->router, IP_ADDR_LEN);
+    fast_memcpy(dhcp_lease.server, opts->server, IP_ADDR_LEN);
+    fast_memcpy(dhcp.server_mac, eth_hdr->sa, ETH_ADDR_LEN);
+    dhcp_lease.lease_time = opts->lease_time;
+    dhcp_lease.obtained = net_timer_now_s();
+
+    /* Defaults of RFC 2131 4.4.5, T1 = 0.5 and T2 = 0.875 of the lease */
+    dhcp.t1 = opts->t1 ? opts->t1 : dhcp_lease.lease_time / 2;
+    dhcp.t2 = opts->t2 ? opts->t2 : dhcp_lease.lease_time - dhcp_lease.lease_time / 8;
+    if (dhcp.t2 > dhcp_lease.lease_time) {
+        dhcp.t2 = dhcp_lease.lease_time;
+    }
+    if (dhcp.t1 > dhcp.t2) {
+        dhcp.t1 = dhcp.t2;
+    }
+
+    fast_memcpy(my_ip, dhcp_lease.address, IP_ADDR_LEN);
+    ip_known = 1;
+    dhcp_ip_found = 1;
+    dhcp.state = DHCP_STATE_BOUND;
+    if (announce) {
+        send_gratuitous_arp(dhcp_arp_frame);
+    }
+    dhcp_lease_timeout();
+}
+
+/***************************************************************************//**
+ * Gives up the lease and goes back to the static address.
+ */
+static void dhcp_unbind(void)
+{
+    fast_memcpy(my_ip, dhcp.static_ip, IP_ADDR_LEN);
+    ip_known = 0;
+    dhcp_ip_found = 0;
+    fast_memset(&dhcp_lease, 0, sizeof(dhcp_lease));
+}
+
+/***************************************************************************//**
+ * Starts a new acquisition.
+ */
+static void dhcp_discover(void)
+{
+    uint32_t xid = dhcp_random();
+
+    dhcp.xid[0] = (unsigned char)(xid >> 24);
+    dhcp.xid[1] = (unsigned char)(xid >> 16);
+    dhcp.xid[2] = (unsigned char)(xid >> 8);
+    dhcp.xid[3] = (unsigned char)xid;
+    dhcp.started = net_timer_now_s();
+    dhcp.state = DHCP_STATE_SELECTING;
+    dhcp.tries = 0;
+    dhcp_send(DHCP_TYPE_DISCOVER);
+    dhcp_retry();
+}
+
+/***************************************************************************//**
+ * Arms the retransmission timer of SELECTING and REQUESTING: the delay
+ * doubles with each try up to NET_DHCP_RETRY_MAX_MS, with up to 255 ms of
+ * jitter so that boards powered together do not stay in step.
+ */
+static void dhcp_retry(void)
+{
+    uint32_t ms = NET_DHCP_RETRY_MS;
+    unsigned char i;
+
+    for (i = 0; (i < dhcp.tries) && (ms < NET_DHCP_RETRY_MAX_MS); i++) {
+        ms <<= 1;
+    }
+    if (ms > NET_DHCP_RETRY_MAX_MS) {
+        ms = NET_DHCP_RETRY_MAX_MS;
+    }
+    dhcp.tries++;
+    net_timer_start(&dhcp.timer, ms + (dhcp_random() & 0xFF), dhcp_timeout, NULL);
+}
+
+/***************************************************************************//**
+ * Arms the timer for a lease event, in steps when it is too far away.
+ */
+static void dhcp_wait_s(uint32_t seconds)
+{
+    if (seconds > NET_TIMER_MAX_MS / 1000UL) {
+        seconds = NET_TIMER_MAX_MS / 1000UL;
+    }
+    net_timer_start(&dhcp.timer, seconds * 1000UL, dhcp_timeout, NULL);
+}
+
+/***************************************************************************//**
+ * Timer function.
+ */
+static void dhcp_timeout(void *arg)
+{
+    (void)arg;
+
+    switch (dhcp.state) {
+    case DHCP_STATE_SELECTING:
+        dhcp_send(DHCP_TYPE_DISCOVER);
+        dhcp_retry();
+        break;
+    case DHCP_STATE_REQUESTING:
+        if (dhcp.tries >= NET_DHCP_REQUEST_TRIES) {
+            /* The server went away, look for another one */
+            dhcp_discover();
+        } else {
+            dhcp_send(DHCP_TYPE_REQUEST);
+            dhcp_retry();
+        }
+        break;
+    case DHCP_STATE_BOUND:
+    case DHCP_STATE_RENEWING:
+    case DHCP_STATE_REBINDING:
+        dhcp_lease_timeout();
+        break;
+    default:
+        break;
+    }
+}
+
+/***************************************************************************//**
+ * Moves through BOUND, RENEWING and REBINDING as the lease ages, sending the
+ * renewal requests, and drops the address when the lease has expired.
+ */
+static void dhcp_lease_timeout(void)
+{
+    uint32_t elapsed = net_timer_now_s() - dhcp_lease.obtained;
+    uint32_t left;
+    uint32_t next;
+
+    if (dhcp_lease.lease_time == DHCP_INFINITE_LEASE) {
+        dhcp.state = DHCP_STATE_BOUND;
+        return;
+    }
+    if (elapsed >= dhcp_lease.lease_time) {
+        dhcp_unbind();
+        dhcp_discover();
+        return;
+    }
+    if (elapsed >= dhcp.t2) {
+        dhcp.state = DHCP_STATE_REBINDING;
+        left = dhcp_lease.lease_time - elapsed;
+    } else if (elapsed >= dhcp.t1) {
+        dhcp.state = DHCP_STATE_RENEWING;
+        left = dhcp.t2 - elapsed;
+    } else {
+        dhcp_wait_s(dhcp.t1 - elapsed);
+        return;
+    }
+
+    dhcp_send(DHCP_TYPE_REQUEST);
+    next = left / 2;
+    if (next < DHCP_MIN_RETRY_S) {
+        next = DHCP_MIN_RETRY_S;
+    }
+    if (next > left) {
+        next = left;
+    }
+    dhcp_wait_s(next);
+}
+
+/***************************************************************************//**
+ * Sends a message for the current state. DISCOVER and the REQUEST of an
+ * offer are broadcast from 0.0.0.0, not from the static address; renewals
+ * carry the leased address, and go straight to the server while RENEWING. A message that cannot get a
+ * packet buffer is simply lost, the timer retransmits it.
+ */
+static void dhcp_send(unsigned char type)
+{
+    pbuf_t *p = pbuf_alloc(NET_PBUF_HEADROOM, sizeof(bootp_pkt_t));
+    bootp_pkt_xp msg;
+    unsigned char *opts;
+    uint32_t secs;
+    unsigned char renewal = (dhcp.state == DHCP_STATE_RENEWING) ||
+                            (dhcp.state == DHCP_STATE_REBINDING);
+
+    if ((p == NULL) || (p->next != NULL)) {
+        pbuf_free(p);
+        return;
+    }
+    msg = (bootp_pkt_xp ) p->payload;
+    fast_memset(msg, 0, sizeof(bootp_pkt_t));
+    msg->op = BOOTP_OP_REQUEST;
+    msg->hwtype = BOOTP_HWTYPE_ETH;
+    msg->hlen = ETH_ADDR_LEN;
+    fast_memcpy(msg->xid, dhcp.xid, BOOTP_XID_LEN);
+    secs = net_timer_now_s() - dhcp.started;
+    if (secs > 0xFFFF) {
+        secs = 0xFFFF;
+    }
+    msg->secs[0] = (unsigned char)(secs >> 8);
+    msg->secs[1] = (unsigned char)secs;
+    fast_memcpy(msg->chaddr, my_mac, ETH_ADDR_LEN);
+    if (renewal) {
+        fast_memcpy(msg->ciaddr, dhcp_lease.address, IP_ADDR_LEN);
+    } else {
+        msg->flags[0] = 0x80;    /* ask for a broadcast, we have no address yet */
+    }
+
+    opts = msg->vend;
+    fast_memcpy(opts, dhcp_magic, sizeof(dhcp_magic));
+    opts += sizeof(dhcp_magic);
+    *opts++ = BOOTP_OPTCODE_DHCP_TYPE;
+    *opts++ = 1;
+    *opts++ = type;
+    if ((type == DHCP_TYPE_REQUEST) && !renewal) {
+        *opts++ = DHCP_OPTCODE_REQ_IP;
+        *opts++ = IP_ADDR_LEN;
+        fast_memcpy(opts, dhcp.offered, IP_ADDR_LEN);
+        opts += IP_ADDR_LEN;
+    }
+    if (((type == DHCP_TYPE_REQUEST) && !renewal) || (type == DHCP_TYPE_RELEASE)) {
+        *opts++ = BOOTP_OPTCODE_DHCP_SID;
+        *opts++ = IP_ADDR_LEN;
+        fast_memcpy(opts, dhcp_lease.server, IP_ADDR_LEN);
+        opts += IP_ADDR_LEN;
+    }
+    if (type != DHCP_TYPE_RELEASE) {
+        *opts++ = DHCP_OPTCODE_PARAMS;
+        *opts++ = 4;
+        *opts++ = BOOTP_OPTCODE_DHCP_SUBNET;
+        *opts++ = BOOTP_OPTCODE_DHCP_ROUTER;
+        *opts++ = BOOTP_OPTCODE_DHCP_RENEW;
+        *opts++ = BOOTP_OPTCODE_DHCP_REBIND;
+    }
+    *opts++ = BOOTP_OPTCODE_END;
+
+    if (dhcp.state == DHCP_STATE_RENEWING) {
+        send_udp_pbuf(dhcp_lease.address, dhcp.server_mac, dhcp_lease.server,
+                      BOOTP_CLIENT_PORT, BOOTP_SERVER_PORT, p);
+    } else {
+        send_udp_pbuf(renewal ? dhcp_lease.address : dhcp_any_ip, dhcp_bcast_mac,
+                      dhcp_bcast_ip, BOOTP_CLIENT_PORT, BOOTP_SERVER_PORT, p);
+    }
+}
+
+/***************************************************************************//**
+ * Pseudo random numbers for transaction IDs and jitter.
+ */
+static uint32_t dhcp_random(void)
+{
+    dhcp.seed = dhcp.seed * 1103515245UL + 12345UL;
+    return dhcp.seed ^ (dhcp.seed >> 16);
+}
+
+static uint32_t dhcp_get32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
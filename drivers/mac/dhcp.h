@@ -0,0 +1,69 @@
+/*******************************************************************************
+ *  dhcp.h: DHCP client.
+ *
+ *  Acquires an address with DISCOVER/OFFER/REQUEST/ACK, renews it with the
+ *  server that granted it at T1, rebinds with any server at T2 and gives it up
+ *  when the lease expires, then starts over. Everything is driven by network
+ *  timers and received messages, nothing ever blocks. Until a lease is
+ *  obtained, and after one is lost, the stack keeps using its static address.
+ *
+ *  All functions must be called from the network interface task.
+ */
+#ifndef DHCP_H_
+#define DHCP_H_
+
+#include <stdint.h>
+#include "nettype.h"
+
+/***************************************************************************//**
+ * Client states, RFC 2131 figure 5.
+ */
+typedef enum dhcp_state {
+    DHCP_STATE_OFF = 0,
+    DHCP_STATE_SELECTING,       /* DISCOVER sent, waiting for an OFFER */
+    DHCP_STATE_REQUESTING,      /* REQUEST sent for an offer */
+    DHCP_STATE_BOUND,
+    DHCP_STATE_RENEWING,        /* past T1, unicast REQUEST to the server */
+    DHCP_STATE_REBINDING        /* past T2, broadcast REQUEST */
+} dhcp_state_t;
+
+/***************************************************************************//**
+ * Current lease. Only meaningful from DHCP_STATE_BOUND onwards.
+ */
+typedef struct dhcp_lease {
+    unsigned char address[IP_ADDR_LEN];
+    unsigned char netmask[IP_ADDR_LEN];
+    unsigned char router[IP_ADDR_LEN];
+    unsigned char server[IP_ADDR_LEN];
+    uint32_t lease_time;        /* seconds granted */
+    uint32_t obtained;          /* net_timer_now_s() when granted */
+} dhcp_lease_t;
+
+/***************************************************************************//**
+ * Starts address acquisition. Called once the MAC address is set.
+ */
+void dhcp_start(void);
+
+/***************************************************************************//**
+ * Releases the lease, if any, and stops the client.
+ */
+void dhcp_stop(void);
+
+/***************************************************************************//**
+ * Handles a message received on the BOOTP client port.
+ *
+ * @param  buf      Frame, starting with the Ethernet header.
+ */
+void dhcp_input(unsigned char *buf);
+
+/***************************************************************************//**
+ * Returns the client state.
+ */
+dhcp_state_t dhcp_get_state(void);
+
+/***************************************************************************//**
+ * Returns the current lease.
+ */
+const dhcp_lease_t *dhcp_get_lease(void);
+
+#endif /* DHCP_H_ */
@@ -0,0 +1,24 @@
+/*******************************************************************************
+ *  fs.c: read-only file image served by the HTTP server.
+ */
+#include <string.h>
+#include "fs.h"
+
+/* Generated in fs_data.c */
+extern const fs_file_t fs_files[];
+extern const unsigned int fs_file_count;
+
+/***************************************************************************//**
+ *  See fs.h for more information.
+ */
+const fs_file_t *fs_open(const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < fs_file_count; i++) {
+        if (!strcmp(fs_files[i].name, name)) {
+            return &fs_files[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,31 @@
+/*******************************************************************************
+ *  fs.h: read-only file image served by the HTTP server.
+ *
+ *  The image is the fs_files table of fs_data.c, generated from the web/
+ *  directory by tools/mkfsdata.py. Text files are stored gzipped when that
+ *  makes them smaller, so they take less flash and fewer frames, and are sent
+ *  to the client as they are.
+ */
+#ifndef FS_H_
+#define FS_H_
+
+#include <stdint.h>
+
+#define FS_FLAG_GZIP    0x01    /* data is gzip encoded */
+
+typedef struct fs_file {
+    const char *name;           /* absolute path, e.g. "/index.html" */
+    const unsigned char *data;
+    uint32_t len;
+    const char *content_type;
+    unsigned char flags;        /* FS_FLAG_* */
+} fs_file_t;
+
+/***************************************************************************//**
+ * Looks a file up by path.
+ *
+ * @return  the file, NULL if there is none of that name
+ */
+const fs_file_t *fs_open(const char *name);
+
+#endif /* FS_H_ */
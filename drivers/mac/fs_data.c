@@ -0,0 +1,88 @@
+/*******************************************************************************
+ *  fs_data.c: file image of the HTTP server, see fs.h.
+ *
+ *  Generated by tools/mkfsdata.py from web/, do not edit.
+ */
+#include "fs.h"
+
+static const unsigned char data_index_html[275] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7d, 0x51, 0xb1, 0x4e, 0xc4, 0x30,
+    0x0c, 0xdd, 0xfb, 0x15, 0x26, 0xfb, 0xb5, 0xe2, 0x26, 0x86, 0xb6, 0x12, 0xba, 0x83, 0x11, 0x10,
+    0xdc, 0xc2, 0x98, 0x26, 0x2e, 0x0d, 0x4d, 0x9b, 0x2a, 0x76, 0x0f, 0xf5, 0xef, 0x71, 0xda, 0xb2,
+    0x80, 0xc4, 0x64, 0xf9, 0xbd, 0x97, 0xf7, 0x6c, 0xa7, 0xbc, 0x39, 0x3f, 0x9f, 0x2e, 0xef, 0x2f,
+    0x0f, 0xd0, 0xf1, 0xe0, 0xeb, 0xac, 0xfc, 0x29, 0xa8, 0xad, 0x94, 0x01, 0x59, 0x83, 0xe9, 0x74,
+    0x24, 0xe4, 0x4a, 0xcd, 0xdc, 0x1e, 0xee, 0x94, 0xc0, 0xec, 0xd8, 0x63, 0xfd, 0x36, 0xe8, 0xc8,
+    0x8f, 0x33, 0xb9, 0x30, 0x42, 0x13, 0x74, 0xb4, 0x40, 0xac, 0x79, 0xa6, 0xb2, 0xd8, 0xf8, 0xac,
+    0xf4, 0x6e, 0xec, 0x21, 0xa2, 0xaf, 0x14, 0xf1, 0xe2, 0x91, 0x3a, 0x44, 0x56, 0xd0, 0x45, 0x6c,
+    0x2b, 0x55, 0xac, 0x50, 0x6e, 0x88, 0x92, 0x63, 0xb1, 0x07, 0x36, 0xc1, 0x2e, 0x29, 0xfe, 0xf6,
+    0x1f, 0x77, 0x21, 0x33, 0x91, 0x1c, 0xeb, 0xfb, 0xf3, 0x49, 0xba, 0x63, 0x1a, 0x48, 0x37, 0x1e,
+    0xc1, 0xd9, 0x4a, 0x69, 0x6b, 0x54, 0x2d, 0x13, 0x24, 0x60, 0x97, 0x3d, 0x21, 0x7f, 0x85, 0xd8,
+    0xff, 0x91, 0x8e, 0x32, 0xcc, 0x2f, 0xe9, 0x45, 0x53, 0x4f, 0xbb, 0x70, 0x8a, 0x9b, 0x8c, 0x13,
+    0x96, 0x84, 0x02, 0x24, 0xd9, 0x04, 0xc6, 0x6b, 0x22, 0x79, 0x1f, 0x18, 0x55, 0xfd, 0x8a, 0x6d,
+    0x4c, 0x9b, 0x59, 0xc0, 0x2b, 0xc6, 0x05, 0x08, 0x4d, 0x18, 0x2d, 0x04, 0x69, 0x40, 0x03, 0xb9,
+    0xf1, 0x43, 0xe2, 0x7a, 0x9c, 0xf8, 0xa0, 0xbd, 0xbb, 0x22, 0x08, 0x3b, 0xa2, 0x61, 0x59, 0x2b,
+    0x17, 0xcb, 0x64, 0x48, 0x26, 0xba, 0x89, 0x81, 0xa2, 0x59, 0xaf, 0x92, 0x96, 0xcc, 0x3f, 0xd7,
+    0xc4, 0x8d, 0x49, 0xe7, 0xd9, 0xef, 0x52, 0x6c, 0xdf, 0xf3, 0x0d, 0x87, 0xa6, 0xcc, 0xf7, 0xb6,
+    0x01, 0x00, 0x00,
+};
+
+static const unsigned char data_status_js[486] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x95, 0x52, 0xcb, 0x6e, 0xdb, 0x30,
+    0x10, 0xbc, 0xeb, 0x2b, 0x16, 0x3c, 0x49, 0xb0, 0x2a, 0xb9, 0xd7, 0x38, 0x49, 0x81, 0x16, 0x05,
+    0xda, 0xa2, 0x8f, 0x00, 0xf5, 0x2d, 0xe9, 0x61, 0x43, 0xad, 0x2c, 0xd5, 0x12, 0xe9, 0x92, 0xab,
+    0x34, 0x46, 0xe0, 0x7f, 0xef, 0x92, 0xb2, 0x1d, 0x39, 0x41, 0x80, 0x94, 0x07, 0x49, 0x5c, 0xce,
+    0xce, 0xcc, 0x72, 0x54, 0x96, 0x70, 0x65, 0xbb, 0xce, 0x03, 0x37, 0x04, 0xd5, 0xd6, 0x60, 0xdf,
+    0x6a, 0xd8, 0xe0, 0x8a, 0x3c, 0xd8, 0x3a, 0x16, 0x6f, 0x2d, 0xba, 0x0a, 0xd0, 0x54, 0x50, 0xb7,
+    0x07, 0x20, 0xe3, 0x6d, 0x37, 0x22, 0x5a, 0x53, 0xd1, 0x7d, 0xd1, 0x70, 0xdf, 0x15, 0x49, 0x59,
+    0xc2, 0x52, 0x0e, 0x1d, 0xfd, 0x19, 0xc8, 0xb3, 0x07, 0x74, 0x04, 0x3d, 0x56, 0x04, 0xd6, 0x10,
+    0x60, 0xcd, 0xe4, 0x62, 0xb3, 0x95, 0x87, 0x03, 0x6f, 0x65, 0x83, 0x3c, 0x4a, 0x38, 0xfb, 0xd7,
+    0x4b, 0xcd, 0xd1, 0xe0, 0x85, 0x16, 0x03, 0x93, 0x6f, 0xcd, 0xaa, 0x23, 0xd0, 0xd6, 0x18, 0xd2,
+    0xdc, 0x5a, 0x93, 0x4f, 0xdc, 0x58, 0xd3, 0x6d, 0xa1, 0x41, 0x81, 0x0a, 0x60, 0xd8, 0x74, 0x54,
+    0x24, 0x49, 0x3d, 0x98, 0x88, 0x8b, 0x36, 0xd3, 0xb6, 0xca, 0xe1, 0x0e, 0x3b, 0x31, 0x92, 0xc1,
+    0x43, 0x02, 0xb2, 0xee, 0x50, 0x04, 0x44, 0x07, 0x2e, 0x40, 0xa9, 0x45, 0x2c, 0xd5, 0xd6, 0x41,
+    0x1a, 0xea, 0x6b, 0xda, 0xca, 0x24, 0x4f, 0x1a, 0xc2, 0x8a, 0x0d, 0x33, 0xe9, 0x38, 0x67, 0x77,
+    0x79, 0xce, 0xd5, 0xa5, 0x82, 0x59, 0x44, 0xcf, 0xa4, 0x54, 0xca, 0x5e, 0x6a, 0xa0, 0x3b, 0xf4,
+    0xfe, 0xe2, 0x46, 0xc5, 0xf6, 0x1b, 0x15, 0x31, 0x23, 0xd5, 0xb5, 0x40, 0x7f, 0x3d, 0x62, 0x4b,
+    0x21, 0xd9, 0x4b, 0xef, 0xe2, 0xb3, 0xb2, 0x7a, 0xe8, 0xc9, 0x70, 0xb1, 0x22, 0xfe, 0xd8, 0x51,
+    0xf8, 0x7c, 0xbf, 0xfd, 0x5c, 0x89, 0xfb, 0xac, 0x68, 0x65, 0x70, 0xf7, 0x69, 0xf9, 0xed, 0xab,
+    0x18, 0x0e, 0x36, 0x16, 0xc9, 0x6e, 0x32, 0xa4, 0x34, 0xa4, 0x1b, 0xe4, 0xe6, 0x60, 0xd6, 0x11,
+    0x0f, 0x4e, 0x66, 0x27, 0xd6, 0x4d, 0x3c, 0xc8, 0xe1, 0x01, 0x34, 0xea, 0x86, 0xce, 0x40, 0x19,
+    0xfb, 0xc6, 0xb3, 0x75, 0xa4, 0x60, 0x97, 0x15, 0x72, 0x8b, 0x26, 0x3d, 0xf2, 0xa4, 0xee, 0x64,
+    0xdc, 0x91, 0xc5, 0x15, 0x76, 0x0d, 0xef, 0xe4, 0xc5, 0x74, 0xcf, 0x69, 0x06, 0x67, 0x70, 0xe5,
+    0x6c, 0xdf, 0x7a, 0x2a, 0x1c, 0xfd, 0x96, 0x34, 0x52, 0x57, 0x78, 0x46, 0x1e, 0x7c, 0xb6, 0x1f,
+    0x26, 0x3b, 0x35, 0xb7, 0x91, 0x3f, 0x2a, 0x3d, 0xf0, 0x06, 0xa7, 0xaa, 0x1c, 0xf1, 0x25, 0x56,
+    0x5a, 0x3d, 0xb3, 0x10, 0x54, 0xa6, 0x2e, 0x62, 0x80, 0x2a, 0x40, 0x73, 0xf8, 0xf2, 0xf3, 0xc7,
+    0xf7, 0x62, 0x83, 0xce, 0xd3, 0x08, 0xdb, 0x2b, 0x4e, 0xcc, 0x9e, 0xf0, 0x1b, 0x62, 0x75, 0x34,
+    0xf5, 0x3a, 0x9d, 0xd0, 0xf2, 0xdf, 0x3a, 0x8c, 0x7e, 0xed, 0x5f, 0xaf, 0xf4, 0x52, 0xce, 0x6a,
+    0xcf, 0x13, 0x2f, 0xfa, 0x83, 0x35, 0x2c, 0x07, 0x12, 0x77, 0xd8, 0x1d, 0xa9, 0x35, 0x86, 0x48,
+    0x1f, 0xb9, 0x0f, 0xbc, 0xcf, 0x55, 0xa7, 0x8a, 0x9e, 0x78, 0xd9, 0xf6, 0x64, 0x07, 0xf9, 0x4d,
+    0x24, 0x8d, 0x1c, 0xde, 0xce, 0xe7, 0xf3, 0xd3, 0xb8, 0xc6, 0x94, 0x16, 0xc9, 0x3f, 0xe3, 0xa6,
+    0x82, 0x37, 0x03, 0x04, 0x00, 0x00,
+};
+
+static const unsigned char data_style_css[241] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6d, 0x90, 0x41, 0x6e, 0xc3, 0x20,
+    0x10, 0x45, 0xf7, 0x3e, 0x05, 0x52, 0xd6, 0x58, 0x36, 0x4a, 0x24, 0x0b, 0x4e, 0x83, 0x01, 0x13,
+    0x14, 0x60, 0x10, 0x90, 0x2a, 0x69, 0xd5, 0xbb, 0x17, 0x8c, 0xa9, 0xa2, 0xb4, 0xb0, 0x41, 0xf3,
+    0xff, 0xbc, 0x19, 0xfe, 0x0a, 0xf2, 0x89, 0xbe, 0x06, 0x54, 0xce, 0x06, 0x3e, 0xe3, 0x8d, 0x3b,
+    0x63, 0x9f, 0x14, 0x25, 0xee, 0x13, 0x4e, 0x2a, 0x9a, 0x8d, 0xed, 0xa2, 0xe3, 0x51, 0x1b, 0x4f,
+    0x11, 0x51, 0xae, 0x15, 0x04, 0x58, 0x88, 0x14, 0x9d, 0x08, 0x21, 0x6c, 0xf8, 0x1e, 0xae, 0xf3,
+    0x2b, 0x25, 0x99, 0x4f, 0x45, 0xd1, 0x3c, 0x9e, 0xab, 0xbb, 0x88, 0xe4, 0x3f, 0x71, 0xee, 0xa8,
+    0xc6, 0xc6, 0x19, 0x42, 0x2d, 0x5f, 0x7a, 0x79, 0x85, 0x28, 0x55, 0xc4, 0x2b, 0xe4, 0x0c, 0xae,
+    0x28, 0xe1, 0x81, 0x12, 0x58, 0x23, 0xd1, 0x49, 0x08, 0x51, 0xb1, 0x99, 0xaf, 0x56, 0x1d, 0xe4,
+    0xc3, 0x5c, 0xb6, 0xb2, 0x3c, 0xa4, 0xc2, 0xef, 0xaf, 0xdd, 0x28, 0x0f, 0x57, 0xe0, 0x52, 0x1a,
+    0xaf, 0x29, 0x9a, 0xea, 0xf4, 0x36, 0xec, 0x78, 0x4f, 0xcd, 0x38, 0x7e, 0x70, 0x7b, 0xef, 0xd0,
+    0xac, 0x1e, 0x19, 0x73, 0x6b, 0x74, 0xf9, 0x78, 0x34, 0xfa, 0x9a, 0xd9, 0xdf, 0xa0, 0x1c, 0x78,
+    0x48, 0x81, 0x8b, 0x7d, 0x50, 0x88, 0xbf, 0xfb, 0x70, 0x71, 0xd3, 0x11, 0xee, 0x5e, 0x96, 0x8c,
+    0xb6, 0x73, 0xbd, 0xec, 0x7d, 0x85, 0x4b, 0x4b, 0x67, 0xf4, 0x90, 0x7b, 0x5b, 0x4f, 0x75, 0x59,
+    0x16, 0xf6, 0x9e, 0xd8, 0x34, 0x2e, 0xad, 0xe1, 0x07, 0x01, 0xc7, 0x01, 0x71, 0xb4, 0x01, 0x00,
+    0x00,
+};
+
+const fs_file_t fs_files[] = {
+    { "/index.html", data_index_html, sizeof(data_index_html), "text/html", FS_FLAG_GZIP },
+    { "/status.js", data_status_js, sizeof(data_status_js), "application/javascript", FS_FLAG_GZIP },
+    { "/style.css", data_style_css, sizeof(data_style_css), "text/css", FS_FLAG_GZIP },
+};
+
+const unsigned int fs_file_count = sizeof(fs_files) / sizeof(fs_files[0]);
@@ -0,0 +1,324 @@
+/*******************************************************************************
+ *  httpd.c: HTTP/1.1 server.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "nettype.h"
+#include "../mss_ethernet_mac/mss_ethernet_mac.h"
+#include "netif.h"
+#include "pbuf.h"
+#include "fs.h"
+#include "httpd.h"
+#include "tcpip.h"
+#include "../fast_mem/fast_mem.h"
+
+typedef struct httpd_conn {
+    uint16_t req_len;                   /* bytes in req */
+    unsigned char busy;                 /* response outstanding */
+    char req[NET_HTTPD_REQUEST_SIZE];
+    char hdr[NET_HTTPD_HEADER_SIZE];
+    char body[NET_HTTPD_DYNAMIC_SIZE];
+} httpd_conn_t;
+
+static httpd_conn_t httpd_conns[NET_TCP_CONNECTIONS];
+static const httpd_cgi_t *httpd_cgi;
+static unsigned char httpd_cgi_count;
+
+static const char httpd_not_found[] = "Not Found\n";
+static const char httpd_bad_request[] = "Bad Request\n";
+static const char httpd_not_implemented[] = "Not Implemented\n";
+static const char httpd_not_acceptable[] = "Not Acceptable, gzip only\n";
+
+/***************************************************************************//**
+ * Compares at most n characters ignoring case.
+ */
+static int httpd_strncasecmp(const char *a, const char *b, uint16_t n)
+{
+    char ca, cb;
+
+    while (n--) {
+        ca = *a++;
+        cb = *b++;
+        if ((ca >= 'A') && (ca <= 'Z')) {
+            ca += 'a' - 'A';
+        }
+        if ((cb >= 'A') && (cb <= 'Z')) {
+            cb += 'a' - 'A';
+        }
+        if ((ca != cb) || (ca == 0)) {
+            return ca - cb;
+        }
+    }
+    return 0;
+}
+
+/***************************************************************************//**
+ * Returns 1 if the list of tokens s, ending at end, contains token.
+ */
+static unsigned char httpd_has_token(const char *s, const char *end, const char *token)
+{
+    uint16_t n = (uint16_t)strlen(token);
+
+    for (; s + n <= end; s++) {
+        if (!httpd_strncasecmp(s, token, n)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/***************************************************************************//**
+ * Finds the value of a header field in the request headers between s and end.
+ *
+ * @return  the start of the value, NULL if the field is absent; *vend is set
+ *          to the end of the line
+ */
+static const char *httpd_field(const char *s, const char *end, const char *name, const char **vend)
+{
+    uint16_t n = (uint16_t)strlen(name);
+    const char *eol;
+
+    while (s < end) {
+        for (eol = s; (eol < end) && (*eol != '\r'); eol++) {
+        }
+        if ((eol - s > n) && (s[n] == ':') && !httpd_strncasecmp(s, name, n)) {
+            s += n + 1;
+            while ((s < eol) && (*s == ' ')) {
+                s++;
+            }
+            *vend = eol;
+            return s;
+        }
+        s = eol + 2;
+    }
+    return NULL;
+}
+
+/***************************************************************************//**
+ *  See httpd.h for more information.
+ */
+void httpd_puts(httpd_buf_t *out, const char *s)
+{
+    while (*s && (out->len < out->size)) {
+        out->data[out->len++] = *s++;
+    }
+}
+
+/***************************************************************************//**
+ *  See httpd.h for more information.
+ */
+void httpd_putu(httpd_buf_t *out, uint32_t v)
+{
+    char digits[11];
+    char *p = &digits[sizeof(digits) - 1];
+
+    *p = 0;
+    do {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    httpd_puts(out, p);
+}
+
+/***************************************************************************//**
+ * Builds the status line and header fields of a response in the header
+ * buffer of the connection and sends it with the body.
+ */
+static void httpd_respond(unsigned char conn, const char *status, const char *content_type,
+                          unsigned char gzip, unsigned char cache,
+                          const void *body, uint16_t blen, unsigned char head,
+                          unsigned char keep_alive)
+{
+    httpd_conn_t *c = &httpd_conns[conn];
+    httpd_buf_t out;
+
+    out.data = c->hdr;
+    out.len = 0;
+    out.size = sizeof(c->hdr);
+    httpd_puts(&out, "HTTP/1.1 ");
+    httpd_puts(&out, status);
+    httpd_puts(&out, "\r\nContent-Type: ");
+    httpd_puts(&out, content_type);
+    httpd_puts(&out, "\r\nContent-Length: ");
+    httpd_putu(&out, blen);
+    if (gzip) {
+        httpd_puts(&out, "\r\nContent-Encoding: gzip");
+    }
+    httpd_puts(&out, cache ? "\r\nCache-Control: max-age=3600" : "\r\nCache-Control: no-store");
+    httpd_puts(&out, keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+
+    c->busy = 1;
+    if (tcp_send(conn, (const unsigned char *)c->hdr, out.len,
+                 (const unsigned char *)body, head ? 0 : blen, !keep_alive) != 0) {
+        c->busy = 0;
+    }
+}
+
+/***************************************************************************//**
+ * Answers the request of len bytes at the start of the request buffer.
+ */
+static void httpd_request(unsigned char conn, uint16_t len)
+{
+    httpd_conn_t *c = &httpd_conns[conn];
+    char *s = c->req;
+    char *end = c->req + len;
+    char *path;
+    char *p;
+    const char *v;
+    const char *vend;
+    unsigned char head = 0;
+    unsigned char keep_alive;
+    unsigned char gzip_ok = 1;
+    const fs_file_t *file;
+    httpd_buf_t out;
+    unsigned char i;
+
+    /* Request line: method, path and version */
+    if (!strncmp(s, "GET ", 4)) {
+        path = s + 4;
+    }
+    else if (!strncmp(s, "HEAD ", 5)) {
+        path = s + 5;
+        head = 1;
+    }
+    else {
+        httpd_respond(conn, "501 Not Implemented", "text/plain", 0, 0, httpd_not_implemented,
+                      sizeof(httpd_not_implemented) - 1, 0, 0);
+        return;
+    }
+    for (p = path; (p < end) && (*p != ' ') && (*p != '?') && (*p != '\r'); p++) {
+    }
+    v = p;
+    while ((v < end) && (*v != ' ') && (*v != '\r')) {
+        v++;
+    }
+    if ((*path != '/') || (*v != ' ') || (end - v < 10) || strncmp(v + 1, "HTTP/1.", 7)) {
+        httpd_respond(conn, "400 Bad Request", "text/plain", 0, 0, httpd_bad_request,
+                      sizeof(httpd_bad_request) - 1, 0, 0);
+        return;
+    }
+    *p = 0;
+
+    /* HTTP/1.1 keeps the connection by default, HTTP/1.0 only on request */
+    keep_alive = (v[8] == '1');
+    v = httpd_field(v, end, "Connection", &vend);
+    if (v != NULL) {
+        if (httpd_has_token(v, vend, "close")) {
+            keep_alive = 0;
+        }
+        else if (httpd_has_token(v, vend, "keep-alive")) {
+            keep_alive = 1;
+        }
+    }
+    v = httpd_field(s, end, "Accept-Encoding", &vend);
+    if (v != NULL) {
+        gzip_ok = httpd_has_token(v, vend, "gzip");
+    }
+
+    if (!strcmp(path, "/")) {
+        path = "/index.html";
+    }
+    for (i = 0; i < httpd_cgi_count; i++) {
+        if (!strcmp(path, httpd_cgi[i].path)) {
+            out.data = c->body;
+            out.len = 0;
+            out.size = sizeof(c->body);
+            httpd_cgi[i].fn(&out);
+            httpd_respond(conn, "200 OK", httpd_cgi[i].content_type, 0, 0,
+                          c->body, out.len, head, keep_alive);
+            return;
+        }
+    }
+    file = fs_open(path);
+    if (file == NULL) {
+        httpd_respond(conn, "404 Not Found", "text/plain", 0, 0, httpd_not_found,
+                      sizeof(httpd_not_found) - 1, head, keep_alive);
+    }
+    else if ((file->flags & FS_FLAG_GZIP) && !gzip_ok) {
+        /* Only the compressed form is in the image */
+        httpd_respond(conn, "406 Not Acceptable", "text/plain", 0, 0, httpd_not_acceptable,
+                      sizeof(httpd_not_acceptable) - 1, head, keep_alive);
+    }
+    else {
+        httpd_respond(conn, "200 OK", file->content_type, file->flags & FS_FLAG_GZIP, 1,
+                      file->data, (uint16_t)file->len, head, keep_alive);
+    }
+}
+
+/***************************************************************************//**
+ * Answers the first request of the buffer if it is complete and removes it.
+ */
+static void httpd_process(unsigned char conn)
+{
+    httpd_conn_t *c = &httpd_conns[conn];
+    uint16_t i;
+    uint16_t len = 0;
+
+    for (i = 3; i < c->req_len; i++) {
+        if ((c->req[i] == '\n') && (c->req[i-1] == '\r') &&
+            (c->req[i-2] == '\n') && (c->req[i-3] == '\r')) {
+            len = i + 1;
+            break;
+        }
+    }
+    if (len == 0) {
+        if (c->req_len == sizeof(c->req)) {
+            /* Headers larger than the buffer */
+            c->req_len = 0;
+            httpd_respond(conn, "431 Request Header Fields Too Large", "text/plain", 0, 0,
+                          httpd_bad_request, sizeof(httpd_bad_request) - 1, 0, 0);
+        }
+        return;
+    }
+    httpd_request(conn, len);
+    /* Keep what follows, the client may have pipelined another request */
+    memmove(c->req, c->req + len, c->req_len - len);
+    c->req_len -= len;
+}
+
+/***************************************************************************//**
+ *  See httpd.h for more information.
+ */
+void httpd_init(const httpd_cgi_t *cgi, unsigned char count)
+{
+    httpd_cgi = cgi;
+    httpd_cgi_count = count;
+}
+
+/***************************************************************************//**
+ *  See httpd.h for more information.
+ */
+unsigned short int httpd_recv(unsigned char conn, const unsigned char *data, unsigned short int len)
+{
+    httpd_conn_t *c = &httpd_conns[conn];
+    uint16_t room = sizeof(c->req) - c->req_len;
+
+    if (len > room) {
+        len = room;
+    }
+    fast_memcpy(c->req + c->req_len, data, len);
+    c->req_len += len;
+    if (!c->busy) {
+        httpd_process(conn);
+    }
+    return len;
+}
+
+/***************************************************************************//**
+ *  See httpd.h for more information.
+ */
+void httpd_sent(unsigned char conn)
+{
+    httpd_conns[conn].busy = 0;
+    httpd_process(conn);
+}
+
+/***************************************************************************//**
+ *  See httpd.h for more information.
+ */
+void httpd_reset(unsigned char conn)
+{
+    httpd_conns[conn].req_len = 0;
+    httpd_conns[conn].busy = 0;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ *  httpd.h: HTTP/1.1 server.
+ *
+ *  Serves GET and HEAD requests on port 80 from the read-only file image of
+ *  fs.h, whose text assets are stored gzipped and sent as they are, and from
+ *  dynamic pages generated by functions the application registers. Connections
+ *  are kept open between requests unless the client asks otherwise, so a
+ *  monitoring page polling the board does not pay for a TCP handshake each
+ *  time. Responses are sent straight from the file image or from a buffer of
+ *  the connection, without copying.
+ *
+ *  The server runs in the network interface task, called by the TCP layer of
+ *  tcpip.c. Dynamic page functions are called from that task too and must not
+ *  block.
+ */
+#ifndef HTTPD_H_
+#define HTTPD_H_
+
+#include <stdint.h>
+#include "net_config.h"
+
+#define HTTPD_PORT      80
+
+/***************************************************************************//**
+ * Output buffer of a dynamic page. Writes past size are dropped.
+ */
+typedef struct httpd_buf {
+    char *data;
+    uint16_t len;
+    uint16_t size;
+} httpd_buf_t;
+
+/***************************************************************************//**
+ * Dynamic page.
+ */
+typedef struct httpd_cgi {
+    const char *path;                   /* e.g. "/status/net" */
+    const char *content_type;
+    void (*fn)(httpd_buf_t *out);       /* writes the page to out */
+} httpd_cgi_t;
+
+/***************************************************************************//**
+ * Registers the dynamic pages. They take precedence over files of the same
+ * name. The table must stay valid. May be called before the scheduler starts.
+ */
+void httpd_init(const httpd_cgi_t *cgi, unsigned char count);
+
+/***************************************************************************//**
+ * Appends a string to a dynamic page.
+ */
+void httpd_puts(httpd_buf_t *out, const char *s);
+
+/***************************************************************************//**
+ * Appends an unsigned number, in decimal, to a dynamic page.
+ */
+void httpd_putu(httpd_buf_t *out, uint32_t v);
+
+/***************************************************************************//**
+ * TCP layer interface, see tcpip.c. httpd_recv() gets the data of connection
+ * conn in order and returns the number of bytes it took, the peer sends the
+ * rest again; it is only called while no response is outstanding.
+ * httpd_sent() reports that the last response was acknowledged, httpd_reset()
+ * that the connection was opened or has gone.
+ */
+unsigned short int httpd_recv(unsigned char conn, const unsigned char *data, unsigned short int len);
+void httpd_sent(unsigned char conn);
+void httpd_reset(unsigned char conn);
+
+#endif /* HTTPD_H_ */
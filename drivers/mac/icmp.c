@@ -0,0 +1,155 @@
+/*******************************************************************************
+ *  icmp.c: ICMP echo replies.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "nettype.h"
+#include "../mss_ethernet_mac/mss_ethernet_mac.h"
+#include "pbuf.h"
+#include "net_timer.h"
+#include "icmp.h"
+#include "tcpip.h"
+#include "../fast_mem/fast_mem.h"
+
+#define OK  0
+#define ERR 1
+
+#define ICMP_TTL            64
+#define ICMP_TOKEN_MS       (1000 / NET_ICMP_ECHO_RATE)
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+extern unsigned char my_mac[ETH_ADDR_LEN];
+extern unsigned int num_pkt_tx;
+
+static icmp_stats_t icmp_stats;
+static uint16_t icmp_tokens = NET_ICMP_ECHO_BURST;
+static uint32_t icmp_refill_ms;     /* time the last token was added */
+
+/***************************************************************************//**
+ * Takes a token from the bucket, refilled with one token every
+ * ICMP_TOKEN_MS.
+ *
+ * @return 1 if a token was available
+ */
+static uint8_t icmp_take_token(void)
+{
+    uint32_t now = net_timer_now_ms();
+    uint32_t elapsed = now - icmp_refill_ms;
+    uint32_t added;
+
+    if (elapsed >= (uint32_t)NET_ICMP_ECHO_BURST * ICMP_TOKEN_MS) {
+        icmp_tokens = NET_ICMP_ECHO_BURST;
+        icmp_refill_ms = now;
+    } else {
+        added = elapsed / ICMP_TOKEN_MS;
+        if (added > 0) {
+            /* The remainder counts towards the next token */
+            icmp_refill_ms += added * ICMP_TOKEN_MS;
+            icmp_tokens += (uint16_t)added;
+            if (icmp_tokens > NET_ICMP_ECHO_BURST) {
+                icmp_tokens = NET_ICMP_ECHO_BURST;
+            }
+        }
+    }
+    if (icmp_tokens == 0) {
+        return 0;
+    }
+    icmp_tokens--;
+    return 1;
+}
+
+/***************************************************************************//**
+ * Updates the checksum at csum for a 16 bit word of the message changed from
+ * old to new, RFC 1624 equation 3.
+ */
+static void icmp_adjust_checksum(unsigned char *csum, uint16_t old, uint16_t new)
+{
+    uint32_t sum;
+
+    sum = (uint16_t)~((csum[0] << 8) | csum[1]);
+    sum += (uint16_t)~old;
+    sum += new;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = ~sum;
+    csum[0] = (unsigned char)(sum >> 8);
+    csum[1] = (unsigned char)sum;
+}
+
+/***************************************************************************//**
+ * Returns the buffer of a reply to its pool once the MAC has sent it.
+ */
+static void icmp_tx_done(void *context)
+{
+    pbuf_free((pbuf_t *)context);
+}
+
+/***************************************************************************//**
+ *  See icmp.h for more information.
+ */
+unsigned char icmp_echo_reply(pbuf_t *p, unsigned char *buf)
+{
+    ether_hdr_t *eth_hdr = (ether_hdr_t *)buf;
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)(buf + sizeof(ether_hdr_t));
+    icmp_hdr_t *icmp_hdr = (icmp_hdr_t *)(buf + sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
+    uint16_t length = (uint16_t)(sizeof(ether_hdr_t) + ((ip_hdr->tlen[0] << 8) | ip_hdr->tlen[1]));
+    mss_mac_tx_segment_t seg;
+    int32_t sent;
+    unsigned char i;
+
+    icmp_stats.echo_requests++;
+    if (!icmp_take_token()) {
+        icmp_stats.rate_limited++;
+        return ERR;
+    }
+
+    /* The reply comes from my_ip even when the request was sent to a group
+       or broadcast address, whose words the IP checksum drops. Swapping the
+       addresses otherwise leaves it as it is, only the TTL and the ICMP type
+       change */
+    fast_memcpy(eth_hdr->da, eth_hdr->sa, ETH_ADDR_LEN);
+    fast_memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
+    for (i = 0; i < IP_ADDR_LEN; i += 2) {
+        icmp_adjust_checksum(ip_hdr->csum, (uint16_t)((ip_hdr->da[i] << 8) | ip_hdr->da[i + 1]),
+                             (uint16_t)((my_ip[i] << 8) | my_ip[i + 1]));
+    }
+    fast_memcpy(ip_hdr->da, ip_hdr->sa, IP_ADDR_LEN);
+    fast_memcpy(ip_hdr->sa, my_ip, IP_ADDR_LEN);
+    icmp_adjust_checksum(ip_hdr->csum, (uint16_t)((ip_hdr->ttl << 8) | ip_hdr->proto),
+                         (uint16_t)((ICMP_TTL << 8) | ip_hdr->proto));
+    ip_hdr->ttl = ICMP_TTL;
+    icmp_adjust_checksum(icmp_hdr->csum, (uint16_t)(ICMP_TYPE_ECHO_REQUEST << 8),
+                         (uint16_t)(ICMP_TYPE_ECHO_REPLY << 8));
+    icmp_hdr->type = ICMP_TYPE_ECHO_REPLY;
+
+    if (p == NULL) {
+        sent = MSS_MAC_tx_packet(buf, length, MSS_MAC_NONBLOCKING);
+    } else {
+        /* Sent from the receive buffer, the reference is dropped when done */
+        seg.data = buf;
+        seg.length = length;
+        pbuf_ref(p);
+        sent = MSS_MAC_tx_packet_sg(&seg, 1, icmp_tx_done, p, MSS_MAC_NONBLOCKING);
+        if (sent == 0) {
+            pbuf_free(p);
+        }
+    }
+    if (sent == 0) {
+        icmp_stats.tx_full++;
+        return ERR;
+    }
+    num_pkt_tx++;
+    icmp_stats.echo_replies++;
+    return OK;
+}
+
+/***************************************************************************//**
+ *  See icmp.h for more information.
+ */
+const icmp_stats_t *icmp_get_stats(void)
+{
+    return &icmp_stats;
+}
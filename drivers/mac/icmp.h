@@ -0,0 +1,50 @@
+/*******************************************************************************
+ *  icmp.h: ICMP echo replies.
+ *
+ *  An echo request is turned into its reply in the buffer it was received
+ *  in: the addresses are swapped and both checksums are updated for the
+ *  fields that change (RFC 1624) instead of being summed over the whole
+ *  message again. A request with a wrong checksum thus gets a reply with a
+ *  wrong checksum, which its sender discards. The reply is handed to the MAC
+ *  without waiting for a free transmit descriptor, it is dropped when the
+ *  ring is full. Replies are limited by a token bucket to NET_ICMP_ECHO_RATE
+ *  per second, so that a ping flood neither takes all the CPU time of the
+ *  network interface task nor fills the transmit ring.
+ *
+ *  Only called from the network interface task.
+ */
+#ifndef ICMP_H_
+#define ICMP_H_
+
+#include <stdint.h>
+#include "pbuf.h"
+
+/***************************************************************************//**
+ * Echo counters.
+ */
+typedef struct icmp_stats {
+    uint32_t echo_requests;     /* requests received */
+    uint32_t echo_replies;      /* replies handed to the MAC */
+    uint32_t rate_limited;      /* requests dropped by the token bucket */
+    uint32_t tx_full;           /* replies dropped, transmit ring full */
+} icmp_stats_t;
+
+/***************************************************************************//**
+ * Answers an echo request.
+ *
+ * @param  p        Packet buffer holding the frame, NULL when the frame is
+ *                  not in a packet buffer (reassembled datagram). The reply
+ *                  is then copied by the MAC, otherwise the buffer is
+ *                  transmitted as is and kept until the MAC is done with it.
+ * @param  buf      Frame, starting with the Ethernet header of a datagram with
+ *                  a 20 byte IP header, at most 1500 bytes long.
+ * @return OK if the reply was sent, ERR otherwise
+ */
+unsigned char icmp_echo_reply(pbuf_t *p, unsigned char *buf);
+
+/***************************************************************************//**
+ * Returns the echo counters.
+ */
+const icmp_stats_t *icmp_get_stats(void);
+
+#endif /* ICMP_H_ */
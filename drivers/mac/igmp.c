@@ -0,0 +1,363 @@
+/*******************************************************************************
+ *  igmp.c: multicast group membership, IGMPv2.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "nettype.h"
+#include "../mss_ethernet_mac/mss_ethernet_mac.h"
+#include "netif.h"
+#include "pbuf.h"
+#include "net_timer.h"
+#include "igmp.h"
+#include "tcpip.h"
+#include "../fast_mem/fast_mem.h"
+
+#define OK  0
+#define ERR 1
+
+#define IGMP_QUERY          0x11
+#define IGMP_V1_REPORT      0x12
+#define IGMP_V2_REPORT      0x16
+#define IGMP_LEAVE          0x17
+
+#define IGMP_TICK_MS        100     /* unit of the report delays */
+#define IGMP_MSG_LEN        8
+#define IGMP_RA_LEN         4       /* router alert option, RFC 2113 */
+#define IGMP_IP_HDR_LEN     (sizeof(ip_hdr_t) + IGMP_RA_LEN)
+#define IGMP_FRAME_LEN      (sizeof(ether_hdr_t) + IGMP_IP_HDR_LEN + IGMP_MSG_LEN)
+
+/* A free entry has no reference and no leave message to send */
+typedef struct igmp_group {
+    unsigned char ip[IP_ADDR_LEN];
+    unsigned char refs;
+    unsigned char leave;            /* leave message to send */
+    unsigned char reports;          /* unsolicited reports still to send */
+    uint16_t delay;                 /* ticks until the next report, 0 for none */
+} igmp_group_t;
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+extern unsigned char my_mac[ETH_ADDR_LEN];
+extern unsigned short int ip_id;
+
+static const unsigned char igmp_all_hosts[IP_ADDR_LEN] = { 224, 0, 0, 1 };
+static const unsigned char igmp_all_routers[IP_ADDR_LEN] = { 224, 0, 0, 2 };
+
+static igmp_group_t igmp_groups[NET_IGMP_GROUPS];
+static net_timer_t igmp_timer;
+static uint32_t igmp_seed;
+
+static void igmp_tick(void *arg);
+
+/***************************************************************************//**
+ * Pseudo random numbers for the report delays.
+ */
+static uint32_t igmp_random(void)
+{
+    igmp_seed = igmp_seed * 1103515245UL + 12345UL;
+    return igmp_seed ^ (igmp_seed >> 16);
+}
+
+/***************************************************************************//**
+ * Ethernet address of a multicast group, RFC 1112 section 6.4.
+ */
+static void igmp_mac(const unsigned char *ip, unsigned char *mac)
+{
+    mac[0] = 0x01;
+    mac[1] = 0x00;
+    mac[2] = 0x5E;
+    mac[3] = ip[1] & 0x7F;
+    mac[4] = ip[2];
+    mac[5] = ip[3];
+}
+
+/***************************************************************************//**
+ * Gives the MAC the addresses to receive besides its own: broadcast,
+ * all-hosts and the joined groups. Groups sharing an Ethernet address take a
+ * single entry.
+ */
+static void igmp_update_filters(void)
+{
+    unsigned char filters[(NET_IGMP_GROUPS + 2) * ETH_ADDR_LEN];
+    unsigned char mac[ETH_ADDR_LEN];
+    uint16_t count = 2;
+    uint16_t i;
+    uint16_t j;
+
+    fast_memset(filters, 0xFF, ETH_ADDR_LEN);
+    igmp_mac(igmp_all_hosts, filters + ETH_ADDR_LEN);
+    portENTER_CRITICAL();
+    for (i = 0; i < NET_IGMP_GROUPS; i++) {
+        if (igmp_groups[i].refs == 0) {
+            continue;
+        }
+        igmp_mac(igmp_groups[i].ip, mac);
+        for (j = 1; (j < count) && memcmp(filters + j * ETH_ADDR_LEN, mac, ETH_ADDR_LEN); j++) {
+        }
+        if (j == count) {
+            fast_memcpy(filters + count * ETH_ADDR_LEN, mac, ETH_ADDR_LEN);
+            count++;
+        }
+    }
+    portEXIT_CRITICAL();
+    netif_set_mac_filters(filters, count);
+}
+
+/***************************************************************************//**
+ * Sends a report or leave message about group to dst. The IP header carries
+ * the router alert option and a TTL of 1, RFC 2236 section 2.
+ */
+static void igmp_send(unsigned char type, const unsigned char *group, const unsigned char *dst)
+{
+    pbuf_t *p = pbuf_alloc(0, IGMP_FRAME_LEN);
+    eth_hdr_xp eth_hdr;
+    ip_hdr_xp ip_hdr;
+    unsigned char *msg;
+
+    if (p == NULL) {
+        return;
+    }
+    eth_hdr = (eth_hdr_xp ) p->payload;
+    ip_hdr = (ip_hdr_xp ) (p->payload + sizeof(ether_hdr_t));
+    msg = p->payload + sizeof(ether_hdr_t) + IGMP_IP_HDR_LEN;
+
+    igmp_mac(dst, eth_hdr->da);
+    fast_memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
+    eth_hdr->type_code[0] = ETH_TYPE_0;
+    eth_hdr->type_code[1] = ETH_TYPE_IP_1;
+
+    fast_memset(ip_hdr, 0, IGMP_IP_HDR_LEN);
+    ip_hdr->ver_hlen = 0x40 | (IGMP_IP_HDR_LEN / 4);
+    ip_hdr->tlen[1] = IGMP_IP_HDR_LEN + IGMP_MSG_LEN;
+    portENTER_CRITICAL();
+    ip_hdr->id[0] = ip_id >> 8;
+    ip_hdr->id[1] = (unsigned char) ip_id;
+    ip_id++;
+    portEXIT_CRITICAL();
+    ip_hdr->ttl = 1;
+    ip_hdr->proto = IGMP_PROTO;
+    fast_memcpy(ip_hdr->sa, my_ip, IP_ADDR_LEN);
+    fast_memcpy(ip_hdr->da, dst, IP_ADDR_LEN);
+    ((unsigned char *)ip_hdr)[sizeof(ip_hdr_t)] = 0x94;
+    ((unsigned char *)ip_hdr)[sizeof(ip_hdr_t) + 1] = IGMP_RA_LEN;
+    fix_checksum((unsigned char *)ip_hdr, IGMP_IP_HDR_LEN, 10);
+
+    msg[0] = type;
+    msg[1] = 0;
+    fast_memcpy(msg + 4, group, IP_ADDR_LEN);
+    fix_checksum(msg, IGMP_MSG_LEN, 2);
+    netif_output_pbuf(p, 0);
+}
+
+/***************************************************************************//**
+ *  See igmp.h for more information.
+ */
+void igmp_init(void)
+{
+    igmp_seed = ((uint32_t)my_mac[2] << 24) ^ ((uint32_t)my_mac[3] << 16) ^
+                ((uint32_t)my_mac[4] << 8) ^ my_mac[5] ^ net_timer_now_ms();
+    igmp_update_filters();
+    net_timer_start(&igmp_timer, IGMP_TICK_MS, igmp_tick, NULL);
+}
+
+/***************************************************************************//**
+ *  See igmp.h for more information.
+ */
+unsigned char igmp_join(const unsigned char *group)
+{
+    igmp_group_t *g = NULL;
+    unsigned char announce = 0;
+    unsigned char i;
+
+    if (!IP_IS_MULTICAST(group)) {
+        return ERR;
+    }
+    if (!memcmp(group, igmp_all_hosts, IP_ADDR_LEN)) {
+        return OK;
+    }
+    portENTER_CRITICAL();
+    for (i = 0; i < NET_IGMP_GROUPS; i++) {
+        if ((igmp_groups[i].refs || igmp_groups[i].leave) &&
+            !memcmp(igmp_groups[i].ip, group, IP_ADDR_LEN)) {
+            g = &igmp_groups[i];
+            break;
+        }
+        if ((g == NULL) && !igmp_groups[i].refs && !igmp_groups[i].leave) {
+            g = &igmp_groups[i];
+        }
+    }
+    if (g != NULL) {
+        if (g->refs == 0) {
+            /* New member, or back before the leave message went out */
+            fast_memcpy(g->ip, group, IP_ADDR_LEN);
+            g->leave = 0;
+            g->reports = NET_IGMP_ROBUSTNESS;
+            g->delay = 1;
+            announce = 1;
+        }
+        g->refs++;
+    }
+    portEXIT_CRITICAL();
+    if (g == NULL) {
+        return ERR;
+    }
+    if (announce) {
+        igmp_update_filters();
+    }
+    return OK;
+}
+
+/***************************************************************************//**
+ *  See igmp.h for more information.
+ */
+unsigned char igmp_leave(const unsigned char *group)
+{
+    igmp_group_t *g = NULL;
+    unsigned char last = 0;
+    unsigned char i;
+
+    portENTER_CRITICAL();
+    for (i = 0; i < NET_IGMP_GROUPS; i++) {
+        if (igmp_groups[i].refs && !memcmp(igmp_groups[i].ip, group, IP_ADDR_LEN)) {
+            g = &igmp_groups[i];
+            if (--g->refs == 0) {
+                g->leave = 1;
+                g->reports = 0;
+                g->delay = 0;
+                last = 1;
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL();
+    if (g == NULL) {
+        return ERR;
+    }
+    if (last) {
+        igmp_update_filters();
+    }
+    return OK;
+}
+
+/***************************************************************************//**
+ *  See igmp.h for more information.
+ */
+unsigned char igmp_is_member(const unsigned char *ip)
+{
+    unsigned char member = 0;
+    unsigned char i;
+
+    if (!memcmp(ip, igmp_all_hosts, IP_ADDR_LEN)) {
+        return 1;
+    }
+    portENTER_CRITICAL();
+    for (i = 0; (i < NET_IGMP_GROUPS) && !member; i++) {
+        member = igmp_groups[i].refs && !memcmp(igmp_groups[i].ip, ip, IP_ADDR_LEN);
+    }
+    portEXIT_CRITICAL();
+    return member;
+}
+
+/***************************************************************************//**
+ *  See igmp.h for more information.
+ */
+unsigned char igmp_input(unsigned char *buf)
+{
+    ip_hdr_xp ip_hdr = (ip_hdr_xp ) (buf + sizeof(ether_hdr_t));
+    unsigned char *msg = buf + sizeof(ether_hdr_t) + sizeof(ip_hdr_t);
+    unsigned short int len = (unsigned short int)(((ip_hdr->tlen[0] << 8) | ip_hdr->tlen[1]) -
+                                                  sizeof(ip_hdr_t));
+    const unsigned char *group = msg + 4;
+    unsigned char general;
+    uint32_t ticks;
+    uint16_t delay;
+    unsigned char i;
+
+    if ((len < IGMP_MSG_LEN) || (check_checksum(msg, len, 2, 'G') != OK)) {
+        return ERR;
+    }
+    general = !(group[0] | group[1] | group[2] | group[3]);
+
+    switch (msg[0]) {
+    case IGMP_QUERY:
+        /* Maximum response time in tenths of seconds. IGMPv1 queries have
+           none and mean 10 s, IGMPv3 ones code large values as floats */
+        ticks = msg[1];
+        if (ticks == 0) {
+            ticks = 100;
+        }
+        else if ((len > IGMP_MSG_LEN) && (ticks >= 128)) {
+            ticks = (uint32_t)((ticks & 0x0F) | 0x10) << (((ticks >> 4) & 0x07) + 3);
+        }
+        ticks = ticks * 100 / IGMP_TICK_MS;
+        if (ticks > 0xFFFF) {
+            ticks = 0xFFFF;
+        }
+        for (i = 0; i < NET_IGMP_GROUPS; i++) {
+            delay = (uint16_t)(1 + igmp_random() % ticks);
+            portENTER_CRITICAL();
+            if (igmp_groups[i].refs &&
+                (general || !memcmp(igmp_groups[i].ip, group, IP_ADDR_LEN)) &&
+                ((igmp_groups[i].delay == 0) || (igmp_groups[i].delay > delay))) {
+                igmp_groups[i].delay = delay;
+            }
+            portEXIT_CRITICAL();
+        }
+        return OK;
+
+    case IGMP_V1_REPORT:
+    case IGMP_V2_REPORT:
+        /* Another member answered, the router only needs one report */
+        for (i = 0; i < NET_IGMP_GROUPS; i++) {
+            portENTER_CRITICAL();
+            if (igmp_groups[i].refs && !memcmp(igmp_groups[i].ip, group, IP_ADDR_LEN)) {
+                igmp_groups[i].delay = 0;
+                igmp_groups[i].reports = 0;
+            }
+            portEXIT_CRITICAL();
+        }
+        return OK;
+
+    default:
+        return ERR;
+    }
+}
+
+/***************************************************************************//**
+ * Sends the reports that are due and the pending leave messages.
+ */
+static void igmp_tick(void *arg)
+{
+    igmp_group_t *g;
+    unsigned char group[IP_ADDR_LEN];
+    unsigned char type;
+    unsigned char i;
+
+    (void)arg;
+    for (i = 0; i < NET_IGMP_GROUPS; i++) {
+        g = &igmp_groups[i];
+        type = 0;
+        portENTER_CRITICAL();
+        if (g->leave) {
+            g->leave = 0;
+            type = IGMP_LEAVE;
+        }
+        else if (g->refs && g->delay && (--g->delay == 0)) {
+            type = IGMP_V2_REPORT;
+            if ((g->reports > 0) && (--g->reports > 0)) {
+                g->delay = (uint16_t)(1 + igmp_random() % (NET_IGMP_UNSOLICITED_MS / IGMP_TICK_MS));
+            }
+        }
+        fast_memcpy(group, g->ip, IP_ADDR_LEN);
+        portEXIT_CRITICAL();
+        if (type == IGMP_LEAVE) {
+            igmp_send(type, group, igmp_all_routers);
+        }
+        else if (type != 0) {
+            igmp_send(type, group, group);
+        }
+    }
+    net_timer_start(&igmp_timer, IGMP_TICK_MS, igmp_tick, NULL);
+}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ *  igmp.h: multicast group membership, IGMPv2 (RFC 2236).
+ *
+ *  Keeps the groups the application joined and gives their Ethernet
+ *  addresses, together with the broadcast and all-hosts addresses, to the
+ *  MAC filter through netif_set_mac_filters(). Multicast frames of other
+ *  groups are then dropped by the MAC instead of reaching process_packet().
+ *  Joins are announced with unsolicited reports, queries from routers are
+ *  answered after a random delay unless another member answers first, and
+ *  leaving the last reference of a group sends a leave message.
+ *
+ *  igmp_join(), igmp_leave() and igmp_is_member() may be called from any
+ *  task; the other functions only from the network interface task.
+ */
+#ifndef IGMP_H_
+#define IGMP_H_
+
+#include "nettype.h"
+
+#define IGMP_PROTO          0x02
+
+#define IP_IS_MULTICAST(ip) (((ip)[0] & 0xF0) == 0xE0)
+
+/***************************************************************************//**
+ * Joins the all-hosts group and starts the report timer. Called by the
+ * network interface task once the MAC is set up.
+ */
+void igmp_init(void);
+
+/***************************************************************************//**
+ * Joins a group. Groups are reference counted, each join must be matched by
+ * a leave.
+ *
+ * @param  group    Multicast IP address.
+ * @return OK, ERR if the address is not multicast or NET_IGMP_GROUPS groups
+ *         are already joined
+ */
+unsigned char igmp_join(const unsigned char *group);
+
+/***************************************************************************//**
+ * Drops a reference to a group, the group is left with the last one.
+ *
+ * @return OK, ERR if the group was not joined
+ */
+unsigned char igmp_leave(const unsigned char *group);
+
+/***************************************************************************//**
+ * Returns 1 if datagrams sent to the multicast address ip are to be
+ * received.
+ */
+unsigned char igmp_is_member(const unsigned char *ip);
+
+/***************************************************************************//**
+ * Handles an IGMP message.
+ *
+ * @param  buf      Frame, starting with the Ethernet header of a datagram with
+ *                  a 20 byte IP header.
+ */
+unsigned char igmp_input(unsigned char *buf);
+
+#endif /* IGMP_H_ */
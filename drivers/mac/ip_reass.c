@@ -0,0 +1,163 @@
+/*******************************************************************************
+ *  ip_reass.c: IPv4 fragment reassembly.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "nettype.h"
+#include "../mss_ethernet_mac/mss_ethernet_mac.h"
+#include "pbuf.h"
+#include "net_timer.h"
+#include "ip_reass.h"
+#include "tcpip.h"
+#include "../fast_mem/fast_mem.h"
+
+#define IP_REASS_HDR_LEN    (sizeof(ether_hdr_t) + sizeof(ip_hdr_t))
+#define IP_REASS_BLOCKS     (NET_IP_REASS_SIZE / 8)
+
+/* Datagram being put together. Its payload is tracked in blocks of 8 bytes,
+   the unit of the fragment offset. */
+typedef struct ip_reass_slot {
+    unsigned char used;
+    unsigned char proto;
+    unsigned char sa[IP_ADDR_LEN];
+    unsigned char id[IP_ID_LEN];
+    unsigned short int size;        /* payload length, 0 until the last fragment is in */
+    uint32_t started;               /* net_timer_now_ms() at the first fragment */
+    net_timer_t timer;
+    uint8_t map[(IP_REASS_BLOCKS + 7) / 8];
+    unsigned char frame[IP_REASS_HDR_LEN + NET_IP_REASS_SIZE];
+} ip_reass_slot_t;
+
+static ip_reass_slot_t ip_reass_slot[NET_IP_REASS_SLOTS];
+static ip_reass_stats_t ip_reass_stats;
+
+/***************************************************************************//**
+ * Drops a datagram whose fragments did not all arrive in time.
+ */
+static void ip_reass_timeout(void *arg)
+{
+    ((ip_reass_slot_t *)arg)->used = 0;
+    ip_reass_stats.timeouts++;
+}
+
+/***************************************************************************//**
+ * Frees a slot.
+ */
+static void ip_reass_free(ip_reass_slot_t *s)
+{
+    net_timer_stop(&s->timer);
+    s->used = 0;
+}
+
+/***************************************************************************//**
+ * Returns 1 if the last fragment and every block before it arrived.
+ */
+static unsigned char ip_reass_complete(const ip_reass_slot_t *s)
+{
+    unsigned short int blocks = (unsigned short int)((s->size + 7) / 8);
+    unsigned short int i;
+
+    if (s->size == 0) {
+        return 0;
+    }
+    for (i = 0; i < blocks; i++) {
+        if (!(s->map[i >> 3] & (1 << (i & 7)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/***************************************************************************//**
+ *  See ip_reass.h for more information.
+ */
+unsigned char *ip_reass_input(unsigned char *buf)
+{
+    ip_hdr_xp ip_hdr = (ip_hdr_xp ) (buf + sizeof(ether_hdr_t));
+    unsigned short int frag = (unsigned short int)((ip_hdr->frag_off[0] << 8) | ip_hdr->frag_off[1]);
+    unsigned short int len = (unsigned short int)(((ip_hdr->tlen[0] << 8) | ip_hdr->tlen[1]) -
+                                                  sizeof(ip_hdr_t));
+    unsigned int off = (unsigned int)(frag & IP_FRAG_OFFSET) * 8;
+    ip_reass_slot_t *s = 0;
+    unsigned int i;
+
+    ip_reass_stats.fragments++;
+    /* Only the last fragment may end off a block boundary */
+    if ((len == 0) || ((frag & IP_FRAG_MF) && (len & 7))) {
+        return 0;
+    }
+
+    for (i = 0; i < NET_IP_REASS_SLOTS; i++) {
+        if (ip_reass_slot[i].used && (ip_reass_slot[i].proto == ip_hdr->proto) &&
+            !memcmp(ip_reass_slot[i].id, ip_hdr->id, IP_ID_LEN) &&
+            !memcmp(ip_reass_slot[i].sa, ip_hdr->sa, IP_ADDR_LEN)) {
+            s = &ip_reass_slot[i];
+            break;
+        }
+    }
+    if (s == 0) {
+        /* A free slot, or the one of the oldest datagram */
+        for (i = 0; i < NET_IP_REASS_SLOTS; i++) {
+            if (!ip_reass_slot[i].used) {
+                s = &ip_reass_slot[i];
+                break;
+            }
+            if ((s == 0) || ((int32_t)(ip_reass_slot[i].started - s->started) < 0)) {
+                s = &ip_reass_slot[i];
+            }
+        }
+        if (s->used) {
+            ip_reass_free(s);
+            ip_reass_stats.evicted++;
+        }
+        s->used = 1;
+        s->proto = ip_hdr->proto;
+        fast_memcpy(s->id, ip_hdr->id, IP_ID_LEN);
+        fast_memcpy(s->sa, ip_hdr->sa, IP_ADDR_LEN);
+        s->size = 0;
+        s->started = net_timer_now_ms();
+        fast_memset(s->map, 0, sizeof(s->map));
+        net_timer_start(&s->timer, NET_IP_REASS_TIMEOUT_MS, ip_reass_timeout, s);
+    }
+
+    if ((off + len > NET_IP_REASS_SIZE) ||
+        (!(frag & IP_FRAG_MF) && (s->size != 0) && (s->size != off + len))) {
+        ip_reass_free(s);
+        ip_reass_stats.too_big++;
+        return 0;
+    }
+    if (!(frag & IP_FRAG_MF)) {
+        s->size = (unsigned short int)(off + len);
+    }
+    if (off == 0) {
+        fast_memcpy(s->frame, buf, IP_REASS_HDR_LEN);
+    }
+    fast_memcpy(s->frame + IP_REASS_HDR_LEN + off, buf + IP_REASS_HDR_LEN, len);
+    for (i = off / 8; i < (off + len + 7) / 8; i++) {
+        s->map[i >> 3] |= (uint8_t)(1 << (i & 7));
+    }
+    if (!ip_reass_complete(s)) {
+        return 0;
+    }
+
+    /* Turn the header of the first fragment into that of the datagram */
+    ip_hdr = (ip_hdr_xp ) (s->frame + sizeof(ether_hdr_t));
+    len = (unsigned short int)(s->size + sizeof(ip_hdr_t));
+    ip_hdr->tlen[0] = (unsigned char)(len >> 8);
+    ip_hdr->tlen[1] = (unsigned char)len;
+    ip_hdr->frag_off[0] = 0;
+    ip_hdr->frag_off[1] = 0;
+    fix_checksum((unsigned char *)ip_hdr, sizeof(ip_hdr_t), 10);
+    ip_reass_free(s);
+    ip_reass_stats.datagrams++;
+    return s->frame;
+}
+
+/***************************************************************************//**
+ *  See ip_reass.h for more information.
+ */
+const ip_reass_stats_t *ip_reass_get_stats(void)
+{
+    return &ip_reass_stats;
+}
@@ -0,0 +1,50 @@
+/*******************************************************************************
+ *  ip_reass.h: IPv4 fragment reassembly.
+ *
+ *  Fragments are put together in NET_IP_REASS_SLOTS static buffers of
+ *  NET_IP_REASS_SIZE bytes of payload, so the memory used does not depend on
+ *  what the network sends. A datagram that does not fit, or whose fragments
+ *  do not all arrive within NET_IP_REASS_TIMEOUT_MS, is dropped. When a
+ *  fragment of a new datagram finds every buffer taken, the oldest datagram
+ *  is dropped to make room. Must be called from the network interface task.
+ */
+#ifndef IP_REASS_H_
+#define IP_REASS_H_
+
+#include <stdint.h>
+#include "nettype.h"
+#include "net_config.h"
+
+/* Flags and offset field of the IP header */
+#define IP_FRAG_DF          0x4000
+#define IP_FRAG_MF          0x2000
+#define IP_FRAG_OFFSET      0x1FFF
+
+/***************************************************************************//**
+ * Reassembly counters.
+ */
+typedef struct ip_reass_stats {
+    uint32_t fragments;             /* fragments received */
+    uint32_t datagrams;             /* datagrams put together */
+    uint32_t timeouts;              /* datagrams dropped incomplete */
+    uint32_t too_big;               /* datagrams larger than NET_IP_REASS_SIZE */
+    uint32_t evicted;               /* datagrams dropped for lack of buffer */
+} ip_reass_stats_t;
+
+/***************************************************************************//**
+ * Takes a fragment. The IP header checksum must have been checked.
+ *
+ * @param  buf      Frame holding the fragment, starting with the Ethernet
+ *                  header.
+ * @return The complete datagram, in the same layout as a received frame with
+ *         a 20 byte IP header, once the last missing fragment arrives, 0
+ *         otherwise. It stays valid until the next call.
+ */
+unsigned char *ip_reass_input(unsigned char *buf);
+
+/***************************************************************************//**
+ * Returns the reassembly counters.
+ */
+const ip_reass_stats_t *ip_reass_get_stats(void);
+
+#endif /* IP_REASS_H_ */
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ *  net_capture.c: Ethernet frame capture for offline analysis.
+ *
+ *  The hook is called from the transmit and receive functions of the MAC
+ *  driver, that is from the network interface task, so filling a record needs
+ *  no locking. It only copies at most NET_CAPTURE_SNAPLEN bytes per frame to
+ *  keep the cost on the data path low.
+ */
+#include "FreeRTOS.h"
+
+#include "../fast_mem/fast_mem.h"
+#include "../cycle_counter/cycle_counter.h"
+#include "../../BSP/spi_flash_driver/spi_flash.h"
+#include "net_capture.h"
+
+#if NET_CAPTURE
+
+#define FLASH_BLOCK_SIZE        4096UL
+
+/* The image exactly as it is saved, header first */
+static struct {
+    net_capture_hdr_t hdr;
+    net_capture_rec_t rec[NET_CAPTURE_SLOTS];
+} net_capture_image;
+
+static volatile uint8_t net_capture_enabled;
+
+/***************************************************************************//**
+ *  See net_capture.h for more information.
+ */
+void net_capture_init(void)
+{
+    net_capture_enabled = 0;
+    fast_memset(&net_capture_image, 0, sizeof(net_capture_image));
+    net_capture_image.hdr.magic = NET_CAPTURE_MAGIC;
+    net_capture_image.hdr.version = NET_CAPTURE_VERSION;
+    net_capture_image.hdr.snaplen = NET_CAPTURE_SNAPLEN;
+    net_capture_image.hdr.clock_hz = configCPU_CLOCK_HZ;
+    net_capture_image.hdr.slot_count = NET_CAPTURE_SLOTS;
+
+    cycle_counter_enable();
+    net_capture_enabled = 1;
+}
+
+/***************************************************************************//**
+ *  See net_capture.h for more information.
+ */
+void net_capture_frame(uint32_t direction, const mss_mac_tx_segment_t *segments,
+                       uint8_t segment_count)
+{
+    net_capture_rec_t *rec;
+    uint32_t timestamp = cycle_counter_read();
+    uint32_t room = NET_CAPTURE_SNAPLEN;
+    uint32_t orig_len = 0;
+    uint32_t n;
+    uint8_t i;
+
+    if (!net_capture_enabled) {
+        return;
+    }
+    rec = &net_capture_image.rec[net_capture_image.hdr.next];
+    rec->timestamp = timestamp;
+    rec->direction = (uint8_t)direction;
+    for (i = 0; i < segment_count; i++) {
+        n = segments[i].length;
+        if (n > room) {
+            n = room;
+        }
+        fast_memcpy(&rec->data[NET_CAPTURE_SNAPLEN - room], segments[i].data, n);
+        room -= n;
+        orig_len += segments[i].length;
+    }
+    rec->orig_len = (uint16_t)orig_len;
+    rec->cap_len = (uint16_t)(NET_CAPTURE_SNAPLEN - room);
+
+    if (++net_capture_image.hdr.next == NET_CAPTURE_SLOTS) {
+        net_capture_image.hdr.next = 0;
+    }
+    net_capture_image.hdr.captured++;
+}
+
+/***************************************************************************//**
+ *  See net_capture.h for more information.
+ */
+void net_capture_enable(uint8_t enable)
+{
+    net_capture_enabled = enable;
+}
+
+/***************************************************************************//**
+ *  See net_capture.h for more information.
+ */
+uint32_t net_capture_image_size(void)
+{
+    return sizeof(net_capture_image);
+}
+
+/***************************************************************************//**
+ *  See net_capture.h for more information.
+ */
+int32_t net_capture_save(uint32_t address)
+{
+    spi_flash_status_t status;
+    uint32_t block;
+    uint8_t was_enabled = net_capture_enabled;
+
+    net_capture_enabled = 0;
+
+    status = spi_flash_control_hw(SPI_FLASH_GLOBAL_UNPROTECT, 0, NULL);
+    for (block = address & ~(FLASH_BLOCK_SIZE - 1);
+         (status == SPI_FLASH_SUCCESS) && (block < address + sizeof(net_capture_image));
+         block += FLASH_BLOCK_SIZE) {
+        status = spi_flash_control_hw(SPI_FLASH_4KBLOCK_ERASE, block, NULL);
+    }
+    if (status == SPI_FLASH_SUCCESS) {
+        status = spi_flash_write(address, (uint8_t *)&net_capture_image,
+                                 sizeof(net_capture_image));
+    }
+
+    net_capture_enabled = was_enabled;
+    return (int32_t)status;
+}
+
+#endif /* NET_CAPTURE */
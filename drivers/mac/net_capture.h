@@ -0,0 +1,85 @@
+/*******************************************************************************
+ *  net_capture.h: Ethernet frame capture for offline analysis.
+ *
+ *  When NET_CAPTURE is set the network interface installs net_capture_frame()
+ *  as the MAC capture hook. Every frame sent or received is then copied, up to
+ *  NET_CAPTURE_SNAPLEN bytes, into a ring of NET_CAPTURE_SLOTS records together
+ *  with its direction and a timestamp read from the Cortex-M3 DWT cycle
+ *  counter; the oldest record is overwritten when the ring is full.
+ *
+ *  The capture image, header followed by the ring, can be read from RAM with
+ *  the debugger or saved to the SPI flash with net_capture_save(), then
+ *  converted to pcapng on the host with tools/capture2pcapng.py.
+ */
+#ifndef NET_CAPTURE_H_
+#define NET_CAPTURE_H_
+
+#include <stdint.h>
+#include "../mss_ethernet_mac/mss_ethernet_mac.h"
+#include "net_config.h"
+
+#define NET_CAPTURE_MAGIC       0x5041434EUL    /* "NCAP" */
+#define NET_CAPTURE_VERSION     1u
+
+/***************************************************************************//**
+ * Capture image header. All fields are little endian. Records are stored in
+ * slot order; once more than slot_count frames have been captured the oldest
+ * record is the one at index next.
+ */
+typedef struct net_capture_hdr {
+    uint32_t magic;             /* NET_CAPTURE_MAGIC */
+    uint16_t version;           /* NET_CAPTURE_VERSION */
+    uint16_t snaplen;           /* data bytes per record */
+    uint32_t clock_hz;          /* timestamp counter frequency */
+    uint32_t slot_count;        /* records in the image */
+    uint32_t next;              /* slot the next frame goes to */
+    uint32_t captured;          /* frames captured since net_capture_init() */
+} net_capture_hdr_t;
+
+/***************************************************************************//**
+ * One captured frame.
+ */
+typedef struct net_capture_rec {
+    uint32_t timestamp;         /* cycle counter when the frame was captured */
+    uint16_t orig_len;          /* length of the frame on the wire */
+    uint16_t cap_len;           /* bytes held in data */
+    uint8_t direction;          /* MSS_MAC_CAPTURE_RX or MSS_MAC_CAPTURE_TX */
+    uint8_t reserved[3];
+    uint8_t data[NET_CAPTURE_SNAPLEN];
+} net_capture_rec_t;
+
+/***************************************************************************//**
+ * Clears the ring and starts the cycle counter used for the timestamps.
+ */
+void net_capture_init(void);
+
+/***************************************************************************//**
+ * MAC capture hook, see MSS_MAC_capture_t.
+ */
+void net_capture_frame(uint32_t direction, const mss_mac_tx_segment_t *segments,
+                       uint8_t segment_count);
+
+/***************************************************************************//**
+ * Stops or resumes capturing. The ring is left untouched.
+ */
+void net_capture_enable(uint8_t enable);
+
+/***************************************************************************//**
+ * Saves the capture image to the SPI flash. The 4 KB blocks covering the image
+ * are erased first, so address should be on a 4 KB boundary. Capturing is
+ * stopped while the image is written and resumed afterwards.
+ *
+ * The caller must run at a lower priority than the network interface task so
+ * that it cannot preempt the task in the middle of a record.
+ *
+ * @param address       flash address of the image
+ * @return              SPI_FLASH_SUCCESS (0) or the spi_flash_status_t error
+ */
+int32_t net_capture_save(uint32_t address);
+
+/***************************************************************************//**
+ * Returns the size in bytes of the capture image.
+ */
+uint32_t net_capture_image_size(void);
+
+#endif /* NET_CAPTURE_H_ */
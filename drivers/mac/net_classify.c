@@ -0,0 +1,120 @@
+/*******************************************************************************
+ *  net_classify.c: early classification of received frames.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "nettype.h"
+#include "net_config.h"
+#include "igmp.h"
+#include "net_classify.h"
+
+#define ETHERTYPE_IP        0x0800
+#define ETHERTYPE_ARP       0x0806
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+extern unsigned char ip_known;
+
+/* Rules, first match wins. Everything the stack handles is accepted, the
+   protocol handlers still check what they are given. */
+static const net_rx_rule_t net_rx_rules[] = {
+    { "rx_arp",         ETHERTYPE_ARP, NET_RX_DST_ANY,       0,         0,                 NET_RX_ACCEPT },
+    { "rx_ip_host",     ETHERTYPE_IP,  NET_RX_DST_HOST,      0,         0,                 NET_RX_ACCEPT },
+    { "rx_ip_group",    ETHERTYPE_IP,  NET_RX_DST_GROUP,     0,         0,                 NET_RX_ACCEPT },
+#if NET_DHCP_SERVER
+    { "rx_dhcp_server", ETHERTYPE_IP,  NET_RX_DST_ANY,       UDP_PROTO, BOOTP_SERVER_PORT, NET_RX_ACCEPT },
+#endif
+    { "rx_ip_bcast",    ETHERTYPE_IP,  NET_RX_DST_BROADCAST, 0,         0,                 NET_RX_ACCEPT },
+    { "rx_ip_other",    ETHERTYPE_IP,  NET_RX_DST_ANY,       0,         0,                 NET_RX_DROP },
+};
+
+#define NET_RX_RULES    (sizeof(net_rx_rules) / sizeof(net_rx_rules[0]))
+
+static uint32_t net_rx_hits[NET_RX_RULES + 1];
+
+/***************************************************************************//**
+ * Returns 1 if the destination address of an IP header is in class dst.
+ */
+static uint8_t net_classify_dst(const ip_hdr_t *ip, uint8_t dst)
+{
+    switch (dst) {
+    case NET_RX_DST_HOST:
+        return !memcmp(ip->da, my_ip, IP_ADDR_LEN);
+    case NET_RX_DST_GROUP:
+        return IP_IS_MULTICAST(ip->da) && igmp_is_member(ip->da);
+    case NET_RX_DST_BROADCAST:
+        return !ip_known && ((ip->da[0] & ip->da[1] & ip->da[2] & ip->da[3]) == 0xFF);
+    default:
+        return 1;
+    }
+}
+
+/***************************************************************************//**
+ *  See net_classify.h for more information.
+ */
+uint8_t net_classify(const uint8_t *frame, uint32_t length)
+{
+    const ip_hdr_t *ip = (const ip_hdr_t *)(frame + sizeof(ether_hdr_t));
+    const net_rx_rule_t *r;
+    uint16_t ethertype;
+    uint16_t port = 0;
+    uint32_t hlen;
+    uint8_t i;
+
+    if (length < sizeof(ether_hdr_t)) {
+        net_rx_hits[NET_RX_RULES]++;
+        return NET_RX_DROP;
+    }
+    ethertype = (uint16_t)((frame[12] << 8) | frame[13]);
+    if (ethertype == ETHERTYPE_IP) {
+        if (length < sizeof(ether_hdr_t) + sizeof(ip_hdr_t)) {
+            net_rx_hits[NET_RX_RULES]++;
+            return NET_RX_DROP;
+        }
+        /* Ports are where the first fragment has them */
+        hlen = (uint32_t)(ip->ver_hlen & 0x0f) * 4;
+        if (((ip->proto == TCP_PROTO) || (ip->proto == UDP_PROTO)) &&
+            !(((ip->frag_off[0] & 0x1f) | ip->frag_off[1])) &&
+            (length >= sizeof(ether_hdr_t) + hlen + 4)) {
+            port = (uint16_t)((frame[sizeof(ether_hdr_t) + hlen + 2] << 8) |
+                              frame[sizeof(ether_hdr_t) + hlen + 3]);
+        }
+    }
+
+    for (i = 0; i < NET_RX_RULES; i++) {
+        r = &net_rx_rules[i];
+        if (r->ethertype && (r->ethertype != ethertype)) {
+            continue;
+        }
+        if (ethertype == ETHERTYPE_IP) {
+            if ((r->proto && (r->proto != ip->proto)) || (r->port && (r->port != port)) ||
+                !net_classify_dst(ip, r->dst)) {
+                continue;
+            }
+        }
+        else if (r->dst || r->proto || r->port) {
+            continue;
+        }
+        net_rx_hits[i]++;
+        return r->action;
+    }
+    net_rx_hits[NET_RX_RULES]++;
+    return NET_RX_DROP;
+}
+
+/***************************************************************************//**
+ *  See net_classify.h for more information.
+ */
+const net_rx_rule_t *net_classify_rules(uint8_t *count)
+{
+    *count = (uint8_t)NET_RX_RULES;
+    return net_rx_rules;
+}
+
+/***************************************************************************//**
+ *  See net_classify.h for more information.
+ */
+const uint32_t *net_classify_hits(void)
+{
+    return net_rx_hits;
+}
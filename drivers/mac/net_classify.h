@@ -0,0 +1,61 @@
+/*******************************************************************************
+ *  net_classify.h: early classification of received frames.
+ *
+ *  The network interface task runs every received frame through a table of
+ *  rules while it is still in the MAC receive buffer. Frames the stack would
+ *  ignore anyway are given back to the MAC there, before a packet buffer is
+ *  taken, the frame copied or any checksum computed, so a broadcast storm
+ *  costs a few compares per frame. The table is fixed at build time, see
+ *  net_classify.c; the first rule matching a frame decides and is counted.
+ *  Frames no rule matches are dropped.
+ */
+#ifndef NET_CLASSIFY_H_
+#define NET_CLASSIFY_H_
+
+#include <stdint.h>
+
+#define NET_RX_DROP         0
+#define NET_RX_ACCEPT       1
+
+/* IP destination classes */
+#define NET_RX_DST_ANY          0
+#define NET_RX_DST_HOST         1   /* our address */
+#define NET_RX_DST_GROUP        2   /* a multicast group joined, see igmp.h */
+#define NET_RX_DST_BROADCAST    3   /* 255.255.255.255, until DHCP gave us an
+                                       address; process_ip_packet() ignores
+                                       broadcasts afterwards */
+
+/***************************************************************************//**
+ * Rule. Zero fields match anything. The port is the TCP or UDP destination
+ * port, so rules with a port do not match fragments after the first.
+ */
+typedef struct net_rx_rule {
+    const char *name;
+    uint16_t ethertype;
+    uint8_t dst;                    /* NET_RX_DST_*, IP only */
+    uint8_t proto;                  /* IP protocol */
+    uint16_t port;
+    uint8_t action;                 /* NET_RX_ACCEPT or NET_RX_DROP */
+} net_rx_rule_t;
+
+/***************************************************************************//**
+ * Classifies a received frame.
+ *
+ * @param  frame    Frame, starting with the Ethernet header.
+ * @param  length   Frame length, without FCS.
+ * @return NET_RX_ACCEPT or NET_RX_DROP
+ */
+uint8_t net_classify(const uint8_t *frame, uint32_t length);
+
+/***************************************************************************//**
+ * Returns the rule table and its length.
+ */
+const net_rx_rule_t *net_classify_rules(uint8_t *count);
+
+/***************************************************************************//**
+ * Returns the number of frames each rule decided, in table order, followed
+ * by the number of frames no rule matched.
+ */
+const uint32_t *net_classify_hits(void);
+
+#endif /* NET_CLASSIFY_H_ */
@@ -0,0 +1,163 @@
+/*******************************************************************************
+ *  net_config.h: build time options of the network interface and TCP/IP stack.
+ */
+#ifndef NET_CONFIG_H_
+#define NET_CONFIG_H_
+
+/***************************************************************************//**
+ * Set to 0 to build the application without the network interface task.
+ */
+#ifndef NET_USE_NETIF
+#define NET_USE_NETIF               1
+#endif
+
+/***************************************************************************//**
+ * Network interface task.
+ * NET_TASK_STACK_SIZE is given in 32 bit words.
+ */
+#define NET_TASK_PRIORITY           (tskIDLE_PRIORITY + 2)
+#define NET_TASK_STACK_SIZE         (configMINIMAL_STACK_SIZE * 2)
+
+/***************************************************************************//**
+ * Number of frames the task handles in one go before letting other tasks of
+ * the same priority run. The receive interrupt stays disabled until the ring
+ * has been emptied.
+ */
+#define NET_RX_BUDGET               4
+
+/***************************************************************************//**
+ * Descriptor rings, must not exceed RX_RING_SIZE and TX_RING_SIZE of
+ * mss_ethernet_mac_user_cfg.h.
+ */
+#define NET_RX_RING_SIZE            4
+#define NET_TX_RING_SIZE            2
+
+/***************************************************************************//**
+ * Interrupt mitigation, see MSS_MAC_set_interrupt_mitigation(). Receive
+ * interrupts are raised every NET_RX_IRQ_FRAMES frames or when the receive
+ * timer expires, whichever comes first.
+ */
+#define NET_RX_IRQ_FRAMES           2
+#define NET_RX_IRQ_TIMER            2
+#define NET_TX_IRQ_FRAMES           2
+#define NET_TX_IRQ_TIMER            2
+#define NET_IRQ_CYCLE_SIZE          0
+
+/***************************************************************************//**
+ * Packet buffer pools, see pbuf.h. NET_PBUF_SIZE must hold a full frame plus
+ * NET_PBUF_HEADROOM. Reference buffers carry no storage, they point to data
+ * owned by the application, such as constant web pages.
+ */
+#define NET_PBUF_COUNT              6
+#define NET_PBUF_SIZE               1536
+#define NET_PBUF_REF_COUNT          8
+#define NET_PBUF_HEADROOM           64
+
+/***************************************************************************//**
+ * DHCP. The client obtains the address of the board, see dhcp.h; the static
+ * address in my_ip is used until it succeeds. The server hands out
+ * g_client_ip to a PC connected straight to the board and must be disabled
+ * on a LAN that has its own server.
+ * Retransmissions while acquiring start after NET_DHCP_RETRY_MS and double
+ * up to NET_DHCP_RETRY_MAX_MS; a REQUEST is tried NET_DHCP_REQUEST_TRIES
+ * times before looking for another server.
+ */
+#ifndef NET_DHCP_CLIENT
+#define NET_DHCP_CLIENT             1
+#endif
+#ifndef NET_DHCP_SERVER
+#define NET_DHCP_SERVER             1
+#endif
+#define NET_DHCP_RETRY_MS           1000
+#define NET_DHCP_RETRY_MAX_MS       16000
+#define NET_DHCP_REQUEST_TRIES      4
+
+/***************************************************************************//**
+ * UDP sockets, see udp.h. NET_UDP_SOCKETS is the number of ports that may be
+ * bound at the same time. Datagrams waiting in a socket mailbox hold a
+ * receive buffer each, so the mailbox depths should leave some of the
+ * NET_PBUF_COUNT buffers to the rest of the stack.
+ * The ARP cache holds NET_ARP_CACHE_SIZE neighbours; an unresolved address is
+ * asked for again every NET_ARP_RETRY_MS while a sender waits.
+ */
+#define NET_UDP_SOCKETS             4
+#define NET_UDP_EPHEMERAL_PORT      49152
+#define NET_ARP_CACHE_SIZE          4
+#define NET_ARP_RETRY_MS            250
+
+/***************************************************************************//**
+ * Multicast groups, see igmp.h. Up to NET_IGMP_GROUPS groups may be joined.
+ * The MAC filters the first 15 addresses exactly, beyond that by hash, so the
+ * filter stays exact as long as NET_IGMP_GROUPS is at most 13. A join is
+ * announced NET_IGMP_ROBUSTNESS times, the repeats at random within
+ * NET_IGMP_UNSOLICITED_MS.
+ */
+#define NET_IGMP_GROUPS             8
+#define NET_IGMP_ROBUSTNESS         2
+#define NET_IGMP_UNSOLICITED_MS     10000
+#define NET_MAC_FILTERS             (NET_IGMP_GROUPS + 2)
+
+/***************************************************************************//**
+ * TCP connections, served by the HTTP server of httpd.h. Segments are
+ * retransmitted after NET_TCP_RTO_MS, doubled at each of the
+ * NET_TCP_MAX_RETRIES attempts. At most NET_TCP_TX_WINDOW bytes are in
+ * flight per connection. Connections idle for NET_TCP_IDLE_MS are closed and
+ * those whose peer does not finish closing are freed after
+ * NET_TCP_FIN_WAIT_MS.
+ */
+#define NET_TCP_CONNECTIONS         2
+#define NET_TCP_RTO_MS              250
+#define NET_TCP_MAX_RETRIES         6
+#define NET_TCP_TX_WINDOW           (4 * 1460)
+#define NET_TCP_IDLE_MS             15000
+#define NET_TCP_FIN_WAIT_MS         2000
+
+/***************************************************************************//**
+ * IP fragments are reassembled in NET_IP_REASS_SLOTS buffers of
+ * NET_IP_REASS_SIZE bytes, a multiple of 8, and dropped if the datagram is not
+ * complete after NET_IP_REASS_TIMEOUT_MS. TCP segments are sent with the
+ * don't fragment bit and shrunk when a router reports a smaller path MTU,
+ * down to NET_IP_MIN_PMTU; below it they are sent without the bit instead.
+ */
+#define NET_IP_REASS_SLOTS          2
+#define NET_IP_REASS_SIZE           2960
+#define NET_IP_REASS_TIMEOUT_MS     3000
+#define NET_IP_MIN_PMTU             576
+
+/***************************************************************************//**
+ * ICMP echo replies, see icmp.h. At most NET_ICMP_ECHO_RATE replies are sent
+ * per second on average, with bursts of up to NET_ICMP_ECHO_BURST.
+ */
+#define NET_ICMP_ECHO_RATE          100
+#define NET_ICMP_ECHO_BURST         10
+
+/***************************************************************************//**
+ * HTTP server, see httpd.h. Each connection has a request buffer, a response
+ * header buffer and a buffer for dynamic pages.
+ */
+#define NET_HTTPD_REQUEST_SIZE      512
+#define NET_HTTPD_HEADER_SIZE       192
+#define NET_HTTPD_DYNAMIC_SIZE      1024
+
+/***************************************************************************//**
+ * Frame capture, see net_capture.h. Each slot takes NET_CAPTURE_SNAPLEN + 12
+ * bytes of RAM. NET_CAPTURE_SNAPLEN must be a multiple of 4.
+ */
+#ifndef NET_CAPTURE
+#define NET_CAPTURE                 0
+#endif
+#define NET_CAPTURE_SLOTS           32
+#define NET_CAPTURE_SNAPLEN         128
+
+/***************************************************************************//**
+ * Number of frames other tasks may queue for transmission.
+ */
+#define NET_TX_QUEUE_LENGTH         4
+
+/***************************************************************************//**
+ * Longest time, in milliseconds, the task sleeps without an interrupt. Must
+ * stay below 65 ms since the RTOS uses 16 bit ticks of 1 us.
+ */
+#define NET_IDLE_PERIOD_MS          50
+
+#endif /* NET_CONFIG_H_ */
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ *  net_timer.c: one-shot timers for the network stack.
+ *
+ *  Running timers are kept in a list sorted by expiry time, so polling only
+ *  looks at the head. The tick count is read as a difference from the last
+ *  poll, which stays correct across wraps as long as polls are less than one
+ *  wrap apart.
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "net_timer.h"
+
+#define NET_TIMER_TICKS_PER_MS  (configTICK_RATE_HZ / 1000UL)
+
+static net_timer_t *net_timer_list;
+static portTickType net_timer_last_tick;
+static uint32_t net_timer_ticks;        /* ticks not yet counted as a ms */
+static uint32_t net_timer_ms;
+static uint32_t net_timer_ms_part;      /* ms not yet counted as a second */
+static uint32_t net_timer_s;
+
+static void net_timer_update(void);
+
+/***************************************************************************//**
+ *  See net_timer.h for more information.
+ */
+void net_timer_init(void)
+{
+    net_timer_list = NULL;
+    net_timer_last_tick = xTaskGetTickCount();
+    net_timer_ticks = 0;
+    net_timer_ms = 0;
+    net_timer_ms_part = 0;
+    net_timer_s = 0;
+}
+
+/***************************************************************************//**
+ * Adds the ticks elapsed since the last call to the clocks.
+ */
+static void net_timer_update(void)
+{
+    portTickType now = xTaskGetTickCount();
+    uint32_t ms;
+
+    net_timer_ticks += (portTickType)(now - net_timer_last_tick);
+    net_timer_last_tick = now;
+
+    ms = net_timer_ticks / NET_TIMER_TICKS_PER_MS;
+    net_timer_ticks -= ms * NET_TIMER_TICKS_PER_MS;
+    net_timer_ms += ms;
+    net_timer_ms_part += ms;
+    if (net_timer_ms_part >= 1000) {
+        net_timer_s += net_timer_ms_part / 1000;
+        net_timer_ms_part %= 1000;
+    }
+}
+
+/***************************************************************************//**
+ *  See net_timer.h for more information.
+ */
+void net_timer_start(net_timer_t *t, uint32_t ms, net_timer_fn_t fn, void *arg)
+{
+    net_timer_t **pp;
+
+    net_timer_stop(t);
+    net_timer_update();
+    if (ms > NET_TIMER_MAX_MS) {
+        ms = NET_TIMER_MAX_MS;
+    }
+    t->expires = net_timer_ms + ms;
+    t->fn = fn;
+    t->arg = arg;
+
+    /* After the timers expiring at the same time, so they run in order */
+    for (pp = &net_timer_list; *pp != NULL; pp = &(*pp)->next) {
+        if ((int32_t)((*pp)->expires - t->expires) > 0) {
+            break;
+        }
+    }
+    t->next = *pp;
+    *pp = t;
+}
+
+/***************************************************************************//**
+ *  See net_timer.h for more information.
+ */
+void net_timer_stop(net_timer_t *t)
+{
+    net_timer_t **pp;
+
+    for (pp = &net_timer_list; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == t) {
+            *pp = t->next;
+            t->next = NULL;
+            break;
+        }
+    }
+}
+
+/***************************************************************************//**
+ *  See net_timer.h for more information.
+ */
+void net_timer_poll(void)
+{
+    net_timer_t *t;
+
+    net_timer_update();
+    while ((net_timer_list != NULL) &&
+           ((int32_t)(net_timer_ms - net_timer_list->expires) >= 0)) {
+        /* Unlink first, the function may start the timer again */
+        t = net_timer_list;
+        net_timer_list = t->next;
+        t->next = NULL;
+        t->fn(t->arg);
+    }
+}
+
+/***************************************************************************//**
+ *  See net_timer.h for more information.
+ */
+uint32_t net_timer_next_ms(void)
+{
+    int32_t left;
+
+    if (net_timer_list == NULL) {
+        return 0xFFFFFFFFUL;
+    }
+    net_timer_update();
+    left = (int32_t)(net_timer_list->expires - net_timer_ms);
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+/***************************************************************************//**
+ *  See net_timer.h for more information.
+ */
+uint32_t net_timer_now_ms(void)
+{
+    net_timer_update();
+    return net_timer_ms;
+}
+
+/***************************************************************************//**
+ *  See net_timer.h for more information.
+ */
+uint32_t net_timer_now_s(void)
+{
+    net_timer_update();
+    return net_timer_s;
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ *  net_timer.h: one-shot timers for the network stack.
+ *
+ *  The RTOS has no timer service and its 16 bit tick of 1 us wraps every
+ *  65 ms, so the stack keeps its own millisecond and second clocks. They are
+ *  advanced by net_timer_poll(), which the network interface task calls every
+ *  time it wakes up, at least every NET_IDLE_PERIOD_MS. Expired timers are
+ *  called from net_timer_poll(), in the task, so timer functions may use the
+ *  rest of the stack without locking. All functions must be called from the
+ *  network interface task.
+ */
+#ifndef NET_TIMER_H_
+#define NET_TIMER_H_
+
+#include <stdint.h>
+
+/***************************************************************************//**
+ * Longest delay net_timer_start() accepts, about 12 days. Longer waits, such
+ * as DHCP leases, are done in steps.
+ */
+#define NET_TIMER_MAX_MS        0x40000000UL
+
+typedef void (*net_timer_fn_t)(void *arg);
+
+/***************************************************************************//**
+ * Timer. The structure is owned by the caller and must stay valid while the
+ * timer is running.
+ */
+typedef struct net_timer {
+    struct net_timer *next;     /* next timer to expire */
+    uint32_t expires;           /* net_timer_now_ms() at expiry */
+    net_timer_fn_t fn;
+    void *arg;
+} net_timer_t;
+
+/***************************************************************************//**
+ * Starts the clocks. Called by the network interface task before any other
+ * function.
+ */
+void net_timer_init(void);
+
+/***************************************************************************//**
+ * Starts or restarts a timer.
+ *
+ * @param t         timer
+ * @param ms        delay in milliseconds, clamped to NET_TIMER_MAX_MS
+ * @param fn        function called on expiry
+ * @param arg       parameter given to fn
+ */
+void net_timer_start(net_timer_t *t, uint32_t ms, net_timer_fn_t fn, void *arg);
+
+/***************************************************************************//**
+ * Stops a timer. Does nothing if it is not running.
+ */
+void net_timer_stop(net_timer_t *t);
+
+/***************************************************************************//**
+ * Advances the clocks and calls the expired timers.
+ */
+void net_timer_poll(void);
+
+/***************************************************************************//**
+ * Returns the milliseconds until the next timer expires, 0 if one is already
+ * due and 0xFFFFFFFF if no timer is running.
+ */
+uint32_t net_timer_next_ms(void);
+
+/***************************************************************************//**
+ * Millisecond clock. Wraps after 49 days, compare times by subtraction.
+ */
+uint32_t net_timer_now_ms(void);
+
+/***************************************************************************//**
+ * Second clock.
+ */
+uint32_t net_timer_now_s(void);
+
+#endif /* NET_TIMER_H_ */
@@ -0,0 +1,372 @@
+/*******************************************************************************
+ *  netif.c: network interface task.
+ *
+ *  The receive path follows the usual "interrupt then poll" scheme: the first
+ *  receive interrupt disables further receive interrupts and wakes the task,
+ *  which then empties the ring NET_RX_BUDGET frames at a time. Interrupts are
+ *  only re-enabled once the ring is found empty, so a burst of frames costs a
+ *  single interrupt and the task never spins waiting for the MAC. Frames are
+ *  classified in the MAC buffer, see net_classify.h, and only those accepted
+ *  are copied into a packet buffer.
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "../../CMSIS/a2fxxxm3.h"
+#include "../mss_ethernet_mac/mss_ethernet_mac.h"
+#include "netif.h"
+#include "net_capture.h"
+#include "net_classify.h"
+#include "net_timer.h"
+#include "dhcp.h"
+#include "igmp.h"
+#include "tcpip.h"
+#include "../fast_mem/fast_mem.h"
+
+extern unsigned char my_mac[];
+
+typedef struct netif_tx_req {
+    const uint8_t *frame;           /* flat frame, when p is NULL */
+    uint16_t length;
+    MSS_MAC_tx_complete_t complete;
+    void *context;
+    pbuf_t *p;                      /* buffer chain */
+} netif_tx_req_t;
+
+#define NETIF_MAX_SEGMENTS      (2 * NET_TX_RING_SIZE)
+
+static xSemaphoreHandle netif_event_sem;    /* any MAC event or queued frame */
+static xSemaphoreHandle netif_tx_sem;       /* transmit interrupt, for the wait hook */
+static xQueueHandle netif_tx_queue;
+static netif_tx_req_t netif_tx_staged;      /* frame waiting for a free descriptor */
+static unsigned char netif_tx_staged_valid;
+static netif_stats_t netif_stats;
+static uint8_t netif_filters[NET_MAC_FILTERS * 6];
+static uint16_t netif_filter_count;
+static volatile unsigned char netif_filters_changed;
+
+static void netif_task(void *para);
+static void netif_mac_isr(uint32_t events);
+static void netif_wait(void);
+static void netif_poll_rx(void);
+static void netif_drain_tx(void);
+static void netif_pbuf_sent(void *context);
+static void netif_apply_filters(void);
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_init(void)
+{
+    pbuf_init();
+    vSemaphoreCreateBinary(netif_event_sem);
+    vSemaphoreCreateBinary(netif_tx_sem);
+    netif_tx_queue = xQueueCreate(NET_TX_QUEUE_LENGTH, sizeof(netif_tx_req_t));
+    if ((netif_event_sem == NULL) || (netif_tx_sem == NULL) || (netif_tx_queue == NULL)) {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+    /* Semaphores are created given, start with nothing pending */
+    xSemaphoreTake(netif_event_sem, 0);
+    xSemaphoreTake(netif_tx_sem, 0);
+
+    return xTaskCreate(netif_task, (signed portCHAR *) "netif", NET_TASK_STACK_SIZE,
+                       NULL, NET_TASK_PRIORITY, NULL);
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_output(const uint8_t *frame, uint16_t length,
+                           MSS_MAC_tx_complete_t complete, void *context,
+                           portTickType wait)
+{
+    netif_tx_req_t req;
+
+    req.frame = frame;
+    req.length = length;
+    req.complete = complete;
+    req.context = context;
+    req.p = NULL;
+    if (xQueueSend(netif_tx_queue, &req, wait) != pdPASS) {
+        return errQUEUE_FULL;
+    }
+    xSemaphoreGive(netif_event_sem);
+    return pdPASS;
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_output_pbuf(pbuf_t *p, portTickType wait)
+{
+    netif_tx_req_t req;
+
+    req.frame = NULL;
+    req.length = p->tot_len;
+    req.complete = netif_pbuf_sent;
+    req.context = p;
+    req.p = p;
+    if (xQueueSend(netif_tx_queue, &req, wait) != pdPASS) {
+        netif_stats.tx_dropped++;
+        pbuf_free(p);
+        return errQUEUE_FULL;
+    }
+    xSemaphoreGive(netif_event_sem);
+    return pdPASS;
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_set_mac_filters(const uint8_t *filters, uint16_t count)
+{
+    if (count > NET_MAC_FILTERS) {
+        return pdFAIL;
+    }
+    portENTER_CRITICAL();
+    fast_memcpy(netif_filters, filters, (uint32_t)count * 6u);
+    netif_filter_count = count;
+    netif_filters_changed = 1;
+    portEXIT_CRITICAL();
+    xSemaphoreGive(netif_event_sem);
+    return pdPASS;
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+const netif_stats_t *netif_get_stats(void)
+{
+    return &netif_stats;
+}
+
+/***************************************************************************//**
+ * Task body. Brings the MAC up, then waits for events. The idle period bounds
+ * the time a lost interrupt could leave frames in the ring.
+ */
+static void netif_task(void *para)
+{
+    uint32_t wait_ms;
+
+    net_timer_init();
+    MSS_MAC_init(MSS_PHY_ADDRESS_AUTO_DETECT);
+    MSS_MAC_set_ring_sizes(NET_RX_RING_SIZE, NET_TX_RING_SIZE);
+    MSS_MAC_set_mac_address(my_mac);
+    MSS_MAC_set_interrupt_mitigation(NET_RX_IRQ_FRAMES, NET_RX_IRQ_TIMER,
+                                     NET_TX_IRQ_FRAMES, NET_TX_IRQ_TIMER,
+                                     NET_IRQ_CYCLE_SIZE);
+    MSS_MAC_set_wait_hook(netif_wait);
+    MSS_MAC_set_callback(netif_mac_isr);
+#if NET_CAPTURE
+    net_capture_init();
+    MSS_MAC_set_capture_hook(net_capture_frame);
+#endif
+    tcp_init();
+    igmp_init();
+
+    /* The listener uses the RTOS API so the interrupt must not be above
+       configMAX_SYSCALL_INTERRUPT_PRIORITY */
+    NVIC_SetPriority(EthernetMAC_IRQn, configMAX_SYSCALL_INTERRUPT_PRIORITY >> (8 - __NVIC_PRIO_BITS));
+    NVIC_EnableIRQ(EthernetMAC_IRQn);
+#if NET_DHCP_CLIENT
+    dhcp_start();
+#endif
+
+    for (;;) {
+        /* Wake up for the next network timer, and often enough for the
+           timer clocks to see every wrap of the tick count */
+        wait_ms = net_timer_next_ms();
+        if (wait_ms > NET_IDLE_PERIOD_MS) {
+            wait_ms = NET_IDLE_PERIOD_MS;
+        }
+        xSemaphoreTake(netif_event_sem, NET_MS_TO_TICKS(wait_ms));
+        netif_stats.wakeups++;
+        netif_apply_filters();
+        netif_poll_rx();
+        MSS_MAC_tx_reclaim();
+        net_timer_poll();
+        netif_drain_tx();
+    }
+}
+
+/***************************************************************************//**
+ * MAC event listener, runs in the MAC interrupt.
+ */
+static void netif_mac_isr(uint32_t events)
+{
+    portBASE_TYPE woken = pdFALSE;
+
+    if (events & MSS_MAC_EVENT_PACKET_RECEIVED) {
+        /* The task polls from now on */
+        MSS_MAC_disable_rx_irq();
+    }
+    if (events & MSS_MAC_EVENT_PACKET_SEND) {
+        xSemaphoreGiveFromISR(netif_tx_sem, &woken);
+    }
+    xSemaphoreGiveFromISR(netif_event_sem, &woken);
+    portEND_SWITCHING_ISR(woken);
+}
+
+/***************************************************************************//**
+ * MAC wait hook. Blocks the task until a frame has been sent instead of
+ * spinning on the descriptor; the 1 ms bound covers receive waits.
+ */
+static void netif_wait(void)
+{
+    xSemaphoreTake(netif_tx_sem, NET_MS_TO_TICKS(1));
+}
+
+/***************************************************************************//**
+ * Empties the receive ring. After NET_RX_BUDGET frames the task handles its
+ * transmit work and yields before carrying on, so a flood of frames cannot
+ * starve the other tasks of the same priority nor the transmit direction.
+ */
+static void netif_poll_rx(void)
+{
+    int32_t len;
+    unsigned portBASE_TYPE budget;
+    uint8_t *frame;
+    pbuf_t *p;
+
+    for (;;) {
+        for (budget = NET_RX_BUDGET; budget > 0; budget--) {
+            len = MSS_MAC_rx_packet_ptrset(&frame, MSS_MAC_NONBLOCKING);
+            if (len <= 0) {
+                break;
+            }
+            if (net_classify(frame, (uint32_t)len) == NET_RX_DROP) {
+                MSS_MAC_prepare_rx_descriptor();
+                netif_stats.rx_filtered++;
+                continue;
+            }
+            p = pbuf_alloc(0, NET_PBUF_SIZE);
+            if (p == NULL) {
+                /* Frames sent from receive buffers, echo replies, may hold
+                   them still */
+                MSS_MAC_tx_reclaim();
+                p = pbuf_alloc(0, NET_PBUF_SIZE);
+            }
+            if (p == NULL) {
+                /* Out of buffers, the frame is lost */
+                MSS_MAC_prepare_rx_descriptor();
+                netif_stats.rx_no_pbuf++;
+                continue;
+            }
+            if (len > (int32_t)p->len) {
+                /* Frame longer than the buffer */
+                MSS_MAC_prepare_rx_descriptor();
+                netif_stats.rx_dropped++;
+                pbuf_free(p);
+                continue;
+            }
+            fast_memcpy(p->payload, frame, (size_t)len);
+            MSS_MAC_prepare_rx_descriptor();
+            p->len = (uint16_t)len;
+            p->tot_len = (uint16_t)len;
+            netif_stats.rx_frames++;
+            tcpip_input(p);
+        }
+
+        if (budget > 0) {
+            /* Ring empty: back to interrupts, then look again in case a frame
+               arrived before the interrupt was enabled */
+            MSS_MAC_enable_rx_irq();
+            if (MSS_MAC_rx_pckt_size() == 0) {
+                break;
+            }
+            MSS_MAC_disable_rx_irq();
+        } else {
+            netif_stats.rx_budget_exhausted++;
+            MSS_MAC_tx_reclaim();
+            netif_drain_tx();
+            taskYIELD();
+        }
+    }
+}
+
+/***************************************************************************//**
+ * Gives the queued frames to the MAC until the ring is full. The frame that
+ * did not fit is kept aside and retried on the next transmit interrupt.
+ */
+static void netif_drain_tx(void)
+{
+    mss_mac_tx_segment_t seg[NETIF_MAX_SEGMENTS];
+    uint8_t count;
+    pbuf_t *q;
+
+    for (;;) {
+        if (!netif_tx_staged_valid) {
+            if (xQueueReceive(netif_tx_queue, &netif_tx_staged, 0) != pdPASS) {
+                break;
+            }
+            netif_tx_staged_valid = 1;
+        }
+        if (netif_tx_staged.p == NULL) {
+            seg[0].data = netif_tx_staged.frame;
+            seg[0].length = netif_tx_staged.length;
+            count = 1;
+        } else {
+            count = 0;
+            for (q = netif_tx_staged.p; (q != NULL) && (count < NETIF_MAX_SEGMENTS); q = q->next) {
+                seg[count].data = q->payload;
+                seg[count].length = q->len;
+                count++;
+            }
+            if (q != NULL) {
+                /* More buffers than descriptors can carry, flatten the chain */
+                q = pbuf_alloc(0, netif_tx_staged.p->tot_len);
+                if ((q == NULL) || (q->next != NULL)) {
+                    pbuf_free(q);
+                    pbuf_free(netif_tx_staged.p);
+                    netif_stats.tx_dropped++;
+                    netif_tx_staged_valid = 0;
+                    continue;
+                }
+                pbuf_copy_out(netif_tx_staged.p, q->payload, q->len, 0);
+                pbuf_free(netif_tx_staged.p);
+                netif_tx_staged.p = q;
+                netif_tx_staged.context = q;
+                netif_stats.tx_linearized++;
+                seg[0].data = q->payload;
+                seg[0].length = q->len;
+                count = 1;
+            }
+        }
+        if (MSS_MAC_tx_packet_sg(seg, count, netif_tx_staged.complete,
+                                 netif_tx_staged.context, MSS_MAC_NONBLOCKING) == 0) {
+            netif_stats.tx_ring_full++;
+            break;
+        }
+        netif_stats.tx_frames++;
+        netif_tx_staged_valid = 0;
+    }
+}
+
+/***************************************************************************//**
+ * Transmit completion of a buffer chain.
+ */
+static void netif_pbuf_sent(void *context)
+{
+    pbuf_free((pbuf_t *)context);
+}
+
+/***************************************************************************//**
+ * Programs the MAC filter with the last list given to netif_set_mac_filters().
+ */
+static void netif_apply_filters(void)
+{
+    uint8_t filters[NET_MAC_FILTERS * 6];
+    uint16_t count;
+
+    if (!netif_filters_changed) {
+        return;
+    }
+    portENTER_CRITICAL();
+    count = netif_filter_count;
+    fast_memcpy(filters, netif_filters, (uint32_t)count * 6u);
+    netif_filters_changed = 0;
+    portEXIT_CRITICAL();
+    MSS_MAC_set_mac_filters(count, filters);
+}
@@ -0,0 +1,91 @@
+/*******************************************************************************
+ *  netif.h: network interface task.
+ *
+ *  The task owns the Ethernet MAC. It sleeps until the MAC interrupt wakes it,
+ *  then polls the receive ring with a budget while the receive interrupt is
+ *  disabled, hands the frames to the TCP/IP stack in packet buffers and
+ *  transmits the frames and buffer chains queued by other tasks.
+ */
+#ifndef NETIF_H_
+#define NETIF_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "../mss_ethernet_mac/mss_ethernet_mac.h"
+#include "net_config.h"
+#include "pbuf.h"
+
+/***************************************************************************//**
+ * Converts milliseconds into RTOS ticks. portTICK_RATE_MS cannot be used
+ * since the tick is shorter than a millisecond.
+ */
+#define NET_MS_TO_TICKS(ms)     ((portTickType)(((unsigned long)(ms) * configTICK_RATE_HZ) / 1000UL))
+
+/***************************************************************************//**
+ * Network interface counters.
+ */
+typedef struct netif_stats {
+    uint32_t rx_frames;             /* frames handed to the stack */
+    uint32_t rx_dropped;            /* frames too big for the receive buffer */
+    uint32_t rx_no_pbuf;            /* frames dropped for lack of packet buffer */
+    uint32_t rx_filtered;           /* frames dropped by net_classify() */
+    uint32_t rx_budget_exhausted;   /* polls which ended on the budget */
+    uint32_t tx_frames;             /* queued frames given to the MAC */
+    uint32_t tx_ring_full;          /* queued frames delayed by a full ring */
+    uint32_t tx_linearized;         /* chains copied into a single buffer */
+    uint32_t tx_dropped;            /* chains that could not be sent */
+    uint32_t wakeups;               /* task wake ups */
+} netif_stats_t;
+
+/***************************************************************************//**
+ * Creates the network interface task. The MAC is initialized by the task
+ * itself once the scheduler runs.
+ * 
+ * @return pdPASS   if the task and its queues were created
+ *         errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY otherwise
+ */
+portBASE_TYPE netif_init(void);
+/***************************************************************************//**
+ * Queues a frame for transmission by the network interface task. The frame is
+ * not copied, it must remain unchanged until complete is called.
+ * 
+ * @param  frame    Ethernet frame, starting with the destination address.
+ * @param  length   Number of bytes in the frame.
+ * @param  complete Called once the frame has been sent, may be NULL.
+ * @param  context  Parameter given to complete.
+ * @param  wait     Ticks to wait for room in the queue.
+ * @return pdPASS   if the frame was queued
+ *         errQUEUE_FULL otherwise
+ */
+portBASE_TYPE netif_output(const uint8_t *frame, uint16_t length,
+                           MSS_MAC_tx_complete_t complete, void *context,
+                           portTickType wait);
+/***************************************************************************//**
+ * Queues a packet buffer chain for transmission. The chain is freed once it
+ * has been sent; the reference held by the caller is passed to the interface,
+ * also when the chain cannot be queued.
+ * 
+ * @param  p        Ethernet frame.
+ * @param  wait     Ticks to wait for room in the queue.
+ * @return pdPASS   if the frame was queued
+ *         errQUEUE_FULL otherwise
+ */
+portBASE_TYPE netif_output_pbuf(pbuf_t *p, portTickType wait);
+/***************************************************************************//**
+ * Sets the multicast and broadcast addresses the MAC receives besides its
+ * own. The list is copied; the task programs the MAC filter with it, since
+ * doing so briefly stops the MAC.
+ * 
+ * @param  filters  count Ethernet addresses of 6 bytes, each with the group
+ *                  bit set.
+ * @param  count    Number of addresses, at most NET_MAC_FILTERS.
+ * @return pdPASS   if the list was taken
+ *         pdFAIL   if it is too long
+ */
+portBASE_TYPE netif_set_mac_filters(const uint8_t *filters, uint16_t count);
+/***************************************************************************//**
+ * Returns the network interface counters.
+ */
+const netif_stats_t *netif_get_stats(void);
+
+#endif /* NETIF_H_ */
@@ -85,6 +85,8 @@ typedef struct ip_hdr {
 
 #define ICMP_TYPE_ECHO_REQUEST  8
 #define ICMP_TYPE_ECHO_REPLY    0
+#define ICMP_TYPE_UNREACHABLE   3
+#define ICMP_CODE_FRAG_NEEDED   4
 
 typedef struct icmp_hdr {
     unsigned char type;
@@ -194,16 +196,31 @@ typedef struct tcp_control_block {
     unsigned char remote_port[TCP_PORT_LEN];
     unsigned char remote_addr[IP_ADDR_LEN];
     tcp_state_t state;
-    unsigned int local_seq;
-    unsigned int remote_seq;
+    unsigned int local_seq;         /* next sequence number to send */
+    unsigned int remote_seq;        /* next sequence number expected */
     unsigned char remote_mac[ETH_ADDR_LEN]; /* this really doesn't belong here */
 //<CJ>:    
     const uint8_t * tx_block_addr;
     unsigned short int tx_block_size;
     unsigned short int tx_block_idx;
     uint8_t * tcp_packet;
+    /* Stream being sent, a header followed by tx_block, see tcp_send() */
+    const uint8_t * tx_hdr_addr;
+    unsigned short int tx_hdr_size;
+    unsigned int tx_start_seq;      /* sequence number of its first byte */
+    unsigned int snd_una;           /* oldest unacknowledged sequence number */
+    unsigned short int snd_wnd;     /* window advertised by the peer */
+    unsigned short int mss;         /* largest segment the peer accepts */
+    unsigned char flags;            /* TCP_FLAG_* */
+    unsigned char retries;          /* retransmissions without progress */
 } tcp_control_block_t;
 
+#define TCP_FLAG_CLOSE      0x01    /* send a FIN after the stream */
+#define TCP_FLAG_FIN_SENT   0x02
+#define TCP_FLAG_FIN_RCVD   0x04
+#define TCP_FLAG_RTO        0x08    /* timer is the retransmission timer */
+#define TCP_FLAG_NO_DF      0x10    /* path MTU below NET_IP_MIN_PMTU, let routers fragment */
+
 
 typedef enum tcp_cntrol_flags_e {
     TCP_CNTRL_FIN = 0x01,
@@ -0,0 +1,244 @@
+/*******************************************************************************
+ *  pbuf.c: packet buffers for the network stack.
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "pbuf.h"
+#include "../fast_mem/fast_mem.h"
+
+static pbuf_t pbuf_data_pool[NET_PBUF_COUNT];
+static pbuf_t pbuf_ref_pool[NET_PBUF_REF_COUNT];
+static uint32_t pbuf_data_mem[NET_PBUF_COUNT][(NET_PBUF_SIZE + 3) / 4];
+static pbuf_t *pbuf_free_list[PBUF_POOL_COUNT];
+static pbuf_stats_t pbuf_stats[PBUF_POOL_COUNT];
+
+static pbuf_t *pbuf_get(pbuf_pool_t pool);
+static void pbuf_put(pbuf_t *p);
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+void pbuf_init(void)
+{
+    int i;
+
+    pbuf_free_list[PBUF_POOL_DATA] = NULL;
+    for (i = 0; i < NET_PBUF_COUNT; i++) {
+        pbuf_data_pool[i].pool = PBUF_POOL_DATA;
+        pbuf_data_pool[i].mem = (uint8_t *)pbuf_data_mem[i];
+        pbuf_data_pool[i].next = pbuf_free_list[PBUF_POOL_DATA];
+        pbuf_free_list[PBUF_POOL_DATA] = &pbuf_data_pool[i];
+    }
+    pbuf_free_list[PBUF_POOL_REF] = NULL;
+    for (i = 0; i < NET_PBUF_REF_COUNT; i++) {
+        pbuf_ref_pool[i].pool = PBUF_POOL_REF;
+        pbuf_ref_pool[i].mem = NULL;
+        pbuf_ref_pool[i].next = pbuf_free_list[PBUF_POOL_REF];
+        pbuf_free_list[PBUF_POOL_REF] = &pbuf_ref_pool[i];
+    }
+    fast_memset(pbuf_stats, 0, sizeof(pbuf_stats));
+    pbuf_stats[PBUF_POOL_DATA].avail = NET_PBUF_COUNT;
+    pbuf_stats[PBUF_POOL_REF].avail = NET_PBUF_REF_COUNT;
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+pbuf_t *pbuf_alloc(uint16_t headroom, uint16_t length)
+{
+    pbuf_t *head = NULL;
+    pbuf_t *last = NULL;
+    pbuf_t *p;
+    uint16_t room;
+
+    if (headroom >= NET_PBUF_SIZE) {
+        return NULL;
+    }
+    do {
+        p = pbuf_get(PBUF_POOL_DATA);
+        if (p == NULL) {
+            pbuf_free(head);
+            return NULL;
+        }
+        room = NET_PBUF_SIZE - headroom;
+        p->payload = p->mem + headroom;
+        p->len = (length < room) ? length : room;
+        p->tot_len = length;
+        length -= p->len;
+        headroom = 0;
+        if (last == NULL) {
+            head = p;
+        } else {
+            last->next = p;
+        }
+        last = p;
+    } while (length > 0);
+    return head;
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+pbuf_t *pbuf_alloc_ref(const void *data, uint16_t length)
+{
+    pbuf_t *p = pbuf_get(PBUF_POOL_REF);
+
+    if (p != NULL) {
+        p->payload = (uint8_t *)data;
+        p->len = length;
+        p->tot_len = length;
+    }
+    return p;
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+void pbuf_ref(pbuf_t *p)
+{
+    portENTER_CRITICAL();
+    p->ref++;
+    portEXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+void pbuf_free(pbuf_t *p)
+{
+    pbuf_t *next;
+    uint8_t ref;
+
+    while (p != NULL) {
+        portENTER_CRITICAL();
+        ref = --p->ref;
+        portEXIT_CRITICAL();
+        if (ref != 0) {
+            break;
+        }
+        next = p->next;
+        pbuf_put(p);
+        p = next;
+    }
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+int pbuf_header(pbuf_t *p, int16_t delta)
+{
+    if (delta > 0) {
+        if ((p->mem == NULL) || ((uint16_t)(p->payload - p->mem) < (uint16_t)delta)) {
+            return -1;
+        }
+    } else if ((uint16_t)(-delta) > p->len) {
+        return -1;
+    }
+    p->payload -= delta;
+    p->len += delta;
+    p->tot_len += delta;
+    return 0;
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+void pbuf_cat(pbuf_t *head, pbuf_t *tail)
+{
+    for (; head->next != NULL; head = head->next) {
+        head->tot_len += tail->tot_len;
+    }
+    head->tot_len += tail->tot_len;
+    head->next = tail;
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+uint16_t pbuf_copy_out(const pbuf_t *p, void *dst, uint16_t len, uint16_t offset)
+{
+    uint8_t *d = (uint8_t *)dst;
+    uint16_t copied = 0;
+    uint16_t n;
+
+    for (; (p != NULL) && (copied < len); p = p->next) {
+        if (offset >= p->len) {
+            offset -= p->len;
+            continue;
+        }
+        n = p->len - offset;
+        if (n > (len - copied)) {
+            n = len - copied;
+        }
+        fast_memcpy(d + copied, p->payload + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+uint16_t pbuf_take(pbuf_t *p, const void *src, uint16_t len)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    uint16_t copied = 0;
+    uint16_t n;
+
+    for (; (p != NULL) && (copied < len); p = p->next) {
+        n = (p->len < (len - copied)) ? p->len : (len - copied);
+        fast_memcpy(p->payload, s + copied, n);
+        copied += n;
+    }
+    return copied;
+}
+
+/***************************************************************************//**
+ *  See pbuf.h for more information.
+ */
+const pbuf_stats_t *pbuf_get_stats(pbuf_pool_t pool)
+{
+    return &pbuf_stats[pool];
+}
+
+/***************************************************************************//**
+ * Takes a buffer from a pool, with a single reference and no successor.
+ */
+static pbuf_t *pbuf_get(pbuf_pool_t pool)
+{
+    pbuf_t *p;
+
+    portENTER_CRITICAL();
+    p = pbuf_free_list[pool];
+    if (p != NULL) {
+        pbuf_free_list[pool] = p->next;
+        pbuf_stats[pool].allocs++;
+        pbuf_stats[pool].used++;
+        if (pbuf_stats[pool].used > pbuf_stats[pool].max_used) {
+            pbuf_stats[pool].max_used = pbuf_stats[pool].used;
+        }
+    } else {
+        pbuf_stats[pool].alloc_fail++;
+    }
+    portEXIT_CRITICAL();
+
+    if (p != NULL) {
+        p->next = NULL;
+        p->ref = 1;
+    }
+    return p;
+}
+
+/***************************************************************************//**
+ * Returns a buffer to its pool.
+ */
+static void pbuf_put(pbuf_t *p)
+{
+    portENTER_CRITICAL();
+    p->next = pbuf_free_list[p->pool];
+    pbuf_free_list[p->pool] = p;
+    pbuf_stats[p->pool].used--;
+    portEXIT_CRITICAL();
+}
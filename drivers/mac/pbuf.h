@@ -0,0 +1,112 @@
+/*******************************************************************************
+ *  pbuf.h: packet buffers for the network stack.
+ *
+ *  Buffers come from two fixed pools. Data buffers own NET_PBUF_SIZE bytes of
+ *  storage; the payload starts after some headroom so that each protocol layer
+ *  can prepend its header in place. Reference buffers own no storage and point
+ *  to application data, which lets constant content be transmitted without a
+ *  copy. Buffers can be chained to hold more than one buffer worth of data and
+ *  are reference counted so that a frame can be queued or shared between
+ *  tasks; the last pbuf_free() returns it to its pool.
+ */
+#ifndef PBUF_H_
+#define PBUF_H_
+
+#include <stdint.h>
+#include "net_config.h"
+
+/***************************************************************************//**
+ * Pool identifiers.
+ */
+typedef enum pbuf_pool {
+    PBUF_POOL_DATA,
+    PBUF_POOL_REF,
+    PBUF_POOL_COUNT
+} pbuf_pool_t;
+
+/***************************************************************************//**
+ * Packet buffer. tot_len is the number of bytes in this buffer and all the
+ * following ones of the chain, so the first buffer gives the packet length.
+ */
+typedef struct pbuf {
+    struct pbuf *next;          /* next buffer of the chain */
+    uint8_t *payload;           /* first valid byte */
+    uint16_t len;               /* valid bytes in this buffer */
+    uint16_t tot_len;           /* valid bytes from here to the end of the chain */
+    uint8_t ref;                /* reference count */
+    uint8_t pool;               /* pbuf_pool_t the buffer belongs to */
+    uint8_t *mem;               /* start of the storage, NULL for references */
+} pbuf_t;
+
+/***************************************************************************//**
+ * Pool counters.
+ */
+typedef struct pbuf_stats {
+    uint16_t avail;             /* buffers in the pool */
+    uint16_t used;              /* buffers currently allocated */
+    uint16_t max_used;          /* high water mark of used */
+    uint32_t allocs;            /* allocations granted */
+    uint32_t alloc_fail;        /* allocations refused */
+} pbuf_stats_t;
+
+/***************************************************************************//**
+ * Initializes the pools, must be called before any other function.
+ */
+void pbuf_init(void);
+/***************************************************************************//**
+ * Allocates data buffers for length bytes of payload, preceded by headroom
+ * bytes in the first buffer. Buffers are chained when the payload does not
+ * fit in one.
+ * 
+ * @return  the first buffer of the chain, NULL if the pool is exhausted
+ */
+pbuf_t *pbuf_alloc(uint16_t headroom, uint16_t length);
+/***************************************************************************//**
+ * Allocates a reference buffer pointing to length bytes at data. The data must
+ * stay valid until the buffer is freed.
+ * 
+ * @return  the buffer, NULL if the pool is exhausted
+ */
+pbuf_t *pbuf_alloc_ref(const void *data, uint16_t length);
+/***************************************************************************//**
+ * Adds a reference to a buffer chain.
+ */
+void pbuf_ref(pbuf_t *p);
+/***************************************************************************//**
+ * Drops a reference to a buffer chain. Buffers whose count reaches zero go back
+ * to their pool; a buffer still referenced keeps the rest of the chain.
+ * Accepts NULL.
+ */
+void pbuf_free(pbuf_t *p);
+/***************************************************************************//**
+ * Moves the start of the payload of the first buffer. A positive delta
+ * prepends delta bytes taken from the headroom, a negative one hides a header.
+ * 
+ * @return  0 on success
+ *          -1 if there is not enough headroom or payload, or the buffer is a
+ *          reference and delta is positive
+ */
+int pbuf_header(pbuf_t *p, int16_t delta);
+/***************************************************************************//**
+ * Appends the chain tail to the chain head. The reference held on tail by the
+ * caller is passed to head.
+ */
+void pbuf_cat(pbuf_t *head, pbuf_t *tail);
+/***************************************************************************//**
+ * Copies len bytes of the chain, starting offset bytes into it, to dst.
+ * 
+ * @return  number of bytes copied
+ */
+uint16_t pbuf_copy_out(const pbuf_t *p, void *dst, uint16_t len, uint16_t offset);
+/***************************************************************************//**
+ * Copies len bytes from src into the payload of the chain.
+ * 
+ * @return  number of bytes copied
+ */
+uint16_t pbuf_take(pbuf_t *p, const void *src, uint16_t len);
+/***************************************************************************//**
+ * Returns the counters of a pool.
+ */
+const pbuf_stats_t *pbuf_get_stats(pbuf_pool_t pool);
+
+#endif /* PBUF_H_ */
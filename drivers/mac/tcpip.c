@@ -6,14 +6,23 @@
 #include "../port_config/cpu_types.h"
 #include "nettype.h"
 #include "../mss_ethernet_mac/mss_ethernet_mac.h"
-#include "../mss_ethernet_mac/mss_ethernet_mac_regs.h"
+#include "netif.h"
+#include "pbuf.h"
+#include "dhcp.h"
+#include "arp.h"
+#include "udp.h"
+#include "net_timer.h"
+#include "httpd.h"
+#include "ip_reass.h"
+#include "igmp.h"
+#include "icmp.h"
 #include "tcpip.h"
+#include "../fast_mem/fast_mem.h"
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
 #define OK  0
 #define ERR 1
-#define MAC_BASE_ADDRESS            0x40003000
 
 
 extern char ethAddr[6];
@@ -33,8 +42,59 @@ unsigned int num_pkt_tx = 0,num_pkt_rx = 0;
 #define TCP_START_SEQ     0x10203040
 static const unsigned char g_client_ip[IP_ADDR_LEN] = { 192, 168, 1, 10 };
 unsigned char oled_string[20];
-tcp_control_block_t tcb;
-MAC_instance_t g_mac;
+/* Connections. tcb points to the one being processed, build_tcp_frame() and
+   the send_tcp_*() functions work on it. A free entry is all zeros, in the
+   LISTEN state. */
+tcp_control_block_t tcb_table[NET_TCP_CONNECTIONS];
+tcp_control_block_t *tcb = &tcb_table[0];
+static net_timer_t tcp_timer[NET_TCP_CONNECTIONS];
+
+#define TCP_CONN(t)         ((unsigned char)((t) - tcb_table))
+#define TCP_SEQ_LT(a, b)    ((int)((a) - (b)) < 0)
+#define TCP_SEQ_LEQ(a, b)   ((int)((a) - (b)) <= 0)
+#define TCP_DEFAULT_MSS     536
+#define TCP_RX_WINDOW       0x0800      /* advertised by build_tcp_frame() */
+#define TCP_MAX_MSS         (1500 - sizeof(ip_hdr_t) - sizeof(tcp_hdr_t))
+#define TCP_MSS_OPT_LEN     4           /* sent in our SYN */
+
+/* Headers of TCP segments sent with send_tcp_data(). Each slot stays busy
+   until the MAC has sent the frame since the payload is not copied. */
+#define TCP_TX_HDR_SLOTS    2
+#define TCP_TX_HDR_LEN      (sizeof(ether_hdr_t) + sizeof(ip_hdr_t) + sizeof(tcp_hdr_t))
+#define UDP_TX_HDR_LEN      (sizeof(ether_hdr_t) + sizeof(ip_hdr_t) + sizeof(udp_hdr_t))
+typedef struct tcp_tx_hdr {
+    unsigned char frame[TCP_TX_HDR_LEN];
+    volatile unsigned char busy;
+    MSS_MAC_tx_complete_t complete;
+    void *context;
+} tcp_tx_hdr_t;
+static tcp_tx_hdr_t tcp_tx_hdr[TCP_TX_HDR_SLOTS];
+
+/* Frame being processed by tcpip_input(), lets the UDP layer queue it to a
+   socket without copying */
+static pbuf_t *tcpip_rx_pbuf;
+
+/* Set while httpd_recv() runs: a response it sends goes out at the end of
+   process_tcp_packet(), acknowledging only the data httpd_recv() took */
+static unsigned char tcp_output_held;
+
+static unsigned int checksum_pbuf(const pbuf_t *p);
+static unsigned short int build_tcp_frame(unsigned char *frame, unsigned char control_bits,
+                                          unsigned int data_sum, unsigned short int buflen);
+static void tcp_tx_done(void *context);
+static void tcp_output(void);
+static void tcp_set_timer(unsigned char restart);
+static void tcp_timeout(void *arg);
+static void tcp_release(void);
+static void tcp_check_sent(void);
+static void tcp_send_reset(unsigned char *buf, unsigned short int dlen);
+static unsigned short int tcp_parse_mss(const unsigned char *opt, unsigned short int len);
+static void tcp_pmtu_update(const unsigned char *icmp, unsigned short int len);
+
+#define tcp_busy()          ((tcb->tx_hdr_size + tcb->tx_block_size) != 0)
+#define tcp_get16(p)        ((unsigned short int)(((p)[0] << 8) | (p)[1]))
+#define tcp_get32(p)        (((unsigned int)(p)[0] << 24) | ((unsigned int)(p)[1] << 16) | \
+                             ((unsigned int)(p)[2] << 8) | (unsigned int)(p)[3])
 
 
 /***************************************************************************//**
@@ -47,13 +107,13 @@ unsigned char send_arp_reply(unsigned char *buf)
     arp_pkt_xp arp_pkt = (arp_pkt_xp )(buf + sizeof(ether_hdr_t));
     eth_hdr_xp eth_hdr = (eth_hdr_xp ) buf;
 
-    memcpy(eth_hdr->da, eth_hdr->sa, ETH_ADDR_LEN);
-    memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
+    fast_memcpy(eth_hdr->da, eth_hdr->sa, ETH_ADDR_LEN);
+    fast_memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
     arp_pkt->opcode[1] = ARP_OPCODE_REPLY_1;
-    memcpy(arp_pkt->mac_ta, arp_pkt->mac_sa, ETH_ADDR_LEN);
-    memcpy(arp_pkt->ip_ta, arp_pkt->ip_sa, IP_ADDR_LEN);
-    memcpy(arp_pkt->mac_sa, my_mac, ETH_ADDR_LEN);
-    memcpy(arp_pkt->ip_sa, my_ip, IP_ADDR_LEN);
+    fast_memcpy(arp_pkt->mac_ta, arp_pkt->mac_sa, ETH_ADDR_LEN);
+    fast_memcpy(arp_pkt->ip_ta, arp_pkt->ip_sa, IP_ADDR_LEN);
+    fast_memcpy(arp_pkt->mac_sa, my_mac, ETH_ADDR_LEN);
+    fast_memcpy(arp_pkt->ip_sa, my_ip, IP_ADDR_LEN);
     num_pkt_tx++;
     MSS_MAC_tx_packet(buf,42, MSS_MAC_BLOCKING);
     return OK;
@@ -65,8 +125,8 @@ void send_gratuitous_arp(unsigned char *buf)
 {
     arp_pkt_xp arp_pkt = (arp_pkt_xp )(buf + sizeof(ether_hdr_t));
     eth_hdr_xp eth_hdr = (eth_hdr_xp ) buf;
-    memset(eth_hdr->da, 0xFF, ETH_ADDR_LEN); /* broadcast */
-    memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
+    fast_memset(eth_hdr->da, 0xFF, ETH_ADDR_LEN); /* broadcast */
+    fast_memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
     eth_hdr->type_code[0] = ETH_TYPE_0;
     eth_hdr->type_code[1] = ETH_TYPE_ARP_1;
     arp_pkt->hw_type[0] = ARP_HW_TYPE_0;
@@ -77,10 +137,10 @@ void send_gratuitous_arp(unsigned char *buf)
     arp_pkt->proto_addr_len = IP_ADDR_LEN;
     arp_pkt->opcode[0] = ARP_OPCODE_0;
     arp_pkt->opcode[1] = ARP_OPCODE_REQ_1;
-    memcpy(arp_pkt->mac_sa, my_mac, ETH_ADDR_LEN);
-    memcpy(arp_pkt->ip_sa, my_ip, IP_ADDR_LEN);
-    memset(arp_pkt->mac_ta, 0x00, ETH_ADDR_LEN);
-    memcpy(arp_pkt->ip_ta, my_ip, IP_ADDR_LEN);
+    fast_memcpy(arp_pkt->mac_sa, my_mac, ETH_ADDR_LEN);
+    fast_memcpy(arp_pkt->ip_sa, my_ip, IP_ADDR_LEN);
+    fast_memset(arp_pkt->mac_ta, 0x00, ETH_ADDR_LEN);
+    fast_memcpy(arp_pkt->ip_ta, my_ip, IP_ADDR_LEN);
     //mac_tx_send(buf,42,0);
     num_pkt_tx++;
     MSS_MAC_tx_packet(buf,42, MSS_MAC_BLOCKING);
@@ -145,31 +205,6 @@ unsigned char check_checksum(unsigned char *buf, unsigned short int len, unsigne
     return OK;
     }
 }
-/***************************************************************************//**
- *  See tcpip.h for more information.
- */
-unsigned char send_icmp_echo_reply(unsigned char *buf)
-{
-    eth_hdr_xp eth_hdr = (eth_hdr_xp ) buf;
-    ip_hdr_xp ip_hdr = (ip_hdr_xp ) (buf + sizeof (ether_hdr_t));
-    icmp_hdr_xp icmp_hdr = (icmp_hdr_xp ) 
-    (buf + sizeof (ether_hdr_t) + sizeof(ip_hdr_t));
-    unsigned short int elen = ((unsigned short int)ip_hdr->tlen[0] << 8) + (unsigned short int)ip_hdr->tlen[1] - sizeof(ip_hdr_t);
-    memcpy(eth_hdr->da, eth_hdr->sa, ETH_ADDR_LEN);
-    memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
-    memcpy(ip_hdr->da, ip_hdr->sa, IP_ADDR_LEN);
-    memcpy(ip_hdr->sa, my_ip, IP_ADDR_LEN);
-    ip_hdr->ttl--;
-    fix_checksum((unsigned char *)ip_hdr, (unsigned short int) 20, (unsigned short int) 10);
-    icmp_hdr->type = ICMP_TYPE_ECHO_REPLY;
-    if (elen & 1) {
-    ((unsigned char *)icmp_hdr)[elen] = 0;
-    }
-    fix_checksum((unsigned char *)icmp_hdr, (unsigned short int) elen, (unsigned short int) 2);
-    num_pkt_tx++;
-    MSS_MAC_tx_packet(buf,elen + sizeof(ether_hdr_t) + sizeof(ip_hdr_t), MSS_MAC_BLOCKING);
-    return OK;
-}
 /***************************************************************************//**
  *  See tcpip.h for more information.
  */
@@ -185,91 +220,6 @@ void dtoa_reverse(unsigned short int n, unsigned char *buf)
     n = n / 10;
     }
 }
-/***************************************************************************//**
- *  See tcpip.h for more information.
- */
-void send_bootp_packet (unsigned char *buf)
-{
-                  /* output packet */
-    eth_hdr_xp eth_hdr = (eth_hdr_xp ) tcp_packet;
-    ip_hdr_xp ip_hdr = (ip_hdr_xp ) (tcp_packet + sizeof(ether_hdr_t));
-    udp_hdr_xp udp_hdr = (udp_hdr_xp ) (tcp_packet + sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
-    bootp_pkt_xp bootp_pkt = (bootp_pkt_xp )((unsigned char *)udp_hdr + sizeof(udp_hdr_t));
-    unsigned char *opts = bootp_pkt->vend;
-                /* input packet */
-   // eth_hdr_xp ieth_hdr = (eth_hdr_xp ) buf;
-   // ip_hdr_xp iip_hdr = (ip_hdr_xp ) (buf + sizeof(ether_hdr_t));
-    udp_hdr_xp iudp_hdr = (udp_hdr_xp ) (buf + sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
-    bootp_pkt_xp ibootp_pkt = (bootp_pkt_xp )((unsigned char *)iudp_hdr + sizeof(udp_hdr_t));
-    unsigned short int plen;
-    /* Set up Bootp */
-    memset(bootp_pkt, 0, sizeof(bootp_pkt_t));
-    bootp_pkt->op = BOOTP_OP_REQUEST;
-    bootp_pkt->hwtype = BOOTP_HWTYPE_ETH;
-    bootp_pkt->hlen = ETH_ADDR_LEN;
-    bootp_pkt->secs[1] = 0x64;
-    memcpy(bootp_pkt->chaddr, my_mac, ETH_ADDR_LEN);
-    bootp_pkt->flags[0] = 0x80;    /* ask for a broadcast */
-    if (buf) {
-        if (memcmp(my_mac, ibootp_pkt->chaddr, ETH_ADDR_LEN)) /* not for me ignore */
-            return;
-        memcpy(my_ip, ibootp_pkt->yiaddr, IP_ADDR_LEN);
-        ip_known = 1;
-        dhcp_ip_found = 1;
-        memcpy(bootp_pkt->ciaddr, ibootp_pkt->yiaddr, IP_ADDR_LEN);
-        memcpy(bootp_pkt->xid, ibootp_pkt->xid, BOOTP_XID_LEN);
-    } else {
-        bootp_pkt->xid[0] = 0x90;
-    }
-    *opts++ = 99;        /* magic number */
-    *opts++ = 130;
-    *opts++ = 83;
-    *opts++ = 99;
-    *opts++ = BOOTP_OPTCODE_DHCP_TYPE;
-    *opts++ = 1;
-    if (buf) {
-        *opts++ = DHCP_TYPE_REQUEST;
-        *opts++ = BOOTP_OPTCODE_DHCP_SID;
-        *opts++ = 4;
-        *opts++ = ibootp_pkt->siaddr[0];
-        *opts++ = ibootp_pkt->siaddr[1];
-        *opts++ = ibootp_pkt->siaddr[2];
-        *opts++ = ibootp_pkt->siaddr[3];
-    } else {
-        *opts++ = DHCP_TYPE_DISCOVER;
-    }
-    *opts++ = BOOTP_OPTCODE_END;
-
-    /* Set up Udp */
-    memset(udp_hdr, 0, sizeof(udp_hdr_t));
-    udp_hdr->sp[1] = BOOTP_CLIENT_PORT;
-    udp_hdr->dp[1] = BOOTP_SERVER_PORT;
-    plen = sizeof(udp_hdr_t) + sizeof(bootp_pkt_t);
-    udp_hdr->len[0] = plen >> 8;
-    udp_hdr->len[1] = (unsigned char) plen;
-    /* leave csum 0 */
-
-    /* Set up IP */
-    memset(ip_hdr, 0, sizeof(ip_hdr_t));
-    ip_hdr->ver_hlen = 0x45;     /* IPv4 with 20 byte header */
-    plen += sizeof(ip_hdr_t);
-    ip_hdr->tlen[0] = plen >> 8;
-    ip_hdr->tlen[1] = (unsigned char) plen;
-    ip_hdr->id[0] = ip_id >> 8;
-    ip_hdr->id[1] = (unsigned char) ip_id;
-    ip_id++;
-    ip_hdr->ttl = 32;         /* max 32 hops */
-    ip_hdr->proto = UDP_PROTO;    
-    memset(ip_hdr->da, 0xFF, IP_ADDR_LEN);
-    fix_checksum((unsigned char *)ip_hdr, sizeof(ip_hdr_t), 10);
-    /* Set up Ethernet */
-    eth_hdr->type_code[0] = ETH_TYPE_0;
-    eth_hdr->type_code[1] = ETH_TYPE_IP_1;
-    memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
-    memset(eth_hdr->da, 0xFF, ETH_ADDR_LEN); /* broadcast */
-    num_pkt_tx++;
-    MSS_MAC_tx_packet(tcp_packet,plen + sizeof(ether_hdr_t), MSS_MAC_BLOCKING);
-}
 /***************************************************************************//**
  *  See tcpip.h for more information.
  */
@@ -293,17 +243,17 @@ void send_dhcp_server_packet (unsigned char *buf)
     unsigned short int plen;
 
     /* Set up Bootp */
-    memset(bootp_pkt, 0, sizeof(bootp_pkt_t));
+    fast_memset(bootp_pkt, 0, sizeof(bootp_pkt_t));
     bootp_pkt->op = BOOTP_OP_REPLY;
     bootp_pkt->hwtype = BOOTP_HWTYPE_ETH;
     bootp_pkt->hlen = ETH_ADDR_LEN;
     bootp_pkt->secs[1] = 0x64;
-    memcpy(bootp_pkt->chaddr, ieth_hdr->sa, ETH_ADDR_LEN);
+    fast_memcpy(bootp_pkt->chaddr, ieth_hdr->sa, ETH_ADDR_LEN);
     bootp_pkt->flags[0] = 0x00;
     if (buf) {
-        memcpy(bootp_pkt->ciaddr, ibootp_pkt->yiaddr, IP_ADDR_LEN);
-        memcpy(bootp_pkt->yiaddr, g_client_ip, IP_ADDR_LEN);
-        memcpy(bootp_pkt->xid, ibootp_pkt->xid, BOOTP_XID_LEN);
+        fast_memcpy(bootp_pkt->ciaddr, ibootp_pkt->yiaddr, IP_ADDR_LEN);
+        fast_memcpy(bootp_pkt->yiaddr, g_client_ip, IP_ADDR_LEN);
+        fast_memcpy(bootp_pkt->xid, ibootp_pkt->xid, BOOTP_XID_LEN);
     } else {
         bootp_pkt->xid[0] = 0x90;
     }
@@ -374,7 +324,7 @@ void send_dhcp_server_packet (unsigned char *buf)
     *opts++ = BOOTP_OPTCODE_END;
 
     /* Set up Udp */
-    memset(udp_hdr, 0, sizeof(udp_hdr_t));
+    fast_memset(udp_hdr, 0, sizeof(udp_hdr_t));
     udp_hdr->sp[1] = BOOTP_SERVER_PORT;
     udp_hdr->dp[1] = BOOTP_CLIENT_PORT;
     plen = sizeof(udp_hdr_t) + sizeof(bootp_pkt_t);
@@ -383,7 +333,7 @@ void send_dhcp_server_packet (unsigned char *buf)
     /* leave csum 0 */
 
     /* Set up IP */
-    memset(ip_hdr, 0, sizeof(ip_hdr_t));
+    fast_memset(ip_hdr, 0, sizeof(ip_hdr_t));
     ip_hdr->ver_hlen = 0x45;     /* IPv4 with 20 byte header */
     plen += sizeof(ip_hdr_t);
     ip_hdr->tlen[0] = plen >> 8;
@@ -393,15 +343,15 @@ void send_dhcp_server_packet (unsigned char *buf)
     ip_id++;
     ip_hdr->ttl = 255;
     ip_hdr->proto = UDP_PROTO;
-    memcpy(ip_hdr->sa, my_ip, IP_ADDR_LEN);
-    memset(ip_hdr->da, 0xFF, IP_ADDR_LEN);
+    fast_memcpy(ip_hdr->sa, my_ip, IP_ADDR_LEN);
+    fast_memset(ip_hdr->da, 0xFF, IP_ADDR_LEN);
     fix_checksum((unsigned char *)ip_hdr, sizeof(ip_hdr_t), 10);
     
     /* Set up Ethernet */
     eth_hdr->type_code[0] = ETH_TYPE_0;
     eth_hdr->type_code[1] = ETH_TYPE_IP_1;
-    memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);    
-    memset(eth_hdr->da, 0xFF, ETH_ADDR_LEN); /* broadcast */
+    fast_memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);    
+    fast_memset(eth_hdr->da, 0xFF, ETH_ADDR_LEN); /* broadcast */
     num_pkt_tx++;
     MSS_MAC_tx_packet(tcp_packet,plen + sizeof(ether_hdr_t), MSS_MAC_BLOCKING);
 }
@@ -412,16 +362,92 @@ unsigned char process_udp_packet (unsigned char *buf)
 {
     
     udp_hdr_xp udp_hdr = (udp_hdr_xp ) (buf + sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
-    
-    if (udp_hdr->dp[1] != BOOTP_CLIENT_PORT) {
-        send_dhcp_server_packet( buf );
-        return OK;
+
+    if (udp_hdr->dp[0] == 0) {
+#if NET_DHCP_CLIENT
+        if (udp_hdr->dp[1] == BOOTP_CLIENT_PORT) {
+            dhcp_input(buf);
+            return OK;
+        }
+#endif
+#if NET_DHCP_SERVER
+        if (udp_hdr->dp[1] == BOOTP_SERVER_PORT) {
+            send_dhcp_server_packet( buf );
+            return OK;
+        }
+#endif
+    }
+    /* Everything else goes to the socket bound to the port, see udp.h */
+    return udp_input(tcpip_rx_pbuf, buf);
+}
+/***************************************************************************//**
+ *  See tcpip.h for more information.
+ */
+unsigned char send_udp_pbuf (const unsigned char *src_ip, const unsigned char *dst_mac,
+                             const unsigned char *dst_ip, unsigned short int src_port,
+                             unsigned short int dst_port, pbuf_t *p)
+{
+    eth_hdr_xp eth_hdr;
+    ip_hdr_xp ip_hdr;
+    udp_hdr_xp udp_hdr;
+    unsigned short int ulen = p->tot_len + sizeof(udp_hdr_t);
+    unsigned short int plen = ulen + sizeof(ip_hdr_t);
+    unsigned int sum = checksum_pbuf(p);
+
+    /* The headers go in the headroom of the first buffer */
+    if (pbuf_header(p, (int16_t)UDP_TX_HDR_LEN) != 0) {
+    pbuf_free(p);
+    return ERR;
+    }
+    eth_hdr = (eth_hdr_xp ) p->payload;
+    ip_hdr = (ip_hdr_xp ) (p->payload + sizeof(ether_hdr_t));
+    udp_hdr = (udp_hdr_xp ) (p->payload + sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
+
+    /* Set up IP. Application tasks send too, so the id is taken atomically */
+    fast_memset(ip_hdr, 0, sizeof(ip_hdr_t));
+    ip_hdr->ver_hlen = 0x45;     /* IPv4 with 20 byte header */
+    ip_hdr->tlen[0] = plen >> 8;
+    ip_hdr->tlen[1] = (unsigned char) plen;
+    portENTER_CRITICAL();
+    ip_hdr->id[0] = ip_id >> 8;
+    ip_hdr->id[1] = (unsigned char) ip_id;
+    ip_id++;
+    portEXIT_CRITICAL();
+    ip_hdr->ttl = 64;
+    ip_hdr->proto = UDP_PROTO;
+    fast_memcpy(ip_hdr->sa, src_ip ? src_ip : my_ip, IP_ADDR_LEN);
+    fast_memcpy(ip_hdr->da, dst_ip, IP_ADDR_LEN);
+    fix_checksum((unsigned char *)ip_hdr, sizeof(ip_hdr_t), 10);
+
+    /* Set up Udp, the checksum covers a pseudo header made of the addresses,
+       the protocol and the length */
+    udp_hdr->sp[0] = src_port >> 8;
+    udp_hdr->sp[1] = (unsigned char) src_port;
+    udp_hdr->dp[0] = dst_port >> 8;
+    udp_hdr->dp[1] = (unsigned char) dst_port;
+    udp_hdr->len[0] = ulen >> 8;
+    udp_hdr->len[1] = (unsigned char) ulen;
+    udp_hdr->csum[0] = 0;
+    udp_hdr->csum[1] = 0;
+    sum = checksum_add(ip_hdr->sa, 2 * IP_ADDR_LEN, sum);
+    sum += UDP_PROTO + ulen;
+    sum = checksum_add((unsigned char *)udp_hdr, sizeof(udp_hdr_t), sum);
+    sum = ~sum & 0xffff;
+    if (sum == 0) {
+    sum = 0xffff;            /* 0 means no checksum */
     }
-    if (ip_known) {
+    udp_hdr->csum[0] = (unsigned char)(sum >> 8);
+    udp_hdr->csum[1] = (unsigned char)sum;
+
+    /* Set up Ethernet */
+    eth_hdr->type_code[0] = ETH_TYPE_0;
+    eth_hdr->type_code[1] = ETH_TYPE_IP_1;
+    fast_memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
+    fast_memcpy(eth_hdr->da, dst_mac, ETH_ADDR_LEN);
+    num_pkt_tx++;
+    if (netif_output_pbuf(p, 0) != pdPASS) {
     return ERR;
     }
-                /* some more error checking here? */
-    send_bootp_packet(buf);
     return OK;
 }
 /***************************************************************************//**
@@ -430,80 +456,240 @@ unsigned char process_udp_packet (unsigned char *buf)
 
 void send_tcp_packet (unsigned char control_bits,unsigned short int buflen) 
 {
-   
-    eth_hdr_xp eth_hdr = (eth_hdr_xp ) tcp_packet;
-    ip_hdr_xp  ip_hdr = (ip_hdr_xp ) (tcp_packet + sizeof(ether_hdr_t));
+    unsigned char *tcp_data = tcp_packet + TCP_TX_HDR_LEN;
+    unsigned short int plen;
+
+    plen = build_tcp_frame(tcp_packet, control_bits, checksum_add(tcp_data, buflen, 0), buflen);
+    num_pkt_tx++;    
+    MSS_MAC_tx_packet(tcp_packet,plen + sizeof(ether_hdr_t), MSS_MAC_BLOCKING);
+}
+/***************************************************************************//**
+ *  See tcpip.h for more information.
+ */
+unsigned char send_tcp_data (unsigned char control_bits, const unsigned char *data,
+                             unsigned short int len, MSS_MAC_tx_complete_t complete,
+                             void *context)
+{
+    mss_mac_tx_segment_t segments[2];
+    tcp_tx_hdr_t *slot = 0;
+    unsigned char i;
+
+    /* Wait for a header slot, they are released as the MAC sends frames */
+    while (slot == 0) {
+    for (i = 0; (i < TCP_TX_HDR_SLOTS) && (slot == 0); i++) {
+        if (!tcp_tx_hdr[i].busy) {
+        slot = &tcp_tx_hdr[i];
+        }
+    }
+    if (slot == 0) {
+        MSS_MAC_tx_reclaim();
+    }
+    }
+    slot->busy = 1;
+    slot->complete = complete;
+    slot->context = context;
+
+    build_tcp_frame(slot->frame, control_bits, checksum_add(data, len, 0), len);
+    segments[0].data = slot->frame;
+    segments[0].length = TCP_TX_HDR_LEN;
+    segments[1].data = data;
+    segments[1].length = len;
+    num_pkt_tx++;
+    if (MSS_MAC_tx_packet_sg(segments, len ? 2 : 1, tcp_tx_done, slot, MSS_MAC_BLOCKING) == 0) {
+    slot->busy = 0;
+    return ERR;
+    }
+    return OK;
+}
+/***************************************************************************//**
+ *  See tcpip.h for more information.
+ */
+unsigned char send_tcp_pbuf (unsigned char control_bits, pbuf_t *p)
+{
+    unsigned short int buflen = p->tot_len;
+    unsigned int sum = checksum_pbuf(p);
+
+    /* The headers go in the headroom of the first buffer */
+    if (pbuf_header(p, (int16_t)TCP_TX_HDR_LEN) != 0) {
+    pbuf_free(p);
+    return ERR;
+    }
+    build_tcp_frame(p->payload, control_bits, sum, buflen);
+    num_pkt_tx++;
+    if (netif_output_pbuf(p, 0) != pdPASS) {
+    return ERR;
+    }
+    return OK;
+}
+/***************************************************************************//**
+ *  See tcpip.h for more information.
+ */
+unsigned char tcpip_input (pbuf_t *p)
+{
+    unsigned char ret;
+
+    tcpip_rx_pbuf = p;
+    ret = process_packet(p->payload);
+    tcpip_rx_pbuf = 0;
+    pbuf_free(p);
+    return ret;
+}
+/***************************************************************************//**
+ * Releases the header slot of a frame sent by send_tcp_data() and notifies
+ * the owner of the payload.
+ */
+static void tcp_tx_done(void *context)
+{
+    tcp_tx_hdr_t *slot = (tcp_tx_hdr_t *)context;
+    MSS_MAC_tx_complete_t complete = slot->complete;
+
+    slot->busy = 0;
+    if (complete) {
+    complete(slot->context);
+    }
+}
+/***************************************************************************//**
+ *  See tcpip.h for more information.
+ */
+unsigned int checksum_add(const unsigned char *buf, unsigned short int len, unsigned int sum)
+{
+    unsigned short int i;
+
+    for (i = 0; (i + 1) < len; i += 2) {
+    sum += (unsigned int)((buf[i] << 8) | buf[i+1]);
+    }
+    if (len & 1) {
+    sum += (unsigned int)(buf[len-1] << 8);
+    }
+    while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return sum;
+}
+/***************************************************************************//**
+ * One's complement sum of a buffer chain, as checksum_add() would return it
+ * for the same bytes in a single buffer. A buffer starting at an odd offset
+ * of the chain contributes its sum byte swapped.
+ */
+static unsigned int checksum_pbuf(const pbuf_t *p)
+{
+    unsigned int sum = 0;
+    unsigned int part;
+    unsigned char odd = 0;
+
+    for (; p != 0; p = p->next) {
+    part = checksum_add(p->payload, p->len, 0);
+    if (odd) {
+        part = ((part & 0xff) << 8) | (part >> 8);
+    }
+    sum += part;
+    odd ^= (unsigned char)(p->len & 1);
+    }
+    while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return sum;
+}
+/***************************************************************************//**
+ * Builds the Ethernet, IP and TCP headers of a segment at the start of frame.
+ * The payload does not need to follow the headers in memory, only its one's
+ * complement sum is needed for the TCP checksum.
+ *
+ * @return  IP datagram length.
+ */
+static unsigned short int build_tcp_frame(unsigned char *frame, unsigned char control_bits,
+                                          unsigned int data_sum, unsigned short int buflen)
+{
+    eth_hdr_xp eth_hdr = (eth_hdr_xp ) frame;
+    ip_hdr_xp  ip_hdr = (ip_hdr_xp ) (frame + sizeof(ether_hdr_t));
     tcp_hdr_xp  tcp_hdr = (tcp_hdr_xp ) 
-    (tcp_packet + sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
+    (frame + sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
     tcp_pseudo_hdr_xp  tcp_pseudo_hdr = (tcp_pseudo_hdr_xp )
     (((unsigned char *)tcp_hdr) - sizeof(tcp_pseudo_hdr_t));
-    unsigned char *tcp_data = tcp_packet + sizeof(ether_hdr_t) + sizeof(ip_hdr_t) + sizeof (tcp_hdr_t);
-    unsigned char *seqp = (unsigned char *)(&tcb.local_seq);
+    unsigned char *seqp = (unsigned char *)(&tcb->local_seq);
+    unsigned short int hlen = sizeof(tcp_hdr_t);
     unsigned short int plen;
-    memset(tcp_hdr, 0, sizeof(tcp_hdr_t));
-    memcpy(tcp_hdr->sp, tcb.local_port, TCP_PORT_LEN);
-    memcpy(tcp_hdr->dp, tcb.remote_port, TCP_PORT_LEN);
+    unsigned int sum;
+    fast_memset(tcp_hdr, 0, sizeof(tcp_hdr_t));
+    fast_memcpy(tcp_hdr->sp, tcb->local_port, TCP_PORT_LEN);
+    fast_memcpy(tcp_hdr->dp, tcb->remote_port, TCP_PORT_LEN);
     tcp_hdr->seqnum[0] = seqp[3];
     tcp_hdr->seqnum[1] = seqp[2];
     tcp_hdr->seqnum[2] = seqp[1];
     tcp_hdr->seqnum[3] = seqp[0];
-    tcb.local_seq++;
-    if (buflen) {
-    tcb.local_seq += buflen - 1;
+    /* SYN and FIN take one sequence number, pure acknowledgements none */
+    tcb->local_seq += buflen;
+    if (control_bits & (TCP_CNTRL_SYN | TCP_CNTRL_FIN)) {
+    tcb->local_seq++;
     }
     if (control_bits & TCP_CNTRL_ACK) {
-    seqp = (unsigned char *)(&tcb.remote_seq);
+    seqp = (unsigned char *)(&tcb->remote_seq);
     tcp_hdr->acknum[3] = seqp[0];
     tcp_hdr->acknum[2] = seqp[1];
     tcp_hdr->acknum[1] = seqp[2];
     tcp_hdr->acknum[0] = seqp[3];
     }
-    tcp_hdr->data_off = 0x50;    /* always 5 32 bit words for us */
+    tcp_hdr->data_off = 0x50;    /* 5 32 bit words, plus the MSS option in a SYN */
+    if (control_bits & TCP_CNTRL_SYN) {
+    /* SYNs carry no data, the option goes where it would be */
+    seqp = (unsigned char *)tcp_hdr + sizeof(tcp_hdr_t);
+    seqp[0] = 2;
+    seqp[1] = TCP_MSS_OPT_LEN;
+    seqp[2] = (unsigned char)(TCP_MAX_MSS >> 8);
+    seqp[3] = (unsigned char)TCP_MAX_MSS;
+    hlen += TCP_MSS_OPT_LEN;
+    tcp_hdr->data_off = 0x60;
+    }
     tcp_hdr->urg_ack_psh_rst_syn_fin = control_bits;
     tcp_hdr->wsize[0] = 0x08;     /* this is 0x0800, which is 2K */
-    if (buflen & 1) {
-    tcp_data[buflen] = 0;
-    }
-    /* memset(tcp_pseudo_hdr, 0, sizeof(tcp_pseudo_hdr_t)); */
-    memcpy(tcp_pseudo_hdr->sa, my_ip, IP_ADDR_LEN);
-    memcpy(tcp_pseudo_hdr->da, tcb.remote_addr, IP_ADDR_LEN);
+    /* fast_memset(tcp_pseudo_hdr, 0, sizeof(tcp_pseudo_hdr_t)); */
+    fast_memcpy(tcp_pseudo_hdr->sa, my_ip, IP_ADDR_LEN);
+    fast_memcpy(tcp_pseudo_hdr->da, tcb->remote_addr, IP_ADDR_LEN);
     tcp_pseudo_hdr->zero = 0;
     tcp_pseudo_hdr->proto = TCP_PROTO;
-    plen = buflen + sizeof(tcp_hdr_t);
+    plen = buflen + hlen;
     tcp_pseudo_hdr->plen[0] = plen >> 8;
     tcp_pseudo_hdr->plen[1] = (unsigned char)plen;
-    fix_checksum((unsigned char *)tcp_pseudo_hdr, 
-         (unsigned short int)(plen + sizeof(tcp_pseudo_hdr_t)), (unsigned short int)28);
+    /* checksum field is still zero from the memset above */
+    sum = ~checksum_add((unsigned char *)tcp_pseudo_hdr,
+         (unsigned short int)(sizeof(tcp_pseudo_hdr_t) + hlen), data_sum);
+    tcp_hdr->csum[0] = (unsigned char)(sum >> 8);
+    tcp_hdr->csum[1] = (unsigned char)sum;
 
-    memset(ip_hdr, 0, sizeof(ip_hdr_t));
+    fast_memset(ip_hdr, 0, sizeof(ip_hdr_t));
 
     ip_hdr->ver_hlen = 0x45;     /* IPv4 with 20 byte header */
     plen += sizeof(ip_hdr_t);    /* add the size of the IP Header */
     ip_hdr->tlen[0] = plen >> 8;
     ip_hdr->tlen[1] = (unsigned char) plen;
+    portENTER_CRITICAL();
     ip_hdr->id[0] = ip_id >> 8;
     ip_hdr->id[1] = (unsigned char) ip_id;
     ip_id++;
+    portEXIT_CRITICAL();
+    /* Routers report a smaller MTU instead of fragmenting, see tcp_pmtu_update() */
+    if (!(tcb->flags & TCP_FLAG_NO_DF)) {
+    ip_hdr->frag_off[0] = (unsigned char)(IP_FRAG_DF >> 8);
+    }
     ip_hdr->ttl = 32;         /* max 32 hops */
     ip_hdr->proto = TCP_PROTO;
-    memcpy(ip_hdr->sa, my_ip, IP_ADDR_LEN);
-    memcpy(ip_hdr->da, tcb.remote_addr, IP_ADDR_LEN);
+    fast_memcpy(ip_hdr->sa, my_ip, IP_ADDR_LEN);
+    fast_memcpy(ip_hdr->da, tcb->remote_addr, IP_ADDR_LEN);
     fix_checksum((unsigned char *)ip_hdr, sizeof(ip_hdr_t), 10);
     /* Fix the Ethernet Header */
     eth_hdr->type_code[0] = ETH_TYPE_0;
     eth_hdr->type_code[1] = ETH_TYPE_IP_1;
-    memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
-    memcpy(eth_hdr->da, tcb.remote_mac, ETH_ADDR_LEN); /* should be table lookup */
-    num_pkt_tx++;    
-    MSS_MAC_tx_packet(tcp_packet,plen + sizeof(ether_hdr_t), MSS_MAC_BLOCKING);
+    fast_memcpy(eth_hdr->sa, my_mac, ETH_ADDR_LEN);
+    fast_memcpy(eth_hdr->da, tcb->remote_mac, ETH_ADDR_LEN); /* should be table lookup */
+    return plen;
 }
 /***************************************************************************//**
  *  See tcpip.h for more information.
  */
 unsigned char tcp_init(void)
 {
-    memset(&tcb,0,sizeof(tcp_control_block_t));
-    tcb.state = TCP_STATE_LISTEN;
+    fast_memset(tcb_table, 0, sizeof(tcb_table));
+    tcb = &tcb_table[0];
     ip_id = 0;
     ip_known = 0;
     return OK;
@@ -533,12 +719,22 @@ unsigned char process_icmp_packet(unsigned char *buf)
     icmp_hdr_xp icmp_hdr = (icmp_hdr_xp ) 
     (buf + sizeof (ether_hdr_t) + sizeof(ip_hdr_t));
     unsigned short int elen = ((unsigned short int)ip_hdr->tlen[0] << 8) + (unsigned short int)ip_hdr->tlen[1] - sizeof(ip_hdr_t);
+    if (icmp_hdr->type == ICMP_TYPE_ECHO_REQUEST) {
+    /* The reply is not fragmented, reassembled requests too big for a frame
+       go unanswered. The checksum is not verified, the reply carries it
+       over, see icmp.h */
+    if (elen > 1500 - sizeof(ip_hdr_t)) {
+        return ERR;
+    }
+    return icmp_echo_reply(tcpip_rx_pbuf, buf);
+    }
     if (check_checksum((unsigned char *)icmp_hdr, (unsigned short int) elen, (unsigned short int) 2, 'M') != OK) 
     return ERR;
-    if (icmp_hdr->type != ICMP_TYPE_ECHO_REQUEST) {
-    return ERR;
+    if ((icmp_hdr->type == ICMP_TYPE_UNREACHABLE) && (icmp_hdr->icode == ICMP_CODE_FRAG_NEEDED)) {
+    tcp_pmtu_update((unsigned char *)icmp_hdr, elen);
+    return OK;
     }
-    return send_icmp_echo_reply(buf);
+    return ERR;
 }
 
  /*  See tcpip.h for more information.
@@ -554,99 +750,438 @@ unsigned char process_tcp_packet(unsigned char *buf)
     tcp_hdr_xp tcp_hdr = (tcp_hdr_xp ) 
     (buf + sizeof (ether_hdr_t) + sizeof(ip_hdr_t));
     unsigned short int elen = ((unsigned short int)ip_hdr->tlen[0] << 8) + (unsigned short int)ip_hdr->tlen[1] - sizeof(ip_hdr_t);
-    unsigned char state;
-    if ( !memcmp(tcb.remote_addr, ip_hdr->sa, IP_ADDR_LEN)  && /* same source IP */
-     !memcmp(tcb.remote_port, tcp_hdr->sp, TCP_PORT_LEN) && /* same source port */
-     !memcmp(tcb.local_port, tcp_hdr->dp, TCP_PORT_LEN)) { /* same dest port */
-    state = tcb.state;
-    } else {            /* copy it over, a new IP wants in */
-    memcpy(tcb.remote_addr, ip_hdr->sa, IP_ADDR_LEN);
-    memcpy(tcb.remote_port, tcp_hdr->sp, TCP_PORT_LEN);
-    memcpy(tcb.local_port, tcp_hdr->dp, TCP_PORT_LEN);
-    memcpy(tcb.remote_mac, eth_hdr->sa, ETH_ADDR_LEN);
-    state = TCP_STATE_LISTEN;
-    } 
-    switch (state) {
-    case TCP_STATE_LISTEN:
-    if (tcp_hdr->urg_ack_psh_rst_syn_fin & TCP_CNTRL_SYN) {
-        /* recd SYN : new connection; send SYN+ACK */      
-                      
-        tcb.local_seq = TCP_START_SEQ;
-        tcb.remote_seq = 0;
-        tcb.remote_seq = (tcb.remote_seq | tcp_hdr->seqnum[0]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[1]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[2]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[3]);    
-        tcb.remote_seq++;
-        send_tcp_packet( TCP_CNTRL_SYN | TCP_CNTRL_ACK, 0);
-        tcb.state = TCP_STATE_SYN_RECVD;
-    } 
-    break;    
-    case TCP_STATE_SYN_RECVD:   
-    if (tcp_hdr->urg_ack_psh_rst_syn_fin & TCP_CNTRL_ACK) { 
-        /* recd ack; send nothing */
-        tcb.state = TCP_STATE_ESTABLISHED;
-    } 
-    else {  
-    tcb.state = TCP_STATE_LISTEN;
-    }   
-    break;
-    case TCP_STATE_ESTABLISHED: 
-    if (tcp_hdr->urg_ack_psh_rst_syn_fin & TCP_CNTRL_FIN) {
-        /* recd fin; send ack */
-        /* skip CLOSE_WAIT state; send fin along with ack */
-        tcb.remote_seq = 0;
-        tcb.remote_seq = (tcb.remote_seq | tcp_hdr->seqnum[0]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[1]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[2]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[3]);   
-        tcb.remote_seq++;
-        send_tcp_packet(TCP_CNTRL_ACK | TCP_CNTRL_FIN, 0);
-        tcb.state = TCP_STATE_LAST_ACK;   
-    /* Default scroll message on OLED */
-    }
-    else if (tcp_hdr->dp[0] != 0 || \
-           tcp_hdr->dp[1] != 80) { /* HTTP Port */
-        break;
-    }
-    else if (elen > sizeof(tcp_hdr_t)) { /* dont respond to empty packets*/
-        tcb.remote_seq = 0;
-        tcb.remote_seq = (tcb.remote_seq | tcp_hdr->seqnum[0]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[1]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[2]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[3]);   
-        tcb.remote_seq += (unsigned long) (elen - sizeof(tcp_hdr_t));
-        //send_http_response(((unsigned char *)(tcp_hdr)) + sizeof (tcp_hdr_t));
-        tcb.state = TCP_STATE_MY_LAST;       
-    } 
-    break;
-    case TCP_STATE_MY_LAST: 
-    if (tcp_hdr->urg_ack_psh_rst_syn_fin & TCP_CNTRL_FIN) {
-                /* sent fin, got fin, ack the fin */
-        tcb.remote_seq = 0;
-        tcb.remote_seq = (tcb.remote_seq | tcp_hdr->seqnum[0]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[1]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[2]);
-        tcb.remote_seq = ((tcb.remote_seq << 8) |tcp_hdr->seqnum[3]);   
-        tcb.remote_seq++;
+    unsigned short int hlen = (unsigned short int)((tcp_hdr->data_off >> 4) * 4);
+    unsigned char flags = tcp_hdr->urg_ack_psh_rst_syn_fin;
+    unsigned int seq = tcp_get32(tcp_hdr->seqnum);
+    unsigned int ack = tcp_get32(tcp_hdr->acknum);
+    unsigned short int dlen;
+    unsigned short int taken;
+    unsigned int sent;
+    unsigned int sum;
+    unsigned char need_ack;
+    unsigned char restart = 0;
+    unsigned char i;
+
+    if ((hlen < sizeof(tcp_hdr_t)) || (hlen > elen)) {
+        return ERR;
+    }
+    dlen = elen - hlen;
+    sum = checksum_add(ip_hdr->sa, 2 * IP_ADDR_LEN, 0);
+    sum += TCP_PROTO + elen;
+    if (checksum_add((unsigned char *)tcp_hdr, elen, sum) != 0xffff) {
+        return ERR;
+    }
+
+    for (i = 0; i < NET_TCP_CONNECTIONS; i++) {
+        tcb = &tcb_table[i];
+        if ((tcb->state != TCP_STATE_LISTEN) &&
+            !memcmp(tcb->remote_addr, ip_hdr->sa, IP_ADDR_LEN) &&   /* same source IP */
+            !memcmp(tcb->remote_port, tcp_hdr->sp, TCP_PORT_LEN) && /* same source port */
+            !memcmp(tcb->local_port, tcp_hdr->dp, TCP_PORT_LEN)) {  /* same dest port */
+            break;
+        }
+    }
+    if (i == NET_TCP_CONNECTIONS) {
+        /* Only a SYN to the HTTP port opens a connection */
+        if (flags & TCP_CNTRL_RST) {
+            return ERR;
+        }
+        if (!(flags & TCP_CNTRL_SYN) || (flags & TCP_CNTRL_ACK) ||
+            (tcp_hdr->dp[0] != (HTTPD_PORT >> 8)) || (tcp_hdr->dp[1] != (HTTPD_PORT & 0xff))) {
+            tcp_send_reset(buf, dlen);
+            return ERR;
+        }
+        for (i = 0; (i < NET_TCP_CONNECTIONS) && (tcb_table[i].state != TCP_STATE_LISTEN); i++) {
+        }
+        if (i == NET_TCP_CONNECTIONS) {
+            /* All busy, the peer will repeat its SYN */
+            return ERR;
+        }
+        tcb = &tcb_table[i];
+        fast_memcpy(tcb->remote_addr, ip_hdr->sa, IP_ADDR_LEN);
+        fast_memcpy(tcb->remote_port, tcp_hdr->sp, TCP_PORT_LEN);
+        fast_memcpy(tcb->local_port, tcp_hdr->dp, TCP_PORT_LEN);
+        fast_memcpy(tcb->remote_mac, eth_hdr->sa, ETH_ADDR_LEN);
+        /* A different initial sequence number for every connection, so that
+           segments of an old one are not taken for new ones */
+        tcb->local_seq = TCP_START_SEQ + (net_timer_now_ms() << 12);
+        tcb->snd_una = tcb->local_seq;
+        tcb->remote_seq = seq + 1;
+        tcb->snd_wnd = tcp_get16(tcp_hdr->wsize);
+        tcb->mss = tcp_parse_mss((unsigned char *)tcp_hdr + sizeof(tcp_hdr_t),
+                                 hlen - sizeof(tcp_hdr_t));
+        tcb->state = TCP_STATE_SYN_RECVD;
+        httpd_reset(TCP_CONN(tcb));
+        send_tcp_packet(TCP_CNTRL_SYN | TCP_CNTRL_ACK, 0);
+        tcp_set_timer(1);
+        return OK;
+    }
+
+    if (flags & TCP_CNTRL_RST) {
+        /* Ignore resets outside the receive window, they could be forged */
+        if ((seq - tcb->remote_seq) < TCP_RX_WINDOW) {
+            tcp_release();
+        }
+        return OK;
+    }
+    if (flags & TCP_CNTRL_SYN) {
+        if (tcb->state == TCP_STATE_SYN_RECVD) {
+            /* Our SYN+ACK was lost */
+            tcb->local_seq = tcb->snd_una;
+            send_tcp_packet(TCP_CNTRL_SYN | TCP_CNTRL_ACK, 0);
+        }
+        else {
+            send_tcp_packet(TCP_CNTRL_ACK, 0);
+        }
+        return OK;
+    }
+    if (!(flags & TCP_CNTRL_ACK)) {
+        return ERR;
+    }
+
+    /* Acknowledgement of what we sent */
+    if (TCP_SEQ_LT(tcb->snd_una, ack) && TCP_SEQ_LEQ(ack, tcb->local_seq)) {
+        tcb->snd_una = ack;
+        tcb->retries = 0;
+        restart = 1;
+        if (tcb->state == TCP_STATE_SYN_RECVD) {
+            tcb->state = TCP_STATE_ESTABLISHED;
+            tcb->tx_start_seq = ack;
+        }
+    }
+    if (tcb->state == TCP_STATE_SYN_RECVD) {
+        return ERR;
+    }
+    tcb->snd_wnd = tcp_get16(tcp_hdr->wsize);
+    if ((tcb->flags & TCP_FLAG_FIN_SENT) && (tcb->snd_una == tcb->local_seq)) {
+        if (tcb->flags & TCP_FLAG_FIN_RCVD) {
+            tcp_release();
+            return OK;
+        }
+        tcb->state = TCP_STATE_MY_LAST;
+    }
+    tcp_check_sent();
+
+    /* Data is only taken in order and while no response is being sent,
+       anything else is dropped and the peer repeats it later */
+    need_ack = (dlen > 0) || (flags & TCP_CNTRL_FIN);
+    if ((dlen > 0) && (seq == tcb->remote_seq) && (tcb->state == TCP_STATE_ESTABLISHED) &&
+        !(tcb->flags & TCP_FLAG_CLOSE) && !tcp_busy()) {
+        tcp_output_held = 1;
+        taken = httpd_recv(TCP_CONN(tcb), (unsigned char *)tcp_hdr + hlen, dlen);
+        tcp_output_held = 0;
+        tcb->remote_seq += taken;
+    }
+    if ((flags & TCP_CNTRL_FIN) && (seq + dlen == tcb->remote_seq) &&
+        !(tcb->flags & TCP_FLAG_FIN_RCVD)) {
+        /* The peer is done, close once the current response is sent */
+        tcb->remote_seq++;
+        tcb->flags |= TCP_FLAG_FIN_RCVD | TCP_FLAG_CLOSE;
+        if (tcb->state == TCP_STATE_MY_LAST) {
+            send_tcp_packet(TCP_CNTRL_ACK, 0);
+            tcp_release();
+            return OK;
+        }
+        tcb->state = TCP_STATE_LAST_ACK;
+    }
+
+    sent = tcb->local_seq;
+    tcp_output();
+    if (need_ack && (sent == tcb->local_seq)) {
         send_tcp_packet(TCP_CNTRL_ACK, 0);
-        tcb.state = TCP_STATE_CLOSED;
     }
-    break;
-    case TCP_STATE_LAST_ACK:
-   
-    if (tcp_hdr->urg_ack_psh_rst_syn_fin & TCP_CNTRL_ACK) {
-        /* recd ack; send nothing */
-        tcb.state = TCP_STATE_CLOSED;
+    tcp_set_timer(restart);
+    return OK;
+}
+/***************************************************************************//**
+ *  See tcpip.h for more information.
+ */
+unsigned char tcp_send(unsigned char conn, const unsigned char *hdr, unsigned short int hlen,
+                       const unsigned char *body, unsigned short int blen, unsigned char close)
+{
+    tcp_control_block_t *prev = tcb;
+    unsigned char ret = ERR;
+
+    tcb = &tcb_table[conn];
+    if (((tcb->state == TCP_STATE_ESTABLISHED) || (tcb->state == TCP_STATE_LAST_ACK)) &&
+        !tcp_busy() && !(tcb->flags & TCP_FLAG_FIN_SENT)) {
+        tcb->tx_hdr_addr = hdr;
+        tcb->tx_hdr_size = hlen;
+        tcb->tx_block_addr = body;
+        tcb->tx_block_size = blen;
+        tcb->tx_start_seq = tcb->local_seq;
+        if (close) {
+            tcb->flags |= TCP_FLAG_CLOSE;
+        }
+        if (!tcp_output_held) {
+            tcp_output();
+            tcp_set_timer(0);
+        }
+        ret = OK;
+    }
+    tcb = prev;
+    return ret;
+}
+/***************************************************************************//**
+ * Sends as much of the stream of the current connection as the peer window
+ * allows, then the FIN if the connection is to be closed. Each segment holds
+ * part of either the header or the body block, which are transmitted in place.
+ */
+static void tcp_output(void)
+{
+    unsigned int total = tcb->tx_hdr_size + tcb->tx_block_size;
+    unsigned int wnd = (tcb->snd_wnd < NET_TCP_TX_WINDOW) ? tcb->snd_wnd : NET_TCP_TX_WINDOW;
+    unsigned int off = tcb->local_seq - tcb->tx_start_seq;
+    unsigned int inflight;
+    unsigned int n;
+    const unsigned char *data;
+
+    if ((tcb->state != TCP_STATE_ESTABLISHED) && (tcb->state != TCP_STATE_LAST_ACK)) {
+        return;
+    }
+    while (off < total) {
+        inflight = tcb->local_seq - tcb->snd_una;
+        if (inflight >= wnd) {
+            return;
+        }
+        if (off < tcb->tx_hdr_size) {
+            data = tcb->tx_hdr_addr + off;
+            n = tcb->tx_hdr_size - off;
+        }
+        else {
+            data = tcb->tx_block_addr + (off - tcb->tx_hdr_size);
+            n = total - off;
+        }
+        if (n > tcb->mss) {
+            n = tcb->mss;
+        }
+        if (n > wnd - inflight) {
+            n = wnd - inflight;
+        }
+        /* The sequence number advances even if the MAC refused the frame,
+           the retransmission timer sends it again */
+        send_tcp_data(TCP_CNTRL_ACK | ((off + n == total) ? TCP_CNTRL_PSH : 0),
+                      data, (unsigned short int)n, 0, 0);
+        off = tcb->local_seq - tcb->tx_start_seq;
+    }
+    if ((tcb->flags & TCP_FLAG_CLOSE) && !(tcb->flags & TCP_FLAG_FIN_SENT)) {
+        send_tcp_packet(TCP_CNTRL_ACK | TCP_CNTRL_FIN, 0);
+        tcb->flags |= TCP_FLAG_FIN_SENT;
+    }
+}
+/***************************************************************************//**
+ * Ends the stream of the current connection once all of it is acknowledged
+ * and lets the server send the next response.
+ */
+static void tcp_check_sent(void)
+{
+    unsigned int total = tcb->tx_hdr_size + tcb->tx_block_size;
+
+    if ((total != 0) && TCP_SEQ_LEQ(tcb->tx_start_seq + total, tcb->snd_una)) {
+        tcb->tx_start_seq += total;
+        tcb->tx_hdr_size = 0;
+        tcb->tx_block_size = 0;
+        if (!(tcb->flags & TCP_FLAG_CLOSE)) {
+            httpd_sent(TCP_CONN(tcb));
+        }
+    }
+}
+/***************************************************************************//**
+ * Starts the retransmission timer of the current connection while something
+ * is unacknowledged, restarting it if restart is set, or the idle timer
+ * otherwise.
+ */
+static void tcp_set_timer(unsigned char restart)
+{
+    net_timer_t *t = &tcp_timer[TCP_CONN(tcb)];
+
+    if (tcb->snd_una != tcb->local_seq) {
+        if (restart || !(tcb->flags & TCP_FLAG_RTO)) {
+            tcb->flags |= TCP_FLAG_RTO;
+            net_timer_start(t, (uint32_t)NET_TCP_RTO_MS << tcb->retries, tcp_timeout, tcb);
+        }
+    }
+    else {
+        tcb->flags &= ~TCP_FLAG_RTO;
+        net_timer_start(t, (tcb->state == TCP_STATE_ESTABLISHED) ? NET_TCP_IDLE_MS : NET_TCP_FIN_WAIT_MS,
+                        tcp_timeout, tcb);
+    }
+}
+/***************************************************************************//**
+ * Timer of a connection. Retransmits from the oldest unacknowledged byte,
+ * with exponential backoff, closes idle connections and frees those whose
+ * peer does not finish closing.
+ */
+static void tcp_timeout(void *arg)
+{
+    tcb = (tcp_control_block_t *)arg;
+    if (!(tcb->flags & TCP_FLAG_RTO)) {
+        if ((tcb->state == TCP_STATE_ESTABLISHED) && !(tcb->flags & TCP_FLAG_CLOSE)) {
+            tcb->flags |= TCP_FLAG_CLOSE;
+            tcp_output();
+            tcp_set_timer(1);
+        }
+        else {
+            tcp_release();
+        }
+        return;
+    }
+    if (++tcb->retries > NET_TCP_MAX_RETRIES) {
+        send_tcp_packet(TCP_CNTRL_RST | TCP_CNTRL_ACK, 0);
+        tcp_release();
+        return;
+    }
+    tcb->local_seq = tcb->snd_una;
+    tcb->flags &= ~(TCP_FLAG_FIN_SENT | TCP_FLAG_RTO);
+    if (tcb->state == TCP_STATE_SYN_RECVD) {
+        send_tcp_packet(TCP_CNTRL_SYN | TCP_CNTRL_ACK, 0);
+    }
+    else {
+        tcp_output();
+    }
+    tcp_set_timer(1);
+}
+/***************************************************************************//**
+ * Frees the current connection.
+ */
+static void tcp_release(void)
+{
+    net_timer_stop(&tcp_timer[TCP_CONN(tcb)]);
+    httpd_reset(TCP_CONN(tcb));
+    fast_memset(tcb, 0, sizeof(tcp_control_block_t));
+}
+/***************************************************************************//**
+ * Answers a segment that belongs to no connection with a reset, RFC 793
+ * section 3.4.
+ */
+static void tcp_send_reset(unsigned char *buf, unsigned short int dlen)
+{
+    eth_hdr_xp eth_hdr = (eth_hdr_xp )buf;
+    ip_hdr_xp ip_hdr = (ip_hdr_xp ) (buf + sizeof (ether_hdr_t));
+    tcp_hdr_xp tcp_hdr = (tcp_hdr_xp ) (buf + sizeof (ether_hdr_t) + sizeof(ip_hdr_t));
+    unsigned char flags = tcp_hdr->urg_ack_psh_rst_syn_fin;
+    tcp_control_block_t *prev = tcb;
+    tcp_control_block_t rst;
+
+    fast_memset(&rst, 0, sizeof(rst));
+    fast_memcpy(rst.remote_addr, ip_hdr->sa, IP_ADDR_LEN);
+    fast_memcpy(rst.remote_port, tcp_hdr->sp, TCP_PORT_LEN);
+    fast_memcpy(rst.local_port, tcp_hdr->dp, TCP_PORT_LEN);
+    fast_memcpy(rst.remote_mac, eth_hdr->sa, ETH_ADDR_LEN);
+    tcb = &rst;
+    if (flags & TCP_CNTRL_ACK) {
+        rst.local_seq = tcp_get32(tcp_hdr->acknum);
+        send_tcp_packet(TCP_CNTRL_RST, 0);
+    }
+    else {
+        rst.remote_seq = tcp_get32(tcp_hdr->seqnum) + dlen +
+                         ((flags & (TCP_CNTRL_SYN | TCP_CNTRL_FIN)) ? 1 : 0);
+        send_tcp_packet(TCP_CNTRL_RST | TCP_CNTRL_ACK, 0);
+    }
+    tcb = prev;
+}
+/***************************************************************************//**
+ * Returns the maximum segment size option of a SYN, TCP_DEFAULT_MSS if it has
+ * none.
+ */
+static unsigned short int tcp_parse_mss(const unsigned char *opt, unsigned short int len)
+{
+    unsigned short int mss = TCP_DEFAULT_MSS;
+    unsigned short int i = 0;
+
+    while (i < len) {
+        if (opt[i] == 0) {              /* end of options */
+            break;
+        }
+        if (opt[i] == 1) {              /* no operation */
+            i++;
+            continue;
+        }
+        if ((i + 1 >= len) || (opt[i+1] < 2)) {
+            break;
+        }
+        if ((opt[i] == 2) && (opt[i+1] == 4) && (i + 4 <= len)) {
+            mss = (unsigned short int)((opt[i+2] << 8) | opt[i+3]);
+        }
+        i += opt[i+1];
+    }
+    if (mss > TCP_MAX_MSS) {
+        mss = TCP_MAX_MSS;
+    }
+    return mss;
+}
+/***************************************************************************//**
+ * Path MTU discovery, RFC 1191. Lowers the segment size of the connection a
+ * "fragmentation needed" message is about and sends again what the router
+ * dropped. Routers that do not give the next hop MTU get the next lower
+ * plateau of the RFC below the size of the dropped datagram.
+ */
+static void tcp_pmtu_update(const unsigned char *icmp, unsigned short int len)
+{
+    static const unsigned short int plateaus[] = { 1492, 1006, 508, 296, 68 };
+    const ip_hdr_t *orig = (const ip_hdr_t *)(icmp + 8);
+    const unsigned char *th;
+    unsigned short int mtu = tcp_get16(icmp + 6);
+    unsigned short int ohlen;
+    unsigned short int mss;
+    unsigned int seq;
+    unsigned char changed = 0;
+    unsigned char i;
+
+    /* The message quotes the IP header and 8 bytes of the dropped segment */
+    if (len < 8 + sizeof(ip_hdr_t) + 8) {
+        return;
+    }
+    ohlen = (unsigned short int)((orig->ver_hlen & 0x0f) * 4);
+    if ((ohlen < sizeof(ip_hdr_t)) || (len < 8 + ohlen + 8) || (orig->proto != TCP_PROTO) ||
+        memcmp(orig->sa, my_ip, IP_ADDR_LEN)) {
+        return;
+    }
+    th = (const unsigned char *)orig + ohlen;
+    for (i = 0; i < NET_TCP_CONNECTIONS; i++) {
+        tcb = &tcb_table[i];
+        if ((tcb->state != TCP_STATE_LISTEN) &&
+            !memcmp(tcb->remote_addr, orig->da, IP_ADDR_LEN) &&
+            !memcmp(tcb->local_port, th, TCP_PORT_LEN) &&
+            !memcmp(tcb->remote_port, th + TCP_PORT_LEN, TCP_PORT_LEN)) {
+            break;
+        }
+    }
+    if (i == NET_TCP_CONNECTIONS) {
+        return;
+    }
+    /* Only believe messages about data that is in flight */
+    seq = tcp_get32(th + 2 * TCP_PORT_LEN);
+    if (TCP_SEQ_LT(seq, tcb->snd_una) || !TCP_SEQ_LT(seq, tcb->local_seq)) {
+        return;
+    }
+
+    if (mtu == 0) {
+        mtu = tcp_get16(orig->tlen);
+        for (i = 0; (plateaus[i] >= mtu) && (plateaus[i] > 68); i++) {
+        }
+        mtu = plateaus[i];
+    }
+    if ((mtu < NET_IP_MIN_PMTU) && !(tcb->flags & TCP_FLAG_NO_DF)) {
+        tcb->flags |= TCP_FLAG_NO_DF;
+        changed = 1;
+    }
+    if (mtu < NET_IP_MIN_PMTU) {
+        mtu = NET_IP_MIN_PMTU;
     }
-    /* no break here... go on to CLOSED directly */
-    case TCP_STATE_CLOSED:   
-    memset (&tcb, 0, sizeof (tcp_control_block_t));
-    break;     
-    default:
-    break;
+    mss = (unsigned short int)(mtu - sizeof(ip_hdr_t) - sizeof(tcp_hdr_t));
+    if (mss < tcb->mss) {
+        tcb->mss = mss;
+        changed = 1;
     }
-    return 0;
+    if (!changed || (tcb->state == TCP_STATE_SYN_RECVD)) {
+        return;
+    }
+    /* Everything past the dropped segment was too big as well */
+    tcb->local_seq = tcb->snd_una;
+    tcb->flags &= ~TCP_FLAG_FIN_SENT;
+    tcp_output();
+    tcp_set_timer(1);
 }
 /***************************************************************************//**
  *  See tcpip.h for more information.
@@ -654,19 +1189,55 @@ unsigned char process_tcp_packet(unsigned char *buf)
 unsigned char process_ip_packet(unsigned char *buf)
 {
     ip_hdr_xp ip_hdr = (ip_hdr_xp ) (buf + sizeof (ether_hdr_t));
+    unsigned short int tlen = tcp_get16(ip_hdr->tlen);
+    unsigned short int frag = tcp_get16(ip_hdr->frag_off);
+    unsigned short int hlen = (unsigned short int)((ip_hdr->ver_hlen & 0x0f) * 4);
     /* Is the incoming pkt for me?
-       (either explicity addressed to me or a broadcast address) */
+       (either explicity addressed to me, a group joined or a broadcast address) */
     if (memcmp(my_ip, ip_hdr->da, IP_ADDR_LEN)) /* not my IP */ {
-    if (ip_known) {
+    if (IP_IS_MULTICAST(ip_hdr->da)) {
+        if (!igmp_is_member(ip_hdr->da)) {
         return ERR;
+        }
     }
-    if (ip_hdr->da[0] != 0xFF || ip_hdr->da[1] != 0xFF ||
-        ip_hdr->da[2] != 0xFF || ip_hdr->da[3] != 0xFF) {
+    else {
+        if (ip_known) {
+        return ERR;
+        }
+        if (ip_hdr->da[0] != 0xFF || ip_hdr->da[1] != 0xFF ||
+            ip_hdr->da[2] != 0xFF || ip_hdr->da[3] != 0xFF) {
         return ERR;
+        }
     }
     }
-    if (check_checksum((unsigned char *)ip_hdr, (unsigned short int) 20, (unsigned short int) 10, 'I') != OK)
+    /* The whole datagram must be in the frame */
+    if (((ip_hdr->ver_hlen & 0xf0) != 0x40) || (hlen < sizeof(ip_hdr_t)) || (tlen < hlen) ||
+        ((tcpip_rx_pbuf != 0) && (sizeof(ether_hdr_t) + tlen > tcpip_rx_pbuf->len))) {
     return ERR;
+    }
+    if (check_checksum((unsigned char *)ip_hdr, hlen, (unsigned short int) 10, 'I') != OK)
+    return ERR;
+    if (hlen > sizeof(ip_hdr_t)) {
+    /* The protocol handlers expect a 20 byte header: drop the options,
+       such as the router alert of IGMP, by moving the headers over them */
+    memmove(buf + (hlen - sizeof(ip_hdr_t)), buf, sizeof(ether_hdr_t) + sizeof(ip_hdr_t));
+    buf += hlen - sizeof(ip_hdr_t);
+    ip_hdr = (ip_hdr_xp ) (buf + sizeof (ether_hdr_t));
+    tlen -= hlen - sizeof(ip_hdr_t);
+    ip_hdr->ver_hlen = 0x45;
+    ip_hdr->tlen[0] = (unsigned char)(tlen >> 8);
+    ip_hdr->tlen[1] = (unsigned char)tlen;
+    fix_checksum((unsigned char *)ip_hdr, sizeof(ip_hdr_t), 10);
+    tcpip_rx_pbuf = 0;
+    }
+    if (frag & (IP_FRAG_MF | IP_FRAG_OFFSET)) {
+    buf = ip_reass_input(buf);
+    if (buf == 0) {
+        return OK;
+    }
+    /* The datagram is no longer in the received buffer */
+    tcpip_rx_pbuf = 0;
+    }
     switch (ip_hdr->proto) 
     {
     case TCP_PROTO:
@@ -675,6 +1246,8 @@ unsigned char process_ip_packet(unsigned char *buf)
         return process_icmp_packet(buf);
     case UDP_PROTO:
         return process_udp_packet(buf);
+    case IGMP_PROTO:
+        return igmp_input(buf);
     default: {
         return ERR;
     }
@@ -694,13 +1267,19 @@ unsigned char process_arp_packet(unsigned char *buf)
          {          
              //printf("IP conflict with MAC");
              //printf("%02x:%02x:%02x:%02x:%02x:%02x",arp_pkt->mac_sa[0],arp_pkt->mac_sa[1],arp_pkt->mac_sa[2],arp_pkt->mac_sa[3],arp_pkt->mac_sa[4],arp_pkt->mac_sa[5]);
-         }             
+         }
+         else
+         {
+             arp_cache_update(arp_pkt->ip_sa, arp_pkt->mac_sa);
+         }
     }
     return ERR;
     }   
     if (memcmp(my_ip, arp_pkt->ip_ta, IP_ADDR_LEN)) {
     return ERR;
     }   
+    /* The sender will most likely talk to us, remember it */
+    arp_cache_update(arp_pkt->ip_sa, arp_pkt->mac_sa);
     return send_arp_reply(buf);
 }
 /***************************************************************************//**
@@ -48,6 +48,18 @@ unsigned short int get_checksum(unsigned char *buf, unsigned short int len, unsi
  *   @return         OK
  */
 unsigned char fix_checksum(unsigned char *buf, unsigned short int len, unsigned short int pos);
+/***************************************************************************//**
+ * Accumulates the one's complement sum of len bytes into sum. The buffer is
+ * treated as if it followed an even number of bytes already summed, so a
+ * checksum can be computed over a header and a separate payload.
+ * 
+ *  @param  buf      Bytes to add.
+ *  @param  len      Number of bytes.
+ *  @param  sum      Sum of the preceding bytes, 0 to start.
+ * 
+ *  @return          folded 16 bit sum, not complemented
+ */
+unsigned int checksum_add(const unsigned char *buf, unsigned short int len, unsigned int sum);
 /***************************************************************************//**
  * Checks the calculated checksum for the errors.
  * 
@@ -59,12 +71,6 @@ unsigned char fix_checksum(unsigned char *buf, unsigned short int len, unsigned
  *           ERR        If there is error in the data                
  */
 unsigned char check_checksum(unsigned char *buf, unsigned short int len, unsigned short int pos, char type);
-/***************************************************************************//**
- * Sends the reply to ICMP request like PING.
- * 
- * @param  buf      Pointer to the recieved buffer from Ethernet MAC.
- */
-unsigned char send_icmp_echo_reply(unsigned char *buf);
 /***************************************************************************//**
  * Converts the input integer to the ascii char and fills in the buffer. 
  * 
@@ -73,11 +79,13 @@ unsigned char send_icmp_echo_reply(unsigned char *buf);
  */
 void dtoa_reverse(unsigned short int n, unsigned char *buf);
 /***************************************************************************//**
- * Sends DHCP request to the server available in LAN.
+ * Answers a DHCP client on the LAN with an offer or an acknowledge of
+ * g_client_ip, for boards connected straight to a PC. Only used when
+ * NET_DHCP_SERVER is set.
  * 
- * @param  buf       Pointer to the recieved data in case of DHCP reply.Zero for request. 
+ * @param  buf       Pointer to the recieved DISCOVER or REQUEST.
  */
-void send_bootp_packet (unsigned char *buf);
+void send_dhcp_server_packet (unsigned char *buf);
 /***************************************************************************//**
  * Processes the UDP datagram.
  * 
@@ -90,6 +98,80 @@ unsigned char process_udp_packet (unsigned char *buf);
  * @param  buf      Pointer to the transmitt buffer to Ethernet MAC.
  */
 void send_tcp_packet (unsigned char control_bits,unsigned short int buflen);
+/***************************************************************************//**
+ * Sends a TCP segment whose payload is transmitted straight from the caller's
+ * buffer. Only the headers are built by the stack, the payload is chained to
+ * them by the Ethernet MAC scatter-gather transmit.
+ * 
+ * @param  control_bits TCP control flags.
+ * @param  data         Pointer to the payload, must stay unchanged until
+ *                      complete is called.
+ * @param  len          Number of payload bytes.
+ * @param  complete     Called once the payload buffer may be reused, may be 0.
+ * @param  context      Parameter given to complete.
+ * @return OK           If the segment was queued for transmission
+ *         ERR          otherwise
+ */
+unsigned char send_tcp_data (unsigned char control_bits, const unsigned char *data,
+                             unsigned short int len, MSS_MAC_tx_complete_t complete,
+                             void *context);
+/***************************************************************************//**
+ * Sends a TCP segment held in a packet buffer chain. The headers are
+ * prepended in the headroom of the first buffer, which must be at least
+ * NET_PBUF_HEADROOM, and the chain is queued to the network interface. The
+ * reference held by the caller is passed to the stack.
+ * 
+ * @param  control_bits TCP control flags.
+ * @param  p            Payload of the segment.
+ * @return OK           If the segment was queued for transmission
+ *         ERR          otherwise
+ */
+unsigned char send_tcp_pbuf (unsigned char control_bits, pbuf_t *p);
+/***************************************************************************//**
+ * Sends a response on a TCP connection: hlen bytes at hdr followed by blen
+ * bytes at body, both transmitted in place. They must stay unchanged until
+ * the peer has acknowledged them, which httpd_sent() reports. Only one
+ * response may be outstanding per connection. Must be called from the
+ * network interface task.
+ * 
+ * @param  conn         Connection, as given to httpd_recv().
+ * @param  hdr          First part of the response, may be 0 if hlen is 0.
+ * @param  hlen         Its length.
+ * @param  body         Second part of the response, may be 0 if blen is 0.
+ * @param  blen         Its length.
+ * @param  close        Closes the connection once the response is sent.
+ * @return OK           If the response was accepted
+ *         ERR          if one is already outstanding or the connection is
+ *                      closing
+ */
+unsigned char tcp_send(unsigned char conn, const unsigned char *hdr, unsigned short int hlen,
+                       const unsigned char *body, unsigned short int blen, unsigned char close);
+/***************************************************************************//**
+ * Sends a UDP datagram held in a packet buffer chain. The Ethernet, IP and UDP
+ * headers are prepended in the headroom of the first buffer, which must be at
+ * least NET_PBUF_HEADROOM, and the chain is queued to the network interface.
+ * The reference held by the caller is passed to the stack. May be called from
+ * any task.
+ * 
+ * @param  src_ip       IP source, 0 for my_ip.
+ * @param  dst_mac      Ethernet destination.
+ * @param  dst_ip       IP destination.
+ * @param  src_port     UDP source port.
+ * @param  dst_port     UDP destination port.
+ * @param  p            Payload of the datagram.
+ * @return OK           If the datagram was queued for transmission
+ *         ERR          otherwise
+ */
+unsigned char send_udp_pbuf (const unsigned char *src_ip, const unsigned char *dst_mac,
+                             const unsigned char *dst_ip, unsigned short int src_port,
+                             unsigned short int dst_port, pbuf_t *p);
+/***************************************************************************//**
+ * Hands a received frame to the stack and releases it.
+ * 
+ * @param  p    Frame, starting with the Ethernet header.
+ * @return      result of process_packet()
+ */
+unsigned char tcpip_input (pbuf_t *p);
 /***************************************************************************//**
  * Initialize TCP for the software TCP/IP stack.
  * 
@@ -106,7 +188,8 @@ unsigned char tcp_init(void);
  */
 unsigned char hex_digits_to_byte(unsigned char u, unsigned char l);
 /***************************************************************************//**
- * Processes ICMP packets
+ * Processes ICMP packets: answers echo requests and lowers the segment size
+ * of TCP connections when a router reports a smaller path MTU.
  * 
  * @param  buf  Pointer to the recieved buffer from Ethernet MAC.
  * 
@@ -127,7 +210,8 @@ unsigned char http_send_logo ();
  */
 unsigned char send_http_response(unsigned char *buf);
 /***************************************************************************//**
- * Process incoming TCP requests and handles the TCP state machine.
+ * Process incoming TCP segments and handles the TCP state machine. Data
+ * received on a connection is passed to the HTTP server.
  * 
  * @param  buf  Pointer to the recieved buffer from Ethernet MAC.
  * @return OK
@@ -135,6 +219,8 @@ unsigned char send_http_response(unsigned char *buf);
 unsigned char process_tcp_packet(unsigned char *buf);
 /***************************************************************************//**
  * Process incoming IP datagrams and handles the TCP state machine.
+ * IP options are removed and fragments reassembled first, see ip_reass.h.
+ * Multicast datagrams are only taken for the groups joined, see igmp.h.
  *  
  * @param  buf  Pointer to the recieved buffer from Ethernet MAC.
  * @return OK
@@ -0,0 +1,338 @@
+/*******************************************************************************
+ *  udp.c: UDP sockets.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "nettype.h"
+#include "../mss_ethernet_mac/mss_ethernet_mac.h"
+#include "netif.h"
+#include "pbuf.h"
+#include "arp.h"
+#include "dhcp.h"
+#include "udp.h"
+#include "tcpip.h"
+#include "../fast_mem/fast_mem.h"
+
+#define OK  0
+#define ERR 1
+
+#define UDP_HDR_OFFSET  (sizeof(ether_hdr_t) + sizeof(ip_hdr_t))
+
+/* Longest single wait, the RTOS uses 16 bit ticks of 1 us */
+#define UDP_WAIT_STEP_MS    50
+/* Period at which the ARP cache is checked while resolving */
+#define UDP_ARP_POLL_MS     5
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+
+static udp_socket_t udp_sockets[NET_UDP_SOCKETS];
+static uint16_t udp_next_port = NET_UDP_EPHEMERAL_PORT;
+
+/***************************************************************************//**
+ * Returns the socket bound to port, NULL if none. Called with the scheduler
+ * suspended.
+ */
+static udp_socket_t *udp_find(uint16_t port)
+{
+    unsigned char i;
+
+    for (i = 0; i < NET_UDP_SOCKETS; i++) {
+        if (udp_sockets[i].port == port) {
+            return &udp_sockets[i];
+        }
+    }
+    return NULL;
+}
+
+/***************************************************************************//**
+ * Finds the Ethernet address to send to ip. Addresses outside the subnet of
+ * the DHCP lease go to its router. Unknown neighbours are asked for every
+ * NET_ARP_RETRY_MS until wait_ms runs out.
+ *
+ * @return 1 if mac was filled, 0 otherwise
+ */
+static unsigned char udp_resolve(const unsigned char *ip, unsigned char *mac, uint32_t wait_ms)
+{
+    unsigned char hop[IP_ADDR_LEN];
+    unsigned char mask[IP_ADDR_LEN];
+    unsigned char i;
+    uint32_t waited = 0;
+    uint32_t asked = 0;
+    const dhcp_lease_t *lease;
+
+    if ((ip[0] == 0xFF) && (ip[1] == 0xFF) && (ip[2] == 0xFF) && (ip[3] == 0xFF)) {
+        fast_memset(mac, 0xFF, ETH_ADDR_LEN);
+        return 1;
+    }
+    if ((ip[0] & 0xF0) == 0xE0) {
+        /* Multicast, RFC 1112 section 6.4 */
+        mac[0] = 0x01;
+        mac[1] = 0x00;
+        mac[2] = 0x5E;
+        mac[3] = ip[1] & 0x7F;
+        mac[4] = ip[2];
+        mac[5] = ip[3];
+        return 1;
+    }
+
+    /* The lease is updated by the network interface task */
+    fast_memcpy(hop, ip, IP_ADDR_LEN);
+    vTaskSuspendAll();
+    if (dhcp_get_state() >= DHCP_STATE_BOUND) {
+        lease = dhcp_get_lease();
+        fast_memcpy(mask, lease->netmask, IP_ADDR_LEN);
+        for (i = 0; i < IP_ADDR_LEN; i++) {
+            if ((ip[i] ^ my_ip[i]) & mask[i]) {
+                fast_memcpy(hop, lease->router, IP_ADDR_LEN);
+                break;
+            }
+        }
+    }
+    xTaskResumeAll();
+
+    for (;;) {
+        if (arp_cache_lookup(hop, mac)) {
+            return 1;
+        }
+        if (asked <= waited) {
+            arp_request(hop);
+            asked = waited + NET_ARP_RETRY_MS;
+        }
+        if (waited >= wait_ms) {
+            return 0;
+        }
+        vTaskDelay(NET_MS_TO_TICKS(UDP_ARP_POLL_MS));
+        waited += UDP_ARP_POLL_MS;
+    }
+}
+
+/***************************************************************************//**
+ * Takes a datagram out of a mailbox, waiting at most timeout_ms.
+ */
+static unsigned char udp_wait(udp_socket_t *s, udp_dgram_t *dgram, uint32_t timeout_ms)
+{
+    uint32_t step;
+
+    do {
+        step = (timeout_ms > UDP_WAIT_STEP_MS) ? UDP_WAIT_STEP_MS : timeout_ms;
+        if (xQueueReceive(s->mbox, dgram, NET_MS_TO_TICKS(step)) == pdPASS) {
+            return 1;
+        }
+        if (timeout_ms != UDP_WAIT_FOREVER) {
+            timeout_ms -= step;
+        }
+    } while (timeout_ms != 0);
+    return 0;
+}
+
+/***************************************************************************//**
+ *  See udp.h for more information.
+ */
+udp_socket_t *udp_bind(uint16_t port, unsigned portBASE_TYPE depth)
+{
+    xQueueHandle mbox = xQueueCreate(depth, sizeof(udp_dgram_t));
+    udp_socket_t *s = NULL;
+    uint16_t tries;
+
+    if (mbox == NULL) {
+        return NULL;
+    }
+    vTaskSuspendAll();
+    if (port == 0) {
+        for (tries = 0; tries < NET_UDP_SOCKETS + 1; tries++) {
+            port = udp_next_port++;
+            if (udp_next_port == 0) {
+                udp_next_port = NET_UDP_EPHEMERAL_PORT;
+            }
+            if (udp_find(port) == NULL) {
+                break;
+            }
+        }
+    }
+    if (udp_find(port) == NULL) {
+        s = udp_find(0);
+    }
+    if (s != NULL) {
+        s->mbox = mbox;
+        s->rx_count = 0;
+        s->rx_dropped = 0;
+        s->port = port;
+    }
+    xTaskResumeAll();
+    if (s == NULL) {
+        vQueueDelete(mbox);
+    }
+    return s;
+}
+
+/***************************************************************************//**
+ *  See udp.h for more information.
+ */
+void udp_close(udp_socket_t *s)
+{
+    udp_dgram_t dgram;
+
+    /* Once the port is cleared the network task no longer posts to the mailbox */
+    vTaskSuspendAll();
+    s->port = 0;
+    xTaskResumeAll();
+    while (xQueueReceive(s->mbox, &dgram, 0) == pdPASS) {
+        pbuf_free(dgram.p);
+    }
+    vQueueDelete(s->mbox);
+    s->mbox = NULL;
+}
+
+/***************************************************************************//**
+ *  See udp.h for more information.
+ */
+int32_t udp_sendto(udp_socket_t *s, const unsigned char *ip, uint16_t port,
+                   const void *data, uint16_t len, uint32_t wait_ms)
+{
+    pbuf_t *p;
+
+    if (len > UDP_MAX_PAYLOAD) {
+        return UDP_ERR_ARG;
+    }
+    p = pbuf_alloc(NET_PBUF_HEADROOM, len);
+    if (p == NULL) {
+        return UDP_ERR_MEM;
+    }
+    pbuf_take(p, data, len);
+    return udp_sendto_pbuf(s, ip, port, p, wait_ms);
+}
+
+/***************************************************************************//**
+ *  See udp.h for more information.
+ */
+int32_t udp_sendto_pbuf(udp_socket_t *s, const unsigned char *ip, uint16_t port,
+                        pbuf_t *p, uint32_t wait_ms)
+{
+    unsigned char mac[ETH_ADDR_LEN];
+    uint16_t len = p->tot_len;
+
+    if ((s == NULL) || (s->port == 0) || (len > UDP_MAX_PAYLOAD)) {
+        pbuf_free(p);
+        return UDP_ERR_ARG;
+    }
+    if (!udp_resolve(ip, mac, wait_ms)) {
+        pbuf_free(p);
+        return UDP_ERR_ROUTE;
+    }
+    if (send_udp_pbuf(0, mac, ip, s->port, port, p) != OK) {
+        return UDP_ERR_NETIF;
+    }
+    return len;
+}
+
+/***************************************************************************//**
+ *  See udp.h for more information.
+ */
+pbuf_t *udp_recv_pbuf(udp_socket_t *s, unsigned char *ip, uint16_t *port,
+                      uint32_t timeout_ms)
+{
+    udp_dgram_t dgram;
+
+    if (!udp_wait(s, &dgram, timeout_ms)) {
+        return NULL;
+    }
+    if (ip != NULL) {
+        fast_memcpy(ip, dgram.ip, IP_ADDR_LEN);
+    }
+    if (port != NULL) {
+        *port = dgram.port;
+    }
+    return dgram.p;
+}
+
+/***************************************************************************//**
+ *  See udp.h for more information.
+ */
+int32_t udp_recvfrom(udp_socket_t *s, void *buf, uint16_t size,
+                     unsigned char *ip, uint16_t *port, uint32_t timeout_ms)
+{
+    pbuf_t *p = udp_recv_pbuf(s, ip, port, timeout_ms);
+    uint16_t len;
+
+    if (p == NULL) {
+        return UDP_ERR_TIMEOUT;
+    }
+    len = pbuf_copy_out(p, buf, size, 0);
+    pbuf_free(p);
+    return len;
+}
+
+/***************************************************************************//**
+ *  See udp.h for more information.
+ */
+unsigned char udp_input(pbuf_t *p, unsigned char *buf)
+{
+    eth_hdr_xp eth_hdr = (eth_hdr_xp ) buf;
+    ip_hdr_xp ip_hdr = (ip_hdr_xp ) (buf + sizeof(ether_hdr_t));
+    udp_hdr_xp udp_hdr = (udp_hdr_xp ) (buf + UDP_HDR_OFFSET);
+    uint16_t tlen = (uint16_t)((ip_hdr->tlen[0] << 8) | ip_hdr->tlen[1]);
+    uint16_t ulen = (uint16_t)((udp_hdr->len[0] << 8) | udp_hdr->len[1]);
+    uint16_t dport = (uint16_t)((udp_hdr->dp[0] << 8) | udp_hdr->dp[1]);
+    unsigned int sum;
+    udp_socket_t *s;
+    udp_dgram_t dgram;
+    pbuf_t *q;
+
+    if ((tlen < sizeof(ip_hdr_t) + sizeof(udp_hdr_t)) ||
+        (ulen < sizeof(udp_hdr_t)) || (ulen > tlen - sizeof(ip_hdr_t)) ||
+        ((p != NULL) && (UDP_HDR_OFFSET + ulen > p->len))) {
+        return ERR;
+    }
+    if (udp_hdr->csum[0] | udp_hdr->csum[1]) {
+        sum = checksum_add(ip_hdr->sa, 2 * IP_ADDR_LEN, 0);
+        sum += UDP_PROTO + ulen;
+        sum = checksum_add((unsigned char *)udp_hdr, ulen, sum);
+        if (sum != 0xffff) {
+            return ERR;
+        }
+    }
+
+    /* Take the buffer over: hide the headers and the Ethernet padding */
+    if (p != NULL) {
+        q = p;
+        pbuf_ref(q);
+        pbuf_header(q, -(int16_t)(UDP_HDR_OFFSET + sizeof(udp_hdr_t)));
+        q->len = q->tot_len = ulen - sizeof(udp_hdr_t);
+    }
+    else {
+        /* Reassembled datagram, copied with room to send it back as is */
+        q = pbuf_alloc(NET_PBUF_HEADROOM, ulen - sizeof(udp_hdr_t));
+        if (q == NULL) {
+            return ERR;
+        }
+        pbuf_take(q, buf + UDP_HDR_OFFSET + sizeof(udp_hdr_t), ulen - sizeof(udp_hdr_t));
+    }
+    dgram.p = q;
+    fast_memcpy(dgram.ip, ip_hdr->sa, IP_ADDR_LEN);
+    dgram.port = (uint16_t)((udp_hdr->sp[0] << 8) | udp_hdr->sp[1]);
+
+    vTaskSuspendAll();
+    s = (dport != 0) ? udp_find(dport) : NULL;
+    if ((s != NULL) && (xQueueSend(s->mbox, &dgram, 0) == pdPASS)) {
+        s->rx_count++;
+        q = NULL;
+    }
+    else if (s != NULL) {
+        s->rx_dropped++;
+    }
+    xTaskResumeAll();
+
+    if (q != NULL) {
+        pbuf_free(q);
+        return ERR;
+    }
+    /* Replies will most likely follow, remember where the datagram came from */
+    if (ip_hdr->sa[0] != 0) {
+        arp_cache_update(ip_hdr->sa, eth_hdr->sa);
+    }
+    return OK;
+}
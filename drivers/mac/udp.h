@@ -0,0 +1,132 @@
+/*******************************************************************************
+ *  udp.h: UDP sockets.
+ *
+ *  A socket binds a local port to a FreeRTOS queue, its mailbox. The network
+ *  interface task posts each datagram for the port straight into the mailbox,
+ *  as a reference to the receive buffer, and the owning task takes it out with
+ *  udp_recvfrom() or udp_recv_pbuf(); there is no copy on the way. When the
+ *  mailbox is full the datagram is dropped and counted, the network task never
+ *  waits for an application.
+ *
+ *  Sending resolves the next hop (the router of the DHCP lease for addresses
+ *  outside the subnet) with the ARP cache, builds the headers in the headroom
+ *  of the payload buffer and queues the frame to the network interface.
+ *
+ *  Sockets may be used from any task, but the network interface task must not
+ *  wait for an address to be resolved or for a datagram since it is the one
+ *  processing the answers.
+ */
+#ifndef UDP_H_
+#define UDP_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "nettype.h"
+#include "pbuf.h"
+
+/***************************************************************************//**
+ * Timeout value waiting without limit.
+ */
+#define UDP_WAIT_FOREVER        0xFFFFFFFFUL
+
+/***************************************************************************//**
+ * Largest payload of a datagram, there is no fragmentation.
+ */
+#define UDP_MAX_PAYLOAD         1472
+
+/***************************************************************************//**
+ * Error codes returned by the send and receive functions.
+ */
+#define UDP_ERR_ARG             (-1)    /* bad socket or length */
+#define UDP_ERR_MEM             (-2)    /* no packet buffer */
+#define UDP_ERR_ROUTE           (-3)    /* destination not resolved in time */
+#define UDP_ERR_TIMEOUT         (-4)    /* no datagram received in time */
+#define UDP_ERR_NETIF           (-5)    /* network interface queue full */
+
+/***************************************************************************//**
+ * Socket. Only the counters may be read by the application.
+ */
+typedef struct udp_socket {
+    uint16_t port;              /* local port, 0 when the socket is free */
+    xQueueHandle mbox;          /* udp_dgram_t of the received datagrams */
+    uint32_t rx_count;          /* datagrams posted to the mailbox */
+    uint32_t rx_dropped;        /* datagrams lost because the mailbox was full */
+} udp_socket_t;
+
+/***************************************************************************//**
+ * Mailbox entry. The buffer payload is the UDP payload of the datagram.
+ */
+typedef struct udp_dgram {
+    pbuf_t *p;
+    unsigned char ip[IP_ADDR_LEN];  /* source address */
+    uint16_t port;                  /* source port */
+} udp_dgram_t;
+
+/***************************************************************************//**
+ * Binds a local port.
+ *
+ * @param  port     Port number, 0 to pick a free port above
+ *                  NET_UDP_EPHEMERAL_PORT.
+ * @param  depth    Number of datagrams the mailbox holds.
+ * @return the socket, NULL if the port is taken or no socket or memory is left
+ */
+udp_socket_t *udp_bind(uint16_t port, unsigned portBASE_TYPE depth);
+/***************************************************************************//**
+ * Releases a socket and the datagrams still in its mailbox.
+ */
+void udp_close(udp_socket_t *s);
+/***************************************************************************//**
+ * Sends a datagram from the socket port. The payload is copied into a packet
+ * buffer.
+ *
+ * @param  s        Socket.
+ * @param  ip       Destination address.
+ * @param  port     Destination port.
+ * @param  data     Payload.
+ * @param  len      Payload length, at most UDP_MAX_PAYLOAD.
+ * @param  wait_ms  Longest time to wait for the destination to be resolved
+ *                  and for room in the network interface queue.
+ * @return len on success, a negative UDP_ERR_ code otherwise
+ */
+int32_t udp_sendto(udp_socket_t *s, const unsigned char *ip, uint16_t port,
+                   const void *data, uint16_t len, uint32_t wait_ms);
+/***************************************************************************//**
+ * Same as udp_sendto() for a payload already held in a packet buffer chain
+ * with at least NET_PBUF_HEADROOM bytes of headroom. The reference held by
+ * the caller is passed to the stack, whatever the result.
+ */
+int32_t udp_sendto_pbuf(udp_socket_t *s, const unsigned char *ip, uint16_t port,
+                        pbuf_t *p, uint32_t wait_ms);
+/***************************************************************************//**
+ * Receives a datagram, copying its payload.
+ *
+ * @param  s            Socket.
+ * @param  buf          Filled with the payload, truncated to size bytes.
+ * @param  size         Size of buf.
+ * @param  ip           Filled with the source address, may be NULL.
+ * @param  port         Filled with the source port, may be NULL.
+ * @param  timeout_ms   Longest time to wait, 0 to poll or UDP_WAIT_FOREVER.
+ * @return number of bytes copied, a negative UDP_ERR_ code otherwise
+ */
+int32_t udp_recvfrom(udp_socket_t *s, void *buf, uint16_t size,
+                     unsigned char *ip, uint16_t *port, uint32_t timeout_ms);
+/***************************************************************************//**
+ * Receives a datagram without copying. The caller owns the returned buffer and
+ * must pbuf_free() it.
+ *
+ * @return the payload, NULL on timeout
+ */
+pbuf_t *udp_recv_pbuf(udp_socket_t *s, unsigned char *ip, uint16_t *port,
+                      uint32_t timeout_ms);
+/***************************************************************************//**
+ * Delivers a received datagram to the socket bound to its destination port.
+ * Called by process_udp_packet() in the network interface task.
+ *
+ * @param  p        Buffer holding the frame, NULL to copy from buf.
+ * @param  buf      Frame, starting with the Ethernet header.
+ * @return OK if the datagram was posted, ERR otherwise
+ */
+unsigned char udp_input(pbuf_t *p, unsigned char *buf);
+
+#endif /* UDP_H_ */
@@ -21,6 +21,7 @@ extern "C" {
 #include "mss_ethernet_mac_desc.h"
 #include "mss_ethernet_mac_conf.h"
 #include "../../CMSIS/mss_assert.h"
+#include "../fast_mem/fast_mem.h"
 
 #include "phy.h"
 
@@ -73,6 +74,10 @@ static const int8_t ErrorMessages[][MAX_ERROR_MESSAGE_WIDTH] = {
 static MAC_instance_t*     NULL_instance;
 static uint8_t*         NULL_buffer;
 static MSS_MAC_callback_t     NULL_callback;
+static MSS_MAC_tx_complete_t  NULL_tx_complete;
+static void*            NULL_context;
+static MSS_MAC_wait_hook_t    NULL_wait_hook;
+static MSS_MAC_capture_t      NULL_capture_hook;
 
 /**************************** INTERNAL FUNCTIONS ******************************/
 
@@ -86,6 +91,10 @@ static void        MAC_start_transmission( void );
 static int32_t    MAC_stop_receiving( void );
 static void        MAC_start_receiving( void );
 
+static int32_t    MAC_wait_tx_descriptors( uint32_t needed, uint32_t time_out );
+static void        MAC_init_rings( void );
+static void        MAC_capture( uint32_t direction, const uint8_t *frame, uint32_t length );
+
 static void        MAC_set_time_out( uint32_t time_out );
 static uint32_t    MAC_get_time_out( void );
 
@@ -111,8 +120,6 @@ MSS_MAC_init
 {
     const uint8_t mac_address[6] = { DEFAULT_MAC_ADDRESS };
 
-    int32_t a;
-
     /* Try to reset chip */
     MAC_BITBAND->CSR0_SWR = 1u;
     
@@ -133,20 +140,9 @@ MSS_MAC_init
     g_mss_mac.base_address = MAC_BASE;
     g_mss_mac.phy_address = phy_address;
 
-    for( a=0; a<RX_RING_SIZE; a++ )
-    {
-        /* Give the ownership to the MAC */
-        g_mss_mac.rx_descriptors[a].descriptor_0 = RDES0_OWN;
-        g_mss_mac.rx_descriptors[a].descriptor_1 = (MSS_RX_BUFF_SIZE << RDES1_RBS1_OFFSET);
-        g_mss_mac.rx_descriptors[a].buffer_1 = (uint32_t)g_mss_mac.rx_buffers[a];
-    }
-    g_mss_mac.rx_descriptors[RX_RING_SIZE-1].descriptor_1 |= RDES1_RER;
-
-    for( a = 0; a < TX_RING_SIZE; a++ )
-    {
-        g_mss_mac.tx_descriptors[a].buffer_1 = (uint32_t)g_mss_mac.tx_buffers[a];
-    }
-    g_mss_mac.tx_descriptors[TX_RING_SIZE - 1].descriptor_1 |= TDES1_TER;
+    g_mss_mac.rx_ring_size = RX_RING_SIZE;
+    g_mss_mac.tx_ring_size = TX_RING_SIZE;
+    MAC_init_rings();
 
     /* Configurable settings */
     MAC_BITBAND->CSR0_DBO = DESCRIPTOR_BYTE_ORDERING_MODE;
@@ -389,8 +385,7 @@ MSS_MAC_tx_packet
     uint32_t time_out
 )
 {
-    uint32_t desc;
-    int32_t error = MAC_OK;
+    int32_t error;
 
     ASSERT( MAC_test_instance() == MAC_OK );
 
@@ -407,37 +402,18 @@ MSS_MAC_tx_packet
                 (time_out == MSS_MAC_NONBLOCKING) ||
                 ((time_out >= 1) && (time_out <= 0x01000000uL)) );
 
-    if( time_out == MSS_MAC_NONBLOCKING )
-    {
-        /* Check if current descriptor is free */
-        if(((g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].descriptor_0) & TDES0_OWN) == TDES0_OWN )
-        {
-            error = MAC_BUFFER_IS_FULL;
-        }
-    }
-    else
-    {
-        /* Wait until descriptor is free */
-        if( time_out != MSS_MAC_BLOCKING ) {
-            MAC_set_time_out( time_out );
-        }
-        
-        while( (((g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].descriptor_0) & TDES0_OWN) == TDES0_OWN )
-                && (error == MAC_OK) )
-        {
-             /* transmit poll demand */
-            MAC->CSR1 = 1u;
-            
-            if(time_out != MSS_MAC_BLOCKING){
-                if(MAC_get_time_out() == 0u) {
-                    error = MAC_TIME_OUT;
-                }
-            }
-        }
-    }
+    error = MAC_wait_tx_descriptors( 1u, time_out );
 
     if( error == MAC_OK ) {
 
+        /* The descriptor may have carried a scatter-gather frame, point it
+           back to its own buffer */
+        g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].buffer_1 =
+            (uint32_t)g_mss_mac.tx_buffers[ g_mss_mac.tx_desc_index ];
+        g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].buffer_2 = 0u;
+        g_mss_mac.tx_complete[ g_mss_mac.tx_desc_index ] = NULL_tx_complete;
+        g_mss_mac.tx_context[ g_mss_mac.tx_desc_index ] = NULL_context;
+
         g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].descriptor_1 = 0u;
 
         if( (g_mss_mac.flags & FLAG_CRC_DISABLE) != 0u ) {
@@ -452,7 +428,7 @@ MSS_MAC_tx_packet
         g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].descriptor_1 |= pacLen;
 
         /* reset end of ring */
-        g_mss_mac.tx_descriptors[TX_RING_SIZE-1].descriptor_1 |= TDES1_TER;
+        g_mss_mac.tx_descriptors[ g_mss_mac.tx_ring_size - 1u ].descriptor_1 |= TDES1_TER;
 
         /* copy data into buffer */
         if( pacLen > MSS_TX_BUFF_SIZE ) /* FLAG_EXCEED_LIMIT */
@@ -464,30 +440,13 @@ MSS_MAC_tx_packet
             g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].buffer_1,
             pacData, (uint32_t)pacLen );
 
-        /* update counters */
-        desc = g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].descriptor_0;
-        if( (desc & TDES0_LO) != 0u ) {
-            g_mss_mac.statistics.tx_loss_of_carrier++;
-        }
-        if( (desc & TDES0_NC) != 0u ) {
-            g_mss_mac.statistics.tx_no_carrier++;
-        }
-        if( (desc & TDES0_LC) != 0u ) {
-            g_mss_mac.statistics.tx_late_collision++;
-        }
-        if( (desc & TDES0_EC) != 0u ) {
-            g_mss_mac.statistics.tx_excessive_collision++;
-        }
-        if( (desc & TDES0_UF) != 0u ) {
-            g_mss_mac.statistics.tx_underflow_error++;
-        }
-        g_mss_mac.statistics.tx_collision_count +=
-            (desc >> TDES0_CC_OFFSET) & TDES0_CC_MASK;
+        MAC_capture( MSS_MAC_CAPTURE_TX, pacData, (uint32_t)pacLen );
 
         /* Give ownership of descriptor to the MAC */
-        g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].descriptor_0 = RDES0_OWN;
+        g_mss_mac.tx_pending++;
+        g_mss_mac.tx_descriptors[ g_mss_mac.tx_desc_index ].descriptor_0 = TDES0_OWN;
 
-        g_mss_mac.tx_desc_index = (g_mss_mac.tx_desc_index + 1u) % (uint32_t)TX_RING_SIZE;
+        g_mss_mac.tx_desc_index = (g_mss_mac.tx_desc_index + 1u) % g_mss_mac.tx_ring_size;
 
         /* Start transmission */
         MAC_start_transmission();
@@ -508,6 +467,203 @@ MSS_MAC_tx_packet
 }
 
 
+/***************************************************************************//**
+  See mss_ethernet_mac.h for details of how to use this function.
+ 
+  The segments are attached two by two to consecutive transmit descriptors
+  using the buffer_1 and buffer_2 fields. The first descriptor of the frame is
+  handed over to the MAC last so that the transmit process never fetches a
+  partially built frame.
+ */
+int32_t
+MSS_MAC_tx_packet_sg
+(
+    const mss_mac_tx_segment_t * segments,
+    uint8_t segment_count,
+    MSS_MAC_tx_complete_t complete,
+    void * context,
+    uint32_t time_out
+)
+{
+    uint32_t seg;
+    uint32_t needed;
+    uint32_t first;
+    uint32_t index;
+    uint32_t last;
+    uint32_t desc_1;
+    uint32_t total = 0u;
+    int32_t error;
+
+    ASSERT( MAC_test_instance() == MAC_OK );
+
+    ASSERT( (segment_count > 0u) && (segment_count <= (2u * g_mss_mac.tx_ring_size)) );
+
+    for( seg = 0u; seg < segment_count; seg++ )
+    {
+        ASSERT( segments[seg].data != NULL_buffer );
+        ASSERT( segments[seg].length <= TDES1_TBS1_MASK );
+        total += segments[seg].length;
+    }
+
+    ASSERT( total >= 12u );
+
+    if( (g_mss_mac.flags & FLAG_EXCEED_LIMIT) == 0u )
+    {
+        ASSERT( total <= MSS_MAX_PACKET_SIZE );
+    }
+
+    ASSERT(  (time_out == MSS_MAC_BLOCKING) ||
+                (time_out == MSS_MAC_NONBLOCKING) ||
+                ((time_out >= 1) && (time_out <= 0x01000000uL)) );
+
+    /* Two buffers per descriptor */
+    needed = ((uint32_t)segment_count + 1u) / 2u;
+
+    error = MAC_wait_tx_descriptors( needed, time_out );
+
+    if( error == MAC_OK )
+    {
+        if( g_mss_mac.capture_hook != NULL_capture_hook )
+        {
+            g_mss_mac.capture_hook( MSS_MAC_CAPTURE_TX, segments, segment_count );
+        }
+
+        first = g_mss_mac.tx_desc_index;
+        index = first;
+        last = first;
+
+        for( seg = 0u; seg < segment_count; seg += 2u )
+        {
+            desc_1 = (uint32_t)segments[seg].length << TDES1_TBS1_OFFSET;
+            g_mss_mac.tx_descriptors[ index ].buffer_1 = (uint32_t)segments[seg].data;
+
+            if( (seg + 1u) < segment_count )
+            {
+                desc_1 |= (uint32_t)segments[seg + 1u].length << TDES1_TBS2_OFFSET;
+                g_mss_mac.tx_descriptors[ index ].buffer_2 = (uint32_t)segments[seg + 1u].data;
+            }
+            else
+            {
+                g_mss_mac.tx_descriptors[ index ].buffer_2 = 0u;
+            }
+
+            if( index == first ) {
+                desc_1 |= TDES1_FS;
+            }
+            if( (seg + 2u) >= segment_count ) {
+                desc_1 |= TDES1_LS;
+            }
+            if( (g_mss_mac.flags & FLAG_CRC_DISABLE) != 0u ) {
+                desc_1 |= TDES1_AC;
+            }
+            if( index == (g_mss_mac.tx_ring_size - 1u) ) {
+                desc_1 |= TDES1_TER;
+            }
+
+            g_mss_mac.tx_descriptors[ index ].descriptor_1 = desc_1;
+            g_mss_mac.tx_complete[ index ] = NULL_tx_complete;
+            g_mss_mac.tx_context[ index ] = NULL_context;
+
+            if( index != first ) {
+                g_mss_mac.tx_descriptors[ index ].descriptor_0 = TDES0_OWN;
+            }
+
+            last = index;
+            index = (index + 1u) % g_mss_mac.tx_ring_size;
+        }
+
+        /* The completion function belongs to the last descriptor, which is the
+           one the MAC writes the frame status into */
+        g_mss_mac.tx_complete[ last ] = complete;
+        g_mss_mac.tx_context[ last ] = context;
+
+        g_mss_mac.tx_pending += needed;
+        g_mss_mac.tx_desc_index = index;
+
+        /* Give ownership of the whole frame to the MAC */
+        g_mss_mac.tx_descriptors[ first ].descriptor_0 = TDES0_OWN;
+
+        /* Start transmission */
+        MAC_start_transmission();
+
+        /* transmit poll demand */
+        MAC->CSR1 = 1u;
+    }
+
+    if (error == MAC_OK)
+    {
+        error = (int32_t)total;
+    }
+    else
+    {
+        error = 0;
+    }
+    return ( error );
+}
+
+
+/***************************************************************************//**
+  See mss_ethernet_mac.h for details of how to use this function.
+ */
+uint32_t
+MSS_MAC_tx_reclaim
+(
+    void
+)
+{
+    uint32_t index;
+    uint32_t desc;
+    uint32_t completed = 0u;
+    MSS_MAC_tx_complete_t complete;
+    void * context;
+
+    while( (g_mss_mac.tx_pending > 0u) &&
+           ((g_mss_mac.tx_descriptors[ g_mss_mac.tx_reclaim_index ].descriptor_0 & TDES0_OWN) == 0u) )
+    {
+        index = g_mss_mac.tx_reclaim_index;
+        g_mss_mac.tx_reclaim_index = (index + 1u) % g_mss_mac.tx_ring_size;
+        g_mss_mac.tx_pending--;
+
+        /* Status is only valid in the last descriptor of a frame */
+        if( (g_mss_mac.tx_descriptors[ index ].descriptor_1 & TDES1_LS) != 0u )
+        {
+            /* update counters */
+            desc = g_mss_mac.tx_descriptors[ index ].descriptor_0;
+            if( (desc & TDES0_LO) != 0u ) {
+                g_mss_mac.statistics.tx_loss_of_carrier++;
+            }
+            if( (desc & TDES0_NC) != 0u ) {
+                g_mss_mac.statistics.tx_no_carrier++;
+            }
+            if( (desc & TDES0_LC) != 0u ) {
+                g_mss_mac.statistics.tx_late_collision++;
+            }
+            if( (desc & TDES0_EC) != 0u ) {
+                g_mss_mac.statistics.tx_excessive_collision++;
+            }
+            if( (desc & TDES0_UF) != 0u ) {
+                g_mss_mac.statistics.tx_underflow_error++;
+            }
+            g_mss_mac.statistics.tx_collision_count +=
+                (desc >> TDES0_CC_OFFSET) & TDES0_CC_MASK;
+
+            completed++;
+
+            complete = g_mss_mac.tx_complete[ index ];
+            context = g_mss_mac.tx_context[ index ];
+            g_mss_mac.tx_complete[ index ] = NULL_tx_complete;
+            g_mss_mac.tx_context[ index ] = NULL_context;
+
+            if( complete != NULL_tx_complete ) {
+                complete( context );
+            }
+        }
+    }
+
+    return completed;
+}
+
+
 /***************************************************************************//**
  * Returns available packet size.
  *
@@ -604,6 +760,9 @@ MSS_MAC_rx_packet
                 exit = 1;
             }
         }
+        if( (exit == 0) && (g_mss_mac.wait_hook != NULL_wait_hook) ) {
+            g_mss_mac.wait_hook();
+        }
     }
 
     if(exit == 0)
@@ -624,6 +783,8 @@ MSS_MAC_rx_packet
                 g_mss_mac.rx_descriptors[ g_mss_mac.rx_desc_index ].buffer_1,
                 (uint32_t)frame_length );
 
+        MAC_capture( MSS_MAC_CAPTURE_RX, pacData, (uint32_t)frame_length );
+
         MSS_MAC_prepare_rx_descriptor();
        
     }
@@ -689,6 +850,9 @@ MSS_MAC_rx_packet_ptrset
                 exit = 1;
             }
         }
+        if( (exit == 0) && (g_mss_mac.wait_hook != NULL_wait_hook) ) {
+            g_mss_mac.wait_hook();
+        }
     }
 
     if(exit == 0)
@@ -706,6 +870,8 @@ MSS_MAC_rx_packet_ptrset
           to prepare the current rx descriptor for receiving the next packet.
        */       
         *pacData = (uint8_t *)g_mss_mac.rx_descriptors[ g_mss_mac.rx_desc_index ].buffer_1 ;         
+
+        MAC_capture( MSS_MAC_CAPTURE_RX, *pacData, (uint32_t)frame_length );
         
     }
     return ((int32_t)frame_length);
@@ -961,6 +1127,135 @@ MSS_MAC_set_callback
 }
 
 
+/***************************************************************************//**
+  See mss_ethernet_mac.h for details of how to use this function.
+ */
+void
+MSS_MAC_enable_rx_irq
+(
+    void
+)
+{
+    MAC_BITBAND->CSR7_RIE = 1u;
+}
+
+
+/***************************************************************************//**
+  See mss_ethernet_mac.h for details of how to use this function.
+ */
+void
+MSS_MAC_disable_rx_irq
+(
+    void
+)
+{
+    MAC_BITBAND->CSR7_RIE = 0u;
+}
+
+
+/***************************************************************************//**
+  See mss_ethernet_mac.h for details of how to use this function.
+ */
+void
+MSS_MAC_set_ring_sizes
+(
+    uint32_t rx_size,
+    uint32_t tx_size
+)
+{
+    int32_t ret;
+
+    ASSERT( MAC_test_instance() == MAC_OK );
+
+    ASSERT( (rx_size >= 1u) && (rx_size <= RX_RING_SIZE) );
+    ASSERT( (tx_size >= 1u) && (tx_size <= TX_RING_SIZE) );
+
+    ret = MAC_stop_transmission();
+    ASSERT( ret == MAC_OK );
+
+    ret = MAC_stop_receiving();
+    ASSERT( ret == MAC_OK );
+
+    g_mss_mac.rx_ring_size = rx_size;
+    g_mss_mac.tx_ring_size = tx_size;
+    MAC_init_rings();
+
+    /* The MAC restarts from the base of the rings */
+    MAC->CSR3 = (uint32_t)&(g_mss_mac.rx_descriptors[0].descriptor_0);
+    MAC->CSR4 = (uint32_t)&(g_mss_mac.tx_descriptors[0].descriptor_0);
+
+    MAC_start_receiving();
+    MAC_start_transmission();
+}
+
+
+/***************************************************************************//**
+  See mss_ethernet_mac.h for details of how to use this function.
+ */
+void
+MSS_MAC_set_interrupt_mitigation
+(
+    uint8_t rx_frames,
+    uint8_t rx_timer,
+    uint8_t tx_frames,
+    uint8_t tx_timer,
+    uint8_t cycle_size
+)
+{
+    uint32_t csr11;
+
+    ASSERT( MAC_test_instance() == MAC_OK );
+
+    ASSERT( rx_frames <= (CSR11_NRP_MASK >> CSR11_NRP_SHIFT) );
+    ASSERT( rx_timer <= (CSR11_RT_MASK >> CSR11_RT_SHIFT) );
+    ASSERT( tx_frames <= (CSR11_NTP_MASK >> CSR11_NTP_SHIFT) );
+    ASSERT( tx_timer <= (CSR11_TT_MASK >> CSR11_TT_SHIFT) );
+    ASSERT( cycle_size <= 1u );
+
+    /* Keep the general-purpose timer running in continuous mode, it is used
+       for the time outs */
+    csr11 = CSR11_CON_MASK | (0x0000FFFFuL << CSR11_TIM_SHIFT);
+    csr11 |= ((uint32_t)rx_frames << CSR11_NRP_SHIFT) & CSR11_NRP_MASK;
+    csr11 |= ((uint32_t)rx_timer << CSR11_RT_SHIFT) & CSR11_RT_MASK;
+    csr11 |= ((uint32_t)tx_frames << CSR11_NTP_SHIFT) & CSR11_NTP_MASK;
+    csr11 |= ((uint32_t)tx_timer << CSR11_TT_SHIFT) & CSR11_TT_MASK;
+    csr11 |= ((uint32_t)cycle_size << CSR11_CS_SHIFT) & CSR11_CS_MASK;
+
+    MAC->CSR11 = csr11;
+    g_mss_mac.last_timer_value = (uint16_t)( MAC->CSR11 & CSR11_TIM_MASK );
+}
+
+
+/***************************************************************************//**
+  See mss_ethernet_mac.h for details of how to use this function.
+ */
+void
+MSS_MAC_set_wait_hook
+(
+    MSS_MAC_wait_hook_t hook
+)
+{
+    ASSERT( MAC_test_instance() == MAC_OK );
+
+    g_mss_mac.wait_hook = hook;
+}
+
+
+/***************************************************************************//**
+  See mss_ethernet_mac.h for details of how to use this function.
+ */
+void
+MSS_MAC_set_capture_hook
+(
+    MSS_MAC_capture_t hook
+)
+{
+    ASSERT( MAC_test_instance() == MAC_OK );
+
+    g_mss_mac.capture_hook = hook;
+}
+
+
 /***************************************************************************//**
  * Returns description of last error.
  *
@@ -1146,7 +1441,7 @@ MSS_MAC_prepare_rx_descriptor
     /* Give ownership of descriptor to the MAC */
     g_mss_mac.rx_descriptors[ g_mss_mac.rx_desc_index ].descriptor_0 =
         RDES0_OWN;
-    g_mss_mac.rx_desc_index = (g_mss_mac.rx_desc_index + 1u) % RX_RING_SIZE;
+    g_mss_mac.rx_desc_index = (g_mss_mac.rx_desc_index + 1u) % g_mss_mac.rx_ring_size;
 
     /* Start receive */
     MAC_start_receiving();
@@ -1213,6 +1508,20 @@ MAC_send_setup_frame
            d += 12;
     }
 
+    /* Let the MAC send the frames it still owns, so that the ring can be
+     * restarted from its first descriptor once the setup frame is out. */
+    MAC_set_time_out( (uint32_t)SETUP_FRAME_TIME_OUT );
+    (void)MSS_MAC_tx_reclaim();
+    while( g_mss_mac.tx_pending > 0u )
+    {
+        /* transmit poll demand */
+        MAC->CSR1 = 1u;
+        if( MAC_get_time_out() == 0u ) {
+            return MAC_TIME_OUT;
+        }
+        (void)MSS_MAC_tx_reclaim();
+    }
+
     /* Stop transmission */
     ret = MAC_stop_transmission();
     ASSERT( ret == MAC_OK );
@@ -1242,7 +1551,10 @@ MAC_send_setup_frame
 
     MAC_CHECK( MAC_stop_transmission() == MAC_OK, MAC_FAIL );
 
-    /* Set tx descriptor */
+    /* Set tx descriptor. The ring was drained above, so restart it from
+     * its base. */
+    g_mss_mac.tx_desc_index = 0u;
+    g_mss_mac.tx_reclaim_index = 0u;
     MAC->CSR4 = (uint32_t)g_mss_mac.tx_descriptors;
     
     /* Start receiving and transmission */
@@ -1253,6 +1565,129 @@ MAC_send_setup_frame
 }
 
 
+/***************************************************************************//**
+ * Gives a single buffer frame to the capture hook, if any.
+ */
+static void
+MAC_capture
+(
+    uint32_t direction,
+    const uint8_t *frame,
+    uint32_t length
+)
+{
+    mss_mac_tx_segment_t segment;
+
+    if( g_mss_mac.capture_hook != NULL_capture_hook )
+    {
+        segment.data = frame;
+        segment.length = (uint16_t)length;
+        g_mss_mac.capture_hook( direction, &segment, 1u );
+    }
+}
+
+
+/***************************************************************************//**
+ * Sets up the receive and transmit rings for the current ring sizes.
+ * All receive descriptors are given to the MAC and the transmit ring is
+ * emptied.
+ */
+static void
+MAC_init_rings
+(
+    void
+)
+{
+    uint32_t a;
+
+    for( a = 0u; a < g_mss_mac.rx_ring_size; a++ )
+    {
+        /* Give the ownership to the MAC */
+        g_mss_mac.rx_descriptors[a].descriptor_0 = RDES0_OWN;
+        g_mss_mac.rx_descriptors[a].descriptor_1 = (MSS_RX_BUFF_SIZE << RDES1_RBS1_OFFSET);
+        g_mss_mac.rx_descriptors[a].buffer_1 = (uint32_t)g_mss_mac.rx_buffers[a];
+        g_mss_mac.rx_descriptors[a].buffer_2 = 0u;
+    }
+    g_mss_mac.rx_descriptors[g_mss_mac.rx_ring_size - 1u].descriptor_1 |= RDES1_RER;
+    g_mss_mac.rx_desc_index = 0u;
+
+    for( a = 0u; a < g_mss_mac.tx_ring_size; a++ )
+    {
+        g_mss_mac.tx_descriptors[a].descriptor_0 = 0u;
+        g_mss_mac.tx_descriptors[a].descriptor_1 = 0u;
+        g_mss_mac.tx_descriptors[a].buffer_1 = (uint32_t)g_mss_mac.tx_buffers[a];
+        g_mss_mac.tx_descriptors[a].buffer_2 = 0u;
+        g_mss_mac.tx_complete[a] = NULL_tx_complete;
+        g_mss_mac.tx_context[a] = NULL_context;
+    }
+    g_mss_mac.tx_descriptors[g_mss_mac.tx_ring_size - 1u].descriptor_1 |= TDES1_TER;
+    g_mss_mac.tx_desc_index = 0u;
+    g_mss_mac.tx_reclaim_index = 0u;
+    g_mss_mac.tx_pending = 0u;
+}
+
+
+/***************************************************************************//**
+ * Waits until at least needed transmit descriptors are free.
+ * Descriptors released by the MAC are reclaimed while waiting.
+ *
+ * @param needed      number of free descriptors required.
+ * @param time_out    same meaning as the time_out parameter of MSS_MAC_tx_packet().
+ * @return            #MAC_OK if the descriptors are available.
+ *                     #MAC_BUFFER_IS_FULL if not available and time_out is
+ *                     #MSS_MAC_NONBLOCKING.
+ *                     #MAC_TIME_OUT if timed out.
+ */
+static int32_t
+MAC_wait_tx_descriptors
+(
+    uint32_t needed,
+    uint32_t time_out
+)
+{
+    int32_t error = MAC_OK;
+
+    (void)MSS_MAC_tx_reclaim();
+
+    if( time_out == MSS_MAC_NONBLOCKING )
+    {
+        /* Check if enough descriptors are free */
+        if( (g_mss_mac.tx_ring_size - g_mss_mac.tx_pending) < needed )
+        {
+            error = MAC_BUFFER_IS_FULL;
+        }
+    }
+    else
+    {
+        /* Wait until descriptors are free */
+        if( time_out != MSS_MAC_BLOCKING ) {
+            MAC_set_time_out( time_out );
+        }
+
+        while( ((g_mss_mac.tx_ring_size - g_mss_mac.tx_pending) < needed)
+                && (error == MAC_OK) )
+        {
+             /* transmit poll demand */
+            MAC->CSR1 = 1u;
+
+            if(time_out != MSS_MAC_BLOCKING){
+                if(MAC_get_time_out() == 0u) {
+                    error = MAC_TIME_OUT;
+                }
+            }
+
+            if( (error == MAC_OK) && (g_mss_mac.wait_hook != NULL_wait_hook) ) {
+                g_mss_mac.wait_hook();
+            }
+
+            (void)MSS_MAC_tx_reclaim();
+        }
+    }
+
+    return error;
+}
+
+
 /***************************************************************************//**
  * Stops transmission.
  * Function will wait until transmit operation enters stop state.
@@ -1434,12 +1869,7 @@ MAC_get_time_out
  */
 static void MAC_memset(uint8_t *s, uint8_t c, uint32_t n)
 {
-    uint8_t *sb = s;
-
-    while( n > 0u ) {
-        n--;
-        sb[n] = c;
-    }
+    (void)fast_memset( s, c, n );
 }
 
 /***************************************************************************//**
@@ -1455,6 +1885,10 @@ static void MAC_memset_All(MAC_instance_t *s, uint32_t c)
     s->last_error = (int8_t)c;
     s->last_timer_value = (uint16_t)c;
     s->listener = NULL_callback;
+    s->wait_hook = NULL_wait_hook;
+    s->capture_hook = NULL_capture_hook;
+    s->tx_ring_size = c;
+    s->rx_ring_size = c;
        MAC_memset( s->mac_address, (uint8_t)c, 6u );
        MAC_memset( s->mac_filter_data, (uint8_t)c, 90u );
     s->phy_address = (uint8_t)c;
@@ -1494,12 +1928,16 @@ static void MAC_memset_All(MAC_instance_t *s, uint32_t c)
         MAC_memset( s->tx_buffers[count], (uint8_t)c, MSS_TX_BUFF_SIZE );
     }
     s->tx_desc_index = c;
+    s->tx_reclaim_index = c;
+    s->tx_pending = c;
     for(count = 0; count < TX_RING_SIZE ;count++)
     {
         s->tx_descriptors[count].buffer_1 = c;
         s->tx_descriptors[count].buffer_2 = c;
         s->tx_descriptors[count].descriptor_0 = c;
         s->tx_descriptors[count].descriptor_1 = c;
+        s->tx_complete[count] = NULL_tx_complete;
+        s->tx_context[count] = NULL_context;
     }
 }
 
@@ -1511,12 +1949,7 @@ static void MAC_memset_All(MAC_instance_t *s, uint32_t c)
  */
 static void MAC_memcpy(uint8_t *dest, const uint8_t *src, uint32_t n)
 {
-    uint8_t *d = dest;
-
-    while( n > 0u ) {
-        n--;
-        d[n] = src[n];
-    }
+    (void)fast_memcpy( dest, src, n );
 }
 
 #ifdef __cplusplus
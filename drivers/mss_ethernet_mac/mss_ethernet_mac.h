@@ -176,6 +176,56 @@ extern "C" {
  */
 typedef void (*MSS_MAC_callback_t)(uint32_t events);
 
+/***************************************************************************//**
+ * Transmit completion function type used with MSS_MAC_tx_packet_sg(). The
+ * function is called once the MAC has released every descriptor of the frame,
+ * which is the point from which the buffers making up the frame may be reused
+ * or freed by the application. It is called from MSS_MAC_tx_reclaim() which is
+ * itself invoked by the transmit functions, so it must not call back into the
+ * transmit API. The parameter is the context given to MSS_MAC_tx_packet_sg().
+ */
+typedef void (*MSS_MAC_tx_complete_t)(void * context);
+
+/***************************************************************************//**
+ * Wait hook function type used with MSS_MAC_set_wait_hook(). The hook is
+ * called repeatedly while a transmit or receive function waits for a
+ * descriptor, so that an RTOS task can block instead of spinning. It is only
+ * called from the context of the transmit and receive functions.
+ */
+typedef void (*MSS_MAC_wait_hook_t)(void);
+
+/***************************************************************************//**
+ * Buffer segment used to describe one part of a frame given to
+ * MSS_MAC_tx_packet_sg(). A frame is typically made of a header segment built
+ * by the protocol stack followed by one or more payload segments which are
+ * transmitted straight from application memory without being copied.
+ */
+typedef struct
+{
+    const uint8_t * data;       /**< start of the segment */
+    uint16_t        length;     /**< number of bytes in the segment */
+} mss_mac_tx_segment_t;
+
+/***************************************************************************//**
+ * Directions reported to the capture hook.
+ */
+#define MSS_MAC_CAPTURE_RX      0u
+#define MSS_MAC_CAPTURE_TX      1u
+
+/***************************************************************************//**
+ * Capture hook function type used with MSS_MAC_set_capture_hook(). The hook
+ * is given every frame handed to or received from the MAC, as a list of
+ * segments in wire order; received frames are a single segment. It runs in
+ * the context of the transmit and receive functions and must not keep the
+ * segment pointers.
+ */
+typedef void (*MSS_MAC_capture_t)
+(
+    uint32_t direction,
+    const mss_mac_tx_segment_t * segments,
+    uint8_t segment_count
+);
+
 /***************************************************************************//**
  * Statistics counter identifiers are used with MAC_get_statistics routine to 
  * receive the count of the requested errors/interrupts occurrences.
@@ -373,6 +423,55 @@ MSS_MAC_tx_packet
 );
 
 
+/***************************************************************************//**
+ * Sends a packet made of several buffer segments without copying them.
+ * The segments are attached directly to the transmit descriptors, two segments
+ * per descriptor, and the frame is spread across as many consecutive
+ * descriptors as needed. The buffers must therefore remain valid and unchanged
+ * until the completion function is called. The total length of the segments
+ * must not exceed MSS_MAX_PACKET_SIZE and the number of segments must not
+ * exceed twice the number of transmit descriptors.
+ *
+ * @param segments      array of segments making up the frame, in wire order.
+ * @param segment_count number of entries in segments.
+ * @param complete      function called once the frame has left the MAC, may
+ *                      be NULL.
+ * @param context       parameter given to the complete function.
+ * @param time_out      Time out value for transmision, same meaning as for
+ *                      MSS_MAC_tx_packet().
+ * @return              Returns 0 if time out occurs otherwise returns size
+ *                      of the packet. The complete function is not called
+ *                      when 0 is returned.
+ * @see   MSS_MAC_tx_packet(), MSS_MAC_tx_reclaim()
+ */
+int32_t
+MSS_MAC_tx_packet_sg
+(
+    const mss_mac_tx_segment_t * segments,
+    uint8_t segment_count,
+    MSS_MAC_tx_complete_t complete,
+    void * context,
+    uint32_t time_out
+);
+
+
+/***************************************************************************//**
+ * Reclaims the transmit descriptors released by the MAC.
+ * Updates the transmit statistics and calls the completion functions of the
+ * frames sent since the last call. The transmit functions call it themselves;
+ * applications using MSS_MAC_tx_packet_sg() should also call it on
+ * MSS_MAC_EVENT_PACKET_SEND so that buffers are released without waiting for
+ * the next transmission.
+ *
+ * @return              Number of frames completed by this call.
+ */
+uint32_t
+MSS_MAC_tx_reclaim
+(
+    void
+);
+
+
 /***************************************************************************//**
  * Returns available packet's size.
  *
@@ -561,6 +660,101 @@ MSS_MAC_set_callback
 );
 
 
+/***************************************************************************//**
+ * Enables the receive interrupt.
+ * Used together with MSS_MAC_disable_rx_irq() to poll the receive ring while
+ * frames keep arriving and to fall back on interrupts once it is empty. May be
+ * called from the event listener.
+ */
+void
+MSS_MAC_enable_rx_irq
+(
+    void
+);
+
+
+/***************************************************************************//**
+ * Disables the receive interrupt.
+ * Transmit interrupts are not affected.
+ */
+void
+MSS_MAC_disable_rx_irq
+(
+    void
+);
+
+
+/***************************************************************************//**
+ * Sets the number of receive and transmit descriptors in use.
+ * Both rings are reset: any frame not yet received is lost and frames queued
+ * for transmission are dropped without calling their completion function. It
+ * should therefore be called right after MSS_MAC_init().
+ *
+ * @param rx_size       number of receive descriptors, from 1 to RX_RING_SIZE.
+ * @param tx_size       number of transmit descriptors, from 1 to TX_RING_SIZE.
+ */
+void
+MSS_MAC_set_ring_sizes
+(
+    uint32_t rx_size,
+    uint32_t tx_size
+);
+
+
+/***************************************************************************//**
+ * Sets the interrupt mitigation parameters.
+ * The MAC delays its receive and transmit interrupts until either the given
+ * number of frames has been handled or the given timer has expired, so that
+ * bursts of frames are handled with a single interrupt. Zero frames and zero
+ * timer disable mitigation for that direction.
+ * The timers are expressed in units of the mitigation cycle selected by
+ * cycle_size, see the Core10/100 handbook (CSR11).
+ *
+ * @param rx_frames     number of received frames before an interrupt, 0 to 7.
+ * @param rx_timer      receive timer, 0 to 15.
+ * @param tx_frames     number of transmitted frames before an interrupt, 0 to 7.
+ * @param tx_timer      transmit timer, 0 to 15.
+ * @param cycle_size    value of the CS field, 0 or 1.
+ */
+void
+MSS_MAC_set_interrupt_mitigation
+(
+    uint8_t rx_frames,
+    uint8_t rx_timer,
+    uint8_t tx_frames,
+    uint8_t tx_timer,
+    uint8_t cycle_size
+);
+
+
+/***************************************************************************//**
+ * Sets the wait hook.
+ * The hook is called from the waiting loops of MSS_MAC_tx_packet(),
+ * MSS_MAC_tx_packet_sg(), MSS_MAC_rx_packet() and MSS_MAC_rx_packet_ptrset().
+ * Assigning NULL pointer restores busy waiting.
+ *
+ * @param hook          function pointer to a MSS_MAC_wait_hook_t function
+ */
+void
+MSS_MAC_set_wait_hook
+(
+    MSS_MAC_wait_hook_t hook
+);
+
+
+/***************************************************************************//**
+ * Sets the capture hook.
+ * Assigning NULL pointer as the hook disables capture.
+ *
+ * @param hook          function pointer to a MSS_MAC_capture_t function
+ */
+void
+MSS_MAC_set_capture_hook
+(
+    MSS_MAC_capture_t hook
+);
+
+
 /***************************************************************************//**
  * Returns description of latest error happened.
  *
@@ -62,11 +62,22 @@ typedef struct {
     uint32_t    time_out_value;            /**< Time out value */
     MSS_MAC_callback_t listener;            /**< Pointer to the call-back function to be triggered 
                                             when a package is received*/
+    MSS_MAC_wait_hook_t wait_hook;          /**< Function called while waiting for descriptors*/
+    MSS_MAC_capture_t capture_hook;         /**< Function given every frame sent or received*/
+    uint32_t    tx_ring_size;           /**< number of transmit descriptors in use*/
+    uint32_t    rx_ring_size;           /**< number of receive descriptors in use*/
 
     /* transmit related info: */
     uint32_t    tx_desc_index;          /**< index of the transmit descriptor getting used*/
+    uint32_t    tx_reclaim_index;       /**< index of the oldest transmit descriptor not yet
+                                            reclaimed from the MAC*/
+    uint32_t    tx_pending;             /**< number of transmit descriptors handed to the MAC
+                                            and not yet reclaimed*/
     uint8_t     tx_buffers[TX_RING_SIZE][MSS_TX_BUFF_SIZE];/**< array of transmit buffers*/
     MAC_descriptor_t tx_descriptors[TX_RING_SIZE];/**< array of transmit descriptors*/
+    MSS_MAC_tx_complete_t tx_complete[TX_RING_SIZE];/**< completion call-back attached to the
+                                            last descriptor of each frame*/
+    void *      tx_context[TX_RING_SIZE];/**< context passed to the completion call-back*/
 
     /* receive related info: */
     uint32_t    rx_desc_index;          /**< index of the receive descriptor getting used*/
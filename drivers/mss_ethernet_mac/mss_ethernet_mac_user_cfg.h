@@ -17,6 +17,8 @@
 
 #define BUS_ARBITRATION_SCHEME 0
 #define PROGRAMMABLE_BURST_LENGTH 0
+/* RX_RING_SIZE and TX_RING_SIZE are the maximum ring sizes, memory is reserved
+   for them. MSS_MAC_set_ring_sizes() selects how many descriptors are used. */
 #define RX_RING_SIZE 4
 #define SETUP_FRAME_TIME_OUT 10000
 #define STATE_CHANGE_TIME_OUT 10000
@@ -74,6 +74,28 @@ static uint8_t g_pdma_next_channel[NB_OF_PDMA_CHANNELS];
 static uint8_t g_pdma_started_a[NB_OF_PDMA_CHANNELS];
 static uint8_t g_pdma_started_b[NB_OF_PDMA_CHANNELS];
 static pdma_channel_isr_t g_pdma_isr_table[NB_OF_PDMA_CHANNELS];
+static const void * g_pdma_owner[NB_OF_PDMA_CHANNELS];
+static uint8_t g_pdma_initialized = 0U;
+
+/*-------------------------------------------------------------------------*//**
+ * Scatter-gather list running on a channel. Entries are loaded alternately
+ * into buffers A and B; at most two are in flight, the oldest completing
+ * first.
+ */
+typedef struct
+{
+    const pdma_sg_entry_t * list;   /* null when no list runs */
+    uint32_t count;
+    uint32_t options;
+    pdma_sg_handler_t handler;
+    uint32_t oldest_entry;          /* entry of the buffer completing next */
+    uint32_t next_entry;            /* entry to load next */
+    uint32_t to_load;               /* entries not loaded yet, without PDMA_SG_LOOP */
+    uint8_t oldest_buffer;          /* NEXT_CHANNEL_A or NEXT_CHANNEL_B */
+    uint8_t in_flight;
+} pdma_sg_state_t;
+
+static pdma_sg_state_t g_pdma_sg[NB_OF_PDMA_CHANNELS];
 static const uint16_t g_pdma_status_mask[NB_OF_PDMA_CHANNELS] =
 {
     (uint16_t)0x0003, /* PDMA_CHANNEL_0 */
@@ -95,6 +117,13 @@ void PDMA_init( void )
 {
     int32_t i;
     
+    /* Drivers sharing the PDMA each call this function. */
+    if ( g_pdma_initialized )
+    {
+        return;
+    }
+    g_pdma_initialized = 1U;
+    
     /* Enable PDMA master access to comms matrix. */
     SYSREG->AHB_MATRIX_CR |= PDMA_MASTER_ENABLE;
     
@@ -114,6 +143,8 @@ void PDMA_init( void )
         g_pdma_started_a[i] = CHANNEL_STOPPED;
         g_pdma_started_b[i] = CHANNEL_STOPPED;
         g_pdma_isr_table[i] = 0;
+        g_pdma_owner[i] = 0;
+        g_pdma_sg[i].list = 0;
     }
 }
 
@@ -291,6 +322,8 @@ uint32_t PDMA_status
 #define CHANNEL_6_STATUS_BITS_MASK     (uint16_t)0x3000
 #define CHANNEL_7_STATUS_BITS_MASK     (uint16_t)0xC000
 
+static void sg_reload( pdma_channel_id_t channel_id );
+
 static pdma_channel_id_t get_channel_id_from_status
 (
     uint16_t status
@@ -354,7 +387,11 @@ void DMA_IRQHandler( void )
     do {
         channel_id = get_channel_id_from_status( status );
         status &= (uint16_t)~g_pdma_status_mask[channel_id];
-        if ( 0 != g_pdma_isr_table[channel_id])
+        if ( 0 != g_pdma_sg[channel_id].list )
+        {
+            sg_reload( channel_id );
+        }
+        else if ( 0 != g_pdma_isr_table[channel_id])
         {
             g_pdma_isr_table[channel_id]();
         }
@@ -399,14 +436,349 @@ void PDMA_clear_irq
     pdma_channel_id_t channel_id
 )
 {
-    /* Clear interrupt in PDMA controller. */
-    PDMA->CHANNEL[channel_id].CRTL |= CLEAR_PORT_A_DONE_MASK;
-    PDMA->CHANNEL[channel_id].CRTL |= CLEAR_PORT_B_DONE_MASK;
+    /* Clear interrupt in PDMA controller. A buffer whose completion is
+       cleared here is free, PDMA_load_next_buffer() must not wait for it. */
+    if ( PDMA->CHANNEL[channel_id].STATUS & PORT_A_COMPLETE_MASK )
+    {
+        PDMA->CHANNEL[channel_id].CRTL |= CLEAR_PORT_A_DONE_MASK;
+        g_pdma_started_a[channel_id] = CHANNEL_STOPPED;
+    }
+    if ( PDMA->CHANNEL[channel_id].STATUS & PORT_B_COMPLETE_MASK )
+    {
+        PDMA->CHANNEL[channel_id].CRTL |= CLEAR_PORT_B_DONE_MASK;
+        g_pdma_started_b[channel_id] = CHANNEL_STOPPED;
+    }
     
     /* Clear interrupt in Cortex-M3 NVIC. */
     NVIC_ClearPendingIRQ( DMA_IRQn );
 }
 
+/***************************************************************************//**
+ * See mss_pdma.h for description of this function.
+ */
+int32_t PDMA_allocate_channel
+(
+    pdma_src_dest_t src_dest,
+    uint32_t channel_cfg,
+    uint8_t write_adjust,
+    const void * owner
+)
+{
+    int32_t i;
+    uint32_t primask;
+    
+    ASSERT( owner != 0 );
+    
+    primask = __get_PRIMASK();
+    __disable_irq();
+    for ( i = 0; i < NB_OF_PDMA_CHANNELS; ++i )
+    {
+        if ( 0 == g_pdma_owner[i] )
+        {
+            g_pdma_owner[i] = owner;
+            break;
+        }
+    }
+    __set_PRIMASK( primask );
+    
+    if ( NB_OF_PDMA_CHANNELS == i )
+    {
+        return PDMA_NO_CHANNEL;
+    }
+    
+    g_pdma_isr_table[i] = 0;
+    g_pdma_sg[i].list = 0;
+    g_pdma_next_channel[i] = NEXT_CHANNEL_A;
+    g_pdma_started_a[i] = CHANNEL_STOPPED;
+    g_pdma_started_b[i] = CHANNEL_STOPPED;
+    PDMA_configure( (pdma_channel_id_t)i, src_dest, channel_cfg, write_adjust );
+    
+    return i;
+}
+
+/***************************************************************************//**
+ * See mss_pdma.h for description of this function.
+ */
+void PDMA_free_channel
+(
+    pdma_channel_id_t channel_id,
+    const void * owner
+)
+{
+    ASSERT( g_pdma_owner[channel_id] == owner );
+    
+    PDMA_stop_sg( channel_id );
+    
+    /* The reset clears the configuration, the interrupt enable included. */
+    PDMA->CHANNEL[channel_id].CRTL |= CHANNEL_RESET_MASK;
+    PDMA->CHANNEL[channel_id].CRTL &= ~CHANNEL_RESET_MASK;
+    g_pdma_isr_table[channel_id] = 0;
+    g_pdma_owner[channel_id] = 0;
+}
+
+/***************************************************************************//**
+ * See mss_pdma.h for description of this function.
+ */
+const void * PDMA_get_channel_owner
+(
+    pdma_channel_id_t channel_id
+)
+{
+    return g_pdma_owner[channel_id];
+}
+
+/***************************************************************************//**
+ * Loads a scatter-gather entry into buffer A or B of a channel.
+ */
+static void sg_load
+(
+    pdma_channel_id_t channel_id,
+    uint8_t buffer,
+    const pdma_sg_entry_t * entry
+)
+{
+    if ( NEXT_CHANNEL_A == buffer )
+    {
+        PDMA->CHANNEL[channel_id].BUFFER_A_SRC_ADDR = entry->src_addr;
+        PDMA->CHANNEL[channel_id].BUFFER_A_DEST_ADDR = entry->dest_addr;
+        PDMA->CHANNEL[channel_id].BUFFER_A_TRANSFER_COUNT = entry->transfer_count;
+        g_pdma_next_channel[channel_id] = NEXT_CHANNEL_B;
+        g_pdma_started_a[channel_id] = CHANNEL_STARTED;
+    }
+    else
+    {
+        PDMA->CHANNEL[channel_id].BUFFER_B_SRC_ADDR = entry->src_addr;
+        PDMA->CHANNEL[channel_id].BUFFER_B_DEST_ADDR = entry->dest_addr;
+        PDMA->CHANNEL[channel_id].BUFFER_B_TRANSFER_COUNT = entry->transfer_count;
+        g_pdma_next_channel[channel_id] = NEXT_CHANNEL_A;
+        g_pdma_started_b[channel_id] = CHANNEL_STARTED;
+    }
+}
+
+/***************************************************************************//**
+ * Loads the next entry of a scatter-gather list, if any, into a buffer.
+ * Returns 1 if an entry was loaded.
+ */
+static uint32_t sg_load_next
+(
+    pdma_channel_id_t channel_id,
+    uint8_t buffer
+)
+{
+    pdma_sg_state_t * sg = &g_pdma_sg[channel_id];
+    
+    if ( ( 0U == ( sg->options & PDMA_SG_LOOP ) ) && ( 0U == sg->to_load ) )
+    {
+        return 0U;
+    }
+    sg_load( channel_id, buffer, &sg->list[sg->next_entry] );
+    if ( ++sg->next_entry == sg->count )
+    {
+        sg->next_entry = 0U;
+    }
+    if ( sg->to_load > 0U )
+    {
+        --sg->to_load;
+    }
+    ++sg->in_flight;
+    return 1U;
+}
+
+/***************************************************************************//**
+ * PDMA interrupt of a channel running a scatter-gather list: each buffer
+ * completed, oldest first, is cleared and reloaded with the next entry.
+ */
+static void sg_reload( pdma_channel_id_t channel_id )
+{
+    pdma_sg_state_t * sg = &g_pdma_sg[channel_id];
+    uint32_t entry;
+    uint32_t last;
+    
+    while ( sg->in_flight > 0U )
+    {
+        if ( NEXT_CHANNEL_A == sg->oldest_buffer )
+        {
+            if ( 0U == ( PDMA->CHANNEL[channel_id].STATUS & PORT_A_COMPLETE_MASK ) )
+            {
+                break;
+            }
+            PDMA->CHANNEL[channel_id].CRTL |= CLEAR_PORT_A_DONE_MASK;
+            g_pdma_started_a[channel_id] = CHANNEL_STOPPED;
+        }
+        else
+        {
+            if ( 0U == ( PDMA->CHANNEL[channel_id].STATUS & PORT_B_COMPLETE_MASK ) )
+            {
+                break;
+            }
+            PDMA->CHANNEL[channel_id].CRTL |= CLEAR_PORT_B_DONE_MASK;
+            g_pdma_started_b[channel_id] = CHANNEL_STOPPED;
+        }
+        --sg->in_flight;
+        entry = sg->oldest_entry;
+        
+        sg_load_next( channel_id, sg->oldest_buffer );
+        sg->oldest_buffer ^= 1U;
+        if ( ++sg->oldest_entry == sg->count )
+        {
+            sg->oldest_entry = 0U;
+        }
+        
+        /* The handler may start another list on the channel. */
+        last = ( 0U == sg->in_flight );
+        if ( last )
+        {
+            sg->list = 0;
+        }
+        if ( ( 0 != sg->handler ) && ( last || ( sg->options & PDMA_SG_NOTIFY_EACH ) ) )
+        {
+            sg->handler( channel_id, entry );
+        }
+        if ( last )
+        {
+            break;
+        }
+    }
+}
+
+/***************************************************************************//**
+ * See mss_pdma.h for description of this function.
+ */
+void PDMA_start_sg
+(
+    pdma_channel_id_t channel_id,
+    const pdma_sg_entry_t * list,
+    uint32_t count,
+    uint32_t options,
+    pdma_sg_handler_t handler
+)
+{
+    pdma_sg_state_t * sg = &g_pdma_sg[channel_id];
+    uint32_t primask;
+    
+    ASSERT( ( list != 0 ) && ( count > 0U ) );
+    
+    /* The interrupt must not see a half started list. */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    
+    sg->list = list;
+    sg->count = count;
+    sg->options = options;
+    sg->handler = handler;
+    sg->oldest_entry = 0U;
+    sg->next_entry = ( count > 1U ) ? 1U : 0U;
+    sg->to_load = count - 1U;
+    sg->in_flight = 1U;
+    
+    /* PDMA_start() picks the buffer the channel uses next. */
+    PDMA_start( channel_id, list[0].src_addr, list[0].dest_addr, list[0].transfer_count );
+    sg->oldest_buffer = ( NEXT_CHANNEL_B == g_pdma_next_channel[channel_id] ) ? NEXT_CHANNEL_A
+                                                                            : NEXT_CHANNEL_B;
+    sg_load_next( channel_id, sg->oldest_buffer ^ 1U );
+    
+    PDMA->CHANNEL[channel_id].CRTL |= PDMA_IRQ_ENABLE_MASK;
+    NVIC_EnableIRQ( DMA_IRQn );
+    
+    __set_PRIMASK( primask );
+}
+
+/***************************************************************************//**
+ * See mss_pdma.h for description of this function.
+ */
+void PDMA_stop_sg
+(
+    pdma_channel_id_t channel_id
+)
+{
+    uint32_t primask;
+    
+    primask = __get_PRIMASK();
+    __disable_irq();
+    
+    if ( 0 != g_pdma_sg[channel_id].list )
+    {
+        PDMA_stop( channel_id );
+    }
+    
+    __set_PRIMASK( primask );
+}
+
+/***************************************************************************//**
+ * See mss_pdma.h for description of this function.
+ */
+void PDMA_stop
+(
+    pdma_channel_id_t channel_id
+)
+{
+    uint32_t ctrl;
+    uint32_t primask;
+    
+    primask = __get_PRIMASK();
+    __disable_irq();
+    
+    /* Reset the channel to drop the loaded buffers, keeping its
+       configuration. */
+    ctrl = PDMA->CHANNEL[channel_id].CRTL & ~( CHANNEL_RESET_MASK | PAUSE_MASK |
+                                              CLEAR_PORT_A_DONE_MASK |
+                                              CLEAR_PORT_B_DONE_MASK );
+    PDMA->CHANNEL[channel_id].CRTL |= CHANNEL_RESET_MASK;
+    PDMA->CHANNEL[channel_id].CRTL &= ~CHANNEL_RESET_MASK;
+    PDMA->CHANNEL[channel_id].CRTL = ctrl;
+    
+    g_pdma_sg[channel_id].list = 0;
+    g_pdma_sg[channel_id].in_flight = 0U;
+    g_pdma_next_channel[channel_id] = NEXT_CHANNEL_A;
+    g_pdma_started_a[channel_id] = CHANNEL_STOPPED;
+    g_pdma_started_b[channel_id] = CHANNEL_STOPPED;
+    
+    __set_PRIMASK( primask );
+}
+
+/***************************************************************************//**
+ * See mss_pdma.h for description of this function.
+ */
+uint32_t PDMA_sg_busy
+(
+    pdma_channel_id_t channel_id
+)
+{
+    return ( 0 != g_pdma_sg[channel_id].list ) ? 1U : 0U;
+}
+
+/***************************************************************************//**
+ * See mss_pdma.h for description of this function.
+ */
+void PDMA_poll
+(
+    pdma_channel_id_t channel_id
+)
+{
+    uint32_t enabled;
+    
+    /* The interrupt must not handle the channel at the same time. */
+    enabled = NVIC->ISER[(uint32_t)DMA_IRQn >> 5] & ( 1UL << ( (uint32_t)DMA_IRQn & 0x1FUL ) );
+    NVIC_DisableIRQ( DMA_IRQn );
+    
+    if ( 0U != ( PDMA->BUFFER_STATUS & g_pdma_status_mask[channel_id] ) )
+    {
+        if ( 0 != g_pdma_sg[channel_id].list )
+        {
+            sg_reload( channel_id );
+        }
+        else if ( 0 != g_pdma_isr_table[channel_id] )
+        {
+            g_pdma_isr_table[channel_id]();
+        }
+    }
+    
+    if ( 0U != enabled )
+    {
+        NVIC_EnableIRQ( DMA_IRQn );
+    }
+}
+
 #ifdef __cplusplus
 }
 #endif
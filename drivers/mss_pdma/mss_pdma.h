@@ -75,6 +75,12 @@
   A DMA transfer can be paused and resumed through calls to functions PDMA_pause()
   and PDMA_resume().
   
+  Drivers sharing the PDMA can take free channels with PDMA_allocate_channel()
+  instead of fixed channel numbers, and give them back with PDMA_free_channel().
+  Longer chains of transfers than the two buffers of a channel are run with
+  PDMA_start_sg(), which reloads each buffer from the PDMA interrupt as soon as
+  it completes.
+  
   Your application can manage DMA transfers using interrupts through the use of
   the following functions:
     - PDMA_set_irq_handler()
@@ -251,6 +257,8 @@ typedef void (*pdma_channel_isr_t)( void );
   internal data. It resets the PDMA and it also clears any pending PDMA
   interrupts in the Cortex-M3 interrupt controller. When the function exits, it
   takes the PDMA block out of reset.
+  Only the first call resets the PDMA: drivers sharing it can each call
+  PDMA_init() without stopping the channels already allocated by others.
  */
 void PDMA_init( void );
 
@@ -687,6 +695,8 @@ void PDMA_set_irq_handler
 /***************************************************************************//**
   The PDMA_clear_irq() function clears interrupts for a specific PDMA channel.
   This function also clears the PDMA interrupt in the Cortex-M3 NVIC.
+  The buffers found complete are marked free so that a following call to
+  PDMA_load_next_buffer() does not wait for them.
  
   @param channel_id
     The channel_id parameter identifies the PDMA channel used by the function.
@@ -696,6 +706,195 @@ void PDMA_clear_irq
     pdma_channel_id_t channel_id
 );
 
+/***************************************************************************//**
+  The PDMA_NO_CHANNEL constant is returned by PDMA_allocate_channel() when all
+  the channels are in use.
+ */
+#define PDMA_NO_CHANNEL     (-1)
+
+/***************************************************************************//**
+  The PDMA_allocate_channel() function takes a free PDMA channel for the owner
+  given as parameter and configures it as PDMA_configure() would. Drivers
+  allocating their channels instead of using fixed channel numbers can share
+  the PDMA without channel assignments having to be agreed upon at build time.
+  The channel's interrupt is disabled until a handler is set for it.
+ 
+  @param src_dest
+    The src_dest parameter specifies the source or destination of the
+    transfers, see PDMA_configure().
+ 
+  @param channel_cfg
+    The channel_cfg parameter specifies the priority, transfer size and address
+    increments of the channel, see PDMA_configure().
+ 
+  @param write_adjust
+    The write_adjust parameter specifies the posted writes adjustment, see
+    PDMA_configure().
+ 
+  @param owner
+    The owner parameter identifies the user of the channel, any non null
+    pointer unique to it. It must be given back to PDMA_free_channel().
+ 
+  @return
+    The channel allocated, or PDMA_NO_CHANNEL when all channels are in use.
+ */
+int32_t PDMA_allocate_channel
+(
+    pdma_src_dest_t src_dest,
+    uint32_t channel_cfg,
+    uint8_t write_adjust,
+    const void * owner
+);
+
+/***************************************************************************//**
+  The PDMA_free_channel() function stops a channel allocated with
+  PDMA_allocate_channel(), removes its interrupt handler and makes it
+  available again.
+ 
+  @param channel_id
+    The channel_id parameter identifies the PDMA channel to free.
+ 
+  @param owner
+    The owner parameter must be the one given when the channel was allocated.
+ */
+void PDMA_free_channel
+(
+    pdma_channel_id_t channel_id,
+    const void * owner
+);
+
+/***************************************************************************//**
+  The PDMA_get_channel_owner() function returns the owner of a channel, or
+  null (0) when the channel is free.
+ 
+  @param channel_id
+    The channel_id parameter identifies the PDMA channel.
+ */
+const void * PDMA_get_channel_owner
+(
+    pdma_channel_id_t channel_id
+);
+
+/***************************************************************************//**
+  The pdma_sg_entry_t type describes one transfer of a scatter-gather list
+  run by PDMA_start_sg().
+ */
+typedef struct __pdma_sg_entry_t
+{
+    uint32_t src_addr;
+    uint32_t dest_addr;
+    uint16_t transfer_count;
+} pdma_sg_entry_t;
+
+/***************************************************************************//**
+  The pdma_sg_handler_t type is a pointer to the function called from the PDMA
+  interrupt as the entries of a scatter-gather list complete.
+  The entry parameter is the index in the list of the entry completed.
+ */
+typedef void (*pdma_sg_handler_t)( pdma_channel_id_t channel_id, uint32_t entry );
+
+/***************************************************************************//**
+  Options of PDMA_start_sg():
+    - PDMA_SG_LOOP starts the list again from its first entry after the last,
+      until PDMA_stop_sg() is called.
+    - PDMA_SG_NOTIFY_EACH calls the handler after every entry instead of only
+      after the last one.
+ */
+#define PDMA_SG_LOOP            0x01u
+#define PDMA_SG_NOTIFY_EACH     0x02u
+
+/***************************************************************************//**
+  The PDMA_start_sg() function runs a list of transfers on a PDMA channel
+  without processor involvement between them. The first two entries are loaded
+  into the channel's buffers A and B; the PDMA interrupt then reloads each
+  buffer with the next entry as soon as it completes, so the channel goes from
+  one transfer to the next as with PDMA_load_next_buffer(). The PDMA interrupt
+  is enabled for the channel and the handler registered with
+  PDMA_set_irq_handler(), if any, is not called while the list runs.
+  The list is not copied, it must remain unchanged until the list completes or
+  PDMA_stop_sg() is called. The PDMA interrupt must have a priority allowing
+  the reload before the channel runs out of its current buffer.
+ 
+  @param channel_id
+    The channel_id parameter identifies the PDMA channel, configured with
+    PDMA_configure() or allocated with PDMA_allocate_channel().
+ 
+  @param list
+    The list parameter is a pointer to the transfers to perform.
+ 
+  @param count
+    The count parameter is the number of entries of the list.
+ 
+  @param options
+    The options parameter is a combination of PDMA_SG_LOOP and
+    PDMA_SG_NOTIFY_EACH, or 0.
+ 
+  @param handler
+    The handler parameter is called when the last entry completes, or when
+    every entry completes with PDMA_SG_NOTIFY_EACH. It can be null (0).
+ */
+void PDMA_start_sg
+(
+    pdma_channel_id_t channel_id,
+    const pdma_sg_entry_t * list,
+    uint32_t count,
+    uint32_t options,
+    pdma_sg_handler_t handler
+);
+
+/***************************************************************************//**
+  The PDMA_stop_sg() function stops the scatter-gather list running on a
+  channel. The entry in progress is abandoned.
+ 
+  @param channel_id
+    The channel_id parameter identifies the PDMA channel.
+ */
+void PDMA_stop_sg
+(
+    pdma_channel_id_t channel_id
+);
+
+/***************************************************************************//**
+  The PDMA_stop() function stops any transfer on a channel, with or without a
+  scatter-gather list, and drops the buffers loaded. The configuration of the
+  channel is kept.
+ 
+  @param channel_id
+    The channel_id parameter identifies the PDMA channel.
+ */
+void PDMA_stop
+(
+    pdma_channel_id_t channel_id
+);
+
+/***************************************************************************//**
+  The PDMA_sg_busy() function returns 1 while a scatter-gather list runs on a
+  channel, 0 once its last entry completed or it was stopped.
+ 
+  @param channel_id
+    The channel_id parameter identifies the PDMA channel.
+ */
+uint32_t PDMA_sg_busy
+(
+    pdma_channel_id_t channel_id
+);
+
+/***************************************************************************//**
+  The PDMA_poll() function does for one channel what the PDMA interrupt does
+  when a buffer of the channel has completed: it reloads its scatter-gather
+  list or calls the handler registered with PDMA_set_irq_handler(). It lets a
+  transfer complete while the PDMA interrupt cannot be taken, before the
+  FreeRTOS scheduler starts for instance, when the critical sections entered
+  so far leave BASEPRI raised.
+ 
+  @param channel_id
+    The channel_id parameter identifies the PDMA channel.
+ */
+void PDMA_poll
+(
+    pdma_channel_id_t channel_id
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,6 +7,7 @@
  * SVN $Revision: 2176 $
  * SVN $Date: 2010-02-15 21:04:22 +0000 (Mon, 15 Feb 2010) $
  */
+#include <string.h>
 #include "mss_spi.h"
 #include "../../CMSIS/mss_assert.h"
 
@@ -391,6 +392,220 @@ void MSS_SPI_transfer_block
     }
 }
 
+/***************************************************************************//**
+ * Byte of a transfer made of a command followed by data. Bytes past the
+ * command are taken from data, or are 0x00 when there is no data to send.
+ */
+static __INLINE uint8_t tx_byte
+(
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    const uint8_t * tx_buffer,
+    uint32_t idx
+)
+{
+    if ( idx < cmd_byte_size )
+    {
+        return cmd_buffer[idx];
+    }
+    return ( tx_buffer != 0 ) ? tx_buffer[idx - cmd_byte_size] : 0x00U;
+}
+
+/***************************************************************************//**
+ * MSS_SPI_transfer_block_burst()
+ * See "mss_spi.h" for details of how to use this function.
+ */
+void MSS_SPI_transfer_block_burst
+(
+    mss_spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    const uint8_t * tx_buffer,
+    uint8_t * rd_buffer,
+    uint16_t data_byte_size,
+    uint8_t max_frame_bits
+)
+{
+    uint32_t transfer_size = (uint32_t)cmd_byte_size + data_byte_size;
+    uint32_t frame_bytes;
+    uint32_t frame_count;
+    uint32_t tx_frame = 0U;
+    uint32_t rx_frame = 0U;
+    uint32_t tx_idx = 0U;
+    uint32_t rx_idx = 0U;
+    uint32_t frame;
+    uint32_t byte_idx;
+    volatile uint32_t rx_raw;
+
+    ASSERT( (this_spi == &g_mss_spi0) || (this_spi == &g_mss_spi1) );
+
+    /* This function is only intended to be used with an SPI master. */
+    ASSERT( this_spi->hw_reg_bit->CTRL_MASTER == MSS_SPI_MODE_MASTER );
+
+    if ( transfer_size == 0U )
+    {
+        return;
+    }
+
+    /* Widest frame dividing the transfer. Frames go out most significant bit
+       first, so bytes packed from the most significant end of a frame are
+       sent in the same order as with 8 bit frames. */
+    if ( ( max_frame_bits >= 32U ) && ( ( transfer_size & 3U ) == 0U ) )
+    {
+        frame_bytes = 4U;
+    }
+    else if ( ( max_frame_bits >= 16U ) && ( ( transfer_size & 1U ) == 0U ) )
+    {
+        frame_bytes = 2U;
+    }
+    else
+    {
+        frame_bytes = 1U;
+    }
+    frame_count = transfer_size / frame_bytes;
+    ASSERT( frame_count <= ( TXRXDFCOUNT_MASK >> TXRXDFCOUNT_SHIFT ) );
+
+    this_spi->hw_reg_bit->CTRL_ENABLE = 0U;
+    this_spi->hw_reg->CONTROL = (this_spi->hw_reg->CONTROL & ~TXRXDFCOUNT_MASK) | ( (frame_count << TXRXDFCOUNT_SHIFT) & TXRXDFCOUNT_MASK);
+    this_spi->hw_reg->TXRXDF_SIZE = frame_bytes * 8U;
+    this_spi->hw_reg_bit->CTRL_ENABLE = 1U;
+
+    /* Flush the receive FIFO. */
+    while ( !this_spi->hw_reg_bit->STATUS_RX_FIFO_EMPTY )
+    {
+        rx_raw = this_spi->hw_reg->RX_DATA;
+    }
+
+    while ( rx_frame < frame_count )
+    {
+        /* Keep as many frames in flight as the receive FIFO can hold: the
+           transmit FIFO cannot be full then and the receive FIFO cannot
+           overflow, whatever the interrupts. */
+        while ( ( tx_frame < frame_count ) && ( ( tx_frame - rx_frame ) < RX_FIFO_SIZE ) )
+        {
+            frame = 0U;
+            for ( byte_idx = 0U; byte_idx < frame_bytes; ++byte_idx )
+            {
+                frame = ( frame << 8 ) | tx_byte( cmd_buffer, cmd_byte_size, tx_buffer, tx_idx );
+                ++tx_idx;
+            }
+            this_spi->hw_reg->TX_DATA = frame;
+            ++tx_frame;
+        }
+
+        while ( !this_spi->hw_reg_bit->STATUS_RX_FIFO_EMPTY )
+        {
+            rx_raw = this_spi->hw_reg->RX_DATA;
+            for ( byte_idx = frame_bytes; byte_idx > 0U; --byte_idx )
+            {
+                if ( ( rx_idx >= cmd_byte_size ) && ( rd_buffer != 0 ) )
+                {
+                    rd_buffer[rx_idx - cmd_byte_size] = (uint8_t)( rx_raw >> ( ( byte_idx - 1U ) * 8U ) );
+                }
+                ++rx_idx;
+            }
+            ++rx_frame;
+        }
+    }
+}
+
+/***************************************************************************//**
+ * Receives the bytes coming in while the command goes out.
+ */
+static uint8_t g_dma_cmd_discard[MSS_SPI_DMA_MAX_CMD_SIZE];
+
+/***************************************************************************//**
+ * MSS_SPI_dma_transfer_block()
+ * See "mss_spi.h" for details of how to use this function.
+ */
+void MSS_SPI_dma_transfer_block
+(
+    mss_spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    const uint8_t * tx_buffer,
+    uint8_t * rd_buffer,
+    uint16_t data_byte_size,
+    pdma_channel_id_t tx_channel,
+    pdma_channel_id_t rx_channel
+)
+{
+    uint32_t tx_reg = (uint32_t)&this_spi->hw_reg->TX_DATA;
+    uint32_t rx_reg = (uint32_t)&this_spi->hw_reg->RX_DATA;
+    uint32_t rx_done_mask;
+    volatile uint32_t rx_raw;
+
+    ASSERT( (this_spi == &g_mss_spi0) || (this_spi == &g_mss_spi1) );
+    ASSERT( cmd_byte_size <= MSS_SPI_DMA_MAX_CMD_SIZE );
+    ASSERT( (uint32_t)cmd_byte_size + data_byte_size > 0U );
+
+    if ( ( tx_buffer == 0 ) && ( rd_buffer != 0 ) )
+    {
+        /* The data to receive is clocked in by sending the destination buffer,
+           cleared first: each byte goes out before its place is received. */
+        memset( rd_buffer, 0, data_byte_size );
+        tx_buffer = rd_buffer;
+    }
+
+    MSS_SPI_disable( this_spi );
+    MSS_SPI_set_transfer_byte_count( this_spi, (uint32_t)cmd_byte_size + data_byte_size );
+    this_spi->hw_reg->TXRXDF_SIZE = 8U;
+
+    /* Flush the receive FIFO. */
+    while ( !this_spi->hw_reg_bit->STATUS_RX_FIFO_EMPTY )
+    {
+        rx_raw = this_spi->hw_reg->RX_DATA;
+    }
+    (void)rx_raw;
+
+    rx_done_mask = 0U;
+    if ( rd_buffer != 0 )
+    {
+        if ( cmd_byte_size > 0U )
+        {
+            PDMA_start( rx_channel, rx_reg, (uint32_t)g_dma_cmd_discard, cmd_byte_size );
+            PDMA_load_next_buffer( rx_channel, rx_reg, (uint32_t)rd_buffer, data_byte_size );
+            rx_done_mask = 3U;
+        }
+        else
+        {
+            PDMA_start( rx_channel, rx_reg, (uint32_t)rd_buffer, data_byte_size );
+            rx_done_mask = 1U;
+        }
+    }
+
+    if ( cmd_byte_size > 0U )
+    {
+        PDMA_start( tx_channel, (uint32_t)cmd_buffer, tx_reg, cmd_byte_size );
+        if ( data_byte_size > 0U )
+        {
+            PDMA_load_next_buffer( tx_channel, (uint32_t)tx_buffer, tx_reg, data_byte_size );
+        }
+    }
+    else
+    {
+        PDMA_start( tx_channel, (uint32_t)tx_buffer, tx_reg, data_byte_size );
+    }
+
+    MSS_SPI_enable( this_spi );
+    while ( !MSS_SPI_tx_done( this_spi ) )
+    {
+        ;
+    }
+
+    /* The last frames may still be in the receive FIFO. With a single buffer
+       either completion bit stands for it. */
+    if ( rx_done_mask != 0U )
+    {
+        while ( ( rx_done_mask == 3U ) ? ( PDMA_status( rx_channel ) != 3U )
+                                       : ( PDMA_status( rx_channel ) == 0U ) )
+        {
+            ;
+        }
+        PDMA_clear_irq( rx_channel );
+    }
+}
+
 /***************************************************************************//**
  * MSS_SPI_set_frame_rx_handler()
  * See "mss_spi.h" for details of how to use this function.
@@ -197,6 +197,7 @@
 #define MSS_SPI_H_
 
 #include "../../CMSIS/a2fxxxm3.h"
+#include "../mss_pdma/mss_pdma.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -1013,6 +1014,118 @@ void MSS_SPI_transfer_block
     uint16_t rd_byte_size
 );
 
+/***************************************************************************//**
+  The MSS_SPI_transfer_block_burst() function is a faster polled alternative to
+  MSS_SPI_transfer_block() for MSS SPI masters. A command is sent followed by
+  data, written from tx_buffer, read into rd_buffer or both, in a single SPI
+  transaction.
+  The transfer uses the widest frames, 32 or 16 bits, that divide its size and
+  that the slave accepts, so that the bytes go out in the same order as with 8
+  bit frames but the processor handles up to four bytes per FIFO access. The
+  transmit FIFO is filled in bursts of up to the FIFO depth and the receive
+  FIFO drained in bursts, instead of one frame per status check.
+  Wide frames suit slaves seeing the transaction as a plain bit stream, such
+  as serial flash memories, but not slaves expecting 8 bit frames.
+ 
+  @param this_spi
+    The this_spi parameter is a pointer to an mss_spi_instance_t structure
+    identifying the MSS SPI hardware block to be used, g_mss_spi0 or
+    g_mss_spi1.
+ 
+  @param cmd_buffer
+    The cmd_buffer parameter is a pointer to the command sent first.
+ 
+  @param cmd_byte_size
+    The cmd_byte_size parameter specifies the number of bytes of the command.
+ 
+  @param tx_buffer
+    The tx_buffer parameter is a pointer to the data sent after the command,
+    or null (0) to send 0x00 bytes while reading.
+ 
+  @param rd_buffer
+    The rd_buffer parameter is a pointer to the buffer where the data received
+    after the command is stored, or null (0) when nothing is to be read.
+ 
+  @param data_byte_size
+    The data_byte_size parameter specifies the number of bytes sent and
+    received after the command.
+ 
+  @param max_frame_bits
+    The max_frame_bits parameter is the widest frame the slave accepts: 8, 16
+    or 32.
+ */
+void MSS_SPI_transfer_block_burst
+(
+    mss_spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    const uint8_t * tx_buffer,
+    uint8_t * rd_buffer,
+    uint16_t data_byte_size,
+    uint8_t max_frame_bits
+);
+
+/***************************************************************************//**
+  Longest command of MSS_SPI_dma_transfer_block() when data is read.
+ */
+#define MSS_SPI_DMA_MAX_CMD_SIZE    16u
+
+/***************************************************************************//**
+  The MSS_SPI_dma_transfer_block() function performs the same transaction as
+  MSS_SPI_transfer_block_burst() with 8 bit frames moved by the PDMA: the
+  tx_channel sends the command then the data, and when rd_buffer is not null
+  the rx_channel receives the bytes coming in during the command into a
+  scratch buffer then the data into rd_buffer. The processor only waits for
+  the end of the transaction.
+  Both channels must have been configured by the application with
+  PDMA_configure() or PDMA_allocate_channel(), tx_channel to write to this SPI with the source address
+  incremented by one byte and rx_channel to read from it with the destination
+  address incremented by one byte. No interrupt handler must be installed for
+  them.
+ 
+  @param this_spi
+    The this_spi parameter is a pointer to an mss_spi_instance_t structure
+    identifying the MSS SPI hardware block to be used, g_mss_spi0 or
+    g_mss_spi1.
+ 
+  @param cmd_buffer
+    The cmd_buffer parameter is a pointer to the command sent first.
+ 
+  @param cmd_byte_size
+    The cmd_byte_size parameter specifies the number of bytes of the command,
+    up to MSS_SPI_DMA_MAX_CMD_SIZE.
+ 
+  @param tx_buffer
+    The tx_buffer parameter is a pointer to the data sent after the command,
+    or null (0) to send 0x00 bytes while reading.
+ 
+  @param rd_buffer
+    The rd_buffer parameter is a pointer to the buffer where the data received
+    after the command is stored, or null (0) when nothing is to be read.
+ 
+  @param data_byte_size
+    The data_byte_size parameter specifies the number of bytes sent and
+    received after the command.
+ 
+  @param tx_channel
+    The tx_channel parameter is the PDMA channel writing to the SPI.
+ 
+  @param rx_channel
+    The rx_channel parameter is the PDMA channel reading from the SPI, unused
+    when rd_buffer is null.
+ */
+void MSS_SPI_dma_transfer_block
+(
+    mss_spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    const uint8_t * tx_buffer,
+    uint8_t * rd_buffer,
+    uint16_t data_byte_size,
+    pdma_channel_id_t tx_channel,
+    pdma_channel_id_t rx_channel
+);
+
 /*==============================================================================
  * Slave functions
  *============================================================================*/
@@ -0,0 +1,224 @@
+/*******************************************************************************
+ *  spi_bus.c: SPI bus manager.
+ *
+ *  Callers queue pointers to their transactions, so queueing costs a pointer
+ *  copy whatever the size of the chain. The task selects the slave, which
+ *  applies the clock, mode and frame size recorded by MSS_SPI_configure_
+ *  master_mode() for it, runs the segments with MSS_SPI_transfer_block_burst()
+ *  and deselects it. The bus lock is held for the whole transaction so that
+ *  direct users of the SPI see it idle.
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "spi_bus.h"
+
+typedef struct spi_bus {
+    mss_spi_instance_t *spi;
+    xQueueHandle queue;             /* of spi_bus_transaction_t pointers */
+    xSemaphoreHandle lock;          /* held by the task or a direct user */
+    spi_bus_stats_t stats;
+} spi_bus_t;
+
+static spi_bus_t spi_buses[2];
+
+static void spi_bus_task(void *para);
+static void spi_bus_run(spi_bus_t *bus, spi_bus_transaction_t *t);
+
+/***************************************************************************//**
+ * Bus of an MSS SPI, NULL if it is not initialized.
+ */
+static spi_bus_t *spi_bus_get(mss_spi_instance_t *spi)
+{
+    spi_bus_t *bus = &spi_buses[(spi == &g_mss_spi0) ? 0 : 1];
+
+    return (bus->spi == spi) ? bus : NULL;
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+portBASE_TYPE spi_bus_init(mss_spi_instance_t *spi)
+{
+    spi_bus_t *bus = &spi_buses[(spi == &g_mss_spi0) ? 0 : 1];
+
+    if (bus->spi == spi) {
+        return pdPASS;
+    }
+    bus->queue = xQueueCreate(SPI_BUS_QUEUE_LENGTH, sizeof(spi_bus_transaction_t *));
+    vSemaphoreCreateBinary(bus->lock);
+    if ((bus->queue == NULL) || (bus->lock == NULL)) {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+    MSS_SPI_init(spi);
+    bus->spi = spi;
+
+    return xTaskCreate(spi_bus_task,
+                       (signed portCHAR *) ((spi == &g_mss_spi0) ? "spi_bus0" : "spi_bus1"),
+                       SPI_BUS_TASK_STACK_SIZE, bus, SPI_BUS_TASK_PRIORITY, NULL);
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+int spi_bus_present(mss_spi_instance_t *spi)
+{
+    return spi_bus_get(spi) != NULL;
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+int spi_bus_add_device(const spi_bus_device_t *device)
+{
+    spi_bus_t *bus = spi_bus_get(device->spi);
+
+    if (bus == NULL) {
+        return SPI_BUS_ERR_NO_BUS;
+    }
+    /* The slave configuration is read by MSS_SPI_set_slave_select() */
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    MSS_SPI_configure_master_mode(device->spi, device->slave, device->mode,
+                                  device->clk_div, MSS_SPI_BLOCK_TRANSFER_FRAME_SIZE);
+    xSemaphoreGive(bus->lock);
+    return SPI_BUS_OK;
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+int spi_bus_submit(spi_bus_transaction_t *t, portTickType wait)
+{
+    spi_bus_t *bus = spi_bus_get(t->device->spi);
+    unsigned portBASE_TYPE queued;
+
+    if (bus == NULL) {
+        t->status = SPI_BUS_ERR_NO_BUS;
+        return SPI_BUS_ERR_NO_BUS;
+    }
+    t->status = SPI_BUS_PENDING;
+    if (xQueueSend(bus->queue, &t, wait) != pdPASS) {
+        bus->stats.queue_full++;
+        t->status = SPI_BUS_ERR_QUEUE_FULL;
+        return SPI_BUS_ERR_QUEUE_FULL;
+    }
+    queued = uxQueueMessagesWaiting(bus->queue);
+    if (queued > bus->stats.max_queued) {
+        bus->stats.max_queued = queued;
+    }
+    return SPI_BUS_OK;
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+int spi_bus_transfer(spi_bus_transaction_t *t, portTickType wait)
+{
+    int status;
+
+    /* A completion nobody waited for must not end this transaction */
+    xSemaphoreTake(t->done, 0);
+    status = spi_bus_submit(t, wait);
+    if (status != SPI_BUS_OK) {
+        return status;
+    }
+    if (xSemaphoreTake(t->done, wait) != pdPASS) {
+        return SPI_BUS_ERR_TIMEOUT;
+    }
+    return t->status;
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+portBASE_TYPE spi_bus_acquire(mss_spi_instance_t *spi, portTickType wait)
+{
+    spi_bus_t *bus = spi_bus_get(spi);
+
+    if (bus == NULL) {
+        return pdFAIL;
+    }
+    return xSemaphoreTake(bus->lock, wait);
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+void spi_bus_release(mss_spi_instance_t *spi)
+{
+    spi_bus_t *bus = spi_bus_get(spi);
+
+    if (bus != NULL) {
+        xSemaphoreGive(bus->lock);
+    }
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+void spi_bus_release_from_isr(mss_spi_instance_t *spi, portBASE_TYPE *woken)
+{
+    spi_bus_t *bus = spi_bus_get(spi);
+
+    if (bus != NULL) {
+        xSemaphoreGiveFromISR(bus->lock, woken);
+    }
+}
+
+/***************************************************************************//**
+ *  See spi_bus.h for more information.
+ */
+const spi_bus_stats_t *spi_bus_get_stats(mss_spi_instance_t *spi)
+{
+    spi_bus_t *bus = spi_bus_get(spi);
+
+    return (bus != NULL) ? &bus->stats : NULL;
+}
+
+/***************************************************************************//**
+ * Task body, runs the queued transactions in order.
+ */
+static void spi_bus_task(void *para)
+{
+    spi_bus_t *bus = (spi_bus_t *)para;
+    spi_bus_transaction_t *t;
+
+    for (;;) {
+        if (xQueueReceive(bus->queue, &t, portMAX_DELAY) != pdPASS) {
+            continue;
+        }
+        xSemaphoreTake(bus->lock, portMAX_DELAY);
+        spi_bus_run(bus, t);
+        xSemaphoreGive(bus->lock);
+
+        bus->stats.transactions++;
+        t->status = SPI_BUS_OK;
+        if (t->complete != NULL) {
+            t->complete(t, t->context);
+        }
+        if (t->done != NULL) {
+            xSemaphoreGive(t->done);
+        }
+    }
+}
+
+/***************************************************************************//**
+ * Runs the segments of a transaction with its slave selected.
+ */
+static void spi_bus_run(spi_bus_t *bus, spi_bus_transaction_t *t)
+{
+    const spi_bus_device_t *device = t->device;
+    spi_bus_segment_t *seg;
+
+    MSS_SPI_set_slave_select(bus->spi, device->slave);
+    for (seg = t->segments; seg != NULL; seg = seg->next) {
+        MSS_SPI_transfer_block_burst(bus->spi, seg->cmd, seg->cmd_length,
+                                     seg->tx, seg->rx, seg->length,
+                                     device->max_frame_bits);
+        bus->stats.segments++;
+        bus->stats.bytes += (uint32_t)seg->cmd_length + seg->length;
+    }
+    MSS_SPI_clear_slave_select(bus->spi, device->slave);
+}
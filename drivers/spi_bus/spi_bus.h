@@ -0,0 +1,174 @@
+/*******************************************************************************
+ *  spi_bus.h: SPI bus manager.
+ *
+ *  One task per MSS SPI owns the bus and runs the transactions queued by the
+ *  device drivers in turn, so devices on the same bus no longer interleave
+ *  their slave selects and frames. A transaction is a chain of segments, each
+ *  a command followed by data sent, received or both, run back to back with
+ *  the slave of the transaction selected. Callers queue transactions and are
+ *  told of their end by a callback or a semaphore instead of waiting for the
+ *  SPI, and queue the next one while the bus is busy.
+ *
+ *  Drivers driving the SPI themselves, with the PDMA for instance, hold the
+ *  bus with spi_bus_acquire() in the meantime.
+ */
+#ifndef SPI_BUS_H_
+#define SPI_BUS_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "../mss_spi/mss_spi.h"
+
+/***************************************************************************//**
+ * Bus tasks. SPI_BUS_TASK_STACK_SIZE is given in 32 bit words.
+ */
+#ifndef SPI_BUS_TASK_PRIORITY
+#define SPI_BUS_TASK_PRIORITY       (tskIDLE_PRIORITY + 2)
+#endif
+#ifndef SPI_BUS_TASK_STACK_SIZE
+#define SPI_BUS_TASK_STACK_SIZE     configMINIMAL_STACK_SIZE
+#endif
+
+/***************************************************************************//**
+ * Transactions waiting for each bus.
+ */
+#ifndef SPI_BUS_QUEUE_LENGTH
+#define SPI_BUS_QUEUE_LENGTH        8
+#endif
+
+/***************************************************************************//**
+ * Transaction status.
+ */
+#define SPI_BUS_OK                  0
+#define SPI_BUS_PENDING             1   /* queued or running */
+#define SPI_BUS_ERR_NO_BUS          (-1)    /* spi_bus_init() not called */
+#define SPI_BUS_ERR_QUEUE_FULL      (-2)
+#define SPI_BUS_ERR_TIMEOUT         (-3)    /* still pending, see spi_bus_transfer() */
+
+/***************************************************************************//**
+ * Slave on a bus, with the settings applied whenever it is selected.
+ */
+typedef struct spi_bus_device {
+    mss_spi_instance_t *spi;        /* &g_mss_spi0 or &g_mss_spi1 */
+    mss_spi_slave_t slave;
+    mss_spi_protocol_mode_t mode;
+    mss_spi_pclk_div_t clk_div;
+    uint8_t max_frame_bits;         /* 8, or 16 or 32 for bit stream slaves */
+} spi_bus_device_t;
+
+/***************************************************************************//**
+ * One SPI transfer: cmd_length bytes of cmd then length bytes of data, sent
+ * from tx or 0x00 when tx is NULL, and received into rx unless it is NULL.
+ */
+typedef struct spi_bus_segment {
+    const uint8_t *cmd;
+    uint16_t cmd_length;
+    const uint8_t *tx;
+    uint8_t *rx;
+    uint16_t length;
+    struct spi_bus_segment *next;   /* run next with the slave still selected */
+} spi_bus_segment_t;
+
+typedef struct spi_bus_transaction spi_bus_transaction_t;
+
+/***************************************************************************//**
+ * Completion callback, called by the bus task once the last segment is done.
+ * It must not block; the bus waits for it.
+ */
+typedef void (*spi_bus_complete_t)(spi_bus_transaction_t *t, void *context);
+
+/***************************************************************************//**
+ * Transaction. It is not copied: the transaction and its segments must remain
+ * unchanged until it completes.
+ */
+struct spi_bus_transaction {
+    const spi_bus_device_t *device;
+    spi_bus_segment_t *segments;
+    spi_bus_complete_t complete;    /* may be NULL */
+    void *context;                  /* given to complete */
+    xSemaphoreHandle done;          /* given after complete, may be NULL */
+    volatile int8_t status;         /* SPI_BUS_PENDING until completed */
+};
+
+/***************************************************************************//**
+ * Bus counters.
+ */
+typedef struct spi_bus_stats {
+    uint32_t transactions;          /* completed */
+    uint32_t segments;
+    uint32_t bytes;                 /* command and data bytes */
+    uint32_t queue_full;            /* transactions refused */
+    uint32_t max_queued;            /* deepest queue seen at submission */
+} spi_bus_stats_t;
+
+/***************************************************************************//**
+ * Initializes an MSS SPI and creates its bus task and queue. Must be called
+ * before the devices are added and before any other driver initializes the
+ * same SPI.
+ * 
+ * @param  spi      &g_mss_spi0 or &g_mss_spi1.
+ * @return pdPASS   if the task and its queue were created
+ *         errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY otherwise
+ */
+portBASE_TYPE spi_bus_init(mss_spi_instance_t *spi);
+/***************************************************************************//**
+ * Tells drivers sharing an SPI whether spi_bus_init() was called for it, in
+ * which case they must not initialize it again.
+ * 
+ * @return 1 if the bus exists, 0 otherwise
+ */
+int spi_bus_present(mss_spi_instance_t *spi);
+/***************************************************************************//**
+ * Records the clock and mode of a slave. The device is not copied, it must
+ * remain valid while in use.
+ * 
+ * @return SPI_BUS_OK or SPI_BUS_ERR_NO_BUS
+ */
+int spi_bus_add_device(const spi_bus_device_t *device);
+/***************************************************************************//**
+ * Queues a transaction and returns. Its status is SPI_BUS_PENDING until the
+ * bus task sets the final status, calls complete and gives done.
+ * 
+ * @param  t        Transaction.
+ * @param  wait     Ticks to wait for room in the queue.
+ * @return SPI_BUS_OK if the transaction was queued, an error otherwise, also
+ *         stored into t->status.
+ */
+int spi_bus_submit(spi_bus_transaction_t *t, portTickType wait);
+/***************************************************************************//**
+ * Queues a transaction and blocks the calling task until it completes. The
+ * done semaphore of the transaction must have been created.
+ * 
+ * @param  t        Transaction.
+ * @param  wait     Ticks to wait for the queue then for the completion,
+ *                  portMAX_DELAY for no limit.
+ * @return SPI_BUS_OK, or SPI_BUS_ERR_TIMEOUT if the transaction is still
+ *         queued or running and must not be reused yet
+ */
+int spi_bus_transfer(spi_bus_transaction_t *t, portTickType wait);
+/***************************************************************************//**
+ * Takes the bus for direct use of the MSS SPI functions, between the
+ * transactions of the bus task.
+ * 
+ * @return pdPASS, or pdFAIL if the bus was not taken within wait ticks
+ */
+portBASE_TYPE spi_bus_acquire(mss_spi_instance_t *spi, portTickType wait);
+/***************************************************************************//**
+ * Gives back the bus taken with spi_bus_acquire().
+ */
+void spi_bus_release(mss_spi_instance_t *spi);
+/***************************************************************************//**
+ * Same as spi_bus_release(), from the interrupt ending a transfer started
+ * while holding the bus. The interrupt priority must allow FreeRTOS calls.
+ * 
+ * @param  woken    Set to pdTRUE if a task waiting for the bus was woken and
+ *                  the interrupt must end with a context switch.
+ */
+void spi_bus_release_from_isr(mss_spi_instance_t *spi, portBASE_TYPE *woken);
+/***************************************************************************//**
+ * Returns the counters of a bus, NULL if it is not initialized.
+ */
+const spi_bus_stats_t *spi_bus_get_stats(mss_spi_instance_t *spi);
+
+#endif /* SPI_BUS_H_ */
@@ -11,6 +11,9 @@
 #include "queue.h"
 
 #include "main.h"
+#include "./drivers/mac/netif.h"
+#include "./application_tasks/telemetry.h"
+#include "./application_tasks/status_pages.h"
 
 #define SYS_TICK_CTRL_AND_STATUS_REG      0xE000E010
 #define SYS_TICK_CONFIG_REG               0xE0042038
@@ -83,6 +86,26 @@ int main()
         return EXIT_FAILURE;
     }
 
+#if NET_USE_NETIF
+    // Status pages of the web server, see web/ for the static files
+    httpd_init(status_pages, status_page_count);
+
+    // The network task brings the Ethernet MAC up once the scheduler runs
+    c = netif_init();
+    if (c != pdPASS) {
+        printf("netif_init failed with code %d, exiting\r\n", c);
+        return EXIT_FAILURE;
+    }
+#if TELEMETRY_ENABLE
+    // Streams the ADC samples read by analog_read_task over UDP
+    c = telemetry_init();
+    if (c != pdPASS) {
+        printf("telemetry_init failed with code %d, exiting\r\n", c);
+        return EXIT_FAILURE;
+    }
+#endif
+#endif
+
     /* Enable the SYS TICK Timer and provide the divider and clock source
      * this is required to enable the RTOS tick */
     *(volatile unsigned long *)SYS_TICK_CTRL_AND_STATUS_REG = ENABLE_SYS_TICK;
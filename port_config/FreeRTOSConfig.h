@@ -86,7 +86,7 @@
 #define configTOTAL_HEAP_SIZE        ( ( size_t ) ( 5 * 1024 ) )
 
 #define configMAX_TASK_NAME_LEN        ( 16 )
-#define configUSE_TRACE_FACILITY    0
+#define configUSE_TRACE_FACILITY    1
 #define configUSE_16_BIT_TICKS        1
 #define configIDLE_SHOULD_YIELD        1
 #define configUSE_MUTEXES            0
@@ -107,6 +107,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskSuspend            1
 #define INCLUDE_vTaskDelayUntil            1
 #define INCLUDE_vTaskDelay                1
+#define INCLUDE_xTaskGetSchedulerState    1
 
 
 #define INCLUDE_vResumeFromISR              1
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Convert a net_capture image to pcapng.
+
+The image is the net_capture_image structure of drivers/mac/net_capture.c,
+read back from the SPI flash or dumped from RAM with the debugger, e.g.
+
+    (gdb) dump binary memory capture.bin &net_capture_image \
+              (char *)&net_capture_image + sizeof(net_capture_image)
+
+Usage:
+
+    capture2pcapng.py capture.bin capture.pcapng
+
+Timestamps come from the 32 bit cycle counter, which wraps every 43 s at
+100 MHz; the converter assumes consecutive frames are less than one wrap apart.
+Frame direction is stored in the epb_flags option so Wireshark can filter on
+inbound/outbound frames.
+"""
+
+import struct
+import sys
+
+MAGIC = 0x5041434E
+VERSION = 1
+HDR = struct.Struct("<IHHIIII")
+REC = struct.Struct("<IHHB3x")
+
+CAPTURE_RX = 0
+CAPTURE_TX = 1
+
+
+def option(code, value):
+    pad = (4 - len(value) % 4) % 4
+    return struct.pack("<HH", code, len(value)) + value + b"\0" * pad
+
+
+def block(block_type, body):
+    length = 12 + len(body)
+    return struct.pack("<II", block_type, length) + body + struct.pack("<I", length)
+
+
+def read_records(image):
+    magic, version, snaplen, clock_hz, slots, nxt, captured = HDR.unpack_from(image, 0)
+    if magic != MAGIC:
+        raise ValueError("not a capture image (magic 0x%08x)" % magic)
+    if version != VERSION:
+        raise ValueError("unsupported capture version %d" % version)
+    if captured == 0xFFFFFFFF:
+        raise ValueError("erased flash, no capture saved")
+
+    rec_size = REC.size + snaplen
+    if len(image) < HDR.size + slots * rec_size:
+        raise ValueError("image truncated")
+
+    if captured > slots:
+        order = [(nxt + i) % slots for i in range(slots)]
+    else:
+        order = range(captured)
+
+    records = []
+    for index in order:
+        offset = HDR.size + index * rec_size
+        timestamp, orig_len, cap_len, direction = REC.unpack_from(image, offset)
+        data = image[offset + REC.size:offset + REC.size + min(cap_len, snaplen)]
+        records.append((timestamp, orig_len, direction, data))
+    return snaplen, clock_hz, captured, records
+
+
+def convert(image):
+    snaplen, clock_hz, captured, records = read_records(image)
+
+    # Section header, byte order magic, version 1.0, unknown section length
+    out = [block(0x0A0D0D0A, struct.pack("<IHHq", 0x1A2B3C4D, 1, 0, -1))]
+
+    # Interface description: Ethernet, nanosecond resolution
+    opts = option(2, b"SmartFusion MAC") + option(9, bytes([9])) + option(0, b"")
+    out.append(block(0x00000001, struct.pack("<HHI", 1, 0, snaplen) + opts))
+
+    high = 0
+    last = None
+    for timestamp, orig_len, direction, data in records:
+        if last is not None and timestamp < last:
+            high += 1 << 32
+        last = timestamp
+        ns = (high + timestamp) * 1000000000 // clock_hz
+        flags = 1 if direction == CAPTURE_RX else 2
+        pad = (4 - len(data) % 4) % 4
+        body = struct.pack("<IIIII", 0, ns >> 32, ns & 0xFFFFFFFF, len(data), orig_len)
+        body += data + b"\0" * pad
+        body += option(2, struct.pack("<I", flags)) + option(0, b"")
+        out.append(block(0x00000006, body))
+
+    lost = captured - len(records)
+    return b"".join(out), len(records), lost
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 2
+    with open(argv[1], "rb") as f:
+        image = f.read()
+    try:
+        pcapng, count, lost = convert(image)
+    except ValueError as e:
+        sys.stderr.write("%s: %s\n" % (argv[1], e))
+        return 1
+    with open(argv[2], "wb") as f:
+        f.write(pcapng)
+    print("%d frames written, %d older frames overwritten" % (count, lost))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,172 @@
+/*******************************************************************************
+ *  fast_mem_bench.c: host benchmark of fast_memcpy() and fast_memset().
+ *
+ *  Sweeps buffer sizes and source/destination alignments, checks the results
+ *  against the C library and prints the time per call for the byte loops the
+ *  MAC driver used before, the C library and fast_mem. Build and run from the
+ *  project root:
+ *
+ *      gcc -O2 -Idrivers/fast_mem -o fast_mem_bench tools/fast_mem_bench.c \
+ *          drivers/fast_mem/fast_mem.c
+ *      ./fast_mem_bench
+ *
+ *  The tools directory is excluded from the firmware build.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "fast_mem.h"
+
+#define BUF_SIZE    2048
+#define MIN_NS      20000000.0     /* time each measurement for at least 20 ms */
+
+typedef void *(*copy_fn_t)(void *, const void *, size_t);
+typedef void *(*fill_fn_t)(void *, int, size_t);
+
+static uint8_t src_buf[BUF_SIZE + 8];
+static uint8_t dst_buf[BUF_SIZE + 8];
+static uint8_t ref_buf[BUF_SIZE + 8];
+
+/* Former MAC_memcpy() and MAC_memset() */
+static void *byte_memcpy(void *dest, const void *src, size_t n)
+{
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+
+    while (n > 0u) {
+        n--;
+        d[n] = s[n];
+    }
+    return dest;
+}
+
+static void *byte_memset(void *s, int c, size_t n)
+{
+    uint8_t *d = s;
+
+    while (n > 0u) {
+        n--;
+        d[n] = (uint8_t)c;
+    }
+    return s;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double time_copy(copy_fn_t fn, size_t dst_off, size_t src_off, size_t n)
+{
+    unsigned long loops = 1, i;
+    double start, elapsed;
+
+    for (;;) {
+        start = now_ns();
+        for (i = 0; i < loops; i++) {
+            fn(dst_buf + dst_off, src_buf + src_off, n);
+            __asm__ __volatile__("" : : "r"(dst_buf) : "memory");
+        }
+        elapsed = now_ns() - start;
+        if (elapsed >= MIN_NS) {
+            return elapsed / (double)loops;
+        }
+        loops *= 2;
+    }
+}
+
+static double time_fill(fill_fn_t fn, size_t off, size_t n)
+{
+    unsigned long loops = 1, i;
+    double start, elapsed;
+
+    for (;;) {
+        start = now_ns();
+        for (i = 0; i < loops; i++) {
+            fn(dst_buf + off, (int)i, n);
+            __asm__ __volatile__("" : : "r"(dst_buf) : "memory");
+        }
+        elapsed = now_ns() - start;
+        if (elapsed >= MIN_NS) {
+            return elapsed / (double)loops;
+        }
+        loops *= 2;
+    }
+}
+
+static int check(void)
+{
+    size_t n, so, doff, i;
+    int c;
+
+    for (i = 0; i < sizeof(src_buf); i++) {
+        src_buf[i] = (uint8_t)(i * 7u + 3u);
+    }
+    for (n = 0; n <= 300; n++) {
+        for (so = 0; so < 4; so++) {
+            for (doff = 0; doff < 4; doff++) {
+                memset(dst_buf, 0xA5, sizeof(dst_buf));
+                memset(ref_buf, 0xA5, sizeof(ref_buf));
+                fast_memcpy(dst_buf + doff, src_buf + so, n);
+                memcpy(ref_buf + doff, src_buf + so, n);
+                if (memcmp(dst_buf, ref_buf, sizeof(dst_buf)) != 0) {
+                    printf("fast_memcpy mismatch: n=%lu src+%lu dst+%lu\n",
+                           (unsigned long)n, (unsigned long)so, (unsigned long)doff);
+                    return 1;
+                }
+            }
+            c = (int)(n & 0xFF);
+            memset(dst_buf, 0xA5, sizeof(dst_buf));
+            memset(ref_buf, 0xA5, sizeof(ref_buf));
+            fast_memset(dst_buf + so, c, n);
+            memset(ref_buf + so, c, n);
+            if (memcmp(dst_buf, ref_buf, sizeof(dst_buf)) != 0) {
+                printf("fast_memset mismatch: n=%lu dst+%lu\n", (unsigned long)n, (unsigned long)so);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 4, 16, 42, 64, 128, 256, 512, 1024, 1514 };
+    static const size_t aligns[][2] = { { 0, 0 }, { 2, 2 }, { 0, 2 }, { 1, 3 } };
+    size_t i, a;
+
+    if (check() != 0) {
+        return EXIT_FAILURE;
+    }
+    printf("results match the C library\n\n");
+
+    printf("memcpy, ns per call\n");
+    printf("%6s %7s %10s %10s %10s\n", "size", "dst/src", "byte", "libc", "fast");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (a = 0; a < sizeof(aligns) / sizeof(aligns[0]); a++) {
+            printf("%6lu %4lu/%-2lu %10.1f %10.1f %10.1f\n",
+                   (unsigned long)sizes[i], (unsigned long)aligns[a][0], (unsigned long)aligns[a][1],
+                   time_copy(byte_memcpy, aligns[a][0], aligns[a][1], sizes[i]),
+                   time_copy(memcpy, aligns[a][0], aligns[a][1], sizes[i]),
+                   time_copy(fast_memcpy, aligns[a][0], aligns[a][1], sizes[i]));
+        }
+    }
+
+    printf("\nmemset, ns per call\n");
+    printf("%6s %7s %10s %10s %10s\n", "size", "dst", "byte", "libc", "fast");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (a = 0; a < 2; a++) {
+            printf("%6lu %7lu %10.1f %10.1f %10.1f\n",
+                   (unsigned long)sizes[i], (unsigned long)aligns[a * 3][0],
+                   time_fill(byte_memset, aligns[a * 3][0], sizes[i]),
+                   time_fill(memset, aligns[a * 3][0], sizes[i]),
+                   time_fill(fast_memset, aligns[a * 3][0], sizes[i]));
+        }
+    }
+    return EXIT_SUCCESS;
+}
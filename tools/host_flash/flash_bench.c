@@ -0,0 +1,291 @@
+/*******************************************************************************
+ *  flash_bench.c: throughput of the SPI flash and of the key/value store on
+ *  the simulated AT25DF641 of host_flash.c.
+ *
+ *  The raw cases erase, program and read a 64 KB scratch area outside the
+ *  store, by pages and by small records. The store case mounts
+ *  BSP/flash_store on the image, so the values of a previous run are found
+ *  again, then updates -k keys in turn -n times with -v byte values. Times
+ *  are simulated flash times: the rates are those the target would see with
+ *  the SPI clock of -s Hz, whatever the speed of the host.
+ *
+ *  With -c the store case is then repeated -c times with a power cut at a
+ *  random point of a burst of updates; after each cut the store is mounted
+ *  again and every key must read either its last acknowledged value or the
+ *  value being written. The program exits with status 1 otherwise.
+ *
+ *      flash_bench [-f image] [-n updates] [-k keys] [-v size] [-s spi_hz]
+ *                  [-c cuts] [-r]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "../../BSP/spi_flash_driver/spi_flash.h"
+#include "../../BSP/flash_store/flash_store.h"
+#include "host_flash.h"
+
+#define SCRATCH_ADDRESS     0x600000UL
+#define SCRATCH_SIZE        0x10000UL
+#define RECORD_SIZE         32UL
+
+static uint8_t scratch[SCRATCH_SIZE];
+
+/* Last acknowledged value of each key, 0 when never written */
+static uint32_t acked[FLASH_STORE_MAX_KEYS];
+
+portTickType xTaskGetTickCount(void)
+{
+    host_flash_stats_t st;
+
+    host_flash_get_stats(&st);
+    return (portTickType)st.time_us;
+}
+
+static uint64_t flash_time_us(void)
+{
+    host_flash_stats_t st;
+
+    host_flash_get_stats(&st);
+    return st.time_us;
+}
+
+static void report(const char *what, uint64_t us, uint64_t bytes, uint32_t ops)
+{
+    printf("%-24s %9.1f ms %9.1f KB/s %8.1f us/op\n", what, us / 1000.0,
+           us ? bytes * 1000000.0 / 1024.0 / us : 0.0, ops ? (double)us / ops : 0.0);
+}
+
+static int raw_cases(void)
+{
+    uint64_t t;
+    uint32_t i;
+
+    if (spi_flash_control_hw(SPI_FLASH_GLOBAL_UNPROTECT, 0, NULL) != SPI_FLASH_SUCCESS) {
+        return -1;
+    }
+
+    t = flash_time_us();
+    if (spi_flash_control_hw(SPI_FLASH_64KBLOCK_ERASE, SCRATCH_ADDRESS, NULL) != SPI_FLASH_SUCCESS) {
+        return -1;
+    }
+    /* The erase ends at the next command */
+    spi_flash_control_hw(SPI_FLASH_GET_STATUS, 0, NULL);
+    report("erase 64K", flash_time_us() - t, SCRATCH_SIZE, 1);
+
+    for (i = 0; i < SCRATCH_SIZE; i++) {
+        scratch[i] = (uint8_t)(i * 7);
+    }
+    t = flash_time_us();
+    if (spi_flash_write(SCRATCH_ADDRESS, scratch, SCRATCH_SIZE) != SPI_FLASH_SUCCESS) {
+        return -1;
+    }
+    spi_flash_control_hw(SPI_FLASH_GET_STATUS, 0, NULL);
+    report("program 64K", flash_time_us() - t, SCRATCH_SIZE, SCRATCH_SIZE / 256);
+
+    t = flash_time_us();
+    if (spi_flash_read(SCRATCH_ADDRESS, scratch, SCRATCH_SIZE) != SPI_FLASH_SUCCESS) {
+        return -1;
+    }
+    report("read 64K", flash_time_us() - t, SCRATCH_SIZE, 1);
+    for (i = 0; i < SCRATCH_SIZE; i++) {
+        if (scratch[i] != (uint8_t)(i * 7)) {
+            printf("read back differs at %u\n", i);
+            return -1;
+        }
+    }
+
+    t = flash_time_us();
+    for (i = 0; i < SCRATCH_SIZE; i += RECORD_SIZE) {
+        if (spi_flash_read(SCRATCH_ADDRESS + i, scratch + i, RECORD_SIZE) != SPI_FLASH_SUCCESS) {
+            return -1;
+        }
+    }
+    report("read 64K by 32 bytes", flash_time_us() - t, SCRATCH_SIZE, SCRATCH_SIZE / RECORD_SIZE);
+    return 0;
+}
+
+static void fill_value(uint8_t *value, uint32_t size, uint32_t tag)
+{
+    uint32_t i;
+
+    memcpy(value, &tag, sizeof(tag));
+    for (i = sizeof(tag); i < size; i++) {
+        value[i] = (uint8_t)(tag + i);
+    }
+}
+
+/* The tag of the value of a key, 0 when not found, -1 when corrupted */
+static int64_t read_tag(uint16_t key, uint32_t size)
+{
+    uint8_t value[FLASH_STORE_MAX_VALUE];
+    uint8_t expected[FLASH_STORE_MAX_VALUE];
+    uint32_t tag;
+    int32_t length = flash_store_read(key, value, sizeof(value));
+
+    if (length == FLASH_STORE_ERR_NOT_FOUND) {
+        return 0;
+    }
+    if (length != (int32_t)size) {
+        return -1;
+    }
+    memcpy(&tag, value, sizeof(tag));
+    fill_value(expected, size, tag);
+    return memcmp(value, expected, size) ? -1 : tag;
+}
+
+static int store_case(uint32_t updates, uint32_t keys, uint32_t size)
+{
+    uint8_t value[FLASH_STORE_MAX_VALUE];
+    flash_store_stats_t st;
+    uint64_t t;
+    uint32_t i;
+    uint32_t tag;
+    int32_t status;
+
+    t = flash_time_us();
+    status = flash_store_init();
+    if (status != FLASH_STORE_OK) {
+        printf("flash_store_init: %d\n", status);
+        return -1;
+    }
+    report("store mount", flash_time_us() - t, 0, 1);
+    for (i = 0; i < keys; i++) {
+        int64_t found = read_tag((uint16_t)i, size);
+
+        if (found < 0) {
+            printf("key %u corrupted\n", i);
+            return -1;
+        }
+        acked[i] = (uint32_t)found;
+    }
+
+    t = flash_time_us();
+    for (i = 0; i < updates; i++) {
+        tag = acked[i % keys] + 1;
+        fill_value(value, size, tag);
+        status = flash_store_write((uint16_t)(i % keys), value, (uint16_t)size);
+        if (status != FLASH_STORE_OK) {
+            printf("flash_store_write: %d\n", status);
+            return -1;
+        }
+        acked[i % keys] = tag;
+    }
+    report("store updates", flash_time_us() - t, (uint64_t)updates * size, updates);
+
+    t = flash_time_us();
+    for (i = 0; i < updates; i++) {
+        if (read_tag((uint16_t)(i % keys), size) != acked[i % keys]) {
+            printf("key %u reads another value\n", i % keys);
+            return -1;
+        }
+    }
+    report("store reads", flash_time_us() - t, (uint64_t)updates * size, updates);
+
+    flash_store_get_stats(&st);
+    printf("store: %u keys %u live bytes, %u collections moving %u records, "
+           "%u erases, block erase counts %u to %u\n",
+           st.keys, st.live_bytes, st.gc_runs, st.gc_copies, st.erases,
+           st.min_erase_count, st.max_erase_count);
+    return 0;
+}
+
+static int power_cut_case(uint32_t cuts, uint32_t keys, uint32_t size)
+{
+    uint8_t value[FLASH_STORE_MAX_VALUE];
+    flash_store_stats_t st;
+    uint32_t cut;
+    uint32_t key = 0;
+    uint32_t torn = 0;
+    uint32_t pending;
+    int64_t found;
+    uint32_t i;
+
+    for (cut = 0; cut < cuts; cut++) {
+        /* Anywhere in the next few collections */
+        host_flash_power_cut(1 + (uint32_t)rand() % (16 * 4096));
+        do {
+            key = (key + 1) % keys;
+            pending = acked[key] + 1;
+            fill_value(value, size, pending);
+            if (flash_store_write((uint16_t)key, value, (uint16_t)size) == FLASH_STORE_OK) {
+                acked[key] = pending;
+            }
+        } while (!host_flash_power_lost());
+
+        host_flash_power_on();
+        if (flash_store_init() != FLASH_STORE_OK) {
+            printf("cut %u: mount failed\n", cut);
+            return -1;
+        }
+        flash_store_get_stats(&st);
+        torn += st.torn;
+        for (i = 0; i < keys; i++) {
+            found = read_tag((uint16_t)i, size);
+            if ((i == key) && (found == pending)) {
+                acked[i] = pending;
+            } else if (found != acked[i]) {
+                printf("cut %u: key %u reads %lld, expected %u\n", cut, i, (long long)found, acked[i]);
+                return -1;
+            }
+        }
+    }
+    printf("power cuts: %u, %u torn records skipped at mount, all keys consistent\n", cuts, torn);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = "flash.img";
+    uint32_t updates = 10000;
+    uint32_t keys = 16;
+    uint32_t size = 16;
+    uint32_t cuts = 0;
+    host_flash_stats_t st;
+    int opt;
+    int rc = 0;
+
+    while ((opt = getopt(argc, argv, "f:n:k:v:s:c:r")) != -1) {
+        switch (opt) {
+        case 'f': path = optarg; break;
+        case 'n': updates = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'k': keys = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'v': size = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 's': host_flash_set_spi_hz((uint32_t)strtoul(optarg, NULL, 0)); break;
+        case 'c': cuts = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': host_flash_set_realtime(1); break;
+        default:
+            fprintf(stderr, "usage: %s [-f image] [-n updates] [-k keys] [-v size] "
+                    "[-s spi_hz] [-c cuts] [-r]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((keys == 0) || (keys > FLASH_STORE_MAX_KEYS) ||
+        (size < sizeof(uint32_t)) || (size > FLASH_STORE_MAX_VALUE)) {
+        fprintf(stderr, "keys 1 to %u, value size %u to %u\n",
+                FLASH_STORE_MAX_KEYS, (unsigned)sizeof(uint32_t), FLASH_STORE_MAX_VALUE);
+        return 2;
+    }
+
+    if (host_flash_open(path) < 0) {
+        perror(path);
+        return 1;
+    }
+    spi_flash_init();
+
+    if ((raw_cases() < 0) || (store_case(updates, keys, size) < 0) ||
+        (cuts && (power_cut_case(cuts, keys, size) < 0))) {
+        rc = 1;
+    }
+
+    host_flash_get_stats(&st);
+    printf("flash: %llu page programs, %u 4K erases, most erased block %u times, "
+           "%u protection errors, %u address errors\n",
+           (unsigned long long)st.page_programs, st.erases_4k, st.max_block_erases,
+           st.protect_errors, st.address_errors);
+    host_flash_close();
+    return rc;
+}
@@ -0,0 +1,408 @@
+/*******************************************************************************
+ *  host_flash.c: Linux implementation of the spi_flash.h API on an image
+ *  file, see host_flash.h.
+ *
+ *  The costs follow the command sequences of BSP/spi_flash_driver/spi_flash.c:
+ *  a status read before each command, a read is one READ_ARRAY command, a
+ *  write unprotects the sector then sends a write enable and a page program
+ *  per page. The clock moves by the SPI transfer time of each command and,
+ *  when the device is still busy with a program or an erase, up to its end.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../BSP/spi_flash_driver/spi_flash.h"
+#include "host_flash.h"
+
+#define PAGE_SIZE_BYTES         256UL
+#define BLOCK_4K                0x1000UL
+#define SECTOR_SIZE             0x10000UL
+#define NB_SECTORS              (HOST_FLASH_SIZE / SECTOR_SIZE)
+#define NB_BLOCKS               (HOST_FLASH_SIZE / BLOCK_4K)
+
+/* Typical busy times of the AT25DF641, as in spi_flash.c */
+#define PAGE_PROGRAM_US         1500UL
+#define ERASE_4K_US             50000UL
+#define ERASE_32K_US            250000UL
+#define ERASE_64K_US            400000UL
+#define CHIP_ERASE_US           32000000UL
+
+/* Bytes on the bus: status read, READ_ARRAY with its address and dummy
+   bytes, write enable, page program or erase with its address */
+#define STATUS_BYTES            2UL
+#define READ_CMD_BYTES          6UL
+#define WRITE_ENABLE_BYTES      1UL
+#define ADDRESS_CMD_BYTES       4UL
+
+static uint8_t *image;
+static uint8_t sector_protected[NB_SECTORS];
+static uint32_t block_erases[NB_BLOCKS];
+static uint32_t spi_hz = HOST_FLASH_SPI_HZ;
+static int realtime;
+static uint64_t busy_until;
+static uint32_t cut_budget;
+static int cut_armed;
+static int power_lost;
+static uint8_t async_pending;
+static host_flash_stats_t stats;
+
+/* Moves the clock by a transfer of bytes on the SPI bus, after waiting for
+   the end of the operation in progress */
+static void bus_transfer(uint32_t bytes)
+{
+    uint64_t start = stats.time_us;
+
+    if (busy_until > stats.time_us) {
+        stats.time_us = busy_until;
+    }
+    stats.time_us += ((uint64_t)bytes * 8 * 1000000 + spi_hz - 1) / spi_hz;
+    stats.commands++;
+    if (realtime) {
+        usleep((useconds_t)(stats.time_us - start));
+    }
+}
+
+static void device_busy(uint32_t us)
+{
+    busy_until = stats.time_us + us;
+}
+
+static int check_range(uint32_t address, size_t size)
+{
+    if ((address >= HOST_FLASH_SIZE) || (size > HOST_FLASH_SIZE - address)) {
+        stats.address_errors++;
+        return 0;
+    }
+    return 1;
+}
+
+/* Programs up to a page, the bytes cleared only. Returns 0 when the power was
+   cut in the middle. */
+static int program_page(uint32_t address, const uint8_t *data, uint32_t size)
+{
+    uint32_t i;
+
+    bus_transfer(STATUS_BYTES + WRITE_ENABLE_BYTES + ADDRESS_CMD_BYTES + size);
+    stats.page_programs++;
+    if (sector_protected[address / SECTOR_SIZE]) {
+        stats.protect_errors++;
+        return 1;
+    }
+    for (i = 0; i < size; i++) {
+        if (cut_armed && (cut_budget-- == 0)) {
+            /* The byte being programmed gets some of its bits */
+            image[address + i] &= (uint8_t)(data[i] | (uint8_t)rand());
+            power_lost = 1;
+            cut_armed = 0;
+            return 0;
+        }
+        image[address + i] &= data[i];
+    }
+    stats.program_bytes += size;
+    device_busy(PAGE_PROGRAM_US);
+    return 1;
+}
+
+/* Erases size bytes from an aligned address */
+static void erase(uint32_t address, uint32_t size, uint32_t us)
+{
+    uint32_t offset;
+    uint32_t done = size;
+
+    bus_transfer(STATUS_BYTES + WRITE_ENABLE_BYTES + ADDRESS_CMD_BYTES);
+    if (cut_armed && (cut_budget-- == 0)) {
+        /* Part of the block is erased */
+        done = (uint32_t)rand() % size;
+        power_lost = 1;
+        cut_armed = 0;
+    }
+    for (offset = 0; offset < size; offset += SECTOR_SIZE) {
+        if (sector_protected[(address + offset) / SECTOR_SIZE]) {
+            stats.protect_errors++;
+            return;
+        }
+    }
+    memset(image + address, 0xFF, done);
+    for (offset = 0; offset < done; offset += BLOCK_4K) {
+        block_erases[(address + offset) / BLOCK_4K]++;
+        if (block_erases[(address + offset) / BLOCK_4K] > stats.max_block_erases) {
+            stats.max_block_erases = block_erases[(address + offset) / BLOCK_4K];
+        }
+    }
+    device_busy(us);
+}
+
+/***************************************************************************//**
+ *  See host_flash.h for more information.
+ */
+int host_flash_open(const char *path)
+{
+    struct stat st;
+    int created = 0;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        if (ftruncate(fd, HOST_FLASH_SIZE) < 0) {
+            close(fd);
+            return -1;
+        }
+        created = 1;
+    } else if (st.st_size != (off_t)HOST_FLASH_SIZE) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    image = mmap(NULL, HOST_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        image = NULL;
+        return -1;
+    }
+    if (created) {
+        memset(image, 0xFF, HOST_FLASH_SIZE);
+    }
+    memset(&stats, 0, sizeof(stats));
+    memset(block_erases, 0, sizeof(block_erases));
+    busy_until = 0;
+    host_flash_power_on();
+    return 0;
+}
+
+/***************************************************************************//**
+ *  See host_flash.h for more information.
+ */
+void host_flash_close(void)
+{
+    if (image != NULL) {
+        msync(image, HOST_FLASH_SIZE, MS_SYNC);
+        munmap(image, HOST_FLASH_SIZE);
+        image = NULL;
+    }
+}
+
+/***************************************************************************//**
+ *  See host_flash.h for more information.
+ */
+void host_flash_set_spi_hz(uint32_t hz)
+{
+    spi_hz = hz;
+}
+
+/***************************************************************************//**
+ *  See host_flash.h for more information.
+ */
+void host_flash_set_realtime(int enable)
+{
+    realtime = enable;
+}
+
+/***************************************************************************//**
+ *  See host_flash.h for more information.
+ */
+void host_flash_power_cut(uint32_t program_bytes)
+{
+    cut_budget = program_bytes;
+    cut_armed = (program_bytes != 0);
+}
+
+/***************************************************************************//**
+ *  See host_flash.h for more information.
+ */
+int host_flash_power_lost(void)
+{
+    return power_lost;
+}
+
+/***************************************************************************//**
+ *  See host_flash.h for more information.
+ */
+void host_flash_power_on(void)
+{
+    power_lost = 0;
+    cut_armed = 0;
+    async_pending = 0;
+    memset(sector_protected, 1, sizeof(sector_protected));
+}
+
+/***************************************************************************//**
+ *  See host_flash.h for more information.
+ */
+void host_flash_get_stats(host_flash_stats_t *out)
+{
+    *out = stats;
+}
+
+/*------------------------------------------------------------------------------
+ * spi_flash.h API
+ */
+spi_flash_status_t spi_flash_init(void)
+{
+    return (image != NULL) ? SPI_FLASH_SUCCESS : SPI_FLASH_UNSUCCESS;
+}
+
+spi_flash_status_t spi_flash_control_hw(spi_flash_control_hw_t operation, uint32_t peram1, void *ptrPeram)
+{
+    uint32_t i;
+
+    if ((image == NULL) || power_lost) {
+        return SPI_FLASH_UNSUCCESS;
+    }
+
+    switch (operation) {
+    case SPI_FLASH_READ_DEVICE_ID:
+        bus_transfer(STATUS_BYTES + READ_CMD_BYTES);
+        ((struct device_Info *)ptrPeram)->manufacturer_id = 0x1F;
+        ((struct device_Info *)ptrPeram)->device_id = 0x48;
+        break;
+    case SPI_FLASH_SECTOR_PROTECT:
+    case SPI_FLASH_SECTOR_UNPROTECT:
+        bus_transfer(STATUS_BYTES + WRITE_ENABLE_BYTES + ADDRESS_CMD_BYTES);
+        if (!check_range(peram1, 1)) {
+            return SPI_FLASH_INVALID_ADDRESS;
+        }
+        sector_protected[peram1 / SECTOR_SIZE] = (operation == SPI_FLASH_SECTOR_PROTECT);
+        break;
+    case SPI_FLASH_GLOBAL_PROTECT:
+    case SPI_FLASH_GLOBAL_UNPROTECT:
+        /* The driver sends a zero status register for both */
+        bus_transfer(STATUS_BYTES + WRITE_ENABLE_BYTES + 2);
+        memset(sector_protected, 0, sizeof(sector_protected));
+        break;
+    case SPI_FLASH_CHIP_ERASE:
+        erase(0, HOST_FLASH_SIZE, CHIP_ERASE_US);
+        stats.chip_erases++;
+        break;
+    case SPI_FLASH_4KBLOCK_ERASE:
+    case SPI_FLASH_32KBLOCK_ERASE:
+    case SPI_FLASH_64KBLOCK_ERASE:
+        if (!check_range(peram1, 1)) {
+            return SPI_FLASH_INVALID_ADDRESS;
+        }
+        if (operation == SPI_FLASH_4KBLOCK_ERASE) {
+            erase(peram1 & ~(BLOCK_4K - 1), BLOCK_4K, ERASE_4K_US);
+            stats.erases_4k++;
+        } else if (operation == SPI_FLASH_32KBLOCK_ERASE) {
+            erase(peram1 & ~(0x8000UL - 1), 0x8000UL, ERASE_32K_US);
+            stats.erases_32k++;
+        } else {
+            erase(peram1 & ~(SECTOR_SIZE - 1), SECTOR_SIZE, ERASE_64K_US);
+            stats.erases_64k++;
+        }
+        break;
+    case SPI_FLASH_RESET:
+        bus_transfer(STATUS_BYTES + WRITE_ENABLE_BYTES);
+        break;
+    case SPI_FLASH_GET_STATUS:
+    {
+        /* Busy bit and software protection bits: all, none or some */
+        uint32_t count = 0;
+
+        bus_transfer(STATUS_BYTES);
+        for (i = 0; i < NB_SECTORS; i++) {
+            count += sector_protected[i];
+        }
+        return (spi_flash_status_t)(((busy_until > stats.time_us) ? 0x01 : 0x00) |
+                                    ((count == NB_SECTORS) ? 0x0C : (count ? 0x04 : 0x00)));
+    }
+    default:
+        return SPI_FLASH_INVALID_ARGUMENTS;
+    }
+    return (power_lost) ? SPI_FLASH_UNSUCCESS : SPI_FLASH_SUCCESS;
+}
+
+spi_flash_status_t spi_flash_read(uint32_t address, uint8_t *rx_buffer, size_t size_in_bytes)
+{
+    if ((image == NULL) || power_lost) {
+        return SPI_FLASH_UNSUCCESS;
+    }
+    if (!check_range(address, size_in_bytes)) {
+        return SPI_FLASH_INVALID_ADDRESS;
+    }
+    bus_transfer(STATUS_BYTES + READ_CMD_BYTES + size_in_bytes);
+    memcpy(rx_buffer, image + address, size_in_bytes);
+    stats.reads++;
+    stats.read_bytes += size_in_bytes;
+    return SPI_FLASH_SUCCESS;
+}
+
+spi_flash_status_t spi_flash_write(uint32_t address, uint8_t *write_buffer, size_t size_in_bytes)
+{
+    uint32_t size;
+
+    if ((image == NULL) || power_lost) {
+        return SPI_FLASH_UNSUCCESS;
+    }
+    if (!check_range(address, size_in_bytes)) {
+        return SPI_FLASH_INVALID_ADDRESS;
+    }
+
+    /* Write enable and unprotect of the first sector, then page programs */
+    bus_transfer(STATUS_BYTES + WRITE_ENABLE_BYTES + STATUS_BYTES + ADDRESS_CMD_BYTES);
+    sector_protected[address / SECTOR_SIZE] = 0;
+    while (size_in_bytes > 0) {
+        size = PAGE_SIZE_BYTES - (address & (PAGE_SIZE_BYTES - 1));
+        if (size > size_in_bytes) {
+            size = size_in_bytes;
+        }
+        if (!program_page(address, write_buffer, size)) {
+            return SPI_FLASH_UNSUCCESS;
+        }
+        address += size;
+        write_buffer += size;
+        size_in_bytes -= size;
+    }
+    bus_transfer(STATUS_BYTES + WRITE_ENABLE_BYTES);
+    return SPI_FLASH_SUCCESS;
+}
+
+#ifdef USE_DMA_FOR_SPI_FLASH
+/* The copy is done at once, the wait only checks a read was started */
+spi_flash_status_t spi_flash_read_async(uint32_t address, uint8_t *rx_buffer, size_t size_in_bytes)
+{
+    spi_flash_status_t status;
+
+    if (async_pending) {
+        return SPI_FLASH_UNSUCCESS;
+    }
+    status = spi_flash_read(address, rx_buffer, size_in_bytes);
+    async_pending = (status == SPI_FLASH_SUCCESS);
+    return status;
+}
+
+spi_flash_status_t spi_flash_read_wait(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    if (!async_pending) {
+        return SPI_FLASH_UNSUCCESS;
+    }
+    async_pending = 0;
+    return SPI_FLASH_SUCCESS;
+}
+#endif
+
+#if SPI_FLASH_CACHE_PAGES > 0
+/* The read cache of the driver is not simulated, every read reaches the image */
+void spi_flash_cache_invalidate(void)
+{
+}
+
+void spi_flash_get_cache_stats(spi_flash_cache_stats_t *cache_stats)
+{
+    memset(cache_stats, 0, sizeof(*cache_stats));
+}
+#endif
@@ -0,0 +1,91 @@
+/*******************************************************************************
+ *  host_flash.h: Linux implementation of the spi_flash.h API.
+ *
+ *  The AT25DF641 is simulated on a memory mapped image file, so the storage
+ *  layers above the driver can be run and measured on the host and the image
+ *  inspected or kept between runs. The simulation follows the device rather
+ *  than the ideal API:
+ *
+ *  - programming only clears bits, an erase sets a whole 4, 32 or 64 KB block
+ *    or the chip to 0xFF;
+ *  - spi_flash_write() programs page by page like the driver, after
+ *    unprotecting the 64 KB sector of its start address only;
+ *  - the sectors are protected at power up, programs and erases of a
+ *    protected sector are ignored and counted;
+ *  - every command takes its SPI transfer time and programs and erases their
+ *    typical busy time on a simulated clock, which can also be slept.
+ *
+ *  A power cut can be armed to tear a program or an erase part way and fail
+ *  every access until host_flash_power_on().
+ */
+#ifndef HOST_FLASH_H_
+#define HOST_FLASH_H_
+
+#include <stdint.h>
+
+#define HOST_FLASH_SIZE         0x800000UL      /* 64 Mbit */
+#define HOST_FLASH_SPI_HZ       390625UL        /* PCLK 100 MHz / 256 */
+
+typedef struct host_flash_stats {
+    uint64_t time_us;           /* simulated time spent by the flash */
+    uint32_t commands;
+    uint32_t reads;
+    uint64_t read_bytes;
+    uint32_t page_programs;
+    uint64_t program_bytes;
+    uint32_t erases_4k;
+    uint32_t erases_32k;
+    uint32_t erases_64k;
+    uint32_t chip_erases;
+    uint32_t protect_errors;    /* programs or erases of a protected sector */
+    uint32_t address_errors;    /* accesses beyond the device */
+    uint32_t max_block_erases;  /* erases of the most erased 4 KB block */
+} host_flash_stats_t;
+
+/***************************************************************************//**
+ * Maps the image file, created erased when it does not exist.
+ *
+ * @param path      image file of HOST_FLASH_SIZE bytes
+ * @return          0 on success, -1 with errno set otherwise
+ */
+int host_flash_open(const char *path);
+
+/***************************************************************************//**
+ * Writes the image back and unmaps it.
+ */
+void host_flash_close(void);
+
+/***************************************************************************//**
+ * Sets the SPI clock of the simulated transfers, HOST_FLASH_SPI_HZ by default.
+ */
+void host_flash_set_spi_hz(uint32_t hz);
+
+/***************************************************************************//**
+ * With realtime set, the caller sleeps for the simulated time of each command
+ * as the task calling the driver would on the target.
+ */
+void host_flash_set_realtime(int realtime);
+
+/***************************************************************************//**
+ * Cuts the power once program_bytes more bytes are programmed, or during the
+ * erase after them. 0 disarms.
+ */
+void host_flash_power_cut(uint32_t program_bytes);
+
+/***************************************************************************//**
+ * Returns 1 once an armed power cut happened.
+ */
+int host_flash_power_lost(void);
+
+/***************************************************************************//**
+ * Restores the power: accesses work again and every sector is protected, as
+ * after a reset of the device.
+ */
+void host_flash_power_on(void);
+
+/***************************************************************************//**
+ * Copies the counters.
+ */
+void host_flash_get_stats(host_flash_stats_t *stats);
+
+#endif /* HOST_FLASH_H_ */
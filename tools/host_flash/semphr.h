@@ -0,0 +1,25 @@
+/*******************************************************************************
+ *  semphr.h: host stand-in for the FreeRTOS binary semaphores used by the
+ *  flash storage layers, built on the queues of host_mac/host_rtos.c.
+ *
+ *  The host runs one thread, so a semaphore is only ever taken when free.
+ */
+#ifndef HOST_SEMPHR_H_
+#define HOST_SEMPHR_H_
+
+#include "queue.h"
+
+typedef xQueueHandle xSemaphoreHandle;
+
+#define vSemaphoreCreateBinary(sem)                 \
+    do {                                            \
+        (sem) = xQueueCreate(1, 0);                 \
+        if ((sem) != NULL) {                        \
+            xSemaphoreGive(sem);                    \
+        }                                           \
+    } while (0)
+
+#define xSemaphoreTake(sem, wait)   xQueueReceive((sem), NULL, (wait))
+#define xSemaphoreGive(sem)         xQueueSend((sem), NULL, 0)
+
+#endif /* HOST_SEMPHR_H_ */
@@ -0,0 +1,40 @@
+/*******************************************************************************
+ *  FreeRTOS.h: host stand-in for the RTOS definitions used by the network
+ *  stack.
+ *
+ *  The host harness runs the stack from a single thread, so critical sections
+ *  reduce to nothing. The tick is kept at 1 us like on the target so that
+ *  NET_MS_TO_TICKS() gives the same values.
+ */
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define portBASE_TYPE           long
+#define portTickType            unsigned long
+#define portMAX_DELAY           ((portTickType)0xFFFFFFFFUL)
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdPASS                  1
+#define pdFAIL                  0
+#define errQUEUE_EMPTY          0
+#define errQUEUE_FULL           0
+#define errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY   (-1)
+
+#define configTICK_RATE_HZ      ((portTickType)1000000)
+#define configCPU_CLOCK_HZ      ((unsigned long)100000000)
+#define configMINIMAL_STACK_SIZE    128
+#define tskIDLE_PRIORITY        0
+
+#define portENTER_CRITICAL()
+#define portEXIT_CRITICAL()
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+/* Current time in ticks, provided by host_main.c */
+portTickType xTaskGetTickCount(void);
+
+#endif /* HOST_FREERTOS_H_ */
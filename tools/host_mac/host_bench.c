@@ -0,0 +1,598 @@
+/*******************************************************************************
+ *  host_bench.c: load generator and regression benchmark for the receive
+ *  path of the drivers/mac TCP/IP stack.
+ *
+ *  Synthetic frames are fed through the receive path of the network
+ *  interface task, net_classify() then tcpip_input() in a packet buffer,
+ *  against a stubbed MAC that only counts the frames the stack transmits.
+ *  Each case runs a ring of prepared frames: ARP requests, ICMP echo
+ *  requests paced to the echo rate limit and flooding it, TCP SYNs to the
+ *  HTTP port each followed by a reset, a SYN flood with all connections busy,
+ *  malformed headers and frames for another host. Pacing is done by moving
+ *  the clock of the stack forward after each frame.
+ *  For every case the time per frame of the fastest of three runs, the frames
+ *  transmitted and the packet buffers allocated per frame are printed, and a case fails when it
+ *  transmits another number of replies than expected or leaks buffers.
+ *
+ *  With -w the frame rates are saved as a baseline, with -b they are compared
+ *  to a saved baseline and the program exits with status 1 when a case is
+ *  more than -t percent slower. Baselines only compare runs of the same
+ *  build on the same machine, so keep them out of the repository:
+ *
+ *      make bench              saves bench.baseline on the first run,
+ *                              compares to it on the next ones
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "../../drivers/mss_ethernet_mac/mss_ethernet_mac.h"
+#include "../../drivers/mac/netif.h"
+#include "../../drivers/mac/net_timer.h"
+#include "../../drivers/mac/pbuf.h"
+#include "../../drivers/mac/nettype.h"
+#include "../../drivers/mac/tcpip.h"
+#include "../../drivers/mac/httpd.h"
+#include "../../drivers/mac/igmp.h"
+#include "../../drivers/mac/icmp.h"
+#include "../../drivers/mac/net_classify.h"
+
+#define BENCH_VARIANTS      64          /* frames in the ring of a case */
+#define BENCH_FRAME_MAX     128
+#define BENCH_TX_PENDING    16
+#define BENCH_NO_CHECK      (-1)
+#define BENCH_REPEAT        3           /* runs per case, the fastest counts */
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+extern unsigned char my_mac[ETH_ADDR_LEN];
+
+static const uint8_t bench_peer_mac[ETH_ADDR_LEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t bench_peer_ip[IP_ADDR_LEN] = { 192, 168, 0, 1 };
+static const uint8_t bench_other_ip[IP_ADDR_LEN] = { 192, 168, 0, 99 };
+
+typedef struct bench_case {
+    const char *name;
+    uint16_t (*build)(uint8_t *frame, uint32_t i);
+    int tx_pct;                         /* replies per 100 frames */
+    uint32_t advance_us;                /* stack clock moved on per frame */
+} bench_case_t;
+
+typedef struct bench_result {
+    uint32_t frames;
+    double ns_per_frame;
+    double kfps;
+    double tx_per_frame;
+    double allocs_per_frame;
+    uint16_t leaked;
+} bench_result_t;
+
+static netif_stats_t bench_stats;
+static struct {
+    MSS_MAC_tx_complete_t complete;
+    void *context;
+} bench_tx_done[BENCH_TX_PENDING];
+static uint32_t bench_tx_done_count;
+static uint32_t bench_tx_frames;
+static uint8_t bench_frames[BENCH_VARIANTS][BENCH_FRAME_MAX];
+static uint16_t bench_lengths[BENCH_VARIANTS];
+static uint64_t bench_clock_offset_ns;
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/***************************************************************************//**
+ *  See FreeRTOS.h for more information.
+ */
+portTickType xTaskGetTickCount(void)
+{
+    return (portTickType)((bench_now_ns() + bench_clock_offset_ns) / 1000ULL);
+}
+
+/*------------------------------------------------------------------------------
+ * Stubbed MAC: transmitted frames are counted and dropped, completions are
+ * deferred to MSS_MAC_tx_reclaim() as on the target.
+ */
+int32_t MSS_MAC_tx_packet_sg(const mss_mac_tx_segment_t *segments, uint8_t segment_count,
+                             MSS_MAC_tx_complete_t complete, void *context,
+                             uint32_t time_out)
+{
+    int32_t total = 0;
+    uint8_t i;
+
+    (void)time_out;
+    for (i = 0; i < segment_count; i++) {
+        total += segments[i].length;
+    }
+    if ((total == 0) || (total > MSS_MAX_PACKET_SIZE)) {
+        return 0;
+    }
+    bench_tx_frames++;
+    if (complete != NULL) {
+        if (bench_tx_done_count == BENCH_TX_PENDING) {
+            MSS_MAC_tx_reclaim();
+        }
+        bench_tx_done[bench_tx_done_count].complete = complete;
+        bench_tx_done[bench_tx_done_count].context = context;
+        bench_tx_done_count++;
+    }
+    return total;
+}
+
+int32_t MSS_MAC_tx_packet(const uint8_t *pacData, uint16_t pacLen, uint32_t time_out)
+{
+    mss_mac_tx_segment_t segment;
+
+    segment.data = pacData;
+    segment.length = pacLen;
+    return MSS_MAC_tx_packet_sg(&segment, 1, NULL, NULL, time_out);
+}
+
+uint32_t MSS_MAC_tx_reclaim(void)
+{
+    uint32_t count = bench_tx_done_count;
+    uint32_t i;
+
+    bench_tx_done_count = 0;
+    for (i = 0; i < count; i++) {
+        bench_tx_done[i].complete(bench_tx_done[i].context);
+    }
+    return count;
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_output(const uint8_t *frame, uint16_t length,
+                           MSS_MAC_tx_complete_t complete, void *context,
+                           portTickType wait)
+{
+    mss_mac_tx_segment_t seg;
+
+    (void)wait;
+    seg.data = frame;
+    seg.length = length;
+    if (MSS_MAC_tx_packet_sg(&seg, 1, complete, context, MSS_MAC_BLOCKING) == 0) {
+        bench_stats.tx_dropped++;
+        return errQUEUE_FULL;
+    }
+    bench_stats.tx_frames++;
+    return pdPASS;
+}
+
+static void bench_pbuf_sent(void *context)
+{
+    pbuf_free((pbuf_t *)context);
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_output_pbuf(pbuf_t *p, portTickType wait)
+{
+    mss_mac_tx_segment_t seg[16];
+    uint8_t count = 0;
+    pbuf_t *q;
+
+    (void)wait;
+    for (q = p; (q != NULL) && (count < 16); q = q->next) {
+        seg[count].data = q->payload;
+        seg[count].length = q->len;
+        count++;
+    }
+    if ((q != NULL) ||
+        (MSS_MAC_tx_packet_sg(seg, count, bench_pbuf_sent, p, MSS_MAC_BLOCKING) == 0)) {
+        pbuf_free(p);
+        bench_stats.tx_dropped++;
+        return errQUEUE_FULL;
+    }
+    bench_stats.tx_frames++;
+    return pdPASS;
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_set_mac_filters(const uint8_t *filters, uint16_t count)
+{
+    (void)filters;
+    return (count > NET_MAC_FILTERS) ? pdFAIL : pdPASS;
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+const netif_stats_t *netif_get_stats(void)
+{
+    return &bench_stats;
+}
+
+/*------------------------------------------------------------------------------
+ * Frame builders. Each returns the length of frame i of the ring of its case.
+ */
+static uint32_t bench_sum(const uint8_t *buf, uint32_t len, uint32_t sum)
+{
+    uint32_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        sum += (uint32_t)((buf[i] << 8) | buf[i + 1]);
+    }
+    if (len & 1) {
+        sum += (uint32_t)(buf[len - 1] << 8);
+    }
+    return sum;
+}
+
+static void bench_put_csum(uint8_t *at, uint32_t sum)
+{
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    sum = ~sum & 0xffff;
+    at[0] = (uint8_t)(sum >> 8);
+    at[1] = (uint8_t)sum;
+}
+
+/* Ethernet and IP headers to dst, returns the offset of the IP payload */
+static uint16_t bench_ip(uint8_t *frame, const uint8_t *dst, uint8_t proto, uint16_t plen,
+                         uint32_t id)
+{
+    ether_hdr_t *eth = (ether_hdr_t *)frame;
+    ip_hdr_t *ip = (ip_hdr_t *)(frame + sizeof(ether_hdr_t));
+    uint16_t tlen = (uint16_t)(sizeof(ip_hdr_t) + plen);
+
+    memcpy(eth->da, my_mac, ETH_ADDR_LEN);
+    memcpy(eth->sa, bench_peer_mac, ETH_ADDR_LEN);
+    eth->type_code[0] = ETH_TYPE_0;
+    eth->type_code[1] = ETH_TYPE_IP_1;
+    memset(ip, 0, sizeof(*ip));
+    ip->ver_hlen = 0x45;
+    ip->tlen[0] = (uint8_t)(tlen >> 8);
+    ip->tlen[1] = (uint8_t)tlen;
+    ip->id[0] = (uint8_t)(id >> 8);
+    ip->id[1] = (uint8_t)id;
+    ip->ttl = 64;
+    ip->proto = proto;
+    memcpy(ip->sa, bench_peer_ip, IP_ADDR_LEN);
+    memcpy(ip->da, dst, IP_ADDR_LEN);
+    bench_put_csum(ip->csum, bench_sum((uint8_t *)ip, sizeof(*ip), 0));
+    return sizeof(ether_hdr_t) + sizeof(ip_hdr_t);
+}
+
+static uint16_t bench_build_arp(uint8_t *frame, uint32_t i)
+{
+    ether_hdr_t *eth = (ether_hdr_t *)frame;
+    arp_pkt_t *arp = (arp_pkt_t *)(frame + sizeof(ether_hdr_t));
+    static const uint8_t request[] = { 0x00, 0x01, 0x08, 0x00, 6, 4, 0x00, 0x01 };
+
+    (void)i;
+    memset(eth->da, 0xff, ETH_ADDR_LEN);
+    memcpy(eth->sa, bench_peer_mac, ETH_ADDR_LEN);
+    eth->type_code[0] = ETH_TYPE_0;
+    eth->type_code[1] = ETH_TYPE_ARP_1;
+    memcpy(arp, request, sizeof(request));
+    memcpy(arp->mac_sa, bench_peer_mac, ETH_ADDR_LEN);
+    memcpy(arp->ip_sa, bench_peer_ip, IP_ADDR_LEN);
+    memset(arp->mac_ta, 0, ETH_ADDR_LEN);
+    memcpy(arp->ip_ta, my_ip, IP_ADDR_LEN);
+    return 60;
+}
+
+static uint16_t bench_build_ping(uint8_t *frame, uint32_t i)
+{
+    uint16_t off = bench_ip(frame, my_ip, ICMP_PROTO, 8 + 56, i);
+    uint8_t *icmp = frame + off;
+    uint8_t k;
+
+    icmp[0] = ICMP_TYPE_ECHO_REQUEST;
+    icmp[1] = 0;
+    icmp[2] = icmp[3] = 0;
+    icmp[4] = 0x12;
+    icmp[5] = 0x34;
+    icmp[6] = (uint8_t)(i >> 8);
+    icmp[7] = (uint8_t)i;
+    for (k = 0; k < 56; k++) {
+        icmp[8 + k] = k;
+    }
+    bench_put_csum(icmp + 2, bench_sum(icmp, 8 + 56, 0));
+    return (uint16_t)(off + 8 + 56);
+}
+
+/* TCP segment of 20 bytes with an MSS option when flags has SYN */
+static uint16_t bench_tcp(uint8_t *frame, uint16_t sport, uint32_t seq, uint8_t flags)
+{
+    uint16_t hlen = (flags & TCP_CNTRL_SYN) ? 24 : 20;
+    uint16_t off = bench_ip(frame, my_ip, TCP_PROTO, hlen, sport);
+    uint8_t *tcp = frame + off;
+    uint32_t sum;
+
+    memset(tcp, 0, hlen);
+    tcp[0] = (uint8_t)(sport >> 8);
+    tcp[1] = (uint8_t)sport;
+    tcp[2] = (uint8_t)(HTTPD_PORT >> 8);
+    tcp[3] = (uint8_t)HTTPD_PORT;
+    tcp[4] = (uint8_t)(seq >> 24);
+    tcp[5] = (uint8_t)(seq >> 16);
+    tcp[6] = (uint8_t)(seq >> 8);
+    tcp[7] = (uint8_t)seq;
+    tcp[12] = (uint8_t)((hlen / 4) << 4);
+    tcp[13] = flags;
+    tcp[14] = 0x16;                     /* window 5840 */
+    tcp[15] = 0xd0;
+    if (hlen == 24) {
+        tcp[20] = 2;                    /* MSS 1460 */
+        tcp[21] = 4;
+        tcp[22] = 0x05;
+        tcp[23] = 0xb4;
+    }
+    sum = bench_sum(bench_peer_ip, IP_ADDR_LEN, 0);
+    sum = bench_sum(my_ip, IP_ADDR_LEN, sum);
+    sum += TCP_PROTO + hlen;
+    bench_put_csum(tcp + 16, bench_sum(tcp, hlen, sum));
+    return (uint16_t)(off + hlen);
+}
+
+/* A SYN then the reset that releases the connection again */
+static uint16_t bench_build_syn(uint8_t *frame, uint32_t i)
+{
+    uint16_t sport = (uint16_t)(40000 + i / 2);
+    uint32_t seq = 1000 * i;
+
+    if (i & 1) {
+        return bench_tcp(frame, sport, seq - 1000 + 1, TCP_CNTRL_RST);
+    }
+    return bench_tcp(frame, sport, seq, TCP_CNTRL_SYN);
+}
+
+/* SYNs from ever new ports, once the connections are taken they are ignored */
+static uint16_t bench_build_flood(uint8_t *frame, uint32_t i)
+{
+    return bench_tcp(frame, (uint16_t)(50000 + i), 7777 * i, TCP_CNTRL_SYN);
+}
+
+static uint16_t bench_build_malformed(uint8_t *frame, uint32_t i)
+{
+    ip_hdr_t *ip = (ip_hdr_t *)(frame + sizeof(ether_hdr_t));
+    uint16_t len = bench_build_ping(frame, i);
+
+    switch (i % 6) {
+    case 0:                             /* runt, Ethernet header only */
+        return sizeof(ether_hdr_t);
+    case 1:                             /* IP header checksum wrong */
+        ip->csum[1] ^= 0x5a;
+        return len;
+    case 2:                             /* total length beyond the frame */
+        ip->tlen[0] += 2;
+        break;
+    case 3:                             /* not IPv4 */
+        ip->ver_hlen = 0x65;
+        break;
+    case 4:                             /* header length below 20 bytes */
+        ip->ver_hlen = 0x43;
+        break;
+    default:                            /* ICMP checksum wrong */
+        frame[sizeof(ether_hdr_t) + sizeof(ip_hdr_t) + 2] ^= 0x5a;
+        return len;
+    }
+    ip->csum[0] = ip->csum[1] = 0;
+    bench_put_csum(ip->csum, bench_sum((uint8_t *)ip, sizeof(*ip), 0));
+    return len;
+}
+
+static uint16_t bench_build_foreign(uint8_t *frame, uint32_t i)
+{
+    uint16_t len = bench_build_ping(frame, i);
+    ip_hdr_t *ip = (ip_hdr_t *)(frame + sizeof(ether_hdr_t));
+
+    memcpy(ip->da, bench_other_ip, IP_ADDR_LEN);
+    ip->csum[0] = ip->csum[1] = 0;
+    bench_put_csum(ip->csum, bench_sum((uint8_t *)ip, sizeof(*ip), 0));
+    return len;
+}
+
+static const bench_case_t bench_cases[] = {
+    { "arp",        bench_build_arp,       100,            0 },
+    { "ping",       bench_build_ping,      100,            1000000 / NET_ICMP_ECHO_RATE },
+    { "ping_flood", bench_build_ping,      BENCH_NO_CHECK, 0 },
+    { "syn",        bench_build_syn,       50,             0 },
+    { "syn_flood",  bench_build_flood,     BENCH_NO_CHECK, 0 },
+    { "malformed",  bench_build_malformed, 0,              0 },
+    { "foreign",    bench_build_foreign,   0,              0 },
+};
+
+#define BENCH_CASES (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+/***************************************************************************//**
+ * Hands one frame to the stack, as netif_poll_rx() does with a frame in the
+ * receive buffer of the MAC.
+ */
+static void bench_rx(const uint8_t *frame, uint16_t length)
+{
+    pbuf_t *p;
+
+    if (net_classify(frame, length) == NET_RX_DROP) {
+        bench_stats.rx_filtered++;
+        return;
+    }
+    p = pbuf_alloc(0, NET_PBUF_SIZE);
+    if (p == NULL) {
+        bench_stats.rx_no_pbuf++;
+        return;
+    }
+    memcpy(p->payload, frame, length);
+    p->len = length;
+    p->tot_len = length;
+    bench_stats.rx_frames++;
+    tcpip_input(p);
+    MSS_MAC_tx_reclaim();
+}
+
+static uint32_t bench_allocs(void)
+{
+    return pbuf_get_stats(PBUF_POOL_DATA)->allocs + pbuf_get_stats(PBUF_POOL_REF)->allocs;
+}
+
+static void bench_run(const bench_case_t *c, uint32_t frames, bench_result_t *r)
+{
+    uint32_t allocs, tx, i, n;
+    uint16_t used;
+    uint64_t t0, dt, best = 0;
+
+    for (i = 0; i < BENCH_VARIANTS; i++) {
+        memset(bench_frames[i], 0, BENCH_FRAME_MAX);
+        bench_lengths[i] = c->build(bench_frames[i], i);
+    }
+    /* Warm the caches and fill the ARP cache and connections first */
+    for (i = 0; i < BENCH_VARIANTS; i++) {
+        bench_rx(bench_frames[i], bench_lengths[i]);
+        bench_clock_offset_ns += c->advance_us * 1000ULL;
+    }
+
+    used = pbuf_get_stats(PBUF_POOL_DATA)->used + pbuf_get_stats(PBUF_POOL_REF)->used;
+    allocs = bench_allocs();
+    tx = bench_tx_frames;
+    for (n = 0; n < BENCH_REPEAT; n++) {
+        t0 = bench_now_ns();
+        for (i = 0; i < frames; i++) {
+            bench_rx(bench_frames[i % BENCH_VARIANTS], bench_lengths[i % BENCH_VARIANTS]);
+            bench_clock_offset_ns += c->advance_us * 1000ULL;
+        }
+        dt = bench_now_ns() - t0;
+        if ((n == 0) || (dt < best)) {
+            best = dt;
+        }
+        net_timer_poll();
+    }
+
+    r->frames = frames;
+    r->ns_per_frame = (double)best / frames;
+    r->kfps = (best > 0) ? (double)frames * 1e6 / (double)best : 0.0;
+    r->tx_per_frame = (double)(bench_tx_frames - tx) / ((double)frames * BENCH_REPEAT);
+    r->allocs_per_frame = (double)(bench_allocs() - allocs) / ((double)frames * BENCH_REPEAT);
+    r->leaked = (uint16_t)(pbuf_get_stats(PBUF_POOL_DATA)->used +
+                           pbuf_get_stats(PBUF_POOL_REF)->used - used);
+}
+
+/* Rate of a case in a baseline file, 0 when the file has none */
+static double bench_baseline(const char *path, const char *name)
+{
+    char line[128], key[64];
+    double kfps;
+    FILE *f = fopen(path, "r");
+    double found = 0.0;
+
+    if (f == NULL) {
+        return 0.0;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if ((sscanf(line, "%63s %lf", key, &kfps) == 2) && !strcmp(key, name)) {
+            found = kfps;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static void bench_usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n frames] [-b baseline] [-w baseline] [-t pct] [case]...\n"
+                    "  -n  frames per case, 200000 by default\n"
+                    "  -b  fail when a case is slower than in the baseline file\n"
+                    "  -w  save the frame rates to a baseline file\n"
+                    "  -t  tolerated slowdown in percent, 25 by default\n", prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    bench_result_t r;
+    const char *compare = NULL;
+    const char *save = NULL;
+    FILE *out = NULL;
+    uint32_t frames = 200000;
+    double tolerance = 25.0;
+    double base;
+    int failed = 0;
+    int opt, k;
+    size_t i;
+
+    while ((opt = getopt(argc, argv, "b:n:t:w:")) != -1) {
+        switch (opt) {
+        case 'b':
+            compare = optarg;
+            break;
+        case 'n':
+            frames = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        case 'w':
+            save = optarg;
+            break;
+        default:
+            bench_usage(argv[0]);
+        }
+    }
+    if (frames == 0) {
+        bench_usage(argv[0]);
+    }
+    if ((save != NULL) && ((out = fopen(save, "w")) == NULL)) {
+        perror(save);
+        return 1;
+    }
+
+    pbuf_init();
+    net_timer_init();
+    tcp_init();
+    igmp_init();
+    httpd_init(NULL, 0);
+
+    printf("%-10s %10s %10s %10s %8s %8s\n", "case", "frames", "ns/frame", "kframes/s", "tx", "allocs");
+    for (i = 0; i < BENCH_CASES; i++) {
+        const bench_case_t *c = &bench_cases[i];
+
+        if (optind < argc) {
+            for (k = optind; (k < argc) && strcmp(argv[k], c->name); k++) {
+            }
+            if (k == argc) {
+                continue;
+            }
+        }
+        bench_run(c, frames, &r);
+        printf("%-10s %10lu %10.1f %10.1f %8.2f %8.2f", c->name, (unsigned long)r.frames,
+               r.ns_per_frame, r.kfps, r.tx_per_frame, r.allocs_per_frame);
+        if (r.leaked) {
+            printf("  FAIL: %u buffers leaked", (unsigned)r.leaked);
+            failed = 1;
+        }
+        if ((c->tx_pct != BENCH_NO_CHECK) &&
+            ((int)(r.tx_per_frame * 100.0 + 0.5) != c->tx_pct)) {
+            printf("  FAIL: %d replies per 100 frames expected", c->tx_pct);
+            failed = 1;
+        }
+        if (compare != NULL) {
+            base = bench_baseline(compare, c->name);
+            if ((base > 0.0) && (r.kfps < base * (100.0 - tolerance) / 100.0)) {
+                printf("  FAIL: %.1f%% below the baseline", 100.0 - r.kfps * 100.0 / base);
+                failed = 1;
+            }
+        }
+        printf("\n");
+        if (out != NULL) {
+            fprintf(out, "%s %.1f\n", c->name, r.kfps);
+        }
+    }
+    if (out != NULL) {
+        fclose(out);
+    }
+    return failed;
+}
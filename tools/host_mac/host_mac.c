@@ -0,0 +1,504 @@
+/*******************************************************************************
+ *  host_mac.c: Linux implementation of the mss_ethernet_mac.h API.
+ *
+ *  Transmitted frames are written straight away, so the transmit ring never
+ *  fills; completion functions are still deferred to MSS_MAC_tx_reclaim() as
+ *  on the target. A received frame is read into a single buffer standing for
+ *  the receive ring and stays there until it is consumed, which gives
+ *  MSS_MAC_rx_pckt_size() and MSS_MAC_rx_packet_ptrset() their target
+ *  behaviour. Sizes follow the target driver: MSS_MAC_rx_pckt_size() includes
+ *  the 4 byte FCS, the receive functions do not. Once filters are set, frames
+ *  are filtered on their destination address as the MAC would, exactly for
+ *  up to 15 multicast addresses and by hash beyond.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+#include "host_mac.h"
+#include "../../drivers/mss_ethernet_mac/crc32.h"
+
+#define HOST_MAC_NOT_ENOUGH_SPACE   (-5)
+#define HOST_MAC_FCS_LEN            4
+#define HOST_MAC_TX_PENDING         16
+#define HOST_MAC_PERFECT_FILTERS    15
+
+typedef struct host_mac_tx_done {
+    MSS_MAC_tx_complete_t complete;
+    void *context;
+} host_mac_tx_done_t;
+
+static struct {
+    int fd;
+    uint8_t mac_address[6];
+    uint32_t configuration;
+    MSS_MAC_callback_t listener;
+    MSS_MAC_capture_t capture_hook;
+    uint8_t rx_irq_enabled;
+
+    uint8_t filter_set;                     /* filter programmed, see above */
+    uint16_t filter_count;
+    uint8_t filters[HOST_MAC_PERFECT_FILTERS * 6];
+    uint8_t hash[64];
+
+    uint8_t rx_frame[2048];                 /* room to spot frames too long */
+    int32_t rx_length;                      /* 0 when no frame is held */
+
+    host_mac_tx_done_t tx_done[HOST_MAC_TX_PENDING];
+    uint32_t tx_done_count;
+
+    uint32_t rx_frames;
+    uint32_t tx_frames;
+    uint32_t rx_too_long;
+    uint32_t rx_filtered;
+    const char *last_error;
+} host_mac = { -1 };
+
+static int host_mac_attach(int fd);
+static void host_mac_fill(void);
+static int host_mac_accept(const uint8_t *da);
+static void host_mac_capture(uint32_t direction, const uint8_t *frame, uint32_t length);
+static int host_mac_write(const struct iovec *iov, int count, size_t total, uint32_t time_out);
+
+/***************************************************************************//**
+ *  See host_mac.h for more information.
+ */
+int host_mac_open(const char *spec)
+{
+    struct ifreq ifr;
+    int fd;
+
+    if (strncmp(spec, "tap:", 4) == 0) {
+        fd = open("/dev/net/tun", O_RDWR);
+        if (fd < 0) {
+            return -1;
+        }
+        memset(&ifr, 0, sizeof(ifr));
+        ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+        strncpy(ifr.ifr_name, spec + 4, IFNAMSIZ - 1);
+        if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+            close(fd);
+            return -1;
+        }
+    } else if (strncmp(spec, "fd:", 3) == 0) {
+        fd = atoi(spec + 3);
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+    return host_mac_attach(fd);
+}
+
+/***************************************************************************//**
+ *  See host_mac.h for more information.
+ */
+int host_mac_open_pipe(void)
+{
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        return -1;
+    }
+    if (host_mac_attach(sv[0]) < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    return sv[1];
+}
+
+/***************************************************************************//**
+ * Makes fd the frame source. Reads must not block since the receive functions
+ * poll the "ring".
+ */
+static int host_mac_attach(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+        return -1;
+    }
+    host_mac.fd = fd;
+    return 0;
+}
+
+/***************************************************************************//**
+ *  See host_mac.h for more information.
+ */
+int host_mac_fd(void)
+{
+    return host_mac.fd;
+}
+
+/***************************************************************************//**
+ *  See host_mac.h for more information.
+ */
+int host_mac_poll(int timeout_ms)
+{
+    struct pollfd pfd;
+
+    if (host_mac.rx_length == 0) {
+        pfd.fd = host_mac.fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeout_ms) > 0) {
+            host_mac_fill();
+        }
+    }
+    if (host_mac.rx_length == 0) {
+        return 0;
+    }
+    if (host_mac.rx_irq_enabled && (host_mac.listener != NULL)) {
+        host_mac.listener(MSS_MAC_EVENT_PACKET_RECEIVED);
+    }
+    return 1;
+}
+
+/***************************************************************************//**
+ * Reads the next frame into the receive buffer if it is free. Frames longer
+ * than MSS_MAX_PACKET_SIZE are dropped as the MAC would.
+ */
+static void host_mac_fill(void)
+{
+    ssize_t n;
+
+    if ((host_mac.rx_length != 0) || (host_mac.fd < 0)) {
+        return;
+    }
+    n = read(host_mac.fd, host_mac.rx_frame, sizeof(host_mac.rx_frame));
+    if (n <= 0) {
+        return;
+    }
+    if (n > (ssize_t)MSS_MAX_PACKET_SIZE) {
+        host_mac.rx_too_long++;
+        return;
+    }
+    if ((n < 6) || !host_mac_accept(host_mac.rx_frame)) {
+        host_mac.rx_filtered++;
+        return;
+    }
+    host_mac.rx_length = (int32_t)n;
+    host_mac.rx_frames++;
+}
+
+/***************************************************************************//**
+ * Address filter of the MAC, for the destination address da.
+ */
+static int host_mac_accept(const uint8_t *da)
+{
+    uint32_t hash;
+    uint16_t i;
+
+    if (!host_mac.filter_set || (host_mac.configuration & MSS_MAC_CFG_PROMISCUOUS_MODE) ||
+        !memcmp(da, host_mac.mac_address, 6)) {
+        return 1;
+    }
+    if (!(da[0] & 1)) {
+        return 0;
+    }
+    if (host_mac.configuration & MSS_MAC_CFG_PASS_ALL_MULTICAST) {
+        return 1;
+    }
+    if (host_mac.filter_count <= HOST_MAC_PERFECT_FILTERS) {
+        for (i = 0; i < host_mac.filter_count; i++) {
+            if (!memcmp(da, &host_mac.filters[i * 6], 6)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    hash = mss_ethernet_crc(da, 6) & 0x1FF;
+    return (host_mac.hash[hash / 8] >> (hash & 7)) & 1;
+}
+
+/***************************************************************************//**
+ * Gives a frame to the capture hook, if any.
+ */
+static void host_mac_capture(uint32_t direction, const uint8_t *frame, uint32_t length)
+{
+    mss_mac_tx_segment_t segment;
+
+    if (host_mac.capture_hook != NULL) {
+        segment.data = frame;
+        segment.length = (uint16_t)length;
+        host_mac.capture_hook(direction, &segment, 1u);
+    }
+}
+
+/***************************************************************************//**
+ * Writes a frame. A full device queue stands for a full transmit ring: the
+ * write is retried while the time out, in milliseconds, allows.
+ */
+static int host_mac_write(const struct iovec *iov, int count, size_t total, uint32_t time_out)
+{
+    struct pollfd pfd;
+
+    for (;;) {
+        if (writev(host_mac.fd, iov, count) == (ssize_t)total) {
+            return 1;
+        }
+        if ((errno != EAGAIN) || (time_out == MSS_MAC_NONBLOCKING)) {
+            return 0;
+        }
+        pfd.fd = host_mac.fd;
+        pfd.events = POLLOUT;
+        if ((poll(&pfd, 1, (time_out == MSS_MAC_BLOCKING) ? -1 : (int)time_out) <= 0)
+            && (time_out != MSS_MAC_BLOCKING)) {
+            return 0;
+        }
+    }
+}
+
+void MSS_MAC_init(uint8_t phy_address)
+{
+    (void)phy_address;
+    host_mac.listener = NULL;
+    host_mac.capture_hook = NULL;
+    host_mac.rx_irq_enabled = 1;
+    host_mac.rx_length = 0;
+    host_mac.tx_done_count = 0;
+    host_mac.last_error = NULL;
+    if (host_mac.fd < 0) {
+        host_mac.last_error = "no frame source, call host_mac_open() first";
+    }
+}
+
+void MSS_MAC_configure(uint32_t configuration)
+{
+    host_mac.configuration = configuration;
+}
+
+int32_t MSS_MAC_get_configuration(void)
+{
+    return (int32_t)host_mac.configuration;
+}
+
+int32_t MSS_MAC_tx_packet(const uint8_t *pacData, uint16_t pacLen, uint32_t time_out)
+{
+    mss_mac_tx_segment_t segment;
+
+    segment.data = pacData;
+    segment.length = pacLen;
+    return MSS_MAC_tx_packet_sg(&segment, 1, NULL, NULL, time_out);
+}
+
+int32_t MSS_MAC_tx_packet_sg(const mss_mac_tx_segment_t *segments, uint8_t segment_count,
+                             MSS_MAC_tx_complete_t complete, void *context,
+                             uint32_t time_out)
+{
+    struct iovec iov[256];
+    size_t total = 0;
+    uint8_t i;
+
+    (void)time_out;
+    for (i = 0; i < segment_count; i++) {
+        iov[i].iov_base = (void *)segments[i].data;
+        iov[i].iov_len = segments[i].length;
+        total += segments[i].length;
+    }
+    if ((total == 0) || (total > MSS_MAX_PACKET_SIZE)) {
+        host_mac.last_error = "invalid frame length";
+        return 0;
+    }
+    if (host_mac.capture_hook != NULL) {
+        host_mac.capture_hook(MSS_MAC_CAPTURE_TX, segments, segment_count);
+    }
+
+    /* One writev() is one frame on both the TAP device and the pipe */
+    if (!host_mac_write(iov, segment_count, total, time_out)) {
+        host_mac.last_error = "frame write failed";
+        return 0;
+    }
+    host_mac.tx_frames++;
+
+    if (complete != NULL) {
+        if (host_mac.tx_done_count == HOST_MAC_TX_PENDING) {
+            MSS_MAC_tx_reclaim();
+        }
+        host_mac.tx_done[host_mac.tx_done_count].complete = complete;
+        host_mac.tx_done[host_mac.tx_done_count].context = context;
+        host_mac.tx_done_count++;
+    }
+    return (int32_t)total;
+}
+
+uint32_t MSS_MAC_tx_reclaim(void)
+{
+    uint32_t count = host_mac.tx_done_count;
+    uint32_t i;
+
+    /* Completions may transmit again, take the list first */
+    host_mac.tx_done_count = 0;
+    for (i = 0; i < count; i++) {
+        host_mac.tx_done[i].complete(host_mac.tx_done[i].context);
+    }
+    return count;
+}
+
+int32_t MSS_MAC_rx_pckt_size(void)
+{
+    host_mac_fill();
+    return (host_mac.rx_length == 0) ? 0 : host_mac.rx_length + HOST_MAC_FCS_LEN;
+}
+
+void MSS_MAC_prepare_rx_descriptor(void)
+{
+    host_mac.rx_length = 0;
+}
+
+/***************************************************************************//**
+ * Waits for a frame. The target time out is counted in milliseconds here.
+ */
+static int host_mac_wait_rx(uint32_t time_out)
+{
+    if (time_out == MSS_MAC_BLOCKING) {
+        while (!host_mac_poll(-1)) {
+        }
+        return 1;
+    }
+    host_mac_fill();
+    if ((host_mac.rx_length == 0) && (time_out != MSS_MAC_NONBLOCKING)) {
+        host_mac_poll((int)time_out);
+    }
+    return host_mac.rx_length != 0;
+}
+
+int32_t MSS_MAC_rx_packet(uint8_t *pacData, uint16_t pacLen, uint32_t time_out)
+{
+    int32_t length;
+
+    if (!host_mac_wait_rx(time_out)) {
+        return 0;
+    }
+    length = host_mac.rx_length;
+    if (length > pacLen) {
+        return HOST_MAC_NOT_ENOUGH_SPACE;
+    }
+    memcpy(pacData, host_mac.rx_frame, (size_t)length);
+    host_mac_capture(MSS_MAC_CAPTURE_RX, pacData, (uint32_t)length);
+    host_mac.rx_length = 0;
+    return length;
+}
+
+int32_t MSS_MAC_rx_packet_ptrset(uint8_t **pacData, uint32_t time_out)
+{
+    if (!host_mac_wait_rx(time_out)) {
+        return 0;
+    }
+    *pacData = host_mac.rx_frame;
+    host_mac_capture(MSS_MAC_CAPTURE_RX, *pacData, (uint32_t)host_mac.rx_length);
+    return host_mac.rx_length;
+}
+
+int32_t MSS_MAC_link_status(void)
+{
+    return MSS_MAC_LINK_STATUS_LINK | MSS_MAC_LINK_STATUS_100MB | MSS_MAC_LINK_STATUS_FDX;
+}
+
+int32_t MSS_MAC_auto_setup_link(void)
+{
+    return MSS_MAC_link_status();
+}
+
+void MSS_MAC_set_mac_address(const uint8_t *new_address)
+{
+    memcpy(host_mac.mac_address, new_address, sizeof(host_mac.mac_address));
+}
+
+void MSS_MAC_get_mac_address(uint8_t *address)
+{
+    memcpy(address, host_mac.mac_address, sizeof(host_mac.mac_address));
+}
+
+void MSS_MAC_set_mac_filters(uint16_t filter_count, const uint8_t *filters)
+{
+    uint32_t hash;
+    uint16_t i;
+
+    host_mac.filter_set = 1;
+    host_mac.filter_count = filter_count;
+    if (filter_count <= HOST_MAC_PERFECT_FILTERS) {
+        memcpy(host_mac.filters, filters, (size_t)filter_count * 6);
+        return;
+    }
+    memset(host_mac.hash, 0, sizeof(host_mac.hash));
+    for (i = 0; i < filter_count; i++) {
+        hash = mss_ethernet_crc(&filters[i * 6], 6) & 0x1FF;
+        host_mac.hash[hash / 8] |= (uint8_t)(1 << (hash & 7));
+    }
+}
+
+void MSS_MAC_set_callback(MSS_MAC_callback_t listener)
+{
+    host_mac.listener = listener;
+}
+
+void MSS_MAC_enable_rx_irq(void)
+{
+    host_mac.rx_irq_enabled = 1;
+}
+
+void MSS_MAC_disable_rx_irq(void)
+{
+    host_mac.rx_irq_enabled = 0;
+}
+
+void MSS_MAC_set_ring_sizes(uint32_t rx_size, uint32_t tx_size)
+{
+    (void)rx_size;
+    (void)tx_size;
+    host_mac.rx_length = 0;
+    host_mac.tx_done_count = 0;
+}
+
+void MSS_MAC_set_interrupt_mitigation(uint8_t rx_frames, uint8_t rx_timer,
+                                      uint8_t tx_frames, uint8_t tx_timer,
+                                      uint8_t cycle_size)
+{
+    (void)rx_frames;
+    (void)rx_timer;
+    (void)tx_frames;
+    (void)tx_timer;
+    (void)cycle_size;
+}
+
+void MSS_MAC_set_wait_hook(MSS_MAC_wait_hook_t hook)
+{
+    /* Writes never wait and receive waits use poll() */
+    (void)hook;
+}
+
+void MSS_MAC_set_capture_hook(MSS_MAC_capture_t hook)
+{
+    host_mac.capture_hook = hook;
+}
+
+const int8_t *MSS_MAC_last_error(void)
+{
+    return (const int8_t *)host_mac.last_error;
+}
+
+uint32_t MSS_MAC_get_statistics(mss_mac_statistics_id_t stat_id)
+{
+    switch (stat_id) {
+    case MSS_MAC_RX_INTERRUPTS:
+        return host_mac.rx_frames;
+    case MSS_MAC_RX_FRAME_TOO_LONG:
+        return host_mac.rx_too_long;
+    case MSS_MAC_RX_FILTERING_FAIL:
+        return host_mac.rx_filtered;
+    case MSS_MAC_TX_INTERRUPTS:
+        return host_mac.tx_frames;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,46 @@
+/*******************************************************************************
+ *  host_mac.h: Linux implementation of the mss_ethernet_mac.h API.
+ *
+ *  Frames are exchanged with a TAP device, so the stack can be reached by
+ *  ping, curl or iperf from the host, or with a frame pipe: a SOCK_SEQPACKET
+ *  socket whose other end is held by a scripted peer. Each read or write on
+ *  the pipe carries exactly one Ethernet frame, without FCS.
+ */
+#ifndef HOST_MAC_H_
+#define HOST_MAC_H_
+
+#include "../../drivers/mss_ethernet_mac/mss_ethernet_mac.h"
+
+/***************************************************************************//**
+ * Selects the frame source, before MSS_MAC_init().
+ *
+ * @param spec      "tap:NAME" to create or attach to TAP interface NAME, or
+ *                  "fd:N" to use the already open frame pipe N.
+ * @return          0 on success, -1 with errno set otherwise
+ */
+int host_mac_open(const char *spec);
+
+/***************************************************************************//**
+ * Creates a frame pipe and makes one end the MAC. The other end is returned
+ * for use by an in-process peer.
+ *
+ * @return          peer end of the pipe, -1 with errno set on error
+ */
+int host_mac_open_pipe(void);
+
+/***************************************************************************//**
+ * Returns the file descriptor frames are read from, for use with poll().
+ */
+int host_mac_fd(void);
+
+/***************************************************************************//**
+ * Waits up to timeout_ms milliseconds for a frame, -1 waits forever. Calls
+ * the MSS_MAC_set_callback() listener with MSS_MAC_EVENT_PACKET_RECEIVED when
+ * a frame is ready and the receive interrupt is enabled, which stands for the
+ * MAC interrupt.
+ *
+ * @return          1 if a frame is ready, 0 otherwise
+ */
+int host_mac_poll(int timeout_ms);
+
+#endif /* HOST_MAC_H_ */
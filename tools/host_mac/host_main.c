@@ -0,0 +1,430 @@
+/*******************************************************************************
+ *  host_main.c: runs the TCP/IP stack of drivers/mac on a Linux host.
+ *
+ *  Stands in for the network interface task: frames read from the host MAC
+ *  are handed to tcpip_input() in packet buffers and the frames queued by the
+ *  stack are sent at once. Network timers run from the same loop, as in the
+ *  task, and the DHCP client starts unless -n is given. With -u, datagrams
+ *  received on a UDP port are echoed back to their sender, -g joins a
+ *  multicast group so that it can be sent to as well. -l drops the given
+ *  percentage of received frames. On exit, or every
+ *  -s seconds, the frame and byte counts and the time spent in the stack per received frame are printed.
+ *
+ *  Build with make in this directory, then for instance
+ *
+ *      sudo ./host_stack -a 192.168.7.2 tap:tap0
+ *      sudo ip addr add 192.168.7.1/24 dev tap0 && sudo ip link set tap0 up
+ *      ping 192.168.7.2
+ *      curl --compressed http://192.168.7.2/ http://192.168.7.2/status/net
+ *
+ *  or let a scripted peer own the other end of a frame pipe, see peer.py:
+ *
+ *      python3 peer.py ./host_stack
+ */
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "FreeRTOS.h"
+#include "host_mac.h"
+#include "../../drivers/mac/netif.h"
+#include "../../drivers/mac/net_timer.h"
+#include "../../drivers/mac/dhcp.h"
+#include "../../drivers/mac/pbuf.h"
+#include "../../drivers/mac/nettype.h"
+#include "../../drivers/mac/tcpip.h"
+#include "../../drivers/mac/udp.h"
+#include "../../drivers/mac/httpd.h"
+#include "../../drivers/mac/ip_reass.h"
+#include "../../drivers/mac/igmp.h"
+#include "../../drivers/mac/icmp.h"
+#include "../../drivers/mac/net_classify.h"
+
+extern unsigned char my_ip[IP_ADDR_LEN];
+extern unsigned char my_mac[ETH_ADDR_LEN];
+
+static netif_stats_t host_stats;
+static int host_loss_pct;
+static volatile sig_atomic_t host_stop;
+static struct {
+    uint32_t rx_frames;             /* counted by the capture hook, whichever */
+    uint32_t tx_frames;             /* path the frame took */
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint64_t rx_ns_total;           /* time spent in tcpip_input() */
+    uint64_t rx_ns_max;
+    uint64_t start_ns;
+} host_perf;
+
+static uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/***************************************************************************//**
+ *  See FreeRTOS.h for more information.
+ */
+portTickType xTaskGetTickCount(void)
+{
+    return (portTickType)(host_now_ns() / 1000ULL);
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_output(const uint8_t *frame, uint16_t length,
+                           MSS_MAC_tx_complete_t complete, void *context,
+                           portTickType wait)
+{
+    mss_mac_tx_segment_t seg;
+
+    (void)wait;
+    seg.data = frame;
+    seg.length = length;
+    if (MSS_MAC_tx_packet_sg(&seg, 1, complete, context, MSS_MAC_BLOCKING) == 0) {
+        host_stats.tx_dropped++;
+        return errQUEUE_FULL;
+    }
+    host_stats.tx_frames++;
+    MSS_MAC_tx_reclaim();
+    return pdPASS;
+}
+
+static void host_pbuf_sent(void *context)
+{
+    pbuf_free((pbuf_t *)context);
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_output_pbuf(pbuf_t *p, portTickType wait)
+{
+    mss_mac_tx_segment_t seg[16];
+    uint8_t count = 0;
+    pbuf_t *q;
+
+    (void)wait;
+    for (q = p; (q != NULL) && (count < 16); q = q->next) {
+        seg[count].data = q->payload;
+        seg[count].length = q->len;
+        count++;
+    }
+    if ((q != NULL) ||
+        (MSS_MAC_tx_packet_sg(seg, count, host_pbuf_sent, p, MSS_MAC_BLOCKING) == 0)) {
+        pbuf_free(p);
+        host_stats.tx_dropped++;
+        return errQUEUE_FULL;
+    }
+    host_stats.tx_frames++;
+    MSS_MAC_tx_reclaim();
+    return pdPASS;
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+portBASE_TYPE netif_set_mac_filters(const uint8_t *filters, uint16_t count)
+{
+    if (count > NET_MAC_FILTERS) {
+        return pdFAIL;
+    }
+    MSS_MAC_set_mac_filters(count, filters);
+    return pdPASS;
+}
+
+/***************************************************************************//**
+ *  See netif.h for more information.
+ */
+const netif_stats_t *netif_get_stats(void)
+{
+    return &host_stats;
+}
+
+/***************************************************************************//**
+ * Hands every waiting frame to the stack, as netif_poll_rx() does.
+ */
+static void host_poll_rx(void)
+{
+    int32_t len;
+    uint8_t *frame;
+    pbuf_t *p;
+    uint64_t t0, dt;
+
+    while ((len = MSS_MAC_rx_packet_ptrset(&frame, MSS_MAC_NONBLOCKING)) > 0) {
+        if (net_classify(frame, (uint32_t)len) == NET_RX_DROP) {
+            MSS_MAC_prepare_rx_descriptor();
+            host_stats.rx_filtered++;
+            continue;
+        }
+        p = pbuf_alloc(0, NET_PBUF_SIZE);
+        if (p == NULL) {
+            MSS_MAC_tx_reclaim();
+            p = pbuf_alloc(0, NET_PBUF_SIZE);
+        }
+        if (p == NULL) {
+            MSS_MAC_prepare_rx_descriptor();
+            host_stats.rx_no_pbuf++;
+            continue;
+        }
+        if (len > (int32_t)p->len) {
+            MSS_MAC_prepare_rx_descriptor();
+            host_stats.rx_dropped++;
+            pbuf_free(p);
+            continue;
+        }
+        memcpy(p->payload, frame, (size_t)len);
+        MSS_MAC_prepare_rx_descriptor();
+        p->len = (uint16_t)len;
+        p->tot_len = (uint16_t)len;
+        if ((host_loss_pct > 0) && (rand() % 100 < host_loss_pct)) {
+            /* Simulated loss, lets the retransmissions be exercised */
+            pbuf_free(p);
+            host_stats.rx_dropped++;
+            continue;
+        }
+        host_stats.rx_frames++;
+
+        t0 = host_now_ns();
+        tcpip_input(p);
+        dt = host_now_ns() - t0;
+        host_perf.rx_ns_total += dt;
+        if (dt > host_perf.rx_ns_max) {
+            host_perf.rx_ns_max = dt;
+        }
+    }
+}
+
+/***************************************************************************//**
+ * MAC capture hook, counts the traffic in both directions.
+ */
+static void host_count(uint32_t direction, const mss_mac_tx_segment_t *segments,
+                       uint8_t segment_count)
+{
+    uint64_t length = 0;
+    uint8_t i;
+
+    for (i = 0; i < segment_count; i++) {
+        length += segments[i].length;
+    }
+    if (direction == MSS_MAC_CAPTURE_TX) {
+        host_perf.tx_frames++;
+        host_perf.tx_bytes += length;
+    } else {
+        host_perf.rx_frames++;
+        host_perf.rx_bytes += length;
+    }
+}
+
+static void host_report(void)
+{
+    static const char *const states[] = {
+        "off", "selecting", "requesting", "bound", "renewing", "rebinding"
+    };
+    double secs = (double)(host_now_ns() - host_perf.start_ns) / 1e9;
+    const pbuf_stats_t *ps = pbuf_get_stats(PBUF_POOL_DATA);
+    const ip_reass_stats_t *rs = ip_reass_get_stats();
+    const icmp_stats_t *is = icmp_get_stats();
+    const net_rx_rule_t *rules;
+    const uint32_t *hits;
+    uint8_t i, count;
+
+    printf("%.1f s: rx %lu frames %.0f kbit/s, tx %lu frames %.0f kbit/s\n",
+           secs,
+           (unsigned long)host_perf.rx_frames, (double)host_perf.rx_bytes * 8.0 / 1000.0 / secs,
+           (unsigned long)host_perf.tx_frames, (double)host_perf.tx_bytes * 8.0 / 1000.0 / secs);
+    printf("  stack time per rx frame: avg %.1f us, max %.1f us\n",
+           host_stats.rx_frames ? (double)host_perf.rx_ns_total / 1000.0 / host_stats.rx_frames : 0.0,
+           (double)host_perf.rx_ns_max / 1000.0);
+    printf("  address %u.%u.%u.%u, dhcp %s\n",
+           my_ip[0], my_ip[1], my_ip[2], my_ip[3], states[dhcp_get_state()]);
+    printf("  dropped: rx %lu, rx no pbuf %lu, rx filtered %lu by the MAC %lu by rules, tx %lu; "
+           "pbufs used at most %u of %u\n",
+           (unsigned long)host_stats.rx_dropped, (unsigned long)host_stats.rx_no_pbuf,
+           (unsigned long)MSS_MAC_get_statistics(MSS_MAC_RX_FILTERING_FAIL),
+           (unsigned long)host_stats.rx_filtered,
+           (unsigned long)host_stats.tx_dropped, (unsigned)ps->max_used, (unsigned)ps->avail);
+    if (rs->fragments) {
+        printf("  fragments %lu: %lu datagrams, %lu timed out, %lu too big, %lu evicted\n",
+               (unsigned long)rs->fragments, (unsigned long)rs->datagrams,
+               (unsigned long)rs->timeouts, (unsigned long)rs->too_big, (unsigned long)rs->evicted);
+    }
+    if (is->echo_requests) {
+        printf("  echo requests %lu: %lu replies, %lu rate limited, %lu tx ring full\n",
+               (unsigned long)is->echo_requests, (unsigned long)is->echo_replies,
+               (unsigned long)is->rate_limited, (unsigned long)is->tx_full);
+    }
+    rules = net_classify_rules(&count);
+    hits = net_classify_hits();
+    printf("  rx rules:");
+    for (i = 0; i < count; i++) {
+        printf(" %s %lu,", rules[i].name, (unsigned long)hits[i]);
+    }
+    printf(" unmatched %lu\n", (unsigned long)hits[count]);
+    fflush(stdout);
+}
+
+/* Dynamic page of the web server, the counters of the harness */
+static void host_status(httpd_buf_t *out)
+{
+    const pbuf_stats_t *ps = pbuf_get_stats(PBUF_POOL_DATA);
+
+    httpd_puts(out, "{\"rx_frames\":");
+    httpd_putu(out, host_stats.rx_frames);
+    httpd_puts(out, ",\"tx_frames\":");
+    httpd_putu(out, host_perf.tx_frames);
+    httpd_puts(out, ",\"pbufs_max_used\":");
+    httpd_putu(out, ps->max_used);
+    httpd_puts(out, "}\n");
+}
+
+static const httpd_cgi_t host_pages[] = {
+    { "/status/net", "application/json", host_status },
+};
+
+/* Echoes what arrived on the socket. The sender is in the ARP cache since
+   its datagram was received, so there is nothing to wait for. */
+static void host_echo(udp_socket_t *s)
+{
+    unsigned char ip[IP_ADDR_LEN];
+    uint16_t port;
+    pbuf_t *p;
+
+    while ((p = udp_recv_pbuf(s, ip, &port, 0)) != NULL) {
+        udp_sendto_pbuf(s, ip, port, p, 0);
+    }
+}
+
+static void host_on_signal(int sig)
+{
+    (void)sig;
+    host_stop = 1;
+}
+
+static void host_usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-a ip] [-g group]... [-l pct] [-m mac] [-n] [-s secs] [-u port] tap:NAME | fd:N\n"
+                    "  -g  join a multicast group\n"
+                    "  -l  drop pct %% of the received frames\n"
+                    "  -n  no DHCP client, keep the -a address\n"
+                    "  -u  echo the datagrams received on a UDP port\n", prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct in_addr addr;
+    unsigned int m[6];
+    int report_secs = 0;
+    int use_dhcp = NET_DHCP_CLIENT;
+    int echo_port = 0;
+    udp_socket_t *echo = NULL;
+    unsigned char groups[NET_IGMP_GROUPS][IP_ADDR_LEN];
+    int group_count = 0;
+    uint32_t wait_ms;
+    uint64_t next_report = 0;
+    int opt;
+    int i;
+
+    while ((opt = getopt(argc, argv, "a:g:l:m:ns:u:")) != -1) {
+        switch (opt) {
+        case 'a':
+            if (inet_pton(AF_INET, optarg, &addr) != 1) {
+                host_usage(argv[0]);
+            }
+            memcpy(my_ip, &addr, IP_ADDR_LEN);
+            break;
+        case 'g':
+            if ((group_count == NET_IGMP_GROUPS) || (inet_pton(AF_INET, optarg, &addr) != 1)) {
+                host_usage(argv[0]);
+            }
+            memcpy(groups[group_count++], &addr, IP_ADDR_LEN);
+            break;
+        case 'l':
+            host_loss_pct = atoi(optarg);
+            break;
+        case 'm':
+            if (sscanf(optarg, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) {
+                host_usage(argv[0]);
+            }
+            for (i = 0; i < 6; i++) {
+                my_mac[i] = (unsigned char)m[i];
+            }
+            break;
+        case 'n':
+            use_dhcp = 0;
+            break;
+        case 's':
+            report_secs = atoi(optarg);
+            break;
+        case 'u':
+            echo_port = atoi(optarg);
+            break;
+        default:
+            host_usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1) {
+        host_usage(argv[0]);
+    }
+    if (host_mac_open(argv[optind]) < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    signal(SIGINT, host_on_signal);
+    signal(SIGTERM, host_on_signal);
+
+    pbuf_init();
+    net_timer_init();
+    MSS_MAC_init(MSS_PHY_ADDRESS_AUTO_DETECT);
+    MSS_MAC_set_mac_address(my_mac);
+    MSS_MAC_set_capture_hook(host_count);
+    tcp_init();
+    igmp_init();
+    for (i = 0; i < group_count; i++) {
+        if (igmp_join(groups[i]) != 0) {
+            fprintf(stderr, "cannot join group %d\n", i + 1);
+            return 1;
+        }
+    }
+    httpd_init(host_pages, 1);
+    if (use_dhcp) {
+        dhcp_start();
+    }
+    if (echo_port > 0) {
+        echo = udp_bind((uint16_t)echo_port, 4);
+    }
+
+    host_perf.start_ns = host_now_ns();
+    next_report = host_perf.start_ns + (uint64_t)report_secs * 1000000000ULL;
+    while (!host_stop) {
+        wait_ms = net_timer_next_ms();
+        if (wait_ms > NET_IDLE_PERIOD_MS) {
+            wait_ms = NET_IDLE_PERIOD_MS;
+        }
+        host_stats.wakeups++;
+        if (host_mac_poll((int)wait_ms)) {
+            host_poll_rx();
+        }
+        if (echo != NULL) {
+            host_echo(echo);
+        }
+        MSS_MAC_tx_reclaim();
+        net_timer_poll();
+        if ((report_secs > 0) && (host_now_ns() >= next_report)) {
+            host_report();
+            next_report += (uint64_t)report_secs * 1000000000ULL;
+        }
+    }
+    host_report();
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*******************************************************************************
+ *  host_rtos.c: the few FreeRTOS services the network stack uses, for the
+ *  single threaded host harness.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+struct host_queue {
+    unsigned long length;
+    unsigned long item_size;
+    unsigned long head;
+    unsigned long count;
+    unsigned char items[];
+};
+
+xQueueHandle xQueueCreate(unsigned portBASE_TYPE length, unsigned portBASE_TYPE item_size)
+{
+    xQueueHandle q = malloc(sizeof(*q) + length * item_size);
+
+    if (q != NULL) {
+        q->length = length;
+        q->item_size = item_size;
+        q->head = 0;
+        q->count = 0;
+    }
+    return q;
+}
+
+void vQueueDelete(xQueueHandle q)
+{
+    free(q);
+}
+
+portBASE_TYPE xQueueSend(xQueueHandle q, const void *item, portTickType wait)
+{
+    (void)wait;
+    if (q->count == q->length) {
+        return errQUEUE_FULL;
+    }
+    memcpy(&q->items[((q->head + q->count) % q->length) * q->item_size], item, q->item_size);
+    q->count++;
+    return pdPASS;
+}
+
+portBASE_TYPE xQueueReceive(xQueueHandle q, void *item, portTickType wait)
+{
+    (void)wait;
+    if (q->count == 0) {
+        return errQUEUE_EMPTY;
+    }
+    memcpy(item, &q->items[q->head * q->item_size], q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdPASS;
+}
+
+void vTaskDelay(portTickType ticks)
+{
+    usleep((useconds_t)(ticks * 1000000UL / configTICK_RATE_HZ));
+}
+
+void vTaskSuspendAll(void)
+{
+}
+
+portBASE_TYPE xTaskResumeAll(void)
+{
+    return pdFALSE;
+}
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Scripted peer for host_stack.
+
+Starts host_stack on one end of a frame pipe and plays a host on the other
+end: resolves the stack's MAC address with ARP, then sends ICMP echo requests
+and UDP datagrams to the echo port of the stack and reports the round trip
+times. Echo requests are sent every -i seconds, slower than the echo reply
+rate limit of the stack (NET_ICMP_ECHO_RATE). The stack prints its own counters when it
+is stopped at the end.
+
+Usage:
+
+    peer.py [-n count] [-s size] [-i interval] [-a stack_ip] ./host_stack
+"""
+
+import argparse
+import os
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+PEER_MAC = bytes([0x02, 0x00, 0x00, 0x00, 0x00, 0x01])
+PEER_IP = "192.168.0.1"
+PEER_PORT = 40000
+ECHO_PORT = 7
+BROADCAST = b"\xff" * 6
+
+
+def checksum(data):
+    if len(data) % 2:
+        data += b"\0"
+    s = sum(struct.unpack("!%dH" % (len(data) // 2), data))
+    s = (s >> 16) + (s & 0xFFFF)
+    s += s >> 16
+    return ~s & 0xFFFF
+
+
+def arp_request(target_ip):
+    arp = struct.pack("!HHBBH6s4s6s4s", 1, 0x0800, 6, 4, 1, PEER_MAC,
+                      socket.inet_aton(PEER_IP), b"\0" * 6, socket.inet_aton(target_ip))
+    return BROADCAST + PEER_MAC + b"\x08\x06" + arp
+
+
+def icmp_echo(dst_mac, dst_ip, ident, seq, size):
+    payload = bytes(i & 0xFF for i in range(size))
+    icmp = struct.pack("!BBHHH", 8, 0, 0, ident, seq) + payload
+    icmp = icmp[:2] + struct.pack("!H", checksum(icmp)) + icmp[4:]
+    ip = struct.pack("!BBHHHBBH4s4s", 0x45, 0, 20 + len(icmp), seq, 0, 64, 1, 0,
+                     socket.inet_aton(PEER_IP), socket.inet_aton(dst_ip))
+    ip = ip[:10] + struct.pack("!H", checksum(ip)) + ip[12:]
+    return dst_mac + PEER_MAC + b"\x08\x00" + ip + icmp
+
+
+def udp_datagram(dst_mac, dst_ip, seq, size):
+    payload = struct.pack("!H", seq) + bytes(i & 0xFF for i in range(size))
+    udp = struct.pack("!HHHH", PEER_PORT, ECHO_PORT, 8 + len(payload), 0) + payload
+    pseudo = socket.inet_aton(PEER_IP) + socket.inet_aton(dst_ip) + struct.pack("!BBH", 0, 17, len(udp))
+    udp = udp[:6] + struct.pack("!H", checksum(pseudo + udp) or 0xFFFF) + udp[8:]
+    ip = struct.pack("!BBHHHBBH4s4s", 0x45, 0, 20 + len(udp), seq, 0, 64, 17, 0,
+                     socket.inet_aton(PEER_IP), socket.inet_aton(dst_ip))
+    ip = ip[:10] + struct.pack("!H", checksum(ip)) + ip[12:]
+    return dst_mac + PEER_MAC + b"\x08\x00" + ip + udp
+
+
+def is_udp_echo(frame, seq, size):
+    if frame[12:14] != b"\x08\x00" or frame[23] != 17:
+        return False
+    sport, dport, ulen, csum = struct.unpack("!HHHH", frame[34:42])
+    if (sport, dport, ulen) != (ECHO_PORT, PEER_PORT, 8 + 2 + size):
+        return False
+    udp = frame[34:34 + ulen]
+    pseudo = frame[26:34] + struct.pack("!BBH", 0, 17, ulen)
+    return checksum(pseudo + udp) == 0 and struct.unpack("!H", udp[8:10])[0] == seq
+
+
+def report(what, rtts, count):
+    if rtts:
+        rtts.sort()
+        print("%d/%d %s, rtt min %.0f us, median %.0f us, max %.0f us"
+              % (len(rtts), count, what, rtts[0], rtts[len(rtts) // 2], rtts[-1]))
+    else:
+        print("no %s" % what)
+
+
+def receive(sock, match, timeout):
+    deadline = time.monotonic() + timeout
+    while True:
+        left = deadline - time.monotonic()
+        if left <= 0:
+            return None
+        sock.settimeout(left)
+        try:
+            frame = sock.recv(2048)
+        except socket.timeout:
+            return None
+        if match(frame):
+            return frame
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("-n", type=int, default=100, help="echo requests to send")
+    ap.add_argument("-s", type=int, default=56, help="echo payload size")
+    ap.add_argument("-i", type=float, default=0.011, help="seconds between echo requests")
+    ap.add_argument("-a", default="192.168.0.14", help="address of the stack")
+    ap.add_argument("stack", help="path of host_stack")
+    args = ap.parse_args()
+
+    mine, theirs = socket.socketpair(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+    proc = subprocess.Popen([args.stack, "-n", "-u", str(ECHO_PORT), "-a", args.a, "fd:%d" % theirs.fileno()],
+                            pass_fds=[theirs.fileno()])
+    theirs.close()
+    failed = 0
+    try:
+        mine.send(arp_request(args.a))
+        reply = receive(mine, lambda f: f[12:14] == b"\x08\x06" and f[20:22] == b"\x00\x02", 1.0)
+        if reply is None:
+            print("no ARP reply from %s" % args.a)
+            return 1
+        stack_mac = reply[22:28]
+        print("%s is at %s" % (args.a, ":".join("%02x" % b for b in stack_mac)))
+
+        rtts = []
+        ident = os.getpid() & 0xFFFF
+        for seq in range(args.n):
+            if seq:
+                time.sleep(args.i)
+            t0 = time.perf_counter()
+            mine.send(icmp_echo(stack_mac, args.a, ident, seq, args.s))
+            reply = receive(mine, lambda f: f[12:14] == b"\x08\x00" and f[23] == 1 and
+                            f[34] == 0 and struct.unpack("!HH", f[38:42]) == (ident, seq), 1.0)
+            if reply is None:
+                failed += 1
+                continue
+            rtts.append((time.perf_counter() - t0) * 1e6)
+
+        report("echo replies", rtts, args.n)
+
+        rtts = []
+        for seq in range(args.n):
+            t0 = time.perf_counter()
+            mine.send(udp_datagram(stack_mac, args.a, seq, args.s))
+            reply = receive(mine, lambda f: is_udp_echo(f, seq, args.s), 1.0)
+            if reply is None:
+                failed += 1
+                continue
+            rtts.append((time.perf_counter() - t0) * 1e6)
+        report("UDP echoes", rtts, args.n)
+    finally:
+        proc.send_signal(signal.SIGTERM)
+        proc.wait()
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
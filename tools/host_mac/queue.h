@@ -0,0 +1,20 @@
+/*******************************************************************************
+ *  queue.h: host stand-in for the FreeRTOS queues used by the network stack,
+ *  implemented in host_rtos.c.
+ *
+ *  Nothing else runs while the single host thread waits, so a receive on an
+ *  empty queue fails at once whatever the wait.
+ */
+#ifndef HOST_QUEUE_H_
+#define HOST_QUEUE_H_
+
+#include "FreeRTOS.h"
+
+typedef struct host_queue *xQueueHandle;
+
+xQueueHandle xQueueCreate(unsigned portBASE_TYPE length, unsigned portBASE_TYPE item_size);
+void vQueueDelete(xQueueHandle q);
+portBASE_TYPE xQueueSend(xQueueHandle q, const void *item, portTickType wait);
+portBASE_TYPE xQueueReceive(xQueueHandle q, void *item, portTickType wait);
+
+#endif /* HOST_QUEUE_H_ */
@@ -0,0 +1,14 @@
+/*******************************************************************************
+ *  task.h: host stand-in for the FreeRTOS task functions used by the network
+ *  stack, implemented in host_rtos.c.
+ */
+#ifndef HOST_TASK_H_
+#define HOST_TASK_H_
+
+#include "FreeRTOS.h"
+
+void vTaskDelay(portTickType ticks);
+void vTaskSuspendAll(void);
+portBASE_TYPE xTaskResumeAll(void);
+
+#endif /* HOST_TASK_H_ */
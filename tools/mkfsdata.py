@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Generate the read-only file image of the HTTP server.
+
+Packs every file under the web directory into drivers/mac/fs_data.c as the
+fs_files table of drivers/mac/fs.h. Text files are gzipped when that makes
+them smaller and flagged FS_FLAG_GZIP; the server sends them as they are with
+Content-Encoding: gzip. The output does not depend on file times, so it only
+changes when the content does.
+
+Usage:
+
+    mkfsdata.py [web_dir [fs_data.c]]
+
+Run from the repository root after editing the pages and commit the result.
+"""
+
+import gzip
+import os
+import sys
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".htm": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".txt": "text/plain",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".gif": "image/gif",
+    ".jpg": "image/jpeg",
+    ".ico": "image/x-icon",
+}
+COMPRESSIBLE = {".html", ".htm", ".css", ".js", ".json", ".txt", ".svg"}
+MAX_SIZE = 0xFFFF
+
+
+def c_name(path):
+    return "data_" + "".join(c if c.isalnum() else "_" for c in path.strip("/"))
+
+
+def c_array(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("    " + " ".join("0x%02x," % b for b in data[i:i + 16]))
+    return "\n".join(lines)
+
+
+def collect(root):
+    files = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for name in sorted(filenames):
+            full = os.path.join(dirpath, name)
+            path = "/" + os.path.relpath(full, root).replace(os.sep, "/")
+            files.append((path, full))
+    return files
+
+
+def main(argv):
+    root = argv[1] if len(argv) > 1 else "web"
+    out = argv[2] if len(argv) > 2 else os.path.join("drivers", "mac", "fs_data.c")
+
+    entries = []
+    arrays = []
+    total = 0
+    for path, full in collect(root):
+        ext = os.path.splitext(path)[1].lower()
+        with open(full, "rb") as f:
+            data = f.read()
+        flags = "0"
+        if ext in COMPRESSIBLE:
+            packed = gzip.compress(data, 9, mtime=0)
+            if len(packed) < len(data):
+                data = packed
+                flags = "FS_FLAG_GZIP"
+        if len(data) > MAX_SIZE:
+            sys.stderr.write("%s: %d bytes, more than the server can send\n" % (path, len(data)))
+            return 1
+        name = c_name(path)
+        arrays.append("static const unsigned char %s[%d] = {\n%s\n};\n" % (name, len(data), c_array(data)))
+        entries.append('    { "%s", %s, sizeof(%s), "%s", %s },' %
+                       (path, name, name, CONTENT_TYPES.get(ext, "application/octet-stream"), flags))
+        total += len(data)
+        print("%-24s %6d bytes%s" % (path, len(data), " gzip" if flags != "0" else ""))
+
+    with open(out, "w", newline="\r\n") as f:
+        f.write("/*******************************************************************************\n")
+        f.write(" *  fs_data.c: file image of the HTTP server, see fs.h.\n")
+        f.write(" *\n")
+        f.write(" *  Generated by tools/mkfsdata.py from %s/, do not edit.\n" % root.rstrip("/"))
+        f.write(" */\n")
+        f.write('#include "fs.h"\n\n')
+        f.write("\n".join(arrays))
+        f.write("\nconst fs_file_t fs_files[] = {\n%s\n};\n\n" % "\n".join(entries))
+        f.write("const unsigned int fs_file_count = sizeof(fs_files) / sizeof(fs_files[0]);\n")
+    print("%d files, %d bytes in %s" % (len(entries), total, out))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
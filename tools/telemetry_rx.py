@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Receive the ADC telemetry stream of application_tasks/telemetry.c.
+
+Listens on the telemetry UDP port and prints, every few seconds, the datagram
+and sample rates, the datagrams lost on the network (gaps in the sequence
+numbers) and the samples the board dropped itself because the sender fell
+behind. Samples can also be written to a CSV file with their timestamps
+converted to seconds.
+
+Usage:
+
+    telemetry_rx.py [-p port] [-i secs] [-o samples.csv]
+
+Timestamps come from the 32 bit cycle counter, which wraps every 43 s at
+100 MHz; the receiver assumes consecutive samples are less than one wrap apart.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x314D4C54
+HDR = struct.Struct("<IIIHH")
+SAMPLE = struct.Struct("<IHH")
+
+
+class Stream:
+    def __init__(self, csv):
+        self.csv = csv
+        self.next_seq = None
+        self.high = 0
+        self.last_ts = None
+        self.first_ts = None
+        self.datagrams = 0
+        self.samples = 0
+        self.bytes = 0
+        self.net_lost = 0
+        self.board_lost = 0
+        self.bad = 0
+        self.reordered = 0
+
+    def unwrap(self, ts):
+        if self.last_ts is not None and ts < self.last_ts:
+            self.high += 1 << 32
+        self.last_ts = ts
+        return self.high + ts
+
+    def feed(self, data):
+        if len(data) < HDR.size:
+            self.bad += 1
+            return
+        magic, seq, clock_hz, count, lost = HDR.unpack_from(data)
+        if magic != MAGIC or len(data) < HDR.size + count * SAMPLE.size:
+            self.bad += 1
+            return
+        if self.next_seq is not None:
+            gap = (seq - self.next_seq) & 0xFFFFFFFF
+            if gap >= 0x80000000:
+                self.reordered += 1
+                return
+            self.net_lost += gap
+        self.next_seq = (seq + 1) & 0xFFFFFFFF
+        self.datagrams += 1
+        self.samples += count
+        self.bytes += len(data)
+        self.board_lost += lost
+        for i in range(count):
+            ts, channel, value = SAMPLE.unpack_from(data, HDR.size + i * SAMPLE.size)
+            ts = self.unwrap(ts)
+            if self.first_ts is None:
+                self.first_ts = ts
+            if self.csv:
+                self.csv.write("%.9f,%d,%d\n" % ((ts - self.first_ts) / clock_hz, channel, value))
+
+    def report(self, secs):
+        sent = self.datagrams + self.net_lost
+        print("%.1f s: %d datagrams %.0f/s, %d samples %.0f/s, %.0f kbit/s" %
+              (secs, self.datagrams, self.datagrams / secs, self.samples,
+               self.samples / secs, self.bytes * 8 / 1000 / secs))
+        print("  lost: %d datagrams on the network (%.2f %%), %d samples on the board; "
+              "%d bad, %d out of order" %
+              (self.net_lost, 100.0 * self.net_lost / sent if sent else 0.0,
+               self.board_lost, self.bad, self.reordered))
+        sys.stdout.flush()
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("-p", type=int, default=5005, help="UDP port")
+    ap.add_argument("-i", type=float, default=5.0, help="report interval in seconds")
+    ap.add_argument("-o", help="write the samples to this CSV file")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.bind(("", args.p))
+
+    csv = open(args.o, "w") if args.o else None
+    if csv:
+        csv.write("time,channel,value\n")
+    stream = Stream(csv)
+    start = time.monotonic()
+    next_report = start + args.i
+    try:
+        while True:
+            sock.settimeout(max(next_report - time.monotonic(), 0.001))
+            try:
+                stream.feed(sock.recv(2048))
+            except socket.timeout:
+                pass
+            now = time.monotonic()
+            if now >= next_report:
+                stream.report(now - start)
+                next_report += args.i
+    except KeyboardInterrupt:
+        stream.report(time.monotonic() - start)
+    finally:
+        if csv:
+            csv.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,34 @@
+// Polls the dynamic pages of the board and fills the tables of index.html.
+// The requests are made one after the other so that the browser reuses a
+// single connection, the board only has a couple.
+
+function fill(id, values) {
+    var rows = "";
+    for (var key in values) {
+        rows += "<tr><td>" + key + "</td><td class=\"value\">" + values[key] + "</td></tr>";
+    }
+    document.getElementById(id).innerHTML = rows;
+}
+
+function get(path) {
+    return fetch(path, { cache: "no-store" }).then(function (r) {
+        return r.ok ? r.text() : Promise.reject(r.status);
+    });
+}
+
+function poll() {
+    get("/status/adc").then(function (text) {
+        fill("adc", JSON.parse(text));
+        return get("/status/net");
+    }).then(function (text) {
+        fill("net", JSON.parse(text));
+        return get("/status/tasks");
+    }).then(function (text) {
+        document.getElementById("tasks").textContent = text;
+    }).catch(function () {
+    }).then(function () {
+        setTimeout(poll, 1000);
+    });
+}
+
+poll();